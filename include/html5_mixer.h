@@ -1,8 +1,13 @@
 #ifndef HTML5_MIXER_H_
 #define HTML5_MIXER_H_
 
+#ifndef HTML5_MIXER_NATIVE
 #include <emscripten.h>
+#endif
 #include "../src/prerequisites.h"
+#include "../src/music_header.h"
+#include "../src/music_effects.h"
+#include "../src/music_nodes.h"
 
 ////////////////////////////////////////////////////////////////////////
 // Mixer Function Shims
@@ -16,6 +21,11 @@
 #define Mix_LoadMUSType_RW HTML5_Mix_LoadMUSType_RW
 #define Mix_LoadMUS_RW HTML5_Mix_LoadMUS_RW
 #define Mix_FreeMusic HTML5_Mix_FreeMusic
+#define Mix_GetNumMusicDecoders HTML5_Mix_GetNumMusicDecoders
+#define Mix_GetMusicDecoder HTML5_Mix_GetMusicDecoder
+#define Mix_HasMusicDecoder HTML5_Mix_HasMusicDecoder
+#define Mix_SetSoundFonts HTML5_Mix_SetSoundFonts
+#define Mix_GetSoundFonts HTML5_Mix_GetSoundFonts
 #define Mix_HookMusicFinished HTML5_Mix_HookMusicFinished
 #define Mix_PlayMusic HTML5_Mix_PlayMusic
 #define Mix_FadeInMusic HTML5_Mix_FadeInMusic
@@ -27,6 +37,28 @@
 #define Mix_ResumeMusic HTML5_Mix_ResumeMusic
 #define Mix_PausedMusic HTML5_Mix_PausedMusic
 #define Mix_SetMusicPosition HTML5_Mix_SetMusicPosition
+#define Mix_GetMusicPosition HTML5_Mix_GetMusicPosition
+#define Mix_GetMusicLoopStartTime HTML5_Mix_GetMusicLoopStartTime
+#define Mix_GetMusicLoopEndTime HTML5_Mix_GetMusicLoopEndTime
+#define Mix_GetMusicLoopLengthTime HTML5_Mix_GetMusicLoopLengthTime
+#define Mix_MusicDuration HTML5_Mix_MusicDuration
+#define Mix_GetMusicType HTML5_Mix_GetMusicType
+#define Mix_GetMusicTitle HTML5_Mix_GetMusicTitle
+#define Mix_GetMusicTitleTag HTML5_Mix_GetMusicTitleTag
+#define Mix_GetMusicArtistTag HTML5_Mix_GetMusicArtistTag
+#define Mix_GetMusicAlbumTag HTML5_Mix_GetMusicAlbumTag
+#define Mix_GetMusicCopyrightTag HTML5_Mix_GetMusicCopyrightTag
+#endif
+
+// Separate from the music shims: the real SDL Mixer may still own channels
+#ifdef HTML5_MIXER_SHIM_EFFECTS
+#define Mix_RegisterEffect HTML5_Mix_RegisterEffect
+#define Mix_UnregisterEffect HTML5_Mix_UnregisterEffect
+#define Mix_UnregisterAllEffects HTML5_Mix_UnregisterAllEffects
+#define Mix_SetPostMix HTML5_Mix_SetPostMix
+#define Mix_SetPanning HTML5_Mix_SetPanning
+#define Mix_SetPosition HTML5_Mix_SetPosition
+#define Mix_SetDistance HTML5_Mix_SetDistance
 #endif
 
 ////////////////////////////////////////////////////////////////////////
@@ -38,9 +70,57 @@
 extern "C" {
 #endif
 
+/* A set of music streams (stems) played sample-locked on one clock */
+typedef struct _HTML5_Mix_StemGroup HTML5_Mix_StemGroup;
+
+/* A named clip within a sprite file, in seconds. An 'end' at or before
+   'start' runs to the end of the file. */
+typedef struct
+{
+    const char *name;
+    double start;
+    double end;
+} HTML5_Mix_SpriteRegion;
+
+/* What became of a play */
+typedef enum
+{
+    HTML5_MIX_PLAY_PENDING,     /* Not known yet */
+    HTML5_MIX_PLAY_STARTED,
+    HTML5_MIX_PLAY_BLOCKED,     /* Waiting for a user gesture (autoplay policy) */
+    HTML5_MIX_PLAY_FAILED
+} HTML5_Mix_PlayResult;
+
+/* Play queue modes, OR'd together */
+typedef enum
+{
+    HTML5_MIX_QUEUE_NORMAL  = 0x00000000,
+    HTML5_MIX_QUEUE_REPEAT  = 0x00000001,
+    HTML5_MIX_QUEUE_SHUFFLE = 0x00000002
+} HTML5_Mix_QueueMode;
+
+/* How soon music loaded by URL is needed, see HTML5_Mix_PrefetchMusic() */
+typedef enum
+{
+    HTML5_MIX_PREFETCH_NOW,         /* Starts at once, past the limit */
+    HTML5_MIX_PREFETCH_NEXT,
+    HTML5_MIX_PREFETCH_BACKGROUND
+} HTML5_Mix_PrefetchPriority;
+
+/* How much of streamed music the browser loads before it plays */
+typedef enum
+{
+    HTML5_MIX_PRELOAD_NONE,
+    HTML5_MIX_PRELOAD_METADATA,
+    HTML5_MIX_PRELOAD_AUTO
+} HTML5_Mix_Preload;
+
 /* Loads dynamic libraries and prepares them for use.  Flags should be
    one or more flags from MIX_InitFlags OR'd together.
    It returns the flags successfully initialized, or 0 on failure.
+   MIX_INIT_MOD and MIX_INIT_MID load their AudioWorklet renderers now;
+   otherwise they load with the first music that needs them. The other
+   flags report whether the browser plays the format.
  */
 extern DECLSPEC int SDLCALL HTML5_Mix_Init(int flags);
 
@@ -48,7 +128,7 @@ extern DECLSPEC int SDLCALL HTML5_Mix_Init(int flags);
 extern DECLSPEC void SDLCALL HTML5_Mix_Quit(void);
 
 /* Load a wave file or a music (.mod .s3m .it .xm) file */
-extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUS(const char *file);
+extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUS(const char *file);
 
 /* Load a music file from an SDL_RWop object (Ogg and MikMod specific currently)
    Matt Campbell (matt@campbellhome.dhs.org) April 2000 */
@@ -57,14 +137,109 @@ extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUS_RW(SDL_RWops *src, int fre
 /* Load a music file from an SDL_RWop object assuming a specific format */
 extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int freesrc);
 
+/* Load music stored at 'offset' for 'length' bytes inside a remote
+   archive, without downloading the rest of it. 'name' is the track's
+   file name in the archive, whose extension gives its format.
+   Bytes are fetched with HTTP Range requests, or cut out of the whole
+   archive if the server ignores them. Formats Media Source Extensions
+   take play as they download; others are downloaded and decoded first.
+   The browser may drop what was already played of a long stream, so
+   seeking or looping back before what it kept downloads the range again.
+ */
+extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUSRange(const char *url, Sint64 offset, Sint64 length, const char *name);
+
+/* Load the best variant of a music file the browser can play.
+   'basename' has no extension; variants are tried in the order .opus,
+   .ogg, .m4a, .webm, .mp3, .aac, .flac, .wav. The first playable variant
+   that exists in FS is loaded. If none exists, 'basename' is taken to be
+   a URL and the first playable variant is requested from the server.
+ */
+extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUSBest(const char *basename);
+
+/* Load music that plays from a fully decoded AudioBuffer, for stingers
+   and short loops: it starts at once and seeks at no cost. It's decoded
+   once, when loaded, and music with the same content shares the buffer.
+   Playback behaves as for any other music.
+ */
+extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUSDecoded(const char *file);
+extern DECLSPEC Mix_Music * SDLCALL HTML5_Mix_LoadMUSDecoded_RW(SDL_RWops *src, int freesrc);
+
+/* Set how many bytes of decoded PCM are kept for replay, 0 for no limit.
+   Past it, the least recently played buffers are dropped, those of freed
+   music first, and decode again when next played. The default is 64 MB
+   or HTML5_MIXER_DECODED_BUDGET.
+ */
+extern DECLSPEC void SDLCALL HTML5_Mix_SetDecodedMusicBudget(size_t bytes);
+
+/* Get the bytes of decoded PCM currently held */
+extern DECLSPEC size_t SDLCALL HTML5_Mix_GetDecodedMusicBytes(void);
+
+/* Pause music and suspend Web Audio while the page is hidden, saving
+   battery on mobile. Everything resumes where it was when the page is
+   shown again, without Mix_HookMusicFinished() firing. Off by default,
+   or on with HTML5_MIXER_SUSPEND_HIDDEN.
+ */
+extern DECLSPEC void SDLCALL HTML5_Mix_SetSuspendWhenHidden(int enable);
+
+/* Download music loaded by URL ahead of its play, after anything more
+   urgent. It then plays from memory. Decoded music is decoded as well.
+   Nothing is downloaded until this is called, or until the music plays
+   or is next in the play queue. Freeing the music cancels its download.
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_PrefetchMusic(Mix_Music *music, HTML5_Mix_PrefetchPriority priority);
+extern DECLSPEC void SDLCALL HTML5_Mix_CancelPrefetch(Mix_Music *music);
+
+/* Set how many downloads run at once, 0 for no limit, so that music
+   doesn't compete with other game data. Those of priority
+   HTML5_MIX_PREFETCH_NOW don't count. The default is 2 or
+   HTML5_MIXER_MAX_PREFETCHES.
+ */
+extern DECLSPEC void SDLCALL HTML5_Mix_SetMaxPrefetches(int count);
+
+/* Set how much of streamed music the browser loads before it plays. The
+   default is HTML5_MIX_PRELOAD_AUTO, or HTML5_MIXER_PRELOAD as "none",
+   "metadata" or "auto".
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicPreload(HTML5_Mix_Preload preload);
+
 /* Free an audio chunk previously loaded */
 extern DECLSPEC void SDLCALL HTML5_Mix_FreeMusic(Mix_Music *music);
 
+/* Get a list of music decoders, i.e. formats this browser can play, such
+   as "OGG" or "MP3", plus "MOD" for ProTracker modules and "MIDI", which
+   are rendered on an AudioWorklet. Formats are probed once by HTML5_Mix_Init(), so
+   these don't call into the browser.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_GetNumMusicDecoders(void);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicDecoder(int index);
+extern DECLSPEC SDL_bool SDLCALL HTML5_Mix_HasMusicDecoder(const char *name);
+
+/* Set the SoundFonts MIDI music is synthesized with, as paths separated
+   by ';' or ':', first match first, or NULL to forget them. The files are
+   read once and moved to the audio thread, where every song shares them.
+   MIDI music can't be loaded until this is set.
+   It returns 1 on success, or 0 if no SoundFont could be read.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetSoundFonts(const char *paths);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetSoundFonts(void);
+
 /* Add your own callback for when the music has finished playing or when it is
  * stopped from a call to Mix_HaltMusic.
+ * In HTML5_MIXER_NATIVE builds, music that ends by itself calls this from the
+ * next call into any HTML5_Mix_* function, on your thread; call
+ * HTML5_Mix_PlayingMusic() once a frame if nothing else does. The music
+ * queue advances the same way.
  */
 extern DECLSPEC void SDLCALL HTML5_Mix_HookMusicFinished(void (SDLCALL *music_finished)(void));
 
+/* Add your own callback for when more of a streamed music object has
+   loaded, to update a loading display. Read the new range with
+   HTML5_Mix_GetMusicBuffered().
+ */
+extern DECLSPEC void SDLCALL HTML5_Mix_HookMusicBuffered(void (SDLCALL *music_buffered)(void));
+
 /* Play an audio chunk on a specific channel.
    If 'loops' is greater than zero, loop the sound that many times.
    If 'loops' is -1, loop inifinitely (~65000 times).
@@ -72,6 +247,37 @@ extern DECLSPEC void SDLCALL HTML5_Mix_HookMusicFinished(void (SDLCALL *music_fi
 */
 extern DECLSPEC int SDLCALL HTML5_Mix_PlayMusic(Mix_Music *music, int loops);
 
+/* Play music as HTML5_Mix_PlayMusic() does, and return a ticket telling
+   what became of it, or -1 on error. Poll it with HTML5_Mix_GetPlayResult()
+   instead of retrying plays that autoplay policy blocks.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_PlayMusicTicket(Mix_Music *music, int loops);
+
+/* Get the HTML5_Mix_PlayResult of a ticket. A final result is returned
+   once, then the ticket is forgotten.
+   Returns -1 for an unknown ticket.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_GetPlayResult(int ticket);
+
+/* Whether audio has been unlocked by a user gesture. Read from memory
+   JS writes, so it is cheap to check every frame.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_IsAudioUnlocked(void);
+
+/* Unlock audio now. Only works when called from a user gesture handler,
+   for games that listen for gestures on elements of their own. Key and
+   mouse presses on the document or canvas unlock audio by themselves.
+*/
+extern DECLSPEC void SDLCALL HTML5_Mix_UnlockAudio(void);
+
+#ifdef HTML5_MIXER_ASYNCIFY
+/* Play music and wait until it starts, is blocked or fails. Build with
+   -sASYNCIFY or -sJSPI and define HTML5_MIXER_ASYNCIFY.
+   Returns an HTML5_Mix_PlayResult other than pending, or -1 on error.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_PlayMusicAwait(Mix_Music *music, int loops);
+#endif
+
 /* Fade in music or a channel over "ms" milliseconds, same semantics as the "Play" functions */
 extern DECLSPEC int SDLCALL HTML5_Mix_FadeInMusic(Mix_Music *music, int loops, int ms);
 extern DECLSPEC int SDLCALL HTML5_Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position);
@@ -94,6 +300,7 @@ extern DECLSPEC int SDLCALL HTML5_Mix_HaltMusic(void);
 /* Pause/Resume the music stream */
 extern DECLSPEC void SDLCALL HTML5_Mix_PauseMusic(void);
 extern DECLSPEC void SDLCALL HTML5_Mix_ResumeMusic(void);
+extern DECLSPEC SDL_bool SDLCALL HTML5_Mix_PausedMusic(void);
 
 /* Set the current position in the music stream.
    This returns 0 if successful, or -1 if it failed or isn't implemented.
@@ -103,6 +310,288 @@ extern DECLSPEC void SDLCALL HTML5_Mix_ResumeMusic(void);
 */
 extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicPosition(double position);
 
+/* Get the current play position of the music, in seconds of media time.
+   If 'music' is NULL, use the currently playing music.
+   Returns -1.0 if this feature is not supported.
+*/
+extern DECLSPEC double SDLCALL HTML5_Mix_GetMusicPosition(Mix_Music *music);
+
+/* Set the playback rate of the music, where 1.0 is normal speed.
+   If 'preserve_pitch' is non-zero, the browser keeps the original pitch.
+   Music with a loop region always changes pitch with the rate.
+   Loop timing and positions follow the new rate.
+   If 'music' is NULL, use the currently playing music.
+   Returns 0, or -1 on failure.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicSpeed(Mix_Music *music, double rate, int preserve_pitch);
+
+/* Set the loop region of a music object, in seconds. The music plays
+   from the beginning, then repeats 'start' to 'end' for each further loop,
+   then plays out the remainder after 'end'. An 'end' of 0 loops to the end.
+   Setting both to 0 removes the loop region.
+   Music with a loop region is decoded and looped on the audio thread, so
+   there are no seeks when it wraps. Changes apply to the music if it is
+   playing.
+   Returns 0, or -1 on failure.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicLoopPoints(Mix_Music *music, double start, double end);
+
+/* Get the loop region of the music, in seconds. If 'music' is NULL, use
+   the currently playing music.
+   Returns -1.0 if the music has no loop region.
+*/
+extern DECLSPEC double SDLCALL HTML5_Mix_GetMusicLoopStartTime(Mix_Music *music);
+extern DECLSPEC double SDLCALL HTML5_Mix_GetMusicLoopEndTime(Mix_Music *music);
+extern DECLSPEC double SDLCALL HTML5_Mix_GetMusicLoopLengthTime(Mix_Music *music);
+
+/* Register a special effect function on MIX_CHANNEL_POST, the only
+   channel music has. Effects run in registration order on the audio
+   thread, on blocks of MUSIC_EFFECTS_FRAMES frames of interleaved stereo
+   AUDIO_F32SYS at the audio context's rate, so they must not touch state
+   the main thread changes without synchronizing. 'd' is called on the
+   main thread once the effect is unregistered.
+   These need a build with -sAUDIO_WORKLET -sWASM_WORKERS and
+   HTML5_MIXER_AUDIO_WORKLET defined; otherwise they fail.
+   Returns zero if error (no such channel), nonzero if added.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_RegisterEffect(int chan, Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg);
+
+/* Remove the first registration of 'f', or all effects.
+   Returns zero if error (no such channel or effect), nonzero if removed.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_UnregisterEffect(int channel, Mix_EffectFunc_t f);
+extern DECLSPEC int SDLCALL HTML5_Mix_UnregisterAllEffects(int channel);
+
+/* Set a function that is called after all effects, or NULL to remove it.
+   The stream is as for effects.
+ */
+extern DECLSPEC void SDLCALL HTML5_Mix_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg);
+
+/* Get what running the effects cost since the last call.
+   Returns 0 on success, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicEffectStats(HTML5_Mix_EffectStats *stats);
+
+/* Native Web Audio effects on music, run by the browser rather than in
+   wasm and kept across tracks. Parameters ramp over 'ms' milliseconds.
+   Each effect leaves the graph once set back to neutral. These need
+   HTML5 music opened first.
+   All return 0 on success, or -1 on error.
+ */
+
+/* Filter music through a BiquadFilterNode, HTML5_MIX_FILTER_NONE
+   removing it. 'frequency' is in Hz; 'gain' in dB applies to shelves
+   and peaking only.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicFilter(HTML5_Mix_FilterType type, float frequency, float q, float gain, int ms);
+
+/* As Mix_SetPanning(): the volume of each side, 255 being full */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicPanning(Uint8 left, Uint8 right, int ms);
+
+/* As Mix_SetPosition(): 'angle' in degrees clockwise from ahead,
+   'distance' from 0 (near) to 255 (inaudible)
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicDirection(Sint16 angle, Uint8 distance, int ms);
+
+/* Compress music: 'threshold' and 'knee' in dB, 'attack' and 'release'
+   in seconds. A 'ratio' of 1 or less removes the compressor.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicCompressor(float threshold, float knee, float ratio, float attack, float release, int ms);
+
+/* Use an impulse response from FS or a URL for reverb, or NULL for the
+   built-in room. The file is decoded in the background.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_LoadMusicReverb(const char *file);
+
+/* Mix in reverb at 'wet' from 0 to 1, 0 removing it */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicReverb(float wet, int ms);
+
+/* SDL Mixer's positional effects, applied to music through the nodes
+   above. Only MIX_CHANNEL_POST is accepted.
+   Returns zero if error, nonzero if set.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetPanning(int channel, Uint8 left, Uint8 right);
+extern DECLSPEC int SDLCALL HTML5_Mix_SetPosition(int channel, Sint16 angle, Uint8 distance);
+extern DECLSPEC int SDLCALL HTML5_Mix_SetDistance(int channel, Uint8 distance);
+
+/* Ducking lowers music under voice or effects, with the fades run by
+   the browser rather than by per-frame volume calls. Music stays ducked
+   while any trigger is held or a timed duck lasts.
+   All return 0 on success, or -1 on error (HTML5 music not opened).
+ */
+
+/* Set the ducked volume, from 0 to 1 of normal (default 0.25), and the
+   fade down and back up (default 50 and 400 ms)
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicDucking(float volume, int attack_ms, int release_ms);
+
+/* Hold or release a trigger: any number, such as the channel playing a
+   voice line, e.g. released from a Mix_ChannelFinished() callback
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_DuckMusic(int trigger);
+extern DECLSPEC int SDLCALL HTML5_Mix_UnduckMusic(int trigger);
+
+/* Duck for 'ms' milliseconds from now, e.g. the length of a voice line */
+extern DECLSPEC int SDLCALL HTML5_Mix_DuckMusicFor(int ms);
+
+/* Configure the analyser on music: 'fft_size' a power of two from 32 to
+   32768 (default 2048), 'smoothing' of the spectrum over time from 0 to
+   1 (default 0.8). Music plays through Web Audio from the first call.
+   Returns 0 on success, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_SetMusicAnalyser(int fft_size, float smoothing);
+
+/* Fill 'out' with the music's spectrum in dB, one value per bin of
+   sampleRate / fft_size Hz, at most fft_size / 2 bins. Silence reads
+   as -infinity. The buffer is written in place, so this is cheap
+   enough to call every frame.
+   Returns the number of bins written, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicSpectrum(float *out, int bins);
+
+/* Fill 'out' with the latest music samples, from -1 to 1, at most
+   fft_size of them.
+   Returns the number of samples written, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicWaveform(float *out, int samples);
+
+/* Get the length of the music in seconds. If 'music' is NULL, use the
+   currently playing music.
+   The length comes from the file header when it was loaded from FS or
+   memory, otherwise from the browser once it knows it.
+   Returns -1.0 if the length is unknown.
+*/
+extern DECLSPEC double SDLCALL HTML5_Mix_MusicDuration(Mix_Music *music);
+
+/* Get the range of the music, in seconds, that the browser has loaded
+   ahead of the play position, or the next range after it. If 'music' is
+   NULL, use the currently playing music. Streamed music only loads once
+   it plays or is prefetched; other music reports its whole length.
+   The range is kept in wasm memory, so this is cheap enough to call
+   every frame. Either pointer may be NULL.
+   Returns 0, or -1 if there is no music.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicBuffered(Mix_Music *music, double *start, double *end);
+
+/* Find out the format of a music object, detected from its leading bytes
+   or, for URLs, its file extension. If 'music' is NULL, use the currently
+   playing music. Formats SDL_mixer has no decoder for, such as MP4 and
+   WebM, report MUS_HTML5.
+   Returns MUS_NONE if no music is playing.
+*/
+extern DECLSPEC Mix_MusicType SDLCALL HTML5_Mix_GetMusicType(const Mix_Music *music);
+
+/* Get the tags of the music, read from the file header when it was loaded.
+   If 'music' is NULL, use the currently playing music.
+   HTML5_Mix_GetMusicTitle() falls back to the file name without its path.
+   Returns "" if the tag is not present.
+*/
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicTitle(const Mix_Music *music);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicTitleTag(const Mix_Music *music);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicArtistTag(const Mix_Music *music);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicAlbumTag(const Mix_Music *music);
+extern DECLSPEC const char * SDLCALL HTML5_Mix_GetMusicCopyrightTag(const Mix_Music *music);
+
+/* Read the format, length, sample rate and tags of a music file without
+   loading it. Only the file header (a few KB) is read, which is cheap
+   enough to build track lists from.
+   Returns 0, or -1 if the format is not recognized.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicInfo(const char *file, HTML5_Mix_MusicInfo *info);
+extern DECLSPEC int SDLCALL HTML5_Mix_GetMusicInfo_RW(SDL_RWops *src, HTML5_Mix_MusicInfo *info);
+
+/* Create a stem group from 'num_stems' loaded music objects.
+   The stems are decoded once and started together on a single Web Audio
+   timeline, so they never drift apart. Stems should have equal length.
+   Free the group before freeing any of its stems.
+   Returns NULL on failure.
+*/
+extern DECLSPEC HTML5_Mix_StemGroup * SDLCALL HTML5_Mix_CreateStemGroup(Mix_Music **stems, int num_stems);
+extern DECLSPEC void SDLCALL HTML5_Mix_FreeStemGroup(HTML5_Mix_StemGroup *group);
+
+/* Play all stems of a group from the beginning, same 'loops' semantics as
+   HTML5_Mix_PlayMusic(). Playback starts once every stem is decoded.
+   Stem groups play independently of the music stream.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_PlayStemGroup(HTML5_Mix_StemGroup *group, int loops);
+extern DECLSPEC int SDLCALL HTML5_Mix_HaltStemGroup(HTML5_Mix_StemGroup *group);
+extern DECLSPEC void SDLCALL HTML5_Mix_PauseStemGroup(HTML5_Mix_StemGroup *group);
+extern DECLSPEC void SDLCALL HTML5_Mix_ResumeStemGroup(HTML5_Mix_StemGroup *group);
+extern DECLSPEC int SDLCALL HTML5_Mix_PlayingStemGroup(HTML5_Mix_StemGroup *group);
+
+/* Ramp the volume (0-128) of a stem over "ms" milliseconds.
+   If 'stem' is -1, set the volume of all stems.
+   The ramp runs on the audio thread.
+   Returns 0, or -1 if the stem index is invalid.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_VolumeStem(HTML5_Mix_StemGroup *group, int stem, int volume, int ms);
+
+/* Name regions of a music to play as clips, e.g. many UI sounds in one
+   file. The file is fetched and decoded once, shared with the decoded
+   music cache, and decoding starts now. Names given again are replaced.
+   Returns 0, or -1 on error.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_SetSpriteRegions(Mix_Music *music, const HTML5_Mix_SpriteRegion *regions, int num_regions);
+
+/* Play a region once as a clip. Clips overlap freely and play apart from
+   the music stream and its effects; they stop when the music is freed.
+   Returns a handle for HTML5_Mix_HaltSprite(), or -1 on error.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_PlaySprite(Mix_Music *music, const char *region);
+
+/* Stop a clip, or every clip if 'handle' is -1 */
+extern DECLSPEC void SDLCALL HTML5_Mix_HaltSprite(int handle);
+
+/* Set the volume (0-128) of all clips, or query it if 'volume' is -1.
+   Returns the previous volume.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_VolumeSprites(int volume);
+
+/* Append music to the play queue, same 'loops' semantics as
+   HTML5_Mix_PlayMusic(). If no music is playing, it plays immediately.
+   When the current music finishes, the next queued entry starts. The next
+   entry starts buffering HTML5_MIXER_PREFETCH_SECONDS before the current
+   one ends, so the transition does not wait on the network.
+   The finished hook still runs for every track that ends, before the
+   next entry starts. If the hook plays music itself, the queue waits
+   for that music to finish.
+   Returns 0, or -1 on failure.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_QueueMusic(Mix_Music *music, int loops);
+extern DECLSPEC void SDLCALL HTML5_Mix_ClearQueue(void);
+extern DECLSPEC int SDLCALL HTML5_Mix_GetQueueLength(void);
+
+/* Set one or more flags from HTML5_Mix_QueueMode OR'd together.
+   REPEAT moves each entry to the back of the queue once it plays.
+   SHUFFLE picks the next entry at random.
+*/
+extern DECLSPEC void SDLCALL HTML5_Mix_SetQueueMode(int mode);
+
+/* Halt the current music and play the next queued entry.
+   Returns 0, or -1 if the queue is empty.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_SkipMusic(void);
+
+#ifdef HTML5_MIXER_TRACE
+/* Record every HTML5_Mix_*() call with its arguments and time into a
+   compact binary trace, for tools/trace_replay.c to replay. Music loaded
+   from memory is stored in the trace whole. Starting again discards the
+   previous trace.
+   Returns 0, or -1 on error.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_StartTrace(void);
+
+/* Stop recording and write the trace to 'file' in FS, unless NULL.
+   Returns 0, or -1 on error.
+*/
+extern DECLSPEC int SDLCALL HTML5_Mix_StopTrace(const char *file);
+
+/* Get the trace recorded so far and its size in bytes. Valid until
+   recording starts again.
+*/
+extern DECLSPEC const void * SDLCALL HTML5_Mix_GetTrace(size_t *size);
+#endif
+
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
 }
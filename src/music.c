@@ -23,46 +23,302 @@
 
 #include "../include/html5_mixer.h"
 #include "music_html5.h"
+#include "music_native.h"
+#include "music_sdl_mixer.h"
+#include "music_mod.h"
+#include "music_midi.h"
+#include "music_effects.h"
+#include "music_nodes.h"
+#include "music_trace.h"
 
 static Mix_Music *music_playing;
+
+/* Variants tried by HTML5_Mix_LoadMUSBest(), best first */
+static const Mix_MusicFormat music_format_preference[] = {
+	MUSIC_FORMAT_OPUS,
+	MUSIC_FORMAT_OGG,
+	MUSIC_FORMAT_MP4,
+	MUSIC_FORMAT_WEBM,
+	MUSIC_FORMAT_MP3,
+	MUSIC_FORMAT_AAC,
+	MUSIC_FORMAT_FLAC,
+	MUSIC_FORMAT_WAV
+};
 static SDL_bool music_active = SDL_TRUE;
+static SDL_bool music_halting = SDL_FALSE;
 static void (SDLCALL *music_finished_hook)(void) = NULL;
+static void (SDLCALL *music_buffered_hook)(void) = NULL;
+
+typedef struct {
+	Mix_Music *music;
+	int loops;
+} MusicQueueEntry;
+
+static MusicQueueEntry *music_queue = NULL;
+static int music_queue_length = 0;
+static int music_queue_capacity = 0;
+static int music_queue_next = -1;
+static int music_queue_mode = HTML5_MIX_QUEUE_NORMAL;
+
+static void music_queue_advance(void);
+
+/* Native interfaces hear music end on their own threads. Every public
+   call first finishes it here, on the application's thread, so the
+   hook and the queue run without the application polling
+   HTML5_Mix_PlayingMusic(). The HTML5 interface finishes music from
+   the <audio> "ended" event instead. */
+#ifdef MUSIC_NATIVE
+static void music_drain(void)
+{
+	if (music_playing)
+		music_playing->interface->IsPlaying(music_playing->context);
+}
+
+#define MUSIC_ENTER(name, ...) MUSIC_TRACE(name, ##__VA_ARGS__); music_drain()
+#else
+#define MUSIC_ENTER(name, ...) MUSIC_TRACE(name, ##__VA_ARGS__)
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// Backends
+////////////////////////////////////////////////////////////////////////
+
+/* The interface taking all music no other one is dedicated to */
+#ifdef MUSIC_NATIVE
+#define music_default_interface Mix_MusicInterface_NATIVE
+#define music_default_has_format MusicNative_HasFormat
+#else
+#define music_default_interface Mix_MusicInterface_HTML5
+#define music_default_has_format MusicHTML5_HasFormat
+#endif
+
+/* Music goes to the interface whose tag names its format, if one is
+   built in; the browser takes everything else. Worklet renderers are
+   listed first and share the browser interface's audio context, so it
+   stays last. */
+static Mix_MusicInterface *music_interfaces[] = {
+#ifdef MUSIC_MOD_WORKLET
+	&Mix_MusicInterface_MOD,
+#endif
+#ifdef MUSIC_MID_WORKLET
+	&Mix_MusicInterface_MIDI,
+#endif
+#ifdef MUSIC_SDL_MIXER
+	&Mix_MusicInterface_SDL_MIXER,
+#endif
+	&music_default_interface
+};
+
+static SDL_bool music_open_interface(Mix_MusicInterface *interface)
+{
+	if (!interface->loaded) {
+		if (interface->Load && interface->Load() < 0)
+			return SDL_FALSE;
+		interface->loaded = SDL_TRUE;
+	}
+
+	if (!interface->opened) {
+		if (interface->Open && interface->Open(0) < 0)
+			return SDL_FALSE;
+		interface->opened = SDL_TRUE;
+	}
+
+	return SDL_TRUE;
+}
+
+/* Open every interface rendering music of this type */
+static SDL_bool music_open_type(Mix_MusicType type)
+{
+	SDL_bool opened = SDL_FALSE;
+	size_t i;
+
+	for (i = 0; i < SDL_arraysize(music_interfaces); ++i)
+		if (music_interfaces[i]->type == type && music_open_interface(music_interfaces[i]))
+			opened = SDL_TRUE;
+
+	return opened;
+}
+
+/* The built-in interface dedicated to a format, or NULL */
+static Mix_MusicInterface *music_find_interface(Mix_MusicFormat format)
+{
+	const char *name = music_probe_name(format);
+	size_t i;
+
+	if (format == MUSIC_FORMAT_UNKNOWN || name == NULL)
+		return NULL;
+
+	for (i = 0; i < SDL_arraysize(music_interfaces); ++i)
+		if (music_interfaces[i] != &music_default_interface
+			&& SDL_strcasecmp(music_interfaces[i]->tag, name) == 0)
+			return music_interfaces[i];
+
+	return NULL;
+}
+
+/* Pick the interface for some music, loading it on first use. If that
+   fails, the browser gets the music and reports its own error. */
+static Mix_MusicInterface *music_select_interface(Mix_MusicFormat format)
+{
+	Mix_MusicInterface *interface = music_find_interface(format);
+
+	if (interface && music_open_interface(interface))
+		return interface;
+
+#ifdef MUSIC_SDL_MIXER
+	// SDL Mixer takes what the native interface can't decode, and sniffs
+	// what we couldn't tell
+	if (!music_default_has_format(format)
+		&& (format == MUSIC_FORMAT_UNKNOWN || MusicSDLMixer_HasFormat(format))
+		&& music_open_interface(&Mix_MusicInterface_SDL_MIXER))
+		return &Mix_MusicInterface_SDL_MIXER;
+#endif
+
+	return &music_default_interface;
+}
+
+/* Pick the interface for a type the caller gave, whatever the data looks
+   like, loading it on first use */
+static Mix_MusicInterface *music_select_type(Mix_MusicType type)
+{
+	size_t i;
+
+	for (i = 0; i < SDL_arraysize(music_interfaces); ++i)
+		if (music_interfaces[i] != &music_default_interface
+			&& music_interfaces[i]->type == type
+			&& music_open_interface(music_interfaces[i]))
+			return music_interfaces[i];
+
+#ifdef MUSIC_SDL_MIXER
+	if (type != MUS_WAV && music_open_interface(&Mix_MusicInterface_SDL_MIXER))
+		return &Mix_MusicInterface_SDL_MIXER;
+#endif
+
+	return &music_default_interface;
+}
+
+/* Sniff music in FS; URLs only have their extension to go by */
+static Mix_MusicFormat music_probe_file(const char *file)
+{
+	Mix_MusicFormat format = MUSIC_FORMAT_UNKNOWN;
+	SDL_RWops *src = SDL_RWFromFile(file, "rb");
+
+	if (src) {
+		format = music_probe_rw(src);
+		SDL_RWclose(src);
+	}
+
+	if (format == MUSIC_FORMAT_UNKNOWN)
+		format = music_probe_extension(file);
+
+	return format;
+}
+
+/* Formats the browser plays, plus those rendered by other interfaces */
+static SDL_bool music_has_format(Mix_MusicFormat format)
+{
+	if (music_find_interface(format))
+		return SDL_TRUE;
+#ifdef MUSIC_SDL_MIXER
+	if (MusicSDLMixer_HasFormat(format))
+		return SDL_TRUE;
+#endif
+	return music_default_has_format(format);
+}
 
 ////////////////////////////////////////////////////////////////////////
 // 
 ////////////////////////////////////////////////////////////////////////
 
+/* Flags of formats the browser decodes itself */
+static const struct {
+	int flag;
+	Mix_MusicFormat format;
+} music_init_formats[] = {
+	{ MIX_INIT_FLAC, MUSIC_FORMAT_FLAC },
+	{ MIX_INIT_MP3, MUSIC_FORMAT_MP3 },
+	{ MIX_INIT_OGG, MUSIC_FORMAT_OGG },
+	{ MIX_INIT_OPUS, MUSIC_FORMAT_OPUS }
+};
+
 int HTML5_Mix_Init(int flags)
 {
+	MUSIC_ENTER(Init, flags);
+	int result = 0;
+	size_t i;
+
 	// In SDL Mixer, this happens in Mix_OpenAudio().
 	// We don't shim that, so HACK: do it here.
 
-	Mix_MusicInterface_HTML5.Open(0);
-	Mix_MusicInterface_HTML5.loaded = SDL_TRUE;
+	if (!music_open_interface(&music_default_interface))
+		return 0;
+
+	// Other backends otherwise load with the first music that needs them
+	if ((flags & MIX_INIT_MOD) && music_open_type(MUS_MOD))
+		result |= MIX_INIT_MOD;
+	if ((flags & MIX_INIT_MID) && music_open_type(MUS_MID))
+		result |= MIX_INIT_MID;
 
-	return flags;
+	for (i = 0; i < SDL_arraysize(music_init_formats); ++i)
+		if ((flags & music_init_formats[i].flag) && music_has_format(music_init_formats[i].format))
+			result |= music_init_formats[i].flag;
+
+	return result;
 }
 
 /* Unloads libraries loaded with Mix_Init */
 void HTML5_Mix_Quit(void)
 {
+	MUSIC_ENTER(Quit);
+	size_t i;
+
 	// In SDL Mixer, this happens in Mix_CloseAudio().
 	// We don't shim that, so HACK: do it here.
 
 	if (music_playing)
 		HTML5_Mix_HaltMusic();
 
-	Mix_MusicInterface_HTML5.Close();
+	// As Mix_CloseAudio() does, before the context goes
+	MusicEffects_Close();
+
+	// The browser interface is last; the others render on its context
+	for (i = 0; i < SDL_arraysize(music_interfaces); ++i) {
+		Mix_MusicInterface *interface = music_interfaces[i];
+
+		if (interface->opened && interface->Close)
+			interface->Close();
+		interface->opened = SDL_FALSE;
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////
 // 
 ////////////////////////////////////////////////////////////////////////
 
+/* Keep the file name, without its path, as a fallback title */
+static void music_set_filename(Mix_Music *music, const char *file)
+{
+	const char *name = file;
+	size_t len;
+
+	for (; *file; ++file)
+		if (*file == '/' || *file == '\\')
+			name = file + 1;
+
+	len = SDL_strlen(name);
+	if (len >= sizeof music->filename)
+		len = sizeof music->filename - 1;
+
+	SDL_memcpy(music->filename, name, len);
+	music->filename[len] = '\0';
+}
+
 /* Load a music file */
 Mix_Music *HTML5_Mix_LoadMUS(const char *file)
 {
-	void *context = Mix_MusicInterface_HTML5.CreateFromFile(file);
+	MUSIC_ENTER(LoadMUS, file);
+	Mix_MusicInterface *interface = music_select_interface(music_probe_file(file));
+	void *context = interface->CreateFromFile(file);
 
 	if (context)
 	{
@@ -71,8 +327,10 @@ Mix_Music *HTML5_Mix_LoadMUS(const char *file)
 			Mix_SetError("Out of memory");
 			return NULL;
 		}
-		music->interface = &Mix_MusicInterface_HTML5;
+		music->interface = interface;
 		music->context = context;
+		MUSIC_TRACE_CREATED(music);
+		music_set_filename(music, file);
 		return music;
 	}
 
@@ -82,14 +340,62 @@ Mix_Music *HTML5_Mix_LoadMUS(const char *file)
 	return NULL;
 }
 
+/* Load music from a byte range of a remote archive. Its name in the
+   archive gives the format, as a URL's does. */
+Mix_Music *HTML5_Mix_LoadMUSRange(const char *url, Sint64 offset, Sint64 length, const char *name)
+{
+	MUSIC_ENTER(LoadMUSRange, url, offset, length, name);
+	Mix_Music *music;
+	void *context;
+
+	if (url == NULL || offset < 0 || length <= 0) {
+		Mix_SetError("Invalid music range");
+		return NULL;
+	}
+
+	if (!music_open_interface(&music_default_interface))
+		return NULL;
+
+	context = MusicHTML5_CreateFromRange(url, offset, length,
+		name ? music_probe_extension(name) : MUSIC_FORMAT_UNKNOWN);
+	if (context == NULL)
+		return NULL;
+
+	music = (Mix_Music *)SDL_calloc(1, sizeof(Mix_Music));
+	if (music == NULL) {
+		music_default_interface.Delete(context);
+		Mix_SetError("Out of memory");
+		return NULL;
+	}
+	music->interface = &music_default_interface;
+	music->context = context;
+	MUSIC_TRACE_CREATED(music);
+	music_set_filename(music, name ? name : url);
+	return music;
+}
+
 Mix_Music *HTML5_Mix_LoadMUS_RW(SDL_RWops *src, int freesrc)
 {
+	MUSIC_ENTER(LoadMUS_RW, src, freesrc);
 	return HTML5_Mix_LoadMUSType_RW(src, MUS_NONE, freesrc);
 }
 
 Mix_Music *HTML5_Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int freesrc)
 {
-	void *context = Mix_MusicInterface_HTML5.CreateFromRW(src, freesrc);
+	MUSIC_ENTER(LoadMUSType_RW, src, type, freesrc);
+	Mix_MusicInterface *interface;
+	void *context;
+
+	// A type given by the caller wins over what the data looks like,
+	// as in SDL Mixer
+	if (type != MUS_NONE)
+		interface = music_select_type(type);
+	else
+		interface = music_select_interface(music_probe_rw(src));
+
+	context = interface->CreateFromRW(src, freesrc);
+	if (context == NULL && freesrc && interface != &music_default_interface)
+		SDL_RWclose(src);
 
 	if (context)
 	{
@@ -98,21 +404,161 @@ Mix_Music *HTML5_Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int free
 			Mix_SetError("Out of memory");
 			return NULL;
 		}
-		music->interface = &Mix_MusicInterface_HTML5;
+		music->interface = interface;
 		music->context = context;
+		MUSIC_TRACE_CREATED(music);
 		return music;
 	}
 
 	return NULL;
 }
 
+/* Load the best variant of a track the browser can play, e.g. "music/title"
+   loads "music/title.opus" over "music/title.ogg" */
+Mix_Music *HTML5_Mix_LoadMUSBest(const char *basename)
+{
+	MUSIC_ENTER(LoadMUSBest, basename);
+	char file[1024];
+	Mix_MusicFormat fallback = MUSIC_FORMAT_UNKNOWN;
+	size_t i;
+
+	for (i = 0; i < sizeof music_format_preference / sizeof *music_format_preference; ++i)
+	{
+		Mix_MusicFormat format = music_format_preference[i];
+		SDL_RWops *src;
+
+		if (!music_has_format(format))
+			continue;
+
+		if (fallback == MUSIC_FORMAT_UNKNOWN)
+			fallback = format;
+
+		// Take the first variant that exists in FS
+		SDL_snprintf(file, sizeof file, "%s.%s", basename, music_probe_extension_name(format));
+		src = SDL_RWFromFile(file, "rb");
+		if (src) {
+			SDL_RWclose(src);
+			return HTML5_Mix_LoadMUS(file);
+		}
+	}
+
+	if (fallback == MUSIC_FORMAT_UNKNOWN) {
+		Mix_SetError("No music decoders available");
+		return NULL;
+	}
+
+	// Not in FS, so it's a URL; we can't tell which variants the server
+	// has, so ask for the preferred one.
+	SDL_snprintf(file, sizeof file, "%s.%s", basename, music_probe_extension_name(fallback));
+	return HTML5_Mix_LoadMUS(file);
+}
+
+/* Music rendered by worklets is ready at once already */
+static Mix_Music *music_decode(Mix_Music *music)
+{
+	if (music && music->interface == &music_default_interface)
+		MusicHTML5_Decode(music->context);
+
+	return music;
+}
+
+Mix_Music *HTML5_Mix_LoadMUSDecoded(const char *file)
+{
+	MUSIC_ENTER(LoadMUSDecoded, file);
+	return music_decode(HTML5_Mix_LoadMUS(file));
+}
+
+Mix_Music *HTML5_Mix_LoadMUSDecoded_RW(SDL_RWops *src, int freesrc)
+{
+	MUSIC_ENTER(LoadMUSDecoded_RW, src, freesrc);
+	return music_decode(HTML5_Mix_LoadMUS_RW(src, freesrc));
+}
+
+void HTML5_Mix_SetDecodedMusicBudget(size_t bytes)
+{
+	MUSIC_ENTER(SetDecodedMusicBudget, bytes);
+	MusicHTML5_SetDecodedBudget((double)bytes);
+}
+
+size_t HTML5_Mix_GetDecodedMusicBytes(void)
+{
+	MUSIC_ENTER(GetDecodedMusicBytes);
+	return (size_t)MusicHTML5_GetDecodedBytes();
+}
+
+void HTML5_Mix_SetSuspendWhenHidden(int enable)
+{
+	MUSIC_ENTER(SetSuspendWhenHidden, enable);
+	MusicHTML5_SetSuspendWhenHidden(enable ? SDL_TRUE : SDL_FALSE);
+}
+
+int HTML5_Mix_PrefetchMusic(Mix_Music *music, HTML5_Mix_PrefetchPriority priority)
+{
+	MUSIC_ENTER(PrefetchMusic, music, priority);
+	if (music == NULL) {
+		Mix_SetError("Invalid music");
+		return -1;
+	}
+
+	if (priority < HTML5_MIX_PREFETCH_NOW || priority > HTML5_MIX_PREFETCH_BACKGROUND) {
+		Mix_SetError("Invalid prefetch priority: %d", priority);
+		return -1;
+	}
+
+	// Worklet music has nothing to download; its processor warms up
+	if (music->interface == &music_default_interface)
+		MusicHTML5_PrefetchMusic(music->context, priority);
+	else if (music->interface->Prefetch)
+		music->interface->Prefetch(music->context);
+	return(0);
+}
+
+void HTML5_Mix_CancelPrefetch(Mix_Music *music)
+{
+	MUSIC_ENTER(CancelPrefetch, music);
+	if (music && music->interface == &music_default_interface)
+		MusicHTML5_CancelPrefetch(music->context);
+}
+
+void HTML5_Mix_SetMaxPrefetches(int count)
+{
+	MUSIC_ENTER(SetMaxPrefetches, count);
+	MusicHTML5_SetMaxPrefetches(count);
+}
+
+int HTML5_Mix_SetMusicPreload(HTML5_Mix_Preload preload)
+{
+	MUSIC_ENTER(SetMusicPreload, preload);
+	if (preload < HTML5_MIX_PRELOAD_NONE || preload > HTML5_MIX_PRELOAD_AUTO) {
+		Mix_SetError("Invalid preload: %d", preload);
+		return -1;
+	}
+
+	MusicHTML5_SetPreload(preload);
+	return(0);
+}
+
 void HTML5_Mix_FreeMusic(Mix_Music *music)
 {
+	MUSIC_ENTER(FreeMusic, music);
+	int i;
+
 	if (music_playing == music)
 		HTML5_Mix_HaltMusic();
 
+	// Drop any queued plays of this music
+	for (i = music_queue_length - 1; i >= 0; --i)
+	{
+		if (music_queue[i].music == music) {
+			SDL_memmove(&music_queue[i], &music_queue[i + 1],
+				(music_queue_length - i - 1) * sizeof *music_queue);
+			--music_queue_length;
+		}
+	}
+	music_queue_next = -1;
+
 	// TODO: Wait for any fade out to finish
-	Mix_MusicInterface_HTML5.Delete(music->context);
+	music->interface->Delete(music->context);
 	
 	SDL_free(music);
 }
@@ -123,19 +569,41 @@ void HTML5_Mix_FreeMusic(Mix_Music *music)
 
 void HTML5_Mix_HookMusicFinished(void (SDLCALL *music_finished)(void))
 {
+	MUSIC_ENTER(HookMusicFinished);
 	music_finished_hook = music_finished;
 }
 
 void run_music_finished_hook(void)
 {
+	// Music that stops by itself, rather than by HaltMusic(), hands
+	// over to the next queued track, unless the hook plays something.
+	SDL_bool finished = (music_playing && !music_halting);
+
 	// Reset music status to default. In SDL Mixer, this is handled in
 	// the mix_music() callback loop. For HTML5 Mixer, we handle here because we are
 	// asynchronously called from an <audio> event handler "ended".
 	music_playing = NULL;
 	music_active = SDL_TRUE;
 
+	// The hook runs first, as in SDL Mixer, so music it starts itself
+	// isn't halted by the queue
 	if (music_finished_hook)
 		music_finished_hook();
+
+	if (finished && music_playing == NULL)
+		music_queue_advance();
+}
+
+void HTML5_Mix_HookMusicBuffered(void (SDLCALL *music_buffered)(void))
+{
+	MUSIC_ENTER(HookMusicBuffered);
+	music_buffered_hook = music_buffered;
+}
+
+void run_music_buffered_hook(void)
+{
+	if (music_buffered_hook)
+		music_buffered_hook();
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -146,6 +614,7 @@ void run_music_finished_hook(void)
  */
 int HTML5_Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position)
 {
+	MUSIC_ENTER(FadeInMusicPos, music, loops, ms, position);
 	int retval;
 	(void)ms;
 
@@ -155,9 +624,9 @@ int HTML5_Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double positio
 
 	// TODO: Fade
 	if (position)
-		Mix_MusicInterface_HTML5.Seek(music->context, position);
+		music->interface->Seek(music->context, position);
 
-	retval = Mix_MusicInterface_HTML5.Play(music->context, loops);
+	retval = music->interface->Play(music->context, loops);
 
 	music_playing = music;
 	music_playing->playing = SDL_TRUE;
@@ -167,13 +636,68 @@ int HTML5_Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double positio
 }
 int HTML5_Mix_FadeInMusic(Mix_Music *music, int loops, int ms)
 {
+	MUSIC_ENTER(FadeInMusic, music, loops, ms);
 	return HTML5_Mix_FadeInMusicPos(music, loops, ms, 0.0);
 }
 int HTML5_Mix_PlayMusic(Mix_Music *music, int loops)
 {
+	MUSIC_ENTER(PlayMusic, music, loops);
 	return HTML5_Mix_FadeInMusicPos(music, loops, 0, 0.0);
 }
 
+int HTML5_Mix_PlayMusicTicket(Mix_Music *music, int loops)
+{
+	MUSIC_ENTER(PlayMusicTicket, music, loops);
+	int ticket;
+
+	if (music == NULL) {
+		Mix_SetError("No music given");
+		return -1;
+	}
+
+	// Drop a ticket left by a plain play
+	MusicHTML5_DropPlayTicket();
+
+	HTML5_Mix_PlayMusic(music, loops);
+
+	ticket = MusicHTML5_TakePlayTicket();
+	if (ticket == 0) {
+		Mix_SetError("Music was not played");
+		return -1;
+	}
+	return ticket;
+}
+
+int HTML5_Mix_GetPlayResult(int ticket)
+{
+	MUSIC_ENTER(GetPlayResult, ticket);
+	return MusicHTML5_GetPlayResult(ticket);
+}
+
+int HTML5_Mix_IsAudioUnlocked(void)
+{
+	MUSIC_ENTER(IsAudioUnlocked);
+	return MusicHTML5_IsUnlocked();
+}
+
+void HTML5_Mix_UnlockAudio(void)
+{
+	MUSIC_ENTER(UnlockAudio);
+	MusicHTML5_Unlock();
+}
+
+#ifdef HTML5_MIXER_ASYNCIFY
+int HTML5_Mix_PlayMusicAwait(Mix_Music *music, int loops)
+{
+	MUSIC_ENTER(PlayMusicAwait, music, loops);
+	int ticket = HTML5_Mix_PlayMusicTicket(music, loops);
+
+	if (ticket < 0)
+		return -1;
+	return MusicHTML5_AwaitPlayResult(ticket);
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 // 
 ////////////////////////////////////////////////////////////////////////
@@ -181,7 +705,8 @@ int HTML5_Mix_PlayMusic(Mix_Music *music, int loops)
 /* Check the status of the music */
 int HTML5_Mix_PlayingMusic(void)
 {
-	return music_playing ? Mix_MusicInterface_HTML5.IsPlaying(music_playing->context) : SDL_FALSE;
+	MUSIC_ENTER(PlayingMusic);
+	return music_playing ? music_playing->interface->IsPlaying(music_playing->context) : SDL_FALSE;
 }
 
 static int music_volume = SDL_MIX_MAXVOLUME;
@@ -189,11 +714,12 @@ static int music_volume = SDL_MIX_MAXVOLUME;
 /* Set the music volume */
 int HTML5_Mix_VolumeMusic(int volume)
 {
+	MUSIC_ENTER(VolumeMusic, volume);
 	int prev_volume = SDL_MIX_MAXVOLUME;
 
 	// TODO: Retrieve prev_volume from <audio>
 	if (music_playing)
-		Mix_MusicInterface_HTML5.SetVolume(music_playing->context, volume);
+		music_playing->interface->SetVolume(music_playing->context, volume);
 
 	return(prev_volume);
 }
@@ -201,13 +727,19 @@ int HTML5_Mix_VolumeMusic(int volume)
 /* Halt playing of music */
 int HTML5_Mix_HaltMusic(void)
 {
-	if (music_playing)
+	MUSIC_ENTER(HaltMusic);
+	Mix_Music *music = music_playing;
+
+	if (music)
 	{
-		music_playing->interface->Stop(music_playing->context);
-		music_playing->playing = SDL_FALSE;
-		music_playing = NULL;
+		music_halting = SDL_TRUE;
+		music->interface->Stop(music->context);
+		music->playing = SDL_FALSE;
 
-		run_music_finished_hook();
+		// The interface may already have reported the stop
+		if (music_playing)
+			run_music_finished_hook();
+		music_halting = SDL_FALSE;
 	}
 	else
 	{
@@ -219,6 +751,7 @@ int HTML5_Mix_HaltMusic(void)
 
 void HTML5_Mix_PauseMusic(void)
 {
+	MUSIC_ENTER(PauseMusic);
 	if (music_playing)
 		music_playing->interface->Pause(music_playing->context);
 	music_active = SDL_FALSE;
@@ -226,6 +759,7 @@ void HTML5_Mix_PauseMusic(void)
 
 void HTML5_Mix_ResumeMusic(void)
 {
+	MUSIC_ENTER(ResumeMusic);
 	if (music_playing)
 		music_playing->interface->Resume(music_playing->context);
 	music_active = SDL_TRUE;
@@ -233,12 +767,14 @@ void HTML5_Mix_ResumeMusic(void)
 
 SDL_bool HTML5_Mix_PausedMusic(void)
 {
+	MUSIC_ENTER(PausedMusic);
 	return (music_active == SDL_FALSE);
 }
 
 /* Set the playing music position */
 int HTML5_Mix_SetMusicPosition(double position)
 {
+	MUSIC_ENTER(SetMusicPosition, position);
 	if (music_playing)
 		music_playing->interface->Seek(music_playing->context, position);
 	else
@@ -248,3 +784,788 @@ int HTML5_Mix_SetMusicPosition(double position)
 	}
 	return(0);
 }
+
+/* Get the play position of a music object, or the playing music if NULL */
+double HTML5_Mix_GetMusicPosition(Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicPosition, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->Tell)
+		return music->interface->Tell(music->context);
+
+	return -1.0;
+}
+
+/* Set the playback rate of a music object, or the playing music if NULL */
+int HTML5_Mix_SetMusicSpeed(Mix_Music *music, double rate, int preserve_pitch)
+{
+	MUSIC_ENTER(SetMusicSpeed, music, rate, preserve_pitch);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music == NULL) {
+		Mix_SetError("Music isn't playing");
+		return -1;
+	}
+
+	if (!music->interface->SetSpeed) {
+		Mix_SetError("Playback rate not supported for this music");
+		return -1;
+	}
+
+	return music->interface->SetSpeed(music->context, rate, preserve_pitch ? SDL_TRUE : SDL_FALSE);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Stem Groups
+////////////////////////////////////////////////////////////////////////
+
+struct _HTML5_Mix_StemGroup {
+	int id;
+	int num_stems;
+};
+
+HTML5_Mix_StemGroup *HTML5_Mix_CreateStemGroup(Mix_Music **stems, int num_stems)
+{
+	MUSIC_ENTER(CreateStemGroup, stems, num_stems);
+	HTML5_Mix_StemGroup *group;
+	void **contexts;
+	int i;
+
+	if (stems == NULL || num_stems <= 0) {
+		Mix_SetError("No stems given");
+		return NULL;
+	}
+
+	contexts = (void **)SDL_malloc(num_stems * sizeof *contexts);
+	group = (HTML5_Mix_StemGroup *)SDL_calloc(1, sizeof(HTML5_Mix_StemGroup));
+	if (contexts == NULL || group == NULL) {
+		SDL_free(contexts);
+		SDL_free(group);
+		Mix_SetError("Out of memory");
+		return NULL;
+	}
+
+	for (i = 0; i < num_stems; ++i)
+	{
+		if (stems[i] == NULL || stems[i]->interface != &music_default_interface) {
+			SDL_free(contexts);
+			SDL_free(group);
+			Mix_SetError("Stem %d is not HTML5 music", i);
+			return NULL;
+		}
+		contexts[i] = stems[i]->context;
+	}
+
+	group->id = MusicHTML5_CreateStemGroup(contexts, num_stems);
+	group->num_stems = num_stems;
+	SDL_free(contexts);
+
+	if (group->id == -1) {
+		SDL_free(group);
+		return NULL;
+	}
+
+	MUSIC_TRACE_CREATED(group);
+
+	return group;
+}
+
+void HTML5_Mix_FreeStemGroup(HTML5_Mix_StemGroup *group)
+{
+	MUSIC_ENTER(FreeStemGroup, group);
+	if (group == NULL)
+		return;
+
+	MusicHTML5_DeleteStemGroup(group->id);
+	SDL_free(group);
+}
+
+int HTML5_Mix_PlayStemGroup(HTML5_Mix_StemGroup *group, int loops)
+{
+	MUSIC_ENTER(PlayStemGroup, group, loops);
+	if (group == NULL) {
+		Mix_SetError("Invalid stem group");
+		return -1;
+	}
+
+	// As in SDL Mixer, zero loops means "play once"
+	if (loops == 0)
+		loops = 1;
+
+	return MusicHTML5_PlayStemGroup(group->id, loops);
+}
+
+int HTML5_Mix_HaltStemGroup(HTML5_Mix_StemGroup *group)
+{
+	MUSIC_ENTER(HaltStemGroup, group);
+	if (group == NULL) {
+		Mix_SetError("Invalid stem group");
+		return -1;
+	}
+
+	MusicHTML5_StopStemGroup(group->id);
+	return(0);
+}
+
+void HTML5_Mix_PauseStemGroup(HTML5_Mix_StemGroup *group)
+{
+	MUSIC_ENTER(PauseStemGroup, group);
+	if (group)
+		MusicHTML5_PauseStemGroup(group->id);
+}
+
+void HTML5_Mix_ResumeStemGroup(HTML5_Mix_StemGroup *group)
+{
+	MUSIC_ENTER(ResumeStemGroup, group);
+	if (group)
+		MusicHTML5_ResumeStemGroup(group->id);
+}
+
+int HTML5_Mix_PlayingStemGroup(HTML5_Mix_StemGroup *group)
+{
+	MUSIC_ENTER(PlayingStemGroup, group);
+	return group ? MusicHTML5_IsStemGroupPlaying(group->id) : SDL_FALSE;
+}
+
+/* Ramp the volume of a stem over "ms" milliseconds */
+int HTML5_Mix_VolumeStem(HTML5_Mix_StemGroup *group, int stem, int volume, int ms)
+{
+	MUSIC_ENTER(VolumeStem, group, stem, volume, ms);
+	if (group == NULL || stem < -1 || stem >= group->num_stems) {
+		Mix_SetError("Invalid stem");
+		return -1;
+	}
+
+	MusicHTML5_SetStemVolume(group->id, stem, volume, ms);
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Sprites
+////////////////////////////////////////////////////////////////////////
+
+static SDL_bool music_sprite_source(Mix_Music *music)
+{
+	if (music == NULL || music->interface != &music_default_interface) {
+		Mix_SetError("Sprites need HTML5 music");
+		return SDL_FALSE;
+	}
+	return SDL_TRUE;
+}
+
+int HTML5_Mix_SetSpriteRegions(Mix_Music *music, const HTML5_Mix_SpriteRegion *regions, int num_regions)
+{
+	MUSIC_ENTER(SetSpriteRegions, music, regions, num_regions);
+	int i;
+
+	if (!music_sprite_source(music))
+		return -1;
+
+	for (i = 0; i < num_regions; ++i)
+	{
+		if (MusicHTML5_SetSprite(music->context, regions[i].name, regions[i].start, regions[i].end) < 0)
+			return -1;
+	}
+	return(0);
+}
+
+int HTML5_Mix_PlaySprite(Mix_Music *music, const char *region)
+{
+	MUSIC_ENTER(PlaySprite, music, region);
+	if (!music_sprite_source(music))
+		return -1;
+
+	return MusicHTML5_PlaySprite(music->context, region);
+}
+
+void HTML5_Mix_HaltSprite(int handle)
+{
+	MUSIC_ENTER(HaltSprite, handle);
+	// -1 halts every clip, as with channels; handles start at 1
+	if (handle == 0 || handle < -1) {
+		Mix_SetError("Invalid sprite handle");
+		return;
+	}
+	MusicHTML5_StopSprite(handle);
+}
+
+int HTML5_Mix_VolumeSprites(int volume)
+{
+	MUSIC_ENTER(VolumeSprites, volume);
+	return MusicHTML5_VolumeSprites(volume);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Queue
+////////////////////////////////////////////////////////////////////////
+
+static int music_queue_append(Mix_Music *music, int loops)
+{
+	if (music_queue_length == music_queue_capacity)
+	{
+		int capacity = music_queue_capacity ? music_queue_capacity * 2 : 8;
+		MusicQueueEntry *queue = (MusicQueueEntry *)SDL_realloc(music_queue, capacity * sizeof *queue);
+		if (queue == NULL) {
+			Mix_SetError("Out of memory");
+			return -1;
+		}
+		music_queue = queue;
+		music_queue_capacity = capacity;
+	}
+
+	music_queue[music_queue_length].music = music;
+	music_queue[music_queue_length].loops = loops;
+	++music_queue_length;
+	return(0);
+}
+
+/* Choose the entry that plays next. The choice is kept until it is
+   played, so that the prefetched track is the one that follows.
+ */
+static int music_queue_peek(void)
+{
+	if (music_queue_length == 0)
+		return -1;
+
+	if (music_queue_next < 0 || music_queue_next >= music_queue_length)
+	{
+		if (music_queue_mode & HTML5_MIX_QUEUE_SHUFFLE)
+			music_queue_next = rand() % music_queue_length;
+		else
+			music_queue_next = 0;
+	}
+
+	return music_queue_next;
+}
+
+static void music_queue_play(Mix_Music *music, int loops)
+{
+	// Repeat cycles each played entry back to the end of the queue
+	if (music_queue_mode & HTML5_MIX_QUEUE_REPEAT)
+		music_queue_append(music, loops);
+
+	HTML5_Mix_PlayMusic(music, loops);
+}
+
+static void music_queue_advance(void)
+{
+	MusicQueueEntry entry;
+	int index = music_queue_peek();
+
+	if (index < 0)
+		return;
+
+	entry = music_queue[index];
+	SDL_memmove(&music_queue[index], &music_queue[index + 1],
+		(music_queue_length - index - 1) * sizeof *music_queue);
+	--music_queue_length;
+	music_queue_next = -1;
+
+	music_queue_play(entry.music, entry.loops);
+}
+
+void run_music_near_end_hook(void)
+{
+	// Called from the player's progress events, so buffering of the
+	// next track never starts from the game loop.
+	int index = music_queue_peek();
+	Mix_Music *next;
+
+	if (index < 0)
+		return;
+
+	next = music_queue[index].music;
+	if (next != music_playing && next->interface->Prefetch)
+		next->interface->Prefetch(next->context);
+}
+
+/* Add music to the play queue. Plays immediately if no music is playing */
+int HTML5_Mix_QueueMusic(Mix_Music *music, int loops)
+{
+	MUSIC_ENTER(QueueMusic, music, loops);
+	if (music == NULL) {
+		Mix_SetError("Invalid music");
+		return -1;
+	}
+
+	if (music_playing == NULL) {
+		music_queue_play(music, loops);
+		return(0);
+	}
+
+	return music_queue_append(music, loops);
+}
+
+void HTML5_Mix_ClearQueue(void)
+{
+	MUSIC_ENTER(ClearQueue);
+	music_queue_length = 0;
+	music_queue_next = -1;
+}
+
+int HTML5_Mix_GetQueueLength(void)
+{
+	MUSIC_ENTER(GetQueueLength);
+	return music_queue_length;
+}
+
+void HTML5_Mix_SetQueueMode(int mode)
+{
+	MUSIC_ENTER(SetQueueMode, mode);
+	music_queue_mode = mode;
+	music_queue_next = -1;
+}
+
+/* Stop the current music and play the next queued track */
+int HTML5_Mix_SkipMusic(void)
+{
+	MUSIC_ENTER(SkipMusic);
+	if (music_queue_peek() < 0) {
+		Mix_SetError("Music queue is empty");
+		return -1;
+	}
+
+	if (music_playing)
+		HTML5_Mix_HaltMusic();
+
+	music_queue_advance();
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Loop Points
+////////////////////////////////////////////////////////////////////////
+
+/* Set the loop region of a music object. Returns 0, or -1 on failure */
+int HTML5_Mix_SetMusicLoopPoints(Mix_Music *music, double start, double end)
+{
+	MUSIC_ENTER(SetMusicLoopPoints, music, start, end);
+	if (music == NULL) {
+		Mix_SetError("Invalid music");
+		return -1;
+	}
+
+	if (!music->interface->SetLoopPoints) {
+		Mix_SetError("Loop points not supported for this music");
+		return -1;
+	}
+
+	return music->interface->SetLoopPoints(music->context, start, end);
+}
+
+/* Get the loop region of a music object, or the playing music if NULL */
+double HTML5_Mix_GetMusicLoopStartTime(Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicLoopStartTime, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->LoopStart)
+		return music->interface->LoopStart(music->context);
+
+	return -1.0;
+}
+
+double HTML5_Mix_GetMusicLoopEndTime(Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicLoopEndTime, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->LoopEnd)
+		return music->interface->LoopEnd(music->context);
+
+	return -1.0;
+}
+
+double HTML5_Mix_GetMusicLoopLengthTime(Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicLoopLengthTime, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->LoopLength)
+		return music->interface->LoopLength(music->context);
+
+	return -1.0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Decoders
+////////////////////////////////////////////////////////////////////////
+
+int HTML5_Mix_GetNumMusicDecoders(void)
+{
+	MUSIC_ENTER(GetNumMusicDecoders);
+	int format, count = 0;
+
+	for (format = MUSIC_FORMAT_UNKNOWN + 1; format < MUSIC_FORMAT_LAST; ++format)
+		if (music_has_format((Mix_MusicFormat)format))
+			++count;
+
+	return count;
+}
+
+const char *HTML5_Mix_GetMusicDecoder(int index)
+{
+	MUSIC_ENTER(GetMusicDecoder, index);
+	int format;
+
+	for (format = MUSIC_FORMAT_UNKNOWN + 1; format < MUSIC_FORMAT_LAST; ++format)
+		if (music_has_format((Mix_MusicFormat)format) && index-- == 0)
+			return music_probe_name((Mix_MusicFormat)format);
+
+	return NULL;
+}
+
+SDL_bool HTML5_Mix_HasMusicDecoder(const char *name)
+{
+	MUSIC_ENTER(HasMusicDecoder, name);
+	int format;
+
+	for (format = MUSIC_FORMAT_UNKNOWN + 1; format < MUSIC_FORMAT_LAST; ++format)
+		if (music_has_format((Mix_MusicFormat)format)
+			&& SDL_strcasecmp(name, music_probe_name((Mix_MusicFormat)format)) == 0)
+			return SDL_TRUE;
+
+	return SDL_FALSE;
+}
+
+int HTML5_Mix_SetSoundFonts(const char *paths)
+{
+	MUSIC_ENTER(SetSoundFonts, paths);
+#ifdef MUSIC_MID_WORKLET
+	return MusicMIDI_SetSoundFonts(paths);
+#else
+	(void)paths;
+	Mix_SetError("MIDI support was not built in");
+	return 0;
+#endif
+}
+
+const char *HTML5_Mix_GetSoundFonts(void)
+{
+	MUSIC_ENTER(GetSoundFonts);
+#ifdef MUSIC_MID_WORKLET
+	return MusicMIDI_GetSoundFonts();
+#else
+	return NULL;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+// Effects
+////////////////////////////////////////////////////////////////////////
+
+/* Music is all there is to post-process; channels aren't ours */
+static SDL_bool music_effect_channel(int channel)
+{
+	if (channel != MIX_CHANNEL_POST) {
+		Mix_SetError("Only MIX_CHANNEL_POST effects apply to music");
+		return SDL_FALSE;
+	}
+	return SDL_TRUE;
+}
+
+int HTML5_Mix_RegisterEffect(int chan, Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg)
+{
+	MUSIC_ENTER(RegisterEffect, chan);
+	if (!music_effect_channel(chan))
+		return 0;
+	return MusicEffects_Register(f, d, arg);
+}
+
+int HTML5_Mix_UnregisterEffect(int channel, Mix_EffectFunc_t f)
+{
+	MUSIC_ENTER(UnregisterEffect, channel);
+	if (!music_effect_channel(channel))
+		return 0;
+	return MusicEffects_Unregister(f);
+}
+
+int HTML5_Mix_UnregisterAllEffects(int channel)
+{
+	MUSIC_ENTER(UnregisterAllEffects, channel);
+	if (!music_effect_channel(channel))
+		return 0;
+	return MusicEffects_UnregisterAll();
+}
+
+void HTML5_Mix_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg)
+{
+	MUSIC_ENTER(SetPostMix);
+	MusicEffects_SetPostMix(mix_func, arg);
+}
+
+int HTML5_Mix_GetMusicEffectStats(HTML5_Mix_EffectStats *stats)
+{
+	MUSIC_ENTER(GetMusicEffectStats);
+	return MusicEffects_GetStats(stats);
+}
+
+int HTML5_Mix_SetMusicFilter(HTML5_Mix_FilterType type, float frequency, float q, float gain, int ms)
+{
+	MUSIC_ENTER(SetMusicFilter, type, frequency, q, gain, ms);
+	return MusicNodes_SetFilter(type, frequency, q, gain, ms);
+}
+
+int HTML5_Mix_SetMusicPanning(Uint8 left, Uint8 right, int ms)
+{
+	MUSIC_ENTER(SetMusicPanning, left, right, ms);
+	return MusicNodes_SetPanning(left, right, ms);
+}
+
+int HTML5_Mix_SetMusicDirection(Sint16 angle, Uint8 distance, int ms)
+{
+	MUSIC_ENTER(SetMusicDirection, angle, distance, ms);
+	return MusicNodes_SetDirection(angle, distance, ms);
+}
+
+int HTML5_Mix_SetMusicCompressor(float threshold, float knee, float ratio, float attack, float release, int ms)
+{
+	MUSIC_ENTER(SetMusicCompressor, threshold, knee, ratio, attack, release, ms);
+	return MusicNodes_SetCompressor(threshold, knee, ratio, attack, release, ms);
+}
+
+int HTML5_Mix_LoadMusicReverb(const char *file)
+{
+	MUSIC_ENTER(LoadMusicReverb, file);
+	return MusicNodes_LoadReverb(file);
+}
+
+int HTML5_Mix_SetMusicReverb(float wet, int ms)
+{
+	MUSIC_ENTER(SetMusicReverb, wet, ms);
+	return MusicNodes_SetReverb(wet, ms);
+}
+
+/* SDL Mixer's positional effects, for MIX_CHANNEL_POST only */
+int HTML5_Mix_SetPanning(int channel, Uint8 left, Uint8 right)
+{
+	MUSIC_ENTER(SetPanning, channel, left, right);
+	if (!music_effect_channel(channel))
+		return 0;
+	return MusicNodes_SetPanning(left, right, 0) == 0;
+}
+
+int HTML5_Mix_SetPosition(int channel, Sint16 angle, Uint8 distance)
+{
+	MUSIC_ENTER(SetPosition, channel, angle, distance);
+	if (!music_effect_channel(channel))
+		return 0;
+	return MusicNodes_SetDirection(angle, distance, 0) == 0;
+}
+
+int HTML5_Mix_SetDistance(int channel, Uint8 distance)
+{
+	MUSIC_ENTER(SetDistance, channel, distance);
+	if (!music_effect_channel(channel))
+		return 0;
+	return MusicNodes_SetDistance(distance, 0) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Ducking
+////////////////////////////////////////////////////////////////////////
+
+int HTML5_Mix_SetMusicDucking(float volume, int attack_ms, int release_ms)
+{
+	MUSIC_ENTER(SetMusicDucking, volume, attack_ms, release_ms);
+	return MusicNodes_SetDucking(volume, attack_ms, release_ms);
+}
+
+int HTML5_Mix_DuckMusic(int trigger)
+{
+	MUSIC_ENTER(DuckMusic, trigger);
+	return MusicNodes_Duck(trigger);
+}
+
+int HTML5_Mix_UnduckMusic(int trigger)
+{
+	MUSIC_ENTER(UnduckMusic, trigger);
+	return MusicNodes_Unduck(trigger);
+}
+
+int HTML5_Mix_DuckMusicFor(int ms)
+{
+	MUSIC_ENTER(DuckMusicFor, ms);
+	return MusicNodes_DuckFor(ms);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Analysis
+////////////////////////////////////////////////////////////////////////
+
+int HTML5_Mix_SetMusicAnalyser(int fft_size, float smoothing)
+{
+	MUSIC_ENTER(SetMusicAnalyser, fft_size, smoothing);
+	return MusicNodes_SetAnalyser(fft_size, smoothing);
+}
+
+int HTML5_Mix_GetMusicSpectrum(float *out, int bins)
+{
+	MUSIC_ENTER(GetMusicSpectrum, bins);
+	return MusicNodes_GetSpectrum(out, bins);
+}
+
+int HTML5_Mix_GetMusicWaveform(float *out, int samples)
+{
+	MUSIC_ENTER(GetMusicWaveform, samples);
+	return MusicNodes_GetWaveform(out, samples);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Music Info
+////////////////////////////////////////////////////////////////////////
+
+double HTML5_Mix_MusicDuration(Mix_Music *music)
+{
+	MUSIC_ENTER(MusicDuration, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->Duration)
+		return music->interface->Duration(music->context);
+
+	return -1.0;
+}
+
+int HTML5_Mix_GetMusicBuffered(Mix_Music *music, double *start, double *end)
+{
+	MUSIC_ENTER(GetMusicBuffered, music);
+	double buffered_start = 0.0;
+	double buffered_end = 0.0;
+
+	if (music == NULL)
+		music = music_playing;
+
+	if (music == NULL) {
+		Mix_SetError("Invalid music");
+		return -1;
+	}
+
+	// Music that doesn't stream is all in memory once loaded
+	if (music->interface != &music_default_interface
+		|| !MusicHTML5_GetBuffered(music->context, &buffered_start, &buffered_end))
+	{
+		buffered_end = music->interface->Duration ? music->interface->Duration(music->context) : -1.0;
+		if (buffered_end < 0.0)
+			buffered_end = 0.0;
+	}
+
+	if (start)
+		*start = buffered_start;
+	if (end)
+		*end = buffered_end;
+	return 0;
+}
+
+Mix_MusicType HTML5_Mix_GetMusicType(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicType, music);
+	if (music == NULL)
+		music = music_playing;
+
+	if (music == NULL)
+		return MUS_NONE;
+
+	if (music->interface->GetType)
+		return music->interface->GetType(music->context);
+
+	return music->interface->type;
+}
+
+static const char *music_get_meta_tag(const Mix_Music *music, Mix_MusicMetaTag tag_type)
+{
+	if (music == NULL)
+		music = music_playing;
+
+	if (music && music->interface->GetMetaTag)
+		return music->interface->GetMetaTag(music->context, tag_type);
+
+	return "";
+}
+
+const char *HTML5_Mix_GetMusicTitle(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicTitle, music);
+	const char *title = music_get_meta_tag(music, MIX_META_TITLE);
+
+	if (music == NULL)
+		music = music_playing;
+
+	if (title[0] == '\0' && music)
+		return music->filename;
+
+	return title;
+}
+
+const char *HTML5_Mix_GetMusicTitleTag(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicTitleTag, music);
+	return music_get_meta_tag(music, MIX_META_TITLE);
+}
+
+const char *HTML5_Mix_GetMusicArtistTag(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicArtistTag, music);
+	return music_get_meta_tag(music, MIX_META_ARTIST);
+}
+
+const char *HTML5_Mix_GetMusicAlbumTag(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicAlbumTag, music);
+	return music_get_meta_tag(music, MIX_META_ALBUM);
+}
+
+const char *HTML5_Mix_GetMusicCopyrightTag(const Mix_Music *music)
+{
+	MUSIC_ENTER(GetMusicCopyrightTag, music);
+	return music_get_meta_tag(music, MIX_META_COPYRIGHT);
+}
+
+int HTML5_Mix_GetMusicInfo(const char *file, HTML5_Mix_MusicInfo *info)
+{
+	MUSIC_ENTER(GetMusicInfo, file);
+	if (music_header_parse_file(file, info) == MUSIC_FORMAT_UNKNOWN) {
+		Mix_SetError("Unrecognized music format");
+		return -1;
+	}
+
+	return 0;
+}
+
+int HTML5_Mix_GetMusicInfo_RW(SDL_RWops *src, HTML5_Mix_MusicInfo *info)
+{
+	MUSIC_ENTER(GetMusicInfo_RW, src);
+	if (music_header_parse_rw(src, info) == MUSIC_FORMAT_UNKNOWN) {
+		Mix_SetError("Unrecognized music format");
+		return -1;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Tracing
+////////////////////////////////////////////////////////////////////////
+
+#ifdef HTML5_MIXER_TRACE
+int HTML5_Mix_StartTrace(void)
+{
+	return music_trace_start();
+}
+
+int HTML5_Mix_StopTrace(const char *file)
+{
+	return music_trace_stop(file);
+}
+
+const void *HTML5_Mix_GetTrace(size_t *size)
+{
+	return music_trace_data(size);
+}
+#endif
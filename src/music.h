@@ -29,10 +29,38 @@
 #define HTML5_MIXER
 #endif
 
+/* Desktop builds define HTML5_MIXER_NATIVE: music plays through an SDL
+   audio device, and what only a browser can do reports an error. */
+#ifdef HTML5_MIXER_NATIVE
+
+#ifndef MUSIC_NATIVE
+#define MUSIC_NATIVE
+#endif
+
+/* With HTML5_MIXER_NATIVE_SDL_MIXER, and SDL_mixer linked, formats the
+   native interface can't decode play through SDL_mixer */
+#if !defined(MUSIC_SDL_MIXER) && defined(HTML5_MIXER_NATIVE_SDL_MIXER)
+#define MUSIC_SDL_MIXER
+#endif
+
+#else
+
 #ifndef MUSIC_HTML5
 #define MUSIC_HTML5
 #endif
 
+/* Backends rendered on an AudioWorklet. Define HTML5_MIXER_NO_MOD or
+   HTML5_MIXER_NO_MIDI to leave their processors out of the build. */
+#if !defined(MUSIC_MOD_WORKLET) && !defined(HTML5_MIXER_NO_MOD)
+#define MUSIC_MOD_WORKLET
+#endif
+
+#if !defined(MUSIC_MID_WORKLET) && !defined(HTML5_MIXER_NO_MIDI)
+#define MUSIC_MID_WORKLET
+#endif
+
+#endif /* HTML5_MIXER_NATIVE */
+
 typedef enum
 {
 	MIX_MUSIC_HTML5,
@@ -48,6 +76,8 @@ typedef enum
 	MIX_MUSIC_MAD,
 	MIX_MUSIC_SMPEG,
 	MIX_MUSIC_FLAC,
+	MIX_MUSIC_NATIVE,
+	MIX_MUSIC_SDL_MIXER,
 	MIX_MUSIC_LAST
 } Mix_MusicAPI;
 
@@ -82,6 +112,9 @@ typedef struct
 	/* Start playing music from the beginning with an optional loop count */
 	int (*Play)(void *music, int play_count);
 
+	/* Start buffering music that is expected to play next, without blocking */
+	void (*Prefetch)(void *music);
+
 	/* Returns SDL_TRUE if music is still playing */
 	SDL_bool (*IsPlaying)(void *music);
 
@@ -91,6 +124,29 @@ typedef struct
 	/* Seek to a play position (in seconds) */
 	int (*Seek)(void *music, double position);
 
+	/* Tell play position (in seconds) */
+	double (*Tell)(void *music);
+
+	/* Get the length of the music (in seconds), or -1.0 if unknown */
+	double (*Duration)(void *music);
+
+	/* Set the playback rate, optionally keeping the original pitch */
+	int (*SetSpeed)(void *music, double rate, SDL_bool preserve_pitch);
+
+	/* Set the loop region (in seconds), an end of 0 meaning end of music */
+	int (*SetLoopPoints)(void *music, double start, double end);
+
+	/* Get the loop region (in seconds), or -1.0 if there is none */
+	double (*LoopStart)(void *music);
+	double (*LoopEnd)(void *music);
+	double (*LoopLength)(void *music);
+
+	/* Get a text tag of the music, or "" if there is none */
+	const char *(*GetMetaTag)(void *music, Mix_MusicMetaTag tag_type);
+
+	/* Get the detected type of the music */
+	Mix_MusicType (*GetType)(void *music);
+
 	/* Pause playing music */
 	void (*Pause)(void *music);
 
@@ -114,6 +170,7 @@ typedef struct
 struct _Mix_Music {
 	Mix_MusicInterface *interface;
 	void *context;
+	char filename[1024];
 
 	SDL_bool playing;
 	Mix_Fading fading;
@@ -122,5 +179,7 @@ struct _Mix_Music {
 };
 
 extern void run_music_finished_hook(void);
+extern void run_music_near_end_hook(void);
+extern void run_music_buffered_hook(void);
 
 #endif // #ifndef HTML5_MUSIC_H_
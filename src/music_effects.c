@@ -0,0 +1,513 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports wasm effects on music, the counterpart of effects
+   on MIX_CHANNEL_POST. All music plays through one AudioWorkletNode on a
+   Wasm Audio Worklet thread, which hands each block to the registered
+   effects in shared memory. Build with -sAUDIO_WORKLET -sWASM_WORKERS
+   and define HTML5_MIXER_AUDIO_WORKLET. Native builds run the effects
+   in the audio callback instead, and need nothing more. */
+
+#include "music_effects.h"
+#include "music_html5.h"
+
+#if defined(HTML5_MIXER_AUDIO_WORKLET) || defined(MUSIC_NATIVE)
+
+#ifndef MUSIC_NATIVE
+#include <emscripten.h>
+#include <emscripten/webaudio.h>
+#include <emscripten/wasm_worker.h>
+#include <emscripten/atomic.h>
+
+#define EFFECTS_PROCESSOR "html5-mixer-effects"
+#define EFFECTS_STACK_SIZE 16384
+#endif
+
+#define EFFECTS_MAX 16
+
+typedef struct
+{
+    Mix_EffectFunc_t callback;
+    Mix_EffectDone_t done;
+    void *arg;
+} MusicEffect;
+
+typedef enum
+{
+    EFFECTS_IDLE,
+    EFFECTS_STARTING,
+    EFFECTS_READY
+} MusicEffectsState;
+
+/* Written by the main thread under the lock, copied by the audio thread.
+   The audio thread never waits for the lock: a block that finds it
+   taken plays through the chain it copied last. */
+#ifdef MUSIC_NATIVE
+static SDL_SpinLock effects_lock = 0;
+#define effects_acquire() SDL_AtomicLock(&effects_lock)
+#define effects_try_acquire() SDL_AtomicTryLock(&effects_lock)
+#define effects_release() SDL_AtomicUnlock(&effects_lock)
+#define effects_now() (SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency())
+
+typedef SDL_atomic_t effects_atomic_t;
+#define effects_load(a) ((Uint32)SDL_AtomicGet(a))
+#define effects_store(a, v) SDL_AtomicSet(a, (int)(v))
+#define effects_exchange(a, v) ((Uint32)SDL_AtomicSet(a, (int)(v)))
+#define effects_add(a, v) SDL_AtomicAdd(a, (int)(v))
+#define effects_cas(a, old, v) SDL_AtomicCAS(a, (int)(old), (int)(v))
+#else
+static emscripten_lock_t effects_lock = EMSCRIPTEN_LOCK_T_STATIC_INITIALIZER;
+#define effects_acquire() emscripten_lock_busyspin_waitinf_acquire(&effects_lock)
+#define effects_try_acquire() emscripten_lock_try_acquire(&effects_lock)
+#define effects_release() emscripten_lock_release(&effects_lock)
+#define effects_now() emscripten_get_now()
+
+typedef volatile uint32_t effects_atomic_t;
+#define effects_load(a) emscripten_atomic_load_u32((void *)(a))
+#define effects_store(a, v) emscripten_atomic_store_u32((void *)(a), (v))
+#define effects_exchange(a, v) emscripten_atomic_exchange_u32((void *)(a), (v))
+#define effects_add(a, v) emscripten_atomic_add_u32((void *)(a), (v))
+#define effects_cas(a, old, v) (emscripten_atomic_cas_u32((void *)(a), (old), (v)) == (old))
+#endif
+
+typedef struct
+{
+    MusicEffect effects[EFFECTS_MAX];
+    int num_effects;
+    void (SDLCALL *postmix)(void *udata, Uint8 *stream, int len);
+    void *postmix_arg;
+    Uint32 version;
+} MusicEffectsChain;
+
+static MusicEffect effects[EFFECTS_MAX];
+static int num_effects = 0;
+static void (SDLCALL *effects_postmix)(void *udata, Uint8 *stream, int len) = NULL;
+static void *effects_postmix_arg = NULL;
+static Uint32 effects_version = 0;          /* Bumped with each change */
+
+/* Audio thread only */
+static MusicEffectsChain effects_live;
+
+/* Written by the audio thread. The main thread waits on them before
+   telling removed effects they are done, see effects_sync(). */
+static effects_atomic_t effects_busy;       /* In a block */
+static effects_atomic_t effects_applied;    /* Version of the chain copied last */
+
+/* Cost of the blocks since the last MusicEffects_GetStats(), in
+   microseconds, so reading them takes no lock */
+static effects_atomic_t effects_blocks;
+static effects_atomic_t effects_total_us;
+static effects_atomic_t effects_peak_us;
+
+static SDL_bool effects_active(void)
+{
+    return (num_effects > 0 || effects_postmix != NULL) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Copy the chain for the audio thread, under the lock */
+static void effects_copy(void)
+{
+    SDL_memcpy(effects_live.effects, effects, num_effects * sizeof *effects);
+    effects_live.num_effects = num_effects;
+    effects_live.postmix = effects_postmix;
+    effects_live.postmix_arg = effects_postmix_arg;
+    effects_live.version = effects_version;
+}
+
+/* Run the effects on a block of interleaved stereo floats, on the audio thread */
+static void effects_run(float *block, int frames)
+{
+    double start;
+    Uint32 cost, peak;
+    int i;
+
+    effects_store(&effects_busy, 1);
+
+    if (effects_try_acquire()) {
+        if (effects_live.version != effects_version)
+            effects_copy();
+        effects_release();
+        effects_store(&effects_applied, effects_live.version);
+    }
+
+    if (effects_live.num_effects > 0 || effects_live.postmix) {
+        start = effects_now();
+
+        for (i = 0; i < effects_live.num_effects; ++i)
+            effects_live.effects[i].callback(MIX_CHANNEL_POST, block, frames * 2 * sizeof(float),
+                effects_live.effects[i].arg);
+        if (effects_live.postmix)
+            effects_live.postmix(effects_live.postmix_arg, (Uint8 *)block, frames * 2 * sizeof(float));
+
+        cost = (Uint32)((effects_now() - start) * 1000.0 + 0.5);
+        effects_add(&effects_blocks, 1);
+        effects_add(&effects_total_us, cost);
+        peak = effects_load(&effects_peak_us);
+        while (cost > peak && !effects_cas(&effects_peak_us, peak, cost))
+            peak = effects_load(&effects_peak_us);
+    }
+
+    effects_store(&effects_busy, 0);
+}
+
+/* Wait until no block runs a chain older than the current one. Blocks
+   that start later take the current one, as the lock is free. */
+static void effects_sync(void)
+{
+    while (effects_load(&effects_busy) && effects_load(&effects_applied) != effects_version)
+        ;
+}
+
+#ifdef MUSIC_NATIVE
+
+/* Audio in the last buffer, in milliseconds */
+static double effects_block_ms = 0.0;
+
+void MusicEffects_Process(float *stream, int frames, int freq)
+{
+    effects_block_ms = frames * 1000.0 / freq;
+    effects_run(stream, frames);
+}
+
+/* The audio callback is always running; there is nothing to start */
+static int effects_start(void)
+{
+    return 0;
+}
+
+static void effects_route(void)
+{
+}
+
+#else
+
+/* Main thread only */
+static MusicEffectsState effects_state = EFFECTS_IDLE;
+static EMSCRIPTEN_WEBAUDIO_T effects_context = 0;
+static Uint8 effects_stack[EFFECTS_STACK_SIZE] __attribute__((aligned(16)));
+
+/* Audio thread only */
+static float effects_block[MUSIC_EFFECTS_FRAMES * 2];
+
+/* Put the node in or take it out of the music's path */
+static void effects_route(void)
+{
+    if (effects_state != EFFECTS_READY)
+        return;
+
+    EM_ASM({
+        if (Module["SDL2Mixer"])
+            Module["SDL2Mixer"].setEffects($0);
+    }, effects_active());
+}
+
+static EM_BOOL effects_process(int numInputs, const AudioSampleFrame *inputs,
+    int numOutputs, AudioSampleFrame *outputs,
+    int numParams, const AudioParamFrame *params, void *userData)
+{
+    const int frames = MUSIC_EFFECTS_FRAMES;
+    const float *left = NULL;
+    const float *right = NULL;
+    int i;
+
+    (void)numParams;
+    (void)params;
+    (void)userData;
+
+    if (numOutputs < 1)
+        return EM_TRUE;
+
+    // The node mixes its input to stereo, but may be unconnected
+    if (numInputs > 0 && inputs[0].numberOfChannels > 0) {
+        left = inputs[0].data;
+        right = (inputs[0].numberOfChannels > 1) ? inputs[0].data + frames : left;
+    }
+
+    for (i = 0; i < frames; ++i) {
+        effects_block[2 * i] = left ? left[i] : 0.0f;
+        effects_block[2 * i + 1] = right ? right[i] : 0.0f;
+    }
+
+    effects_run(effects_block, frames);
+
+    for (i = 0; i < frames; ++i) {
+        outputs[0].data[i] = effects_block[2 * i];
+        if (outputs[0].numberOfChannels > 1)
+            outputs[0].data[frames + i] = effects_block[2 * i + 1];
+    }
+
+    return EM_TRUE;
+}
+
+static void effects_processor_created(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *userData)
+{
+    int output_channels[1] = { 2 };
+    EmscriptenAudioWorkletNodeCreateOptions options = {
+        .numberOfInputs = 1,
+        .numberOfOutputs = 1,
+        .outputChannelCounts = output_channels
+    };
+    EMSCRIPTEN_AUDIO_WORKLET_NODE_T node;
+
+    (void)userData;
+
+    // Closed meanwhile
+    if (effects_state != EFFECTS_STARTING || context != effects_context)
+        return;
+
+    if (!success) {
+        EM_ASM({ err("Music effects: could not create the worklet processor"); });
+        effects_state = EFFECTS_IDLE;
+        return;
+    }
+
+    node = emscripten_create_wasm_audio_worklet_node(context, EFFECTS_PROCESSOR, &options,
+        effects_process, NULL);
+
+    EM_ASM({
+        const node = emscriptenGetAudioObject($0);
+        // Mono music is processed as stereo as well
+        node.channelCount = 2;
+        node.channelCountMode = "explicit";
+        Module["SDL2Mixer"].effectsNode = node;
+    }, node);
+
+    effects_state = EFFECTS_READY;
+    effects_route();
+}
+
+static void effects_thread_started(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *userData)
+{
+    WebAudioWorkletProcessorCreateOptions options = {
+        .name = EFFECTS_PROCESSOR
+    };
+
+    (void)userData;
+
+    if (effects_state != EFFECTS_STARTING || context != effects_context)
+        return;
+
+    if (!success) {
+        EM_ASM({ err("Music effects: could not start the audio worklet thread"); });
+        effects_state = EFFECTS_IDLE;
+        return;
+    }
+
+    emscripten_create_wasm_audio_worklet_processor_async(context, &options,
+        effects_processor_created, NULL);
+}
+
+/* Start the worklet thread on the mixer's context, once */
+static int effects_start(void)
+{
+    if (effects_state != EFFECTS_IDLE)
+        return 0;
+
+    if (!EM_ASM_INT({ return !!Module["SDL2Mixer"]; })) {
+        Mix_SetError("HTML5 music must be opened first");
+        return -1;
+    }
+
+    effects_context = EM_ASM_INT({
+        return emscriptenRegisterAudioObject(Module["SDL2Mixer"].getContext());
+    });
+    effects_state = EFFECTS_STARTING;
+    emscripten_start_wasm_audio_worklet_thread_async(effects_context,
+        effects_stack, sizeof effects_stack, effects_thread_started, NULL);
+
+    return 0;
+}
+
+#endif /* MUSIC_NATIVE */
+
+int MusicEffects_Register(Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg)
+{
+    if (f == NULL) {
+        Mix_SetError("NULL effect callback");
+        return 0;
+    }
+
+    if (effects_start() < 0)
+        return 0;
+
+    effects_acquire();
+    if (num_effects == EFFECTS_MAX) {
+        effects_release();
+        Mix_SetError("Too many music effects");
+        return 0;
+    }
+    effects[num_effects].callback = f;
+    effects[num_effects].done = d;
+    effects[num_effects].arg = arg;
+    num_effects++;
+    effects_version++;
+    effects_release();
+
+    effects_route();
+    return 1;
+}
+
+int MusicEffects_Unregister(Mix_EffectFunc_t f)
+{
+    MusicEffect removed;
+    int i;
+
+    effects_acquire();
+    for (i = 0; i < num_effects; ++i)
+        if (effects[i].callback == f)
+            break;
+    if (i == num_effects) {
+        effects_release();
+        Mix_SetError("No such effect registered");
+        return 0;
+    }
+    removed = effects[i];
+    SDL_memmove(&effects[i], &effects[i + 1], (num_effects - i - 1) * sizeof *effects);
+    num_effects--;
+    effects_version++;
+    effects_release();
+
+    // Once the audio thread is done with it
+    effects_sync();
+    if (removed.done)
+        removed.done(MIX_CHANNEL_POST, removed.arg);
+
+    effects_route();
+    return 1;
+}
+
+int MusicEffects_UnregisterAll(void)
+{
+    MusicEffect removed[EFFECTS_MAX];
+    int count, i;
+
+    effects_acquire();
+    count = num_effects;
+    SDL_memcpy(removed, effects, count * sizeof *effects);
+    num_effects = 0;
+    effects_version++;
+    effects_release();
+
+    effects_sync();
+    for (i = 0; i < count; ++i)
+        if (removed[i].done)
+            removed[i].done(MIX_CHANNEL_POST, removed[i].arg);
+
+    effects_route();
+    return 1;
+}
+
+void MusicEffects_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg)
+{
+    if (mix_func && effects_start() < 0)
+        return;
+
+    effects_acquire();
+    effects_postmix = mix_func;
+    effects_postmix_arg = arg;
+    effects_version++;
+    effects_release();
+
+    // The previous function is no longer called once this returns
+    effects_sync();
+
+    effects_route();
+}
+
+int MusicEffects_GetStats(HTML5_Mix_EffectStats *stats)
+{
+    if (stats == NULL) {
+        Mix_SetError("NULL stats");
+        return -1;
+    }
+
+#ifdef MUSIC_NATIVE
+    stats->block_ms = effects_block_ms;
+#else
+    stats->block_ms = (effects_state == EFFECTS_READY)
+        ? EM_ASM_DOUBLE({ return $0 * 1000 / Module["SDL2Mixer"].getContext().sampleRate; }, MUSIC_EFFECTS_FRAMES)
+        : 0.0;
+#endif
+
+    stats->blocks = effects_exchange(&effects_blocks, 0);
+    stats->average_ms = stats->blocks
+        ? effects_exchange(&effects_total_us, 0) / 1000.0 / stats->blocks
+        : 0.0;
+    stats->peak_ms = effects_exchange(&effects_peak_us, 0) / 1000.0;
+
+    return 0;
+}
+
+void MusicEffects_Close(void)
+{
+    MusicEffects_SetPostMix(NULL, NULL);
+    MusicEffects_UnregisterAll();
+
+#ifndef MUSIC_NATIVE
+    // The worklet thread goes away with the context
+    effects_state = EFFECTS_IDLE;
+    effects_context = 0;
+#endif
+}
+
+#else
+
+int MusicEffects_Register(Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg)
+{
+    (void)f;
+    (void)d;
+    (void)arg;
+    Mix_SetError("Music effects need HTML5_MIXER_AUDIO_WORKLET");
+    return 0;
+}
+
+int MusicEffects_Unregister(Mix_EffectFunc_t f)
+{
+    (void)f;
+    Mix_SetError("No such effect registered");
+    return 0;
+}
+
+int MusicEffects_UnregisterAll(void)
+{
+    return 1;
+}
+
+void MusicEffects_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg)
+{
+    (void)mix_func;
+    (void)arg;
+}
+
+int MusicEffects_GetStats(HTML5_Mix_EffectStats *stats)
+{
+    (void)stats;
+    Mix_SetError("Music effects need HTML5_MIXER_AUDIO_WORKLET");
+    return -1;
+}
+
+void MusicEffects_Close(void)
+{
+}
+
+#endif /* HTML5_MIXER_AUDIO_WORKLET || MUSIC_NATIVE */
+
+/* vi: set ts=4 sw=4 expandtab: */
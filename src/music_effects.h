@@ -0,0 +1,55 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports wasm effects on music, run on a Wasm Audio Worklet */
+
+#ifndef MUSIC_EFFECTS_H_
+#define MUSIC_EFFECTS_H_
+
+#include "prerequisites.h"
+
+/* What running the effects has cost, in milliseconds per block */
+typedef struct
+{
+    Uint32 blocks;              /* Blocks processed since the last query */
+    double average_ms;          /* Mean cost of a block */
+    double peak_ms;             /* Costliest block */
+    double block_ms;            /* Audio in a block, the cost not to exceed */
+} HTML5_Mix_EffectStats;
+
+/* Effects see blocks of this many frames of interleaved stereo floats */
+#define MUSIC_EFFECTS_FRAMES 128
+
+extern int MusicEffects_Register(Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg);
+extern int MusicEffects_Unregister(Mix_EffectFunc_t f);
+extern int MusicEffects_UnregisterAll(void);
+extern void MusicEffects_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg);
+extern int MusicEffects_GetStats(HTML5_Mix_EffectStats *stats);
+
+/* Remove every effect and forget the worklet, whose context is closing */
+extern void MusicEffects_Close(void);
+
+#ifdef HTML5_MIXER_NATIVE
+/* Run the effects on a buffer of the native audio callback */
+extern void MusicEffects_Process(float *stream, int frames, int freq);
+#endif
+
+#endif // MUSIC_EFFECTS_H_
@@ -0,0 +1,1574 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Reads duration, format and tags from the first few KB of a music file,
+// so that track lists don't need to load anything into <audio>.
+
+#include <math.h>
+#include "music_header.h"
+
+// Upper bound on tag data (comment packets, ID3 frames, ...) we look at.
+// Cover art is usually stored after the text tags, so it is cut off.
+#define MUSIC_HEADER_TAG_SIZE (16 * 1024)
+
+// Ogg pages are at most 65307 bytes, so the last page header is always
+// within this many bytes from the end.
+#define MUSIC_HEADER_OGG_TAIL_SIZE (65307 + 27)
+
+#define MUSIC_HEADER_MAX_CHUNKS 64
+
+typedef struct {
+	SDL_RWops *src;
+	Sint64 start;           // Stream position of the first byte
+	Sint64 size;            // Bytes from start to the end, or -1
+	Uint8 head[MUSIC_HEADER_READ_SIZE];
+	size_t head_size;
+
+	HTML5_Mix_MusicInfo *info;
+
+	// Loop tags are in samples until the sample rate is known
+	Sint64 loop_start;
+	Sint64 loop_length;
+	Sint64 loop_end;
+} HeaderParser;
+
+////////////////////////////////////////////////////////////////////////
+// Reading
+////////////////////////////////////////////////////////////////////////
+
+static Uint16 header_le16(const Uint8 *p) { return (Uint16)(p[0] | (p[1] << 8)); }
+static Uint32 header_le32(const Uint8 *p) { return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24); }
+static Uint64 header_le64(const Uint8 *p) { return (Uint64)header_le32(p) | ((Uint64)header_le32(p + 4) << 32); }
+static Uint16 header_be16(const Uint8 *p) { return (Uint16)((p[0] << 8) | p[1]); }
+static Uint32 header_be24(const Uint8 *p) { return ((Uint32)p[0] << 16) | ((Uint32)p[1] << 8) | (Uint32)p[2]; }
+static Uint32 header_be32(const Uint8 *p) { return ((Uint32)p[0] << 24) | header_be24(p + 1); }
+static Uint64 header_be64(const Uint8 *p) { return ((Uint64)header_be32(p) << 32) | (Uint64)header_be32(p + 4); }
+
+static SDL_bool header_tag_equals(const Uint8 *p, const char *tag)
+{
+	return (SDL_memcmp(p, tag, SDL_strlen(tag)) == 0) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Read 'len' bytes at 'offset' from the start of the stream.
+   Reads within the first block are served from memory.
+ */
+static size_t header_read_at(HeaderParser *parser, Sint64 offset, void *buf, size_t len)
+{
+	if (offset < 0)
+		return 0;
+
+	if ((Uint64)offset + len <= parser->head_size) {
+		SDL_memcpy(buf, parser->head + offset, len);
+		return len;
+	}
+
+	if (parser->size >= 0 && offset >= parser->size)
+		return 0;
+
+	if (SDL_RWseek(parser->src, parser->start + offset, RW_SEEK_SET) < 0)
+		return 0;
+
+	return SDL_RWread(parser->src, buf, 1, len);
+}
+
+/* Read up to 'max' bytes of a block into a new buffer */
+static Uint8 *header_read_block(HeaderParser *parser, Sint64 offset, Uint64 len, size_t max, size_t *read)
+{
+	Uint8 *block;
+
+	if (len > max)
+		len = max;
+
+	block = (Uint8 *)SDL_malloc(len ? (size_t)len : 1);
+	if (block == NULL) {
+		*read = 0;
+		return NULL;
+	}
+
+	*read = header_read_at(parser, offset, block, (size_t)len);
+	return block;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Text
+////////////////////////////////////////////////////////////////////////
+
+enum {
+	HEADER_TEXT_LATIN1,
+	HEADER_TEXT_UTF16,      // With byte order mark
+	HEADER_TEXT_UTF16BE,
+	HEADER_TEXT_UTF8
+};
+
+static size_t header_put_utf8(char *dst, size_t pos, size_t dstlen, Uint32 c)
+{
+	char bytes[4];
+	size_t i, n;
+
+	if (c < 0x80) {
+		bytes[0] = (char)c;
+		n = 1;
+	} else if (c < 0x800) {
+		bytes[0] = (char)(0xC0 | (c >> 6));
+		bytes[1] = (char)(0x80 | (c & 0x3F));
+		n = 2;
+	} else if (c < 0x10000) {
+		bytes[0] = (char)(0xE0 | (c >> 12));
+		bytes[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		bytes[2] = (char)(0x80 | (c & 0x3F));
+		n = 3;
+	} else {
+		bytes[0] = (char)(0xF0 | (c >> 18));
+		bytes[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+		bytes[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+		bytes[3] = (char)(0x80 | (c & 0x3F));
+		n = 4;
+	}
+
+	// Never split a character; leave room for the terminator
+	if (pos + n >= dstlen)
+		return pos;
+
+	for (i = 0; i < n; ++i)
+		dst[pos + i] = bytes[i];
+	return pos + n;
+}
+
+/* Convert text to UTF-8, stopping at a terminator or 'len' bytes.
+   Trailing spaces are removed.
+   Returns the number of source bytes used, including the terminator.
+ */
+static size_t header_decode_text(char *dst, size_t dstlen, const Uint8 *src, size_t len, int encoding)
+{
+	size_t i = 0, pos = 0;
+	SDL_bool big_endian = (encoding == HEADER_TEXT_UTF16BE);
+
+	if (encoding == HEADER_TEXT_UTF16 && len >= 2) {
+		if (src[0] == 0xFE && src[1] == 0xFF) {
+			big_endian = SDL_TRUE;
+			i = 2;
+		} else if (src[0] == 0xFF && src[1] == 0xFE) {
+			i = 2;
+		}
+	}
+
+	if (encoding == HEADER_TEXT_UTF16 || encoding == HEADER_TEXT_UTF16BE) {
+		while (i + 1 < len) {
+			Uint32 c = big_endian ? header_be16(src + i) : header_le16(src + i);
+			i += 2;
+			if (c == 0)
+				break;
+			if (c >= 0xD800 && c < 0xDC00 && i + 1 < len) {
+				Uint32 low = big_endian ? header_be16(src + i) : header_le16(src + i);
+				if (low >= 0xDC00 && low < 0xE000) {
+					c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+					i += 2;
+				}
+			}
+			pos = header_put_utf8(dst, pos, dstlen, c);
+		}
+	} else {
+		while (i < len) {
+			Uint8 c = src[i++];
+			if (c == 0)
+				break;
+			if (encoding == HEADER_TEXT_UTF8 || c < 0x80) {
+				// Copies UTF-8 bytewise; drop a character cut by the limit
+				if (pos + 1 < dstlen)
+					dst[pos++] = (char)c;
+			} else {
+				pos = header_put_utf8(dst, pos, dstlen, c);
+			}
+		}
+		if (encoding == HEADER_TEXT_UTF8)
+			while (pos > 0 && ((Uint8)dst[pos - 1] & 0xC0) == 0x80)
+				--pos;
+	}
+
+	while (pos > 0 && dst[pos - 1] == ' ')
+		--pos;
+
+	if (dstlen > 0)
+		dst[pos] = '\0';
+
+	return i;
+}
+
+/* Set a tag unless an earlier tag already set it */
+static void header_set_tag(char *tag, const Uint8 *src, size_t len, int encoding)
+{
+	if (tag[0] == '\0')
+		header_decode_text(tag, HTML5_MIX_MUSIC_TAG_LENGTH, src, len, encoding);
+}
+
+static SDL_bool header_key_equals(const char *key, size_t len, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+	{
+		char c = key[i];
+		if (c >= 'a' && c <= 'z')
+			c = (char)(c - 'a' + 'A');
+		if (name[i] == '\0' || c != name[i])
+			return SDL_FALSE;
+	}
+
+	return (name[len] == '\0') ? SDL_TRUE : SDL_FALSE;
+}
+
+static Sint64 header_parse_integer(const char *text, size_t len)
+{
+	Sint64 value = 0;
+	size_t i = 0;
+
+	while (i < len && text[i] == ' ')
+		++i;
+
+	if (i == len || text[i] < '0' || text[i] > '9')
+		return -1;
+
+	while (i < len && text[i] >= '0' && text[i] <= '9')
+		value = value * 10 + (text[i++] - '0');
+
+	return value;
+}
+
+/* Handle one "KEY=value" tag. Loop tags are sample positions. */
+static void header_parse_field(HeaderParser *parser, const char *key, size_t key_len,
+	const Uint8 *value, size_t value_len, int encoding)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	char text[32];
+
+	if (header_key_equals(key, key_len, "TITLE"))
+		header_set_tag(info->title, value, value_len, encoding);
+	else if (header_key_equals(key, key_len, "ARTIST"))
+		header_set_tag(info->artist, value, value_len, encoding);
+	else if (header_key_equals(key, key_len, "ALBUM"))
+		header_set_tag(info->album, value, value_len, encoding);
+	else if (header_key_equals(key, key_len, "COPYRIGHT"))
+		header_set_tag(info->copyright, value, value_len, encoding);
+	else if (header_key_equals(key, key_len, "LOOPSTART")) {
+		header_decode_text(text, sizeof text, value, value_len, encoding);
+		parser->loop_start = header_parse_integer(text, SDL_strlen(text));
+	} else if (header_key_equals(key, key_len, "LOOPLENGTH")) {
+		header_decode_text(text, sizeof text, value, value_len, encoding);
+		parser->loop_length = header_parse_integer(text, SDL_strlen(text));
+	} else if (header_key_equals(key, key_len, "LOOPEND")) {
+		header_decode_text(text, sizeof text, value, value_len, encoding);
+		parser->loop_end = header_parse_integer(text, SDL_strlen(text));
+	}
+}
+
+/* Vorbis comments, as used by Ogg Vorbis, Opus and FLAC */
+static void header_parse_vorbis_comments(HeaderParser *parser, const Uint8 *data, size_t size)
+{
+	Uint64 pos, count, i;
+
+	if (size < 8)
+		return;
+
+	pos = 4 + (Uint64)header_le32(data);    // Skip the vendor string
+	if (pos + 4 > size)
+		return;
+
+	count = header_le32(data + pos);
+	pos += 4;
+
+	for (i = 0; i < count && pos + 4 <= size; ++i)
+	{
+		Uint64 len = header_le32(data + pos);
+		const char *comment = (const char *)data + pos + 4;
+		size_t key_len = 0;
+
+		pos += 4;
+		if (len > size - pos)
+			break;
+
+		while (key_len < len && comment[key_len] != '=')
+			++key_len;
+
+		if (key_len < len)
+			header_parse_field(parser, comment, key_len,
+				(const Uint8 *)comment + key_len + 1, (size_t)(len - key_len - 1), HEADER_TEXT_UTF8);
+
+		pos += len;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// FLAC
+////////////////////////////////////////////////////////////////////////
+
+static void header_parse_streaminfo(HeaderParser *parser, const Uint8 *b)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Uint64 samples = ((Uint64)(b[13] & 0x0F) << 32) | header_be32(b + 14);
+
+	info->sample_rate = (int)(((Uint32)b[10] << 12) | ((Uint32)b[11] << 4) | (b[12] >> 4));
+	info->channels = ((b[12] >> 1) & 0x07) + 1;
+
+	if (samples && info->sample_rate)
+		info->duration = (double)samples / info->sample_rate;
+}
+
+static void header_parse_flac(HeaderParser *parser, Sint64 offset)
+{
+	int i;
+
+	parser->info->type = MUS_FLAC;
+	offset += 4;    // "fLaC"
+
+	for (i = 0; i < MUSIC_HEADER_MAX_CHUNKS; ++i)
+	{
+		Uint8 h[4];
+		Uint8 *block;
+		size_t read;
+		Uint32 len;
+
+		if (header_read_at(parser, offset, h, 4) != 4)
+			break;
+
+		len = header_be24(h + 1);
+		offset += 4;
+
+		if ((h[0] & 0x7F) == 0 && len >= 34) {
+			Uint8 streaminfo[34];
+			if (header_read_at(parser, offset, streaminfo, 34) == 34)
+				header_parse_streaminfo(parser, streaminfo);
+		} else if ((h[0] & 0x7F) == 4) {
+			block = header_read_block(parser, offset, len, MUSIC_HEADER_TAG_SIZE, &read);
+			if (block)
+				header_parse_vorbis_comments(parser, block, read);
+			SDL_free(block);
+		}
+
+		offset += len;
+		if (h[0] & 0x80)    // Last metadata block
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// Ogg (Vorbis, Opus, FLAC)
+////////////////////////////////////////////////////////////////////////
+
+enum {
+	HEADER_OGG_UNKNOWN,
+	HEADER_OGG_VORBIS,
+	HEADER_OGG_OPUS,
+	HEADER_OGG_FLAC
+};
+
+static int header_parse_ogg_packet(HeaderParser *parser, int index, int codec, const Uint8 *packet, size_t len, Uint16 *pre_skip)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+
+	if (index == 0)
+	{
+		if (len >= 30 && packet[0] == 0x01 && header_tag_equals(packet + 1, "vorbis")) {
+			info->type = MUS_OGG;
+			info->channels = packet[11];
+			info->sample_rate = (int)header_le32(packet + 12);
+			return HEADER_OGG_VORBIS;
+		}
+		if (len >= 19 && header_tag_equals(packet, "OpusHead")) {
+			info->type = MUS_OPUS;
+			info->channels = packet[9];
+			// Opus always decodes at 48 kHz; this also applies to
+			// granule positions and loop tags.
+			info->sample_rate = 48000;
+			*pre_skip = header_le16(packet + 10);
+			return HEADER_OGG_OPUS;
+		}
+		if (len >= 51 && packet[0] == 0x7F && header_tag_equals(packet + 1, "FLAC")
+			&& header_tag_equals(packet + 9, "fLaC")) {
+			info->type = MUS_FLAC;
+			header_parse_streaminfo(parser, packet + 17);
+			return HEADER_OGG_FLAC;
+		}
+		return HEADER_OGG_UNKNOWN;
+	}
+
+	if (codec == HEADER_OGG_VORBIS && len >= 7 && packet[0] == 0x03 && header_tag_equals(packet + 1, "vorbis"))
+		header_parse_vorbis_comments(parser, packet + 7, len - 7);
+	else if (codec == HEADER_OGG_OPUS && len >= 8 && header_tag_equals(packet, "OpusTags"))
+		header_parse_vorbis_comments(parser, packet + 8, len - 8);
+	else if (codec == HEADER_OGG_FLAC && len >= 4 && (packet[0] & 0x7F) == 4)
+		header_parse_vorbis_comments(parser, packet + 4, len - 4);
+
+	return codec;
+}
+
+/* Find the granule position of the last page of a logical stream */
+static Sint64 header_ogg_last_granule(HeaderParser *parser, Uint32 serial)
+{
+	Sint64 offset, granule = -1;
+	size_t read, i;
+	Uint8 *tail;
+
+	if (parser->size < 27)
+		return -1;
+
+	offset = parser->size - MUSIC_HEADER_OGG_TAIL_SIZE;
+	if (offset < 0)
+		offset = 0;
+
+	tail = header_read_block(parser, offset, (Uint64)(parser->size - offset), MUSIC_HEADER_OGG_TAIL_SIZE, &read);
+	if (tail == NULL)
+		return -1;
+
+	for (i = read >= 27 ? read - 27 + 1 : 0; i-- > 0; )
+	{
+		if (tail[i] == 'O' && header_tag_equals(tail + i, "OggS")
+			&& header_le32(tail + i + 14) == serial) {
+			granule = (Sint64)header_le64(tail + i + 6);
+			if (granule >= 0)
+				break;
+		}
+	}
+
+	SDL_free(tail);
+	return granule;
+}
+
+static void header_parse_ogg(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Uint8 page[27 + 255];
+	Uint8 *packet = (Uint8 *)SDL_malloc(MUSIC_HEADER_TAG_SIZE);
+	size_t packet_len = 0;
+	Sint64 offset = 0, granule;
+	Uint32 serial = 0;
+	Uint16 pre_skip = 0;
+	int index = 0, codec = HEADER_OGG_UNKNOWN, pages;
+
+	if (packet == NULL)
+		return;
+
+	// The identification and comment headers are the first two packets
+	for (pages = 0; pages < MUSIC_HEADER_MAX_CHUNKS && index < 2; ++pages)
+	{
+		Sint64 body;
+		size_t run = 0, body_len = 0;
+		int segments, i;
+
+		if (header_read_at(parser, offset, page, 27) != 27 || !header_tag_equals(page, "OggS"))
+			break;
+
+		segments = page[26];
+		if (header_read_at(parser, offset + 27, page + 27, segments) != (size_t)segments)
+			break;
+
+		for (i = 0; i < segments; ++i)
+			body_len += page[27 + i];
+
+		body = offset + 27 + segments;
+		offset = body + body_len;
+
+		if (pages == 0)
+			serial = header_le32(page + 14);
+		else if (header_le32(page + 14) != serial)
+			continue;   // Another multiplexed stream
+
+		for (i = 0; i < segments && index < 2; ++i)
+		{
+			Uint8 lace = page[27 + i];
+
+			run += lace;
+			if (lace == 255 && i < segments - 1)
+				continue;
+
+			// Append this page's part of the packet, truncated if large
+			if (packet_len < MUSIC_HEADER_TAG_SIZE) {
+				size_t copy = run;
+				if (copy > MUSIC_HEADER_TAG_SIZE - packet_len)
+					copy = MUSIC_HEADER_TAG_SIZE - packet_len;
+				packet_len += header_read_at(parser, body, packet + packet_len, copy);
+			}
+			body += run;
+			run = 0;
+
+			if (lace < 255) {
+				codec = header_parse_ogg_packet(parser, index, codec, packet, packet_len, &pre_skip);
+				if (codec == HEADER_OGG_UNKNOWN)
+					index = 2;
+				++index;
+				packet_len = 0;
+			}
+		}
+	}
+
+	SDL_free(packet);
+
+	if (codec == HEADER_OGG_UNKNOWN || info->sample_rate <= 0)
+		return;
+
+	if (info->duration < 0.0) {
+		granule = header_ogg_last_granule(parser, serial);
+		if (granule > pre_skip)
+			info->duration = (double)(granule - pre_skip) / info->sample_rate;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// MP3
+////////////////////////////////////////////////////////////////////////
+
+static const Uint16 header_mp3_bitrates[2][3][15] = {
+	{   // MPEG 1: Layer I, II, III
+		{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+		{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+	},
+	{   // MPEG 2 and 2.5
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+	}
+};
+
+static const Uint16 header_mp3_rates[3][3] = {
+	{ 44100, 48000, 32000 },    // MPEG 1
+	{ 22050, 24000, 16000 },    // MPEG 2
+	{ 11025, 12000, 8000 }      // MPEG 2.5
+};
+
+typedef struct {
+	int version;        // 0: MPEG 1, 1: MPEG 2, 2: MPEG 2.5
+	int layer;          // 1 - 3
+	int bitrate;        // kbit/s
+	int sample_rate;
+	int channels;
+	int samples;        // Per frame
+	int length;         // Bytes
+	int side_info;      // Bytes after the frame header
+} HeaderMP3Frame;
+
+static SDL_bool header_parse_mp3_frame(const Uint8 *h, HeaderMP3Frame *frame)
+{
+	int version_bits = (h[1] >> 3) & 0x03;
+	int layer_bits = (h[1] >> 1) & 0x03;
+	int bitrate_index = h[2] >> 4;
+	int rate_index = (h[2] >> 2) & 0x03;
+	int padding = (h[2] >> 1) & 0x01;
+	SDL_bool mono = ((h[3] >> 6) == 3) ? SDL_TRUE : SDL_FALSE;
+
+	if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0
+		|| version_bits == 1 || layer_bits == 0
+		|| bitrate_index == 0 || bitrate_index == 15 || rate_index == 3)
+		return SDL_FALSE;
+
+	frame->version = (version_bits == 3) ? 0 : (version_bits == 2) ? 1 : 2;
+	frame->layer = 4 - layer_bits;
+	frame->bitrate = header_mp3_bitrates[frame->version ? 1 : 0][frame->layer - 1][bitrate_index];
+	frame->sample_rate = header_mp3_rates[frame->version][rate_index];
+	frame->channels = mono ? 1 : 2;
+
+	if (frame->layer == 1) {
+		frame->samples = 384;
+		frame->length = (12000 * frame->bitrate / frame->sample_rate + padding) * 4;
+	} else {
+		frame->samples = (frame->layer == 3 && frame->version) ? 576 : 1152;
+		frame->length = (frame->samples / 8) * 1000 * frame->bitrate / frame->sample_rate + padding;
+	}
+
+	if (frame->version == 0)
+		frame->side_info = mono ? 17 : 32;
+	else
+		frame->side_info = mono ? 9 : 17;
+
+	return SDL_TRUE;
+}
+
+/* ID3v2 tag at the start of the file. Returns the size of the tag. */
+static Sint64 header_parse_id3v2(HeaderParser *parser)
+{
+	Uint8 h[10];
+	Uint8 *frames;
+	Sint64 size;
+	size_t read, pos = 0;
+	int major;
+
+	if (header_read_at(parser, 0, h, 10) != 10 || !header_tag_equals(h, "ID3"))
+		return 0;
+
+	major = h[3];
+	size = ((h[6] & 0x7F) << 21) | ((h[7] & 0x7F) << 14) | ((h[8] & 0x7F) << 7) | (h[9] & 0x7F);
+
+	frames = header_read_block(parser, 10, (Uint64)size, MUSIC_HEADER_TAG_SIZE, &read);
+	if (frames == NULL)
+		return 10 + size;
+
+	// Skip the extended header
+	if ((h[5] & 0x40) && read >= 4) {
+		if (major == 3)
+			pos = 4 + header_be32(frames);
+		else if (major == 4)
+			pos = ((frames[0] & 0x7F) << 21) | ((frames[1] & 0x7F) << 14) | ((frames[2] & 0x7F) << 7) | (frames[3] & 0x7F);
+	}
+
+	while (pos < read)
+	{
+		const Uint8 *frame = frames + pos;
+		const Uint8 *data;
+		size_t id_len = (major == 2) ? 3 : 4;
+		size_t header_len = (major == 2) ? 6 : 10;
+		Uint32 len;
+		int encoding;
+
+		if (pos + header_len > read || frame[0] == 0)
+			break;
+
+		if (major == 2)
+			len = header_be24(frame + 3);
+		else if (major == 4)
+			len = ((frame[4] & 0x7F) << 21) | ((frame[5] & 0x7F) << 14) | ((frame[6] & 0x7F) << 7) | (frame[7] & 0x7F);
+		else
+			len = header_be32(frame + 4);
+
+		pos += header_len;
+		if (len > read - pos)
+			len = (Uint32)(read - pos);
+
+		data = frames + pos;
+		pos += len;
+
+		if (frame[0] != 'T' || len < 1)
+			continue;
+
+		encoding = data[0];
+		if (encoding > HEADER_TEXT_UTF8)
+			continue;
+
+		if (header_tag_equals(frame, id_len == 3 ? "TT2" : "TIT2"))
+			header_set_tag(parser->info->title, data + 1, len - 1, encoding);
+		else if (header_tag_equals(frame, id_len == 3 ? "TP1" : "TPE1"))
+			header_set_tag(parser->info->artist, data + 1, len - 1, encoding);
+		else if (header_tag_equals(frame, id_len == 3 ? "TAL" : "TALB"))
+			header_set_tag(parser->info->album, data + 1, len - 1, encoding);
+		else if (header_tag_equals(frame, id_len == 3 ? "TCR" : "TCOP"))
+			header_set_tag(parser->info->copyright, data + 1, len - 1, encoding);
+		else if (header_tag_equals(frame, id_len == 3 ? "TXX" : "TXXX")) {
+			// User defined "description" = "value", e.g. LOOPSTART
+			char key[16];
+			size_t used = header_decode_text(key, sizeof key, data + 1, len - 1, encoding);
+			if (encoding == HEADER_TEXT_UTF16 || encoding == HEADER_TEXT_UTF16BE)
+				encoding = HEADER_TEXT_UTF16BE;   // Only the description has a BOM
+			if (used < len - 1)
+				header_parse_field(parser, key, SDL_strlen(key), data + 1 + used, len - 1 - used,
+					(data[0] == HEADER_TEXT_UTF16) ? HEADER_TEXT_UTF16 : encoding);
+		}
+	}
+
+	SDL_free(frames);
+
+	return 10 + size + ((h[5] & 0x10) ? 10 : 0);
+}
+
+/* ID3v1 tag in the last 128 bytes. Returns SDL_TRUE if present. */
+static SDL_bool header_parse_id3v1(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Uint8 tag[128];
+
+	if (parser->size < 128
+		|| header_read_at(parser, parser->size - 128, tag, 128) != 128
+		|| !header_tag_equals(tag, "TAG"))
+		return SDL_FALSE;
+
+	header_set_tag(info->title, tag + 3, 30, HEADER_TEXT_LATIN1);
+	header_set_tag(info->artist, tag + 33, 30, HEADER_TEXT_LATIN1);
+	header_set_tag(info->album, tag + 63, 30, HEADER_TEXT_LATIN1);
+	return SDL_TRUE;
+}
+
+static void header_parse_mp3(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Sint64 audio = header_parse_id3v2(parser);
+	Sint64 end = parser->size;
+	HeaderMP3Frame frame, next;
+	Uint8 buf[MUSIC_HEADER_READ_SIZE];
+	size_t read, i;
+
+	// FLAC files sometimes start with an ID3 tag
+	if (audio > 0 && header_read_at(parser, audio, buf, 4) == 4 && header_tag_equals(buf, "fLaC")) {
+		header_parse_flac(parser, audio);
+		return;
+	}
+
+	info->type = MUS_MP3;
+
+	if (header_parse_id3v1(parser))
+		end -= 128;
+
+	// Find the first frame, confirmed by the frame following it
+	read = header_read_at(parser, audio, buf, sizeof buf);
+	for (i = 0; i + 4 <= read; ++i)
+	{
+		if (!header_parse_mp3_frame(buf + i, &frame))
+			continue;
+		if (i + frame.length + 4 <= read && !header_parse_mp3_frame(buf + i + frame.length, &next))
+			continue;
+		break;
+	}
+
+	if (i + 4 > read)
+		return;
+
+	info->sample_rate = frame.sample_rate;
+	info->channels = frame.channels;
+
+	// VBR files have a Xing/Info or VBRI header with the frame count
+	if (i + 4 + frame.side_info + 12 <= read) {
+		const Uint8 *xing = buf + i + 4 + frame.side_info;
+		if ((header_tag_equals(xing, "Xing") || header_tag_equals(xing, "Info"))
+			&& (header_be32(xing + 4) & 0x01)) {
+			info->duration = (double)header_be32(xing + 8) * frame.samples / frame.sample_rate;
+			return;
+		}
+	}
+
+	if (i + 4 + 32 + 18 <= read && header_tag_equals(buf + i + 4 + 32, "VBRI")) {
+		info->duration = (double)header_be32(buf + i + 4 + 32 + 14) * frame.samples / frame.sample_rate;
+		return;
+	}
+
+	// Constant bit rate
+	if (end > audio + (Sint64)i)
+		info->duration = (double)(end - audio - (Sint64)i) * 8.0 / (frame.bitrate * 1000.0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// WAV and AIFF
+////////////////////////////////////////////////////////////////////////
+
+static void header_parse_riff_info(HeaderParser *parser, const Uint8 *list, size_t len)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	size_t pos = 4;     // "INFO"
+
+	while (pos + 8 <= len)
+	{
+		const Uint8 *chunk = list + pos;
+		size_t size = header_le32(chunk + 4);
+
+		pos += 8;
+		if (size > len - pos)
+			size = len - pos;
+
+		if (header_tag_equals(chunk, "INAM"))
+			header_set_tag(info->title, chunk + 8, size, HEADER_TEXT_UTF8);
+		else if (header_tag_equals(chunk, "IART"))
+			header_set_tag(info->artist, chunk + 8, size, HEADER_TEXT_UTF8);
+		else if (header_tag_equals(chunk, "IPRD"))
+			header_set_tag(info->album, chunk + 8, size, HEADER_TEXT_UTF8);
+		else if (header_tag_equals(chunk, "ICOP"))
+			header_set_tag(info->copyright, chunk + 8, size, HEADER_TEXT_UTF8);
+
+		pos += size + (size & 1);
+	}
+}
+
+static void header_parse_wav(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Sint64 offset = 12;
+	Uint32 byte_rate = 0;
+	int i;
+
+	info->type = MUS_WAV;
+
+	for (i = 0; i < MUSIC_HEADER_MAX_CHUNKS; ++i)
+	{
+		Uint8 chunk[8], fmt[16], smpl[52];
+		Uint64 size;
+
+		if (header_read_at(parser, offset, chunk, 8) != 8)
+			break;
+
+		size = header_le32(chunk + 4);
+		offset += 8;
+
+		if (header_tag_equals(chunk, "fmt ") && header_read_at(parser, offset, fmt, 16) == 16) {
+			info->channels = header_le16(fmt + 2);
+			info->sample_rate = (int)header_le32(fmt + 4);
+			byte_rate = header_le32(fmt + 8);
+		} else if (header_tag_equals(chunk, "data")) {
+			// Streamed WAVs leave the size unset
+			if (parser->size >= 0 && (size == 0xFFFFFFFF || offset + (Sint64)size > parser->size))
+				size = (Uint64)(parser->size - offset);
+			if (byte_rate)
+				info->duration = (double)size / byte_rate;
+		} else if (header_tag_equals(chunk, "LIST")) {
+			size_t read;
+			Uint8 *list = header_read_block(parser, offset, size, MUSIC_HEADER_TAG_SIZE, &read);
+			if (list && read >= 4 && header_tag_equals(list, "INFO"))
+				header_parse_riff_info(parser, list, read);
+			SDL_free(list);
+		} else if (header_tag_equals(chunk, "smpl") && size >= 60
+			&& header_read_at(parser, offset + 8, smpl, sizeof smpl) == sizeof smpl) {
+			// Sampler chunk: the first loop is the loop region. Its end
+			// sample is inclusive.
+			if (header_le32(smpl + 20) > 0 && parser->loop_start < 0) {
+				parser->loop_start = header_le32(smpl + 36);
+				parser->loop_end = (Sint64)header_le32(smpl + 40) + 1;
+			}
+		}
+
+		offset += size + (size & 1);
+	}
+}
+
+/* 80-bit IEEE 754 extended precision, as used by AIFF */
+static double header_extended(const Uint8 *b)
+{
+	int exponent = ((b[0] & 0x7F) << 8) | b[1];
+	Uint64 mantissa = header_be64(b + 2);
+	double value;
+
+	if (exponent == 0 && mantissa == 0)
+		return 0.0;
+
+	value = ldexp((double)mantissa, exponent - 16383 - 63);
+	return (b[0] & 0x80) ? -value : value;
+}
+
+static void header_parse_aiff(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Sint64 offset = 12;
+	int i;
+
+	info->type = MUS_WAV;
+
+	for (i = 0; i < MUSIC_HEADER_MAX_CHUNKS; ++i)
+	{
+		Uint8 chunk[8], comm[18];
+		Uint64 size;
+		char *tag = NULL;
+
+		if (header_read_at(parser, offset, chunk, 8) != 8)
+			break;
+
+		size = header_be32(chunk + 4);
+		offset += 8;
+
+		if (header_tag_equals(chunk, "COMM") && header_read_at(parser, offset, comm, 18) == 18) {
+			Uint32 frames = header_be32(comm + 2);
+			double rate = header_extended(comm + 8);
+
+			info->channels = header_be16(comm);
+			info->sample_rate = (int)rate;
+			if (rate > 0.0)
+				info->duration = frames / rate;
+		}
+		else if (header_tag_equals(chunk, "NAME"))
+			tag = info->title;
+		else if (header_tag_equals(chunk, "AUTH"))
+			tag = info->artist;
+		else if (header_tag_equals(chunk, "(c) "))
+			tag = info->copyright;
+
+		if (tag) {
+			size_t read;
+			Uint8 *text = header_read_block(parser, offset, size, HTML5_MIX_MUSIC_TAG_LENGTH, &read);
+			if (text)
+				header_set_tag(tag, text, read, HEADER_TEXT_LATIN1);
+			SDL_free(text);
+		}
+
+		offset += size + (size & 1);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// MP4
+////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+	Sint64 offset;      // Start of the box
+	Sint64 data;        // Start of the contents
+	Sint64 end;
+	Uint8 type[4];
+} HeaderBox;
+
+static SDL_bool header_read_box(HeaderParser *parser, Sint64 offset, Sint64 end, HeaderBox *box)
+{
+	Uint8 h[16];
+	Uint64 size;
+
+	if (offset + 8 > end || header_read_at(parser, offset, h, 8) != 8)
+		return SDL_FALSE;
+
+	size = header_be32(h);
+	SDL_memcpy(box->type, h + 4, 4);
+	box->offset = offset;
+	box->data = offset + 8;
+
+	if (size == 1) {
+		if (header_read_at(parser, offset + 8, h + 8, 8) != 8)
+			return SDL_FALSE;
+		size = header_be64(h + 8);
+		box->data += 8;
+	} else if (size == 0) {
+		size = (Uint64)(end - offset);  // Extends to the end
+	}
+
+	if (size < (Uint64)(box->data - offset))
+		return SDL_FALSE;
+
+	box->end = offset + (Sint64)size;
+	if (box->end > end)
+		box->end = end;
+
+	return SDL_TRUE;
+}
+
+static void header_parse_mp4_boxes(HeaderParser *parser, Sint64 offset, Sint64 end, int depth);
+
+static void header_parse_mp4_ilst_item(HeaderParser *parser, const HeaderBox *item, char *tag)
+{
+	HeaderBox data;
+	Uint8 text[HTML5_MIX_MUSIC_TAG_LENGTH];
+	size_t read;
+
+	// The value is in a "data" box: type (4), locale (4), UTF-8 text
+	if (!header_read_box(parser, item->data, item->end, &data) || !header_tag_equals(data.type, "data"))
+		return;
+
+	if (data.end - data.data <= 8)
+		return;
+
+	read = header_read_at(parser, data.data + 8, text,
+		(size_t)SDL_min(data.end - data.data - 8, (Sint64)sizeof text));
+	header_set_tag(tag, text, read, HEADER_TEXT_UTF8);
+}
+
+static void header_parse_mp4_box(HeaderParser *parser, const HeaderBox *box, int depth)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Uint8 b[36];
+
+	if (header_tag_equals(box->type, "moov")
+		|| header_tag_equals(box->type, "trak")
+		|| header_tag_equals(box->type, "mdia")
+		|| header_tag_equals(box->type, "minf")
+		|| header_tag_equals(box->type, "stbl")
+		|| header_tag_equals(box->type, "udta")
+		|| header_tag_equals(box->type, "ilst"))
+		header_parse_mp4_boxes(parser, box->data, box->end, depth + 1);
+	else if (header_tag_equals(box->type, "meta")) {
+		// Full box in MP4, plain box in QuickTime
+		Sint64 data = box->data;
+		if (header_read_at(parser, data, b, 4) == 4 && header_be32(b) == 0)
+			data += 4;
+		header_parse_mp4_boxes(parser, data, box->end, depth + 1);
+	}
+	else if (header_tag_equals(box->type, "mvhd")) {
+		if (header_read_at(parser, box->data, b, 32) == 32) {
+			Uint32 timescale = (b[0] == 1) ? header_be32(b + 20) : header_be32(b + 12);
+			Uint64 duration = (b[0] == 1) ? header_be64(b + 24) : header_be32(b + 16);
+			if (timescale)
+				info->duration = (double)duration / timescale;
+		}
+	}
+	else if (header_tag_equals(box->type, "stsd")) {
+		// The first sample entry of the first track that has one.
+		// Audio entries have their channel count at 24 and a 16.16
+		// sample rate at 32.
+		if (info->sample_rate == 0 && header_read_at(parser, box->data + 8, b, 36) == 36
+			&& (header_tag_equals(b + 4, "mp4a") || header_tag_equals(b + 4, "alac")
+				|| header_tag_equals(b + 4, "Opus") || header_tag_equals(b + 4, "fLaC")
+				|| header_tag_equals(b + 4, "ac-3") || header_tag_equals(b + 4, "ec-3"))) {
+			info->channels = header_be16(b + 24);
+			info->sample_rate = (int)(header_be32(b + 32) >> 16);
+		}
+	}
+	else if (box->type[0] == 0xA9 && header_tag_equals(box->type + 1, "nam"))
+		header_parse_mp4_ilst_item(parser, box, info->title);
+	else if (box->type[0] == 0xA9 && header_tag_equals(box->type + 1, "ART"))
+		header_parse_mp4_ilst_item(parser, box, info->artist);
+	else if (box->type[0] == 0xA9 && header_tag_equals(box->type + 1, "alb"))
+		header_parse_mp4_ilst_item(parser, box, info->album);
+	else if (header_tag_equals(box->type, "cprt"))
+		header_parse_mp4_ilst_item(parser, box, info->copyright);
+}
+
+static void header_parse_mp4_boxes(HeaderParser *parser, Sint64 offset, Sint64 end, int depth)
+{
+	HeaderBox box;
+	int i;
+
+	if (depth > 8)
+		return;
+
+	// Only box headers are read while walking, so a "moov" box at the
+	// end of the file costs a few seeks rather than a download.
+	for (i = 0; i < MUSIC_HEADER_MAX_CHUNKS && header_read_box(parser, offset, end, &box); ++i)
+	{
+		header_parse_mp4_box(parser, &box, depth);
+		if (box.end <= offset)
+			break;
+		offset = box.end;
+	}
+}
+
+static void header_parse_mp4(HeaderParser *parser)
+{
+	Sint64 end = (parser->size >= 0) ? parser->size : (Sint64)parser->head_size;
+
+	parser->info->type = MUS_HTML5;
+	header_parse_mp4_boxes(parser, 0, end, 0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// WebM / Matroska
+////////////////////////////////////////////////////////////////////////
+
+#define EBML_ID_SEGMENT         0x18538067
+#define EBML_ID_SEEKHEAD        0x114D9B74
+#define EBML_ID_SEEK            0x4DBB
+#define EBML_ID_SEEKID          0x53AB
+#define EBML_ID_SEEKPOSITION    0x53AC
+#define EBML_ID_INFO            0x1549A966
+#define EBML_ID_TIMECODESCALE   0x2AD7B1
+#define EBML_ID_DURATION        0x4489
+#define EBML_ID_TITLE           0x7BA9
+#define EBML_ID_TRACKS          0x1654AE6B
+#define EBML_ID_TRACKENTRY      0xAE
+#define EBML_ID_TRACKTYPE       0x83
+#define EBML_ID_AUDIO           0xE1
+#define EBML_ID_SAMPLINGFREQ    0xB5
+#define EBML_ID_CHANNELS        0x9F
+#define EBML_ID_TAGS            0x1254C367
+#define EBML_ID_TAG             0x7373
+#define EBML_ID_SIMPLETAG       0x67C8
+#define EBML_ID_TAGNAME         0x45A3
+#define EBML_ID_TAGSTRING       0x4487
+#define EBML_ID_CLUSTER         0x1F43B675
+
+#define EBML_UNKNOWN_SIZE       (~(Uint64)0)
+
+typedef struct {
+	Uint32 id;
+	Sint64 data;
+	Sint64 end;
+} HeaderElement;
+
+typedef struct {
+	Uint64 timecode_scale;
+	double duration;
+	int audio_track;
+	char tag_name[32];
+	Sint64 info;        // Positions from the SeekHead, or -1
+	Sint64 tracks;
+	Sint64 tags;
+} HeaderWebM;
+
+/* Read an EBML element header: a variable length ID and size */
+static SDL_bool header_read_element(HeaderParser *parser, Sint64 offset, Sint64 end, HeaderElement *element)
+{
+	Uint8 h[12];
+	size_t read = header_read_at(parser, offset, h, sizeof h);
+	size_t id_len = 1, size_len = 1, i;
+	Uint64 size;
+
+	if (read < 2)
+		return SDL_FALSE;
+
+	while (id_len <= 4 && !(h[0] & (0x80 >> (id_len - 1))))
+		++id_len;
+	if (id_len > 4 || id_len >= read)
+		return SDL_FALSE;
+
+	element->id = 0;
+	for (i = 0; i < id_len; ++i)
+		element->id = (element->id << 8) | h[i];
+
+	while (size_len <= 8 && !(h[id_len] & (0x80 >> (size_len - 1))))
+		++size_len;
+	if (size_len > 8 || id_len + size_len > read)
+		return SDL_FALSE;
+
+	size = h[id_len] & (0xFF >> size_len);
+	for (i = 1; i < size_len; ++i)
+		size = (size << 8) | h[id_len + i];
+
+	// All ones means "unknown size"
+	if (size == ((Uint64)1 << (7 * size_len)) - 1)
+		size = EBML_UNKNOWN_SIZE;
+
+	element->data = offset + (Sint64)(id_len + size_len);
+	if (size == EBML_UNKNOWN_SIZE || (Uint64)(end - element->data) < size)
+		element->end = end;
+	else
+		element->end = element->data + (Sint64)size;
+
+	return SDL_TRUE;
+}
+
+static Uint64 header_element_uint(HeaderParser *parser, const HeaderElement *element)
+{
+	Uint8 b[8];
+	size_t len = (size_t)(element->end - element->data), i;
+	Uint64 value = 0;
+
+	if (len > 8 || header_read_at(parser, element->data, b, len) != len)
+		return 0;
+
+	for (i = 0; i < len; ++i)
+		value = (value << 8) | b[i];
+	return value;
+}
+
+static double header_element_float(HeaderParser *parser, const HeaderElement *element)
+{
+	Uint8 b[8];
+	size_t len = (size_t)(element->end - element->data);
+	union { Uint32 u; float f; } f32;
+	union { Uint64 u; double f; } f64;
+
+	if ((len != 4 && len != 8) || header_read_at(parser, element->data, b, len) != len)
+		return 0.0;
+
+	if (len == 4) {
+		f32.u = header_be32(b);
+		return f32.f;
+	}
+
+	f64.u = header_be64(b);
+	return f64.f;
+}
+
+static void header_element_text(HeaderParser *parser, const HeaderElement *element, char *text, size_t size)
+{
+	Uint8 b[HTML5_MIX_MUSIC_TAG_LENGTH];
+	size_t read = header_read_at(parser, element->data, b,
+		(size_t)SDL_min(element->end - element->data, (Sint64)sizeof b));
+
+	header_decode_text(text, size, b, read, HEADER_TEXT_UTF8);
+}
+
+static void header_parse_webm_elements(HeaderParser *parser, HeaderWebM *webm, Sint64 offset, Sint64 end, Sint64 segment, int depth)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	HeaderElement element;
+	Uint64 seek_id = 0;
+	int i;
+
+	if (depth > 6)
+		return;
+
+	for (i = 0; i < MUSIC_HEADER_MAX_CHUNKS * 4 && header_read_element(parser, offset, end, &element); ++i)
+	{
+		switch (element.id)
+		{
+		case EBML_ID_SEGMENT:
+			header_parse_webm_elements(parser, webm, element.data, element.end, element.data, depth + 1);
+			return;
+
+		case EBML_ID_CLUSTER:
+			// Media data follows; everything else is found via the SeekHead
+			return;
+
+		case EBML_ID_SEEKHEAD:
+		case EBML_ID_SEEK:
+		case EBML_ID_INFO:
+		case EBML_ID_TRACKS:
+		case EBML_ID_AUDIO:
+		case EBML_ID_TAGS:
+		case EBML_ID_TAG:
+			if (element.id == EBML_ID_INFO)
+				webm->info = -1;
+			else if (element.id == EBML_ID_TRACKS)
+				webm->tracks = -1;
+			else if (element.id == EBML_ID_TAGS)
+				webm->tags = -1;
+			header_parse_webm_elements(parser, webm, element.data, element.end, segment, depth + 1);
+			break;
+
+		case EBML_ID_TRACKENTRY:
+			webm->audio_track = 0;
+			header_parse_webm_elements(parser, webm, element.data, element.end, segment, depth + 1);
+			break;
+
+		case EBML_ID_SIMPLETAG:
+			webm->tag_name[0] = '\0';
+			header_parse_webm_elements(parser, webm, element.data, element.end, segment, depth + 1);
+			break;
+
+		case EBML_ID_SEEKID:
+			seek_id = header_element_uint(parser, &element);
+			break;
+
+		case EBML_ID_SEEKPOSITION:
+		{
+			Sint64 position = segment + (Sint64)header_element_uint(parser, &element);
+			if (seek_id == EBML_ID_INFO && webm->info == 0)
+				webm->info = position;
+			else if (seek_id == EBML_ID_TRACKS && webm->tracks == 0)
+				webm->tracks = position;
+			else if (seek_id == EBML_ID_TAGS && webm->tags == 0)
+				webm->tags = position;
+			break;
+		}
+
+		case EBML_ID_TIMECODESCALE:
+			webm->timecode_scale = header_element_uint(parser, &element);
+			break;
+
+		case EBML_ID_DURATION:
+			webm->duration = header_element_float(parser, &element);
+			break;
+
+		case EBML_ID_TITLE:
+			if (info->title[0] == '\0')
+				header_element_text(parser, &element, info->title, sizeof info->title);
+			break;
+
+		case EBML_ID_TRACKTYPE:
+			webm->audio_track = (header_element_uint(parser, &element) == 2);
+			break;
+
+		case EBML_ID_SAMPLINGFREQ:
+			if (info->sample_rate == 0)
+				info->sample_rate = (int)header_element_float(parser, &element);
+			break;
+
+		case EBML_ID_CHANNELS:
+			if (info->channels == 0)
+				info->channels = (int)header_element_uint(parser, &element);
+			break;
+
+		case EBML_ID_TAGNAME:
+			header_element_text(parser, &element, webm->tag_name, sizeof webm->tag_name);
+			break;
+
+		case EBML_ID_TAGSTRING:
+		{
+			Uint8 b[HTML5_MIX_MUSIC_TAG_LENGTH];
+			size_t read = header_read_at(parser, element.data, b,
+				(size_t)SDL_min(element.end - element.data, (Sint64)sizeof b));
+			header_parse_field(parser, webm->tag_name, SDL_strlen(webm->tag_name), b, read, HEADER_TEXT_UTF8);
+			break;
+		}
+
+		default:
+			break;
+		}
+
+		if (element.end <= offset)
+			break;
+		offset = element.end;
+	}
+}
+
+static void header_parse_webm_at(HeaderParser *parser, HeaderWebM *webm, Sint64 position, Sint64 end)
+{
+	HeaderElement element;
+
+	if (position > 0 && header_read_element(parser, position, end, &element))
+		header_parse_webm_elements(parser, webm, position, element.end, 0, 1);
+}
+
+static void header_parse_webm(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	Sint64 end = (parser->size >= 0) ? parser->size : (Sint64)parser->head_size;
+	HeaderWebM webm;
+
+	SDL_memset(&webm, 0, sizeof webm);
+	webm.timecode_scale = 1000000;
+	webm.duration = -1.0;
+
+	info->type = MUS_HTML5;
+	header_parse_webm_elements(parser, &webm, 0, end, 0, 0);
+
+	// Elements placed after the first cluster, as listed in the SeekHead
+	header_parse_webm_at(parser, &webm, webm.info, end);
+	header_parse_webm_at(parser, &webm, webm.tracks, end);
+	header_parse_webm_at(parser, &webm, webm.tags, end);
+
+	if (webm.duration > 0.0)
+		info->duration = webm.duration * webm.timecode_scale / 1e9;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Tracker modules
+////////////////////////////////////////////////////////////////////////
+
+/* Modules only name the song; the length depends on playing the
+   pattern order, so the renderer reports it once loaded. */
+static void header_parse_module(HeaderParser *parser, Mix_MusicFormat format)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	const Uint8 *b = parser->head;
+	size_t size = parser->head_size;
+
+	info->type = MUS_MOD;
+
+	switch (format)
+	{
+	case MUSIC_FORMAT_MOD:
+		if (size >= 1084) {
+			header_set_tag(info->title, b, 20, HEADER_TEXT_LATIN1);
+			if (b[1080] >= '1' && b[1080] <= '9' && header_tag_equals(b + 1081, "CHN"))
+				info->channels = b[1080] - '0';
+			else if (b[1082] == 'C' && (b[1083] == 'H' || b[1083] == 'N'))
+				info->channels = (b[1080] - '0') * 10 + (b[1081] - '0');
+			else if (header_tag_equals(b + 1080, "FLT8") || header_tag_equals(b + 1080, "OCTA")
+				|| header_tag_equals(b + 1080, "CD81"))
+				info->channels = 8;
+			else
+				info->channels = 4;
+		}
+		break;
+	case MUSIC_FORMAT_S3M:
+		if (size >= 28)
+			header_set_tag(info->title, b, 28, HEADER_TEXT_LATIN1);
+		break;
+	case MUSIC_FORMAT_XM:
+		if (size >= 70) {
+			header_set_tag(info->title, b + 17, 20, HEADER_TEXT_LATIN1);
+			info->channels = header_le16(b + 68);
+		}
+		break;
+	case MUSIC_FORMAT_IT:
+		if (size >= 30)
+			header_set_tag(info->title, b + 4, 26, HEADER_TEXT_LATIN1);
+		break;
+	default:
+		break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIDI
+////////////////////////////////////////////////////////////////////////
+
+static SDL_bool header_midi_length(const Uint8 *b, size_t end, size_t *pos, Uint32 *value)
+{
+	int i;
+
+	*value = 0;
+	for (i = 0; i < 4 && *pos < end; ++i)
+	{
+		Uint8 c = b[(*pos)++];
+		*value = (*value << 7) | (c & 0x7F);
+		if (!(c & 0x80))
+			return SDL_TRUE;
+	}
+
+	return SDL_FALSE;
+}
+
+/* Names come from meta events at the start of the first track. The
+   length depends on the tempo map, so the synth reports it once loaded. */
+static void header_parse_midi(HeaderParser *parser)
+{
+	HTML5_Mix_MusicInfo *info = parser->info;
+	const Uint8 *b = parser->head;
+	size_t end = parser->head_size;
+	size_t pos = 0;
+	Uint8 status = 0;
+	Uint32 len;
+
+	info->type = MUS_MID;
+
+	// RIFF MIDI keeps the standard file in its "data" chunk
+	if (end >= 20 && header_tag_equals(b, "RIFF") && header_tag_equals(b + 12, "data"))
+		pos = 20;
+
+	if (pos + 14 > end || !header_tag_equals(b + pos, "MThd"))
+		return;
+
+	pos += 8 + header_be32(b + pos + 4);
+	if (pos + 8 > end || !header_tag_equals(b + pos, "MTrk"))
+		return;
+
+	if (pos + 8 + header_be32(b + pos + 4) < end)
+		end = pos + 8 + header_be32(b + pos + 4);
+	pos += 8;
+
+	while (pos < end)
+	{
+		Uint8 c;
+
+		if (!header_midi_length(b, end, &pos, &len) || pos >= end)
+			break;
+
+		c = b[pos];
+		if (c == 0xFF) {
+			Uint8 type;
+
+			if (pos + 2 > end)
+				break;
+			type = b[pos + 1];
+			pos += 2;
+			if (!header_midi_length(b, end, &pos, &len) || len > end - pos)
+				break;
+			if (type == 0x03)
+				header_set_tag(info->title, b + pos, len, HEADER_TEXT_LATIN1);
+			else if (type == 0x02)
+				header_set_tag(info->copyright, b + pos, len, HEADER_TEXT_LATIN1);
+			else if (type == 0x2F)
+				break;
+			pos += len;
+		} else if (c == 0xF0 || c == 0xF7) {
+			++pos;
+			if (!header_midi_length(b, end, &pos, &len))
+				break;
+			pos += len;
+		} else {
+			// Channel message, possibly with running status
+			if (c & 0x80) {
+				status = c;
+				++pos;
+			}
+			if (status == 0)
+				break;
+			pos += ((status & 0xE0) == 0xC0) ? 1 : 2;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////
+
+static void header_reset_info(HTML5_Mix_MusicInfo *info)
+{
+	SDL_memset(info, 0, sizeof *info);
+	info->type = MUS_NONE;
+	info->duration = -1.0;
+	info->loop_start = -1.0;
+	info->loop_end = -1.0;
+}
+
+Mix_MusicFormat music_header_parse_rw(SDL_RWops *src, HTML5_Mix_MusicInfo *info)
+{
+	HeaderParser *parser;
+	Mix_MusicFormat format;
+	Sint64 end;
+
+	header_reset_info(info);
+
+	if (src == NULL)
+		return MUSIC_FORMAT_UNKNOWN;
+
+	parser = (HeaderParser *)SDL_calloc(1, sizeof *parser);
+	if (parser == NULL)
+		return MUSIC_FORMAT_UNKNOWN;
+
+	parser->src = src;
+	parser->info = info;
+	parser->loop_start = -1;
+	parser->loop_length = -1;
+	parser->loop_end = -1;
+	parser->start = SDL_RWtell(src);
+
+	if (parser->start < 0) {
+		SDL_free(parser);
+		return MUSIC_FORMAT_UNKNOWN;
+	}
+
+	end = SDL_RWsize(src);
+	parser->size = (end >= parser->start) ? end - parser->start : -1;
+	parser->head_size = SDL_RWread(src, parser->head, 1, sizeof parser->head);
+
+	format = music_probe_magic(parser->head, parser->head_size);
+
+	switch (format)
+	{
+	case MUSIC_FORMAT_OGG:
+	case MUSIC_FORMAT_OPUS:
+		header_parse_ogg(parser);
+		break;
+	case MUSIC_FORMAT_FLAC:
+		header_parse_flac(parser, 0);
+		break;
+	case MUSIC_FORMAT_MP3:
+		header_parse_mp3(parser);
+		break;
+	case MUSIC_FORMAT_WAV:
+		header_parse_wav(parser);
+		break;
+	case MUSIC_FORMAT_MP4:
+		header_parse_mp4(parser);
+		break;
+	case MUSIC_FORMAT_AIFF:
+		header_parse_aiff(parser);
+		break;
+	case MUSIC_FORMAT_WEBM:
+	case MUSIC_FORMAT_MATROSKA:
+		header_parse_webm(parser);
+		break;
+	case MUSIC_FORMAT_MOD:
+	case MUSIC_FORMAT_S3M:
+	case MUSIC_FORMAT_XM:
+	case MUSIC_FORMAT_IT:
+		header_parse_module(parser, format);
+		break;
+	case MUSIC_FORMAT_MIDI:
+		header_parse_midi(parser);
+		break;
+	default:
+		info->type = music_probe_type(format);
+		break;
+	}
+
+	if (info->type == MUS_FLAC && format == MUSIC_FORMAT_MP3)
+		format = MUSIC_FORMAT_FLAC;
+
+	// Convert sample positions of loop tags to seconds
+	if (parser->loop_start >= 0 && info->sample_rate > 0) {
+		info->loop_start = (double)parser->loop_start / info->sample_rate;
+		if (parser->loop_length > 0)
+			info->loop_end = (double)(parser->loop_start + parser->loop_length) / info->sample_rate;
+		else if (parser->loop_end > parser->loop_start)
+			info->loop_end = (double)parser->loop_end / info->sample_rate;
+	}
+
+	SDL_RWseek(src, parser->start, RW_SEEK_SET);
+	SDL_free(parser);
+
+	return format;
+}
+
+Mix_MusicFormat music_header_parse_file(const char *file, HTML5_Mix_MusicInfo *info)
+{
+	SDL_RWops *src = SDL_RWFromFile(file, "rb");
+	Mix_MusicFormat format;
+
+	if (src == NULL) {
+		header_reset_info(info);
+		return MUSIC_FORMAT_UNKNOWN;
+	}
+
+	format = music_header_parse_rw(src, info);
+	SDL_RWclose(src);
+
+	return format;
+}
@@ -0,0 +1,60 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef HTML5_MUSIC_HEADER_H_
+#define HTML5_MUSIC_HEADER_H_
+
+#include "music_probe.h"
+
+#define HTML5_MIX_MUSIC_TAG_LENGTH 128
+
+/* Stream properties and tags, as read from the file header */
+typedef struct
+{
+	Mix_MusicType type;         /* MUS_NONE if not recognized */
+	int sample_rate;            /* 0 if unknown */
+	int channels;               /* 0 if unknown */
+	double duration;            /* Seconds, or -1.0 if unknown */
+	double loop_start;          /* Seconds from LOOPSTART tags, or -1.0 */
+	double loop_end;            /* Seconds from LOOPLENGTH/LOOPEND tags, or -1.0 */
+	char title[HTML5_MIX_MUSIC_TAG_LENGTH];
+	char artist[HTML5_MIX_MUSIC_TAG_LENGTH];
+	char album[HTML5_MIX_MUSIC_TAG_LENGTH];
+	char copyright[HTML5_MIX_MUSIC_TAG_LENGTH];
+} HTML5_Mix_MusicInfo;
+
+/* Bytes read from the start of a file. Formats that store their length at
+   the end (Ogg, MP3 without a VBR header, MP4 with a trailing "moov")
+   additionally read small blocks further in.
+ */
+#define MUSIC_HEADER_READ_SIZE 4096
+
+/* Parse the header of a music stream without decoding it.
+   The stream position of 'src' is restored.
+   Returns the detected container, or MUSIC_FORMAT_UNKNOWN.
+ */
+extern Mix_MusicFormat music_header_parse_rw(SDL_RWops *src, HTML5_Mix_MusicInfo *info);
+
+/* As above, for a file in the file system (e.g. MEMFS) */
+extern Mix_MusicFormat music_header_parse_file(const char *file, HTML5_Mix_MusicInfo *info);
+
+#endif // HTML5_MUSIC_HEADER_H_
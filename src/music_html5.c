@@ -21,7 +21,9 @@
 
 /* This file supports an external command for playing music */
 
+#include "../include/html5_mixer.h"
 #include "music_html5.h"
+#include "music_header.h"
 
 #ifdef MUSIC_HTML5
 
@@ -41,9 +43,72 @@
 #define SDL_MIXER_HTML5_ALLOW_AUTOPLAY (SDL_FALSE)
 #endif
 
+// Seconds before the end of a track at which the next queued track
+// starts buffering.
+#ifdef HTML5_MIXER_PREFETCH_SECONDS
+#define SDL_MIXER_HTML5_PREFETCH_SECONDS (HTML5_MIXER_PREFETCH_SECONDS)
+#else
+#define SDL_MIXER_HTML5_PREFETCH_SECONDS (10.0)
+#endif
+
+// URL of a Web Worker script that decodes formats the browser can't
+// play. See "Fallback decoder" below for the message protocol.
+#ifdef HTML5_MIXER_FALLBACK_DECODER
+#define SDL_MIXER_HTML5_FALLBACK_DECODER (HTML5_MIXER_FALLBACK_DECODER)
+#else
+#define SDL_MIXER_HTML5_FALLBACK_DECODER (NULL)
+#endif
+
+// Music up to this long is decoded to an AudioBuffer when it loops
+// forever, so that the loop is gapless. Longer music streams through
+// <audio>, which is cheaper in memory. 0 streams everything.
+#ifdef HTML5_MIXER_BUFFER_SECONDS
+#define SDL_MIXER_HTML5_BUFFER_SECONDS (HTML5_MIXER_BUFFER_SECONDS)
+#else
+#define SDL_MIXER_HTML5_BUFFER_SECONDS (30.0)
+#endif
+
+// Bytes of decoded PCM kept for replay. Decoded music that isn't in use
+// is dropped first once this is exceeded. 0 keeps everything.
+#ifdef HTML5_MIXER_DECODED_BUDGET
+#define SDL_MIXER_HTML5_DECODED_BUDGET (HTML5_MIXER_DECODED_BUDGET)
+#else
+#define SDL_MIXER_HTML5_DECODED_BUDGET (64.0 * 1024 * 1024)
+#endif
+
+// Pause music and suspend the audio graph while the page is hidden
+#ifdef HTML5_MIXER_SUSPEND_HIDDEN
+#define SDL_MIXER_HTML5_SUSPEND_HIDDEN (SDL_TRUE)
+#else
+#define SDL_MIXER_HTML5_SUSPEND_HIDDEN (SDL_FALSE)
+#endif
+
+// Downloads of music loaded by URL that run at once. Music needed to
+// play right away isn't held back by it. 0 for no limit.
+#ifdef HTML5_MIXER_MAX_PREFETCHES
+#define SDL_MIXER_HTML5_MAX_PREFETCHES (HTML5_MIXER_MAX_PREFETCHES)
+#else
+#define SDL_MIXER_HTML5_MAX_PREFETCHES (2)
+#endif
+
+// How much of a track <audio> loads before it plays: "none",
+// "metadata" or "auto"
+#ifdef HTML5_MIXER_PRELOAD
+#define SDL_MIXER_HTML5_PRELOAD (HTML5_MIXER_PRELOAD)
+#else
+#define SDL_MIXER_HTML5_PRELOAD ("auto")
+#endif
+
 #else
 #define SDL_MIXER_HTML5_DISABLE_TYPE_CHECK (SDL_GetHint("SDL_MIXER_HTML5_DISABLE_TYPE_CHECK") ? SDL_TRUE : SDL_FALSE)
 #define SDL_MIXER_HTML5_ALLOW_AUTOPLAY (SDL_GetHint("SDL_MIXER_HTML5_ALLOW_AUTOPLAY") ? SDL_TRUE : SDL_FALSE)
+#define SDL_MIXER_HTML5_PREFETCH_SECONDS (SDL_GetHint("SDL_MIXER_HTML5_PREFETCH_SECONDS") ? SDL_atof(SDL_GetHint("SDL_MIXER_HTML5_PREFETCH_SECONDS")) : 10.0)
+#define SDL_MIXER_HTML5_FALLBACK_DECODER (SDL_GetHint("SDL_MIXER_HTML5_FALLBACK_DECODER"))
+#define SDL_MIXER_HTML5_BUFFER_SECONDS (SDL_GetHint("SDL_MIXER_HTML5_BUFFER_SECONDS") ? SDL_atof(SDL_GetHint("SDL_MIXER_HTML5_BUFFER_SECONDS")) : 30.0)
+#define SDL_MIXER_HTML5_DECODED_BUDGET (SDL_GetHint("SDL_MIXER_HTML5_DECODED_BUDGET") ? SDL_atof(SDL_GetHint("SDL_MIXER_HTML5_DECODED_BUDGET")) : 64.0 * 1024 * 1024)
+#define SDL_MIXER_HTML5_SUSPEND_HIDDEN (SDL_GetHint("SDL_MIXER_HTML5_SUSPEND_HIDDEN") ? SDL_TRUE : SDL_FALSE)
+#define SDL_MIXER_HTML5_MAX_PREFETCHES (SDL_GetHint("SDL_MIXER_HTML5_MAX_PREFETCHES") ? SDL_atoi(SDL_GetHint("SDL_MIXER_HTML5_MAX_PREFETCHES")) : 2)
+#define SDL_MIXER_HTML5_PRELOAD (SDL_GetHint("SDL_MIXER_HTML5_PRELOAD") ? SDL_GetHint("SDL_MIXER_HTML5_PRELOAD") : "auto")
 #endif
 
 typedef struct {
@@ -51,8 +116,52 @@ typedef struct {
     SDL_RWops *src;
     SDL_bool freesrc;
     SDL_bool playing;
+    double loop_start;
+    double loop_end;
+    Mix_MusicFormat format;
+    SDL_bool fallback;
+    HTML5_Mix_MusicInfo info;
+    void *data;
+    /* Start and end in seconds of the range buffered ahead of the play
+       position. Written by JS as the browser loads, read by C without a
+       call. */
+    double buffered[2];
 } MusicHTML5;
 
+/* Bit (1 << Mix_MusicFormat) is set for each format the browser can
+   play. Written once by MusicHTML5_Open(), so C never has to ask JS. */
+static Uint32 html5_formats = 0;
+
+/* Set to 1 by the unlock manager on the first user gesture, when the
+   browser lets audio start. Written by JS, read by C without a call. */
+static Uint32 html5_unlocked = 0;
+
+/* Set by MusicHTML5_SetDecodedBudget() before the interface opens, or -1 */
+static double html5_decoded_budget = -1.0;
+
+/* Set by MusicHTML5_SetSuspendWhenHidden() before the interface opens, or -1 */
+static int html5_suspend_hidden = -1;
+
+/* Set by MusicHTML5_SetMaxPrefetches() before the interface opens, or -1 */
+static int html5_max_prefetches = -1;
+
+/* Set by MusicHTML5_SetPreload() before the interface opens, or NULL */
+static const char *html5_preload = NULL;
+
+/* Volume of sprite clips, kept while the interface is closed */
+static int html5_sprite_volume = MIX_MAX_VOLUME;
+
+/* <audio> preload values by HTML5_Mix_Preload */
+static const char *html5_preload_names[] = { "none", "metadata", "auto" };
+
+/* Music the browser can't play goes to the fallback decoder, if there is one */
+static SDL_bool html5_needs_fallback(Mix_MusicFormat format)
+{
+    return (format != MUSIC_FORMAT_UNKNOWN
+        && !MusicHTML5_HasFormat(format)
+        && SDL_MIXER_HTML5_FALLBACK_DECODER != NULL) ? SDL_TRUE : SDL_FALSE;
+}
+
 static SDL_bool html5_opened(void)
 {
     return EM_ASM_INT({
@@ -74,6 +183,27 @@ static void html5_handle_music_stopped(void *context)
 #endif
 }
 
+static void html5_handle_music_near_end(void *context)
+{
+    // The current track is about to end; give the frontend a chance
+    // to prefetch whatever plays next.
+    (void)context;
+
+#ifdef HTML5_MIXER
+    run_music_near_end_hook();
+#endif
+}
+
+static void html5_handle_music_buffered(void *context)
+{
+    // More of the music has loaded; its range is already in wasm memory
+    (void)context;
+
+#ifdef HTML5_MIXER
+    run_music_buffered_hook();
+#endif
+}
+
 static int MusicHTML5_Open(const SDL_AudioSpec *spec)
 {
     (void)spec;
@@ -84,663 +214,3572 @@ static int MusicHTML5_Open(const SDL_AudioSpec *spec)
     EM_ASM(({
         const wasmMusicStopped = $0;
         const allowAutoplay = $1;
+        const wasmMusicNearEnd = $2;
+        const prefetchSeconds = $3;
+        const wasmFormats = $4;
+        const fallbackDecoder = $5 ? UTF8ToString($5) : null;
+        const decodedBudget = $6;
+        const suspendHidden = !!$7;
+        const wasmUnlocked = $8;
+        const wasmMusicBuffered = $9;
+        const maxPrefetches = $10;
+        const preload = UTF8ToString($11);
+
+        // HTML5_Mix_PrefetchPriority
+        const prefetchNow = 0;
+        const prefetchNext = 1;
+        const prefetchBackground = 2;
+
+        // Plays a decoded AudioBuffer through Web Audio. It implements the
+        // subset of HTMLMediaElement used by the player management below,
+        // so it can take the place of the <audio> element. Loops run on the
+        // audio thread with loopStart/loopEnd and scheduled start/stop
+        // times instead of rewinding currentTime from JavaScript.
+        class BufferPlayer extends EventTarget {
+            constructor(mixer) {
+                super();
+                this.mixer = mixer;
+                this.dataset = {};
+                this.buffer = null;
+                this.sources = [];
+                this.output = mixer.getContext().createGain();
+                this.output.connect(mixer.output);
+                this.paused = true;
+                this.ended = false;
+                this.error = null;
+                this.looping = false;
+                this.rate = 1;
+                // AudioBufferSourceNode always changes pitch with rate
+                this.preservesPitch = false;
+                // Buffer position "offset" plays at context time "anchor"
+                this.offset = 0;
+                this.anchor = 0;
+                this.endTime = Infinity;
+                this.progressTimer = 0;
+                this.generation = 0;
+            }
 
-        Module["SDL2Mixer"] = {
-            ////////////////////////////////////////////////////////////
-            // Data
-            ////////////////////////////////////////////////////////////
+            get duration() {
+                return this.buffer ? this.buffer.duration : NaN;
+            }
 
-            player: (function() {
-                const newPlayer = new Audio();
-                // TODO: Make this configurable
-                newPlayer.crossOrigin = 'anonymous';
-                return newPlayer;
-            })(),
+            get volume() {
+                return this.output.gain.value;
+            }
 
-            blob: {
-                // URL.createObjectURL(...): numUses (int)
-            },
+            set volume(value) {
+                this.output.gain.value = value;
+            }
 
-            music: {
-                // randomId: {
-                //     src: (str),
-                //     context: (int),
-                //     playCount: (int),
-                //     volume: (int)
-                // };
-            },
+            get loop() {
+                return this.looping;
+            }
 
-            ////////////////////////////////////////////////////////////
-            // player <-> music management
-            ////////////////////////////////////////////////////////////
+            set loop(value) {
+                const scheduled = this.isScheduled();
+                if (scheduled)
+                    this.capture();
+                this.looping = !!value;
+                if (scheduled)
+                    this.schedule();
+            }
 
-            setPlayerProperty: function (id, property, value) {
-                this.music[id][property] = value;
-                if (this.player.dataset.currentId == id)
-                    this.player[property] = value;
-            },
+            get playbackRate() {
+                return this.rate;
+            }
 
-            setPlayerDatasetProperty: function (id, property, value) {
-                // music objects do not differentiate dataset fields
-                this.music[id][property] = value;
-                if (this.player.dataset.currentId == id)
-                    this.player.dataset[property] = value;
-            },
+            set playbackRate(value) {
+                const scheduled = this.isScheduled();
+                if (scheduled)
+                    this.capture();
+                this.rate = value;
+                if (scheduled)
+                    this.schedule();
+            }
 
-            setPlayerVolume: function(id, volume) {
-                this.setPlayerProperty(id, "volume", volume);
-            },
+            get currentTime() {
+                if (this.isScheduled())
+                    return this.stateAt(this.mixer.context.currentTime).position;
+                return this.offset;
+            }
 
-            setPlayerLoop: function(id, loop) {
-                this.setPlayerProperty(id, "loop", loop);
-            },
+            set currentTime(value) {
+                const scheduled = this.isScheduled();
+                if (scheduled)
+                    this.capture();
+                this.offset = value;
+                this.ended = false;
+                if (scheduled)
+                    this.schedule();
+            }
 
-            setPlayerCurrentTime: function(id, currentTime) {
-                this.setPlayerProperty(id, "currentTime", currentTime);
-            },
+            // Seconds until the final pass ends, counting pending loops
+            get remainingTime() {
+                if (!this.isScheduled())
+                    return Infinity;
+                return this.endTime - this.mixer.context.currentTime;
+            }
 
-            setPlayerPlayCount: function(id, playCount) {
-                this.setPlayerDatasetProperty(id, "playCount", playCount);
-            },
+            play() {
+                const id = this.dataset.currentId;
 
-            startPlayer: function(id) {
-                if (this.player.dataset.currentId != id) {
-                    if ("volume" in this.music[id])
-                        this.player.volume = this.music[id].volume;
-                    this.player.dataset.currentId = id;
-                    // Don't do this in iOS until the first activation
-                    if (this.player.dataset.activated) {
-                        this.player.src = this.music[id].src;
-                        this.player.load();
-                    }
+                if (!this.paused)
+                    return Promise.resolve();
+
+                // Like <audio>, playing after the end starts over
+                if (this.ended) {
+                    this.ended = false;
+                    this.offset = 0;
                 }
-                return this.playPlayer(id);
-            },
 
-            playPlayer: function(id) {
-                if (this.player.dataset.currentId == id
-                    // For iOS autoplay requirements. This check is not
-                    // necessary for Chrome/Firefox, but do it anyway
-                    // for parity.
-                    && (allowAutoplay || this.player.dataset.activated)
-                )
-                    return this.player.play();
-            },
+                this.paused = false;
+                const generation = ++this.generation;
+
+                return this.mixer.decodeMusic(id).then((buffer) => {
+                    // Paused, stopped or switched while decoding
+                    if (generation !== this.generation)
+                        return;
+                    this.buffer = buffer;
+                    this.schedule();
+                }, (e) => {
+                    this.error = { code: 4, message: String(e) };
+                    this.dispatchEvent(new Event("error"));
+                    throw e;
+                });
+            }
 
-            pausePlayer: function(id) {
-                if (this.player.dataset.currentId == id)
-                    this.player.pause();
-            },
+            pause() {
+                if (this.paused)
+                    return;
 
-            resetMusicState: function(id) {
-                let context = 0;
+                if (this.isScheduled())
+                    this.capture();
 
-                if (id && this.music[id]) {
-                    this.pausePlayer(id);
-                    this.setPlayerPlayCount(id, 0);
-                    this.setPlayerCurrentTime(id, 0);
-                    this.setPlayerLoop(id, false);
-                    if (this.music[id].context)
-                        context = this.music[id].context;
+                this.paused = true;
+                this.generation++;
+                this.stopSources();
+            }
+
+            // Apply changed loop points to a playing track
+            reschedule() {
+                if (this.isScheduled()) {
+                    this.capture();
+                    this.schedule();
                 }
+            }
 
-                wasmTable.get(wasmMusicStopped)(context);
-            },
+            isScheduled() {
+                return this.sources.length > 0;
+            }
 
-            ////////////////////////////////////////////////////////////
-            // Data Management
-            ////////////////////////////////////////////////////////////
+            region() {
+                const music = this.mixer.music[this.dataset.currentId] || {};
+                const duration = this.buffer.duration;
+                const end = (music.loopEnd > 0) ? Math.min(music.loopEnd, duration) : duration;
+                const start = Math.min(music.loopStart || 0, end);
+                return { start: start, end: end, length: end - start };
+            }
 
-            createBlob: function(buf) {
-                const type = this.getTypeFromMagic(buf);
-                const blob = new Blob([buf], { type: type ? type : "octet/stream" });
-                const url = URL.createObjectURL(blob);
+            // Repeats of the loop region still to come after this pass
+            passes() {
+                if (this.looping)
+                    return Infinity;
+                return Math.max(0, (this.dataset.playCount || 1) - 1);
+            }
 
-                // TODO: Match blob by ptr and size so we don't duplicate
+            stateAt(time) {
+                const region = this.region();
+                const passes = this.passes();
+                const position = this.offset + Math.max(0, time - this.anchor) * this.rate;
 
-                if (!(url in this.blob))
-                    this.blob[url] = 0;
-                this.blob[url]++;
+                if (passes === 0
+                    || region.length <= 0
+                    || this.offset >= region.end
+                    || position < region.end)
+                    return { position: Math.min(position, this.buffer.duration), passes: passes };
 
-                return url;
-            },
+                const looped = position - region.end;
+                const begun = Math.floor(looped / region.length) + 1;
 
-            deleteBlob: function(url) {
-                if (url in this.blob && --this.blob[url] <= 0) {
-                    URL.revokeObjectURL(url);
-                    delete this.blob[url];
-                }
-            },
+                if (begun <= passes)
+                    return { position: region.start + looped % region.length, passes: passes - begun };
 
-            createMusic: function(url, context) {
-                const id = this.getNewId();
-                this.music[id] = {
-                    src: url
+                // In the tail after the last loop
+                return {
+                    position: Math.min(region.end + looped - passes * region.length, this.buffer.duration),
+                    passes: 0
                 };
-                if (context)
-                    this.music[id].context = context;
-                return id;
-            },
-
-            deleteMusic: function(id) {
-                if (!(id in this.music))
-                    return;
-                this.resetMusicState(id);
-                this.deleteBlob(this.music[id].src);
-                delete this.music[id];
-            },
+            }
 
-            getNewId: function() {
-                const min = 1;
-                const max = 2147483647; // INT32_MAX
+            // Store the current position and remaining loops, like the
+            // <audio> path keeps them in currentTime and playCount.
+            capture() {
+                const state = this.stateAt(this.mixer.context.currentTime);
+                this.offset = state.position;
+                if (state.passes !== Infinity)
+                    this.setPlayCount(state.passes + 1);
+            }
 
-                // Guard against collisions
-                let id;
-                do
-                {
-                    id = Math.floor(Math.random() * (max - min + 1) + min);
-                } while(id in this.music);
-                return id;
-            },
+            setPlayCount(playCount) {
+                const music = this.mixer.music[this.dataset.currentId];
+                this.dataset.playCount = playCount;
+                if (music)
+                    music.playCount = playCount;
+            }
 
-            canPlayType: function(type) {
-                // Allow user to create shortcuts, i.e. just "mp3"
-                const formats = {
-                    mp3: 'audio/mpeg',
-                    ogg: 'audio/ogg',
-                    wav: 'audio/wav',
-                    flac: 'audio/flac',
-                    mp4: 'audio/mp4',
-                    m4a: 'audio/mp4',
-                    aif: 'audio/x-aiff',
-                    webm: 'audio/webm',
-                    adts: 'audio/aac',
-                    mkv: 'video/x-matroska',
-                    mka: 'audio/x-matroska'
-                };
+            createSource() {
+                const source = this.mixer.context.createBufferSource();
+                source.buffer = this.buffer;
+                source.playbackRate.value = this.rate;
+                source.connect(this.output);
+                this.sources.push(source);
+                return source;
+            }
 
-                return !!this.player.canPlayType(formats[type] || type);
-            },
-
-            canPlayFile: function(file) {
-                const type = file.split('.').pop();
-                if (type)
-                    return this.canPlayType(type);
-                else // Fail without Exception
-                    return false;
-            },
-
-            getTypeFromMagic: function(buf) {
-                let result = null;
-
-                const targets = [
-                    { type: "audio/ogg", magic: [0x4f, 0x67, 0x67, 0x53] },  // OggS
-                    { type: "audio/flac", magic: [0x66, 0x4c, 0x61, 0x43] }, // fLaC
-                    //{ type: "audio/midi", magic: [0x4d, 0x54, 0x68, 0x64] }, // MThd
-                    { type: "audio/mpeg", magic: [0x49, 0x44, 0x33] },        // ID3
-                    { type: "audio/wav", magic: [0x52, 0x49, 0x46, 0x46] },
-                    { type: "audio/mp4", offset: 4, magic: [0x66, 0x74, 0x79, 0x70, 0x69, 0x73, 0x6F, 0x6D] },
-                    { type: "audio/mp4", offset: 4, magic: [0x66, 0x74, 0x79, 0x70, 0x4D, 0x34, 0x41, 0x20] },
-                    { type: "audio/x-aiff", magic: [0x46, 0x4F, 0x52, 0x4D] },
-                    { type: "audio/webm", magic: [0x1A, 0x45, 0xDF, 0xA3] }
-                ];
-                
-                targets.some((target) => {
-                    const targetMagic = target.magic;
-                    const magicLength = targetMagic.length;
-                    const offset = target.offset || 0;
-                    const magic = buf.slice(offset, offset + magicLength);
-
-                    let matching = true;
-                    for (let i = 0; i < magicLength; i++) {
-                        if (magic[i] !== targetMagic[i]) {
-                            matching = false;
-                            break;
-                        }
-                    }
+            schedule() {
+                const context = this.mixer.context;
+                const duration = this.buffer.duration;
+                const region = this.region();
+                const passes = (region.length > 0 && this.offset < region.end) ? this.passes() : 0;
+                const when = context.currentTime;
+                const offset = Math.min(Math.max(0, this.offset), duration);
+                const generation = ++this.generation;
+
+                this.stopSources();
+                this.offset = offset;
+                this.anchor = when;
+
+                const first = this.createSource();
+                let last = first;
+
+                if (passes > 0) {
+                    first.loop = true;
+                    first.loopStart = region.start;
+                    first.loopEnd = region.end;
+                }
 
-                    if (matching) {
-                        result = target.type;
-                        return true;
+                first.start(when, offset);
+
+                // Buffer seconds take 1 / rate seconds of context time
+                if (passes === 0)
+                    this.endTime = when + (duration - offset) / this.rate;
+                else if (passes === Infinity)
+                    this.endTime = Infinity;
+                else {
+                    // Leave the loop after the last pass and continue
+                    // with the tail, sample-accurately.
+                    const tailTime = when + ((region.end - offset) + passes * region.length) / this.rate;
+                    first.stop(tailTime);
+
+                    if (region.end < duration) {
+                        last = this.createSource();
+                        last.start(tailTime, region.end);
                     }
-                });
 
-                // MP3 special case
-                if (!result) {
-                    const magic = buf.slice(0, 2);
-                    if (magic[0] === 0xFF && (magic[1] & 0xFE) === 0xFA)
-                        result = "audio/mpeg";
+                    this.endTime = tailTime + (duration - region.end) / this.rate;
                 }
 
-                return result;
-            },
+                last.onended = () => {
+                    if (generation !== this.generation)
+                        return;
 
-            canPlayMagic: function(buf) {
-                return this.canPlayType(this.getTypeFromMagic(buf));
-            },
+                    this.stopSources();
+                    this.paused = true;
+                    this.ended = true;
+                    this.offset = duration;
 
-            ////////////////////////////////////////////////////////////
-            // Events
-            ////////////////////////////////////////////////////////////
+                    // All passes were played on the audio thread, so let
+                    // musicFinished() count this as the last one.
+                    this.setPlayCount(1);
+                    this.dispatchEvent(new Event("ended"));
+                };
 
-            musicFinished: function(e) {
-                const audio = e.target;
-                const id = audio.dataset.currentId;
+                this.armProgress();
+            }
 
-                if (!(audio instanceof HTMLMediaElement))
+            // Stand in for <audio> "timeupdate" so that queue prefetch
+            // still fires before the end. The timer runs on wall-clock
+            // time, which goes on while the context is suspended, so
+            // musicProgress() arms it again when it fires early.
+            armProgress() {
+                clearTimeout(this.progressTimer);
+                if (!this.isScheduled() || this.endTime === Infinity)
                     return;
+                this.progressTimer = setTimeout(() => {
+                    this.dispatchEvent(new Event("timeupdate"));
+                }, Math.max(0, (this.remainingTime - prefetchSeconds) * 1000));
+            }
 
-                // if playCount == -1, then audio.loop is true and the
-                // "ended" event is not fired (i.e., we never reach this function.)
+            stopSources() {
+                clearTimeout(this.progressTimer);
+                this.sources.forEach((source) => {
+                    source.onended = null;
+                    source.stop();
+                    source.disconnect();
+                });
+                this.sources = [];
+            }
+        };
 
-                const playCount = audio.dataset.playCount - 1;
-                Module["SDL2Mixer"].setPlayerPlayCount(id, playCount);
+        // Plays music rendered by an AudioWorkletProcessor registered in
+        // "processors". Like BufferPlayer it stands in for the <audio>
+        // element. The processor owns the playback position; it reports
+        // it back a few times per second and this class extrapolates on
+        // the context clock in between.
+        //
+        // Messages to the processor:
+        //   { type: "load", data }    Music data (Uint8Array)
+        //   { type: "unload" }
+        //   { type: "play", serial, position, passes, rate }
+        //                             position is -1 to resume in place;
+        //                             passes is Infinity to loop forever
+        //   { type: "update", passes, rate }
+        //   { type: "pause" }
+        //   { type: "close" }
+        //
+        // Messages from the processor:
+        //   { type: "loaded", duration }
+        //   { type: "position", serial, time, position, remaining, passes }
+        //   { type: "ended", serial }
+        //   { type: "error", message }
+        class WorkletPlayer extends EventTarget {
+            constructor(mixer, processor) {
+                super();
+                this.mixer = mixer;
+                this.processor = processor;
+                this.dataset = {};
+                this.node = null;
+                this.ready = null;
+                this.loadedId = null;
+                this.output = mixer.getContext().createGain();
+                this.output.connect(mixer.output);
+                this.paused = true;
+                this.ended = false;
+                this.error = null;
+                this.looping = false;
+                this.rate = 1;
+                // Processors change the tempo, not the pitch
+                this.preservesPitch = true;
+                this.length = NaN;
+                // Music position "position" at context time "stamp"
+                this.position = 0;
+                this.stamp = 0;
+                this.remaining = Infinity;
+                this.seekPending = true;
+                this.serial = 0;
+                this.generation = 0;
+            }
 
-                if (playCount > 0) {
-                    audio.currentTime = 0;
-                    audio.play();
-                } else
-                    Module["SDL2Mixer"].resetMusicState(id);
-            },
+            get duration() {
+                return this.length;
+            }
 
-            musicError: function(e) {
-                const audio = e.target;
+            get volume() {
+                return this.output.gain.value;
+            }
 
-                if (!(audio instanceof HTMLMediaElement))
-                    return;
+            set volume(value) {
+                this.output.gain.value = value;
+            }
 
-                err("Error " + audio.error.code + "; details: " + audio.error.message);
+            get loop() {
+                return this.looping;
+            }
 
-                Module["SDL2Mixer"].resetMusicState(audio.dataset.currentId);
-            },
+            set loop(value) {
+                this.looping = !!value;
+                this.update();
+            }
 
-            musicInterrupted: function(e) {
-                Module["SDL2Mixer"].resetMusicState(e.target.dataset.currentId);
+            get playbackRate() {
+                return this.rate;
             }
-        };
 
-        Module["SDL2Mixer"].player.addEventListener("ended", Module["SDL2Mixer"].musicFinished, false);
-        Module["SDL2Mixer"].player.addEventListener("error", Module["SDL2Mixer"].musicError, false);
-        Module["SDL2Mixer"].player.addEventListener("abort", Module["SDL2Mixer"].musicInterrupted, false);
-        // Can browser recover from these states? If not, consider enabling these
-        // as well as the corresponding removeEventListeners in deleteMusic().
-        //Module["SDL2Mixer"].player.addEventListener("stalled", Module["SDL2Mixer"].musicInterrupted, false);
-        //Module["SDL2Mixer"].player.addEventListener("suspend", Module["SDL2Mixer"].musicInterrupted, false);
+            set playbackRate(value) {
+                this.position = this.currentTime;
+                this.stamp = this.mixer.context.currentTime;
+                this.rate = value;
+                this.update();
+            }
 
-        // Satisfy iOS input requirement for autoplay.
-        // Based on https://github.com/emscripten-core/emscripten/pull/10843
-        ["keydown","mousedown","touchstart"].forEach(function(event) {
-            [document, document.getElementById("canvas")].forEach(function (element) {
-                if (element)
-                    element.addEventListener(event, function () {
-                        if (Module["SDL2Mixer"] 
-                            && Module["SDL2Mixer"].player 
-                            && !Module["SDL2Mixer"].player.dataset.activated
-                        ) {
-                            if (Module["SDL2Mixer"].player.dataset.currentId) {
-                                const id = parseInt(Module["SDL2Mixer"].player.dataset.currentId);
-                                if (Module["SDL2Mixer"].music[id]) {
-                                    Module["SDL2Mixer"].player.src = Module["SDL2Mixer"].music[id].src;
-                                    Module["SDL2Mixer"].player.load();
-                                }
-                            }
-                            Module["SDL2Mixer"].player.play();
-                            Module["SDL2Mixer"].player.dataset.activated = true;
-                        }
-                    }, { once: true });
-            });
-        });
-    }), html5_handle_music_stopped, SDL_MIXER_HTML5_ALLOW_AUTOPLAY);
+            get currentTime() {
+                if (this.paused || !this.node)
+                    return this.position;
+                return this.position + Math.max(0, this.mixer.context.currentTime - this.stamp) * this.rate;
+            }
 
-    return 0;
-}
+            set currentTime(value) {
+                this.position = value;
+                this.ended = false;
+                this.seekPending = true;
+                if (!this.paused && this.node && this.loadedId == this.dataset.currentId)
+                    this.start();
+            }
 
-static void *MusicHTML5_CreateFromRW(SDL_RWops *src, int freesrc)
-{
-    int id = -1;
-    int size = src->size(src);
-    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);
+            // Seconds until the final pass ends
+            get remainingTime() {
+                if (this.paused || !this.node)
+                    return Infinity;
+                return this.remaining - Math.max(0, this.mixer.context.currentTime - this.stamp);
+            }
 
-    if (music == NULL) {
-        Mix_SetError("Out of memory");
-        return NULL;
+            play() {
+                const id = this.dataset.currentId;
+
+                if (!this.paused)
+                    return Promise.resolve();
+
+                // Like <audio>, playing after the end starts over
+                if (this.ended) {
+                    this.ended = false;
+                    this.position = 0;
+                    this.seekPending = true;
+                }
+
+                this.paused = false;
+                const generation = ++this.generation;
+
+                return this.connect().then(() => {
+                    // Paused, stopped or switched while loading the processor
+                    if (generation !== this.generation)
+                        return;
+                    if (this.loadedId != id) {
+                        this.loadedId = id;
+                        this.length = NaN;
+                        this.seekPending = true;
+                        this.node.port.postMessage({ type: "load", data: this.mixer.music[id].data });
+                    }
+                    this.start();
+                }, (e) => {
+                    this.paused = true;
+                    this.error = { code: 4, message: String(e) };
+                    this.dispatchEvent(new Event("error"));
+                    throw e;
+                });
+            }
+
+            pause() {
+                if (this.paused)
+                    return;
+
+                this.position = this.currentTime;
+                this.paused = true;
+                this.generation++;
+                this.serial++;
+                if (this.node)
+                    this.node.port.postMessage({ type: "pause" });
+            }
+
+            // Drop the processor's copy of deleted music
+            unload(id) {
+                if (this.loadedId != id)
+                    return;
+                this.loadedId = null;
+                this.length = NaN;
+                if (this.node)
+                    this.node.port.postMessage({ type: "unload" });
+            }
+
+            close() {
+                this.pause();
+                if (this.node) {
+                    this.node.port.postMessage({ type: "close" });
+                    this.node.disconnect();
+                }
+                this.output.disconnect();
+            }
+
+            connect() {
+                if (!this.ready) {
+                    this.ready = this.mixer.loadProcessor(this.processor).then(() => {
+                        this.node = new AudioWorkletNode(this.mixer.context, this.processor, {
+                            numberOfInputs: 0,
+                            numberOfOutputs: 1,
+                            outputChannelCount: [2]
+                        });
+                        this.node.port.onmessage = (e) => this.receive(e.data);
+                        this.node.connect(this.output);
+                    });
+                    // Try again on the next play
+                    this.ready.catch(() => { this.ready = null; });
+                }
+                return this.ready;
+            }
+
+            // Send a message to the processor once it is running
+            send(message, transfer) {
+                return this.connect().then(() => this.node.port.postMessage(message, transfer || []));
+            }
+
+            // Repeats still to come after this pass, like BufferPlayer
+            passes() {
+                if (this.looping)
+                    return Infinity;
+                return Math.max(0, (this.dataset.playCount || 1) - 1);
+            }
+
+            start() {
+                this.serial++;
+                this.stamp = this.mixer.context.currentTime;
+                this.remaining = Infinity;
+                this.node.port.postMessage({
+                    type: "play",
+                    serial: this.serial,
+                    position: this.seekPending ? Math.max(0, this.position) : -1,
+                    passes: this.passes(),
+                    rate: this.rate
+                });
+                this.seekPending = false;
+            }
+
+            update() {
+                if (!this.paused && this.node)
+                    this.node.port.postMessage({ type: "update", passes: this.passes(), rate: this.rate });
+            }
+
+            setPlayCount(playCount) {
+                const music = this.mixer.music[this.dataset.currentId];
+                this.dataset.playCount = playCount;
+                if (music)
+                    music.playCount = playCount;
+            }
+
+            receive(message) {
+                switch (message.type) {
+                case "loaded": {
+                    const music = this.mixer.music[this.loadedId];
+                    this.length = message.duration;
+                    if (music)
+                        music.duration = message.duration;
+                    break;
+                }
+                case "position":
+                    if (message.serial !== this.serial)
+                        return;
+                    this.position = message.position;
+                    this.stamp = message.time;
+                    this.remaining = message.remaining;
+                    if (message.passes !== Infinity && this.dataset.playCount > 0)
+                        this.setPlayCount(message.passes + 1);
+                    this.dispatchEvent(new Event("timeupdate"));
+                    break;
+                case "ended":
+                    if (message.serial !== this.serial)
+                        return;
+                    this.paused = true;
+                    this.ended = true;
+                    this.generation++;
+                    this.position = isFinite(this.length) ? this.length : this.position;
+                    // All passes were played by the processor
+                    this.setPlayCount(1);
+                    this.dispatchEvent(new Event("ended"));
+                    break;
+                case "error":
+                    this.paused = true;
+                    this.generation++;
+                    this.error = { code: 4, message: message.message };
+                    this.dispatchEvent(new Event("error"));
+                    break;
+                }
+            }
+        };
+
+        Module["SDL2Mixer"] = {
+            ////////////////////////////////////////////////////////////
+            // Data
+            ////////////////////////////////////////////////////////////
+
+            // The active player: either "element" or "bufferPlayer"
+            player: null,
+
+            // <audio> element for streamed playback
+            element: null,
+
+            // Buffers the next queued track while the element is busy
+            standby: null,
+
+            // BufferPlayer for music that loops on the audio thread
+            bufferPlayer: null,
+
+            workletPlayers: {
+                // processor name: WorkletPlayer
+            },
+
+            processors: {
+                // processor name: function() { registerProcessor(...); }
+            },
+
+            // processor name: Promise of audioWorklet.addModule()
+            processorModules: {},
+
+            // Set on the first user activation (iOS autoplay policy)
+            activated: false,
+
+            // Music ids whose play waits for the first activation
+            intents: [],
+
+            // Half a second of silence, to prime <audio> elements
+            silentUrl: null,
+
+            // Outcomes of plays until read, see trackPlay()
+            playTickets: {
+                // ticket: { result: (int), done: Promise of result }
+            },
+            playTicket: 0,
+            lastPlayTicket: 0,
+
+            // Whether to suspend while the page is hidden, and what was
+            // running when it was: { element: (bool), context: (bool) }
+            suspendHidden: suspendHidden,
+            hidden: null,
+
+            blob: {
+                // URL.createObjectURL(...): numUses (int)
+            },
+
+            // Downloads of music loaded by URL, see fetchMusic()
+            prefetches: {
+                // musicId: {
+                //     priority: (int),
+                //     serial: (int),
+                //     controller: AbortController, once started,
+                //     done: Promise of ArrayBuffer
+                // };
+            },
+            prefetchWaiting: [],
+            prefetchRunning: 0,
+            prefetchSerial: 0,
+            prefetchLimit: maxPrefetches,
+
+            // preload of the <audio> element, except while it's on standby
+            preload: preload,
+
+            music: {
+                // randomId: {
+                //     src: (str),
+                //     context: (int),
+                //     playCount: (int),
+                //     volume: (int),
+                //     loopStart: (float),
+                //     loopEnd: (float),
+                //     buffer: (AudioBuffer),
+                //     cacheKey: (str),
+                //     decode: (bool),
+                //     processor: (str),
+                //     data: (Uint8Array),
+                //     duration: (float),
+                //     sprites: { name: { start, end } },
+                //     wasmBuffered: (int) address of MusicHTML5.buffered,
+                //     range: { url, offset, length } in a remote archive
+                // };
+            },
+
+            // AudioBuffers by content, shared by music with equal files
+            decodedCache: {
+                // contentKey(): {
+                //     buffer: Promise of AudioBuffer,
+                //     users: Set of music ids,
+                //     bytes: (int),
+                //     lastUsed: (int)
+                // };
+            },
+            decodedBytes: 0,
+            decodedBudget: decodedBudget,
+            decodedClock: 0,
+
+            // Web Audio graph, created on demand by getContext()
+            context: null,
+            output: null,
+
+            // AudioWorkletNode running wasm effects, see music_effects.c
+            effectsNode: null,
+            effects: false,
+
+            // Native effect stages between output and the destination,
+            // built once by getNativeEffects() and kept across tracks
+            nativeEffects: null,
+
+            // Set once <audio> plays through Web Audio
+            routed: false,
+
+            // AnalyserNode tapping the end of the chain, made on demand
+            // by getAnalyser(), and the HEAPF32 view last filled from it
+            analyser: null,
+            analyserView: null,
+
+            stemGroups: {
+                // randomId: {
+                //     stems: [musicId, ...],
+                //     gains: [GainNode, ...],
+                //     sources: [AudioBufferSourceNode, ...],
+                //     playCount: (int),
+                //     duration: (float),
+                //     startTime: (float),
+                //     offset: (float),
+                //     playing: (bool),
+                //     paused: (bool),
+                //     generation: (int)
+                // };
+            },
+
+            // Sprite clips playing or waiting for their buffer, each on
+            // its own AudioBufferSourceNode, outside the music chain
+            spriteVoices: {
+                // handle: { id: musicId, source: AudioBufferSourceNode or null }
+            },
+            spriteHandle: 0,
+            spriteOutput: null,
+            spriteVolume: 1,
+
+            ////////////////////////////////////////////////////////////
+            // player <-> music management
+            ////////////////////////////////////////////////////////////
+
+            createPlayer: function() {
+                const newPlayer = new Audio();
+                // TODO: Make this configurable
+                newPlayer.crossOrigin = 'anonymous';
+                newPlayer.preload = this.preload;
+
+                newPlayer.addEventListener("ended", this.musicFinished, false);
+                newPlayer.addEventListener("error", this.musicError, false);
+                newPlayer.addEventListener("abort", this.musicInterrupted, false);
+                newPlayer.addEventListener("timeupdate", this.musicProgress, false);
+                newPlayer.addEventListener("progress", this.musicBuffered, false);
+                newPlayer.addEventListener("seeked", this.musicBuffered, false);
+                // Can browser recover from these states? If not, consider enabling these
+                // as well as the corresponding removeEventListeners in deletePlayer().
+                //newPlayer.addEventListener("stalled", this.musicInterrupted, false);
+                //newPlayer.addEventListener("suspend", this.musicInterrupted, false);
+
+                if (this.routed)
+                    this.routePlayer(newPlayer);
+
+                return newPlayer;
+            },
+
+            deletePlayer: function(player) {
+                player.pause();
+                player.removeAttribute("src");
+                player.load();
+                player.remove();
+
+                player.removeEventListener("ended", this.musicFinished, false);
+                player.removeEventListener("error", this.musicError, false);
+                player.removeEventListener("abort", this.musicInterrupted, false);
+                player.removeEventListener("timeupdate", this.musicProgress, false);
+                player.removeEventListener("progress", this.musicBuffered, false);
+                player.removeEventListener("seeked", this.musicBuffered, false);
+                //player.removeEventListener("stalled", this.musicInterrupted, false);
+                //player.removeEventListener("suspend", this.musicInterrupted, false);
+            },
+
+            // <audio> plays outside of Web Audio until it gets a source
+            // node, which is for good: an element takes only one.
+            routePlayer: function(player) {
+                if (player && !player.sourceNode) {
+                    player.sourceNode = this.getContext().createMediaElementSource(player);
+                    player.sourceNode.connect(this.output);
+                }
+            },
+
+            // Pass all music through the effects node, or bypass it
+            setEffects: function(enabled) {
+                if (!this.effectsNode)
+                    return;
+                this.effects = enabled;
+                this.connectOutput();
+            },
+
+            // Chain output through the enabled effect stages. Stages have
+            // an input and an output node; disabled ones are left out,
+            // so they cost nothing.
+            connectOutput: function() {
+                const context = this.getContext();
+                const stages = [];
+                let last = this.output;
+
+                if (this.nativeEffects)
+                    this.nativeEffects.order.forEach((name) => {
+                        const stage = this.nativeEffects[name];
+                        stage.output.disconnect();
+                        if (stage.enabled)
+                            stages.push(stage);
+                    });
+                if (this.effectsNode) {
+                    this.effectsNode.disconnect();
+                    if (this.effects)
+                        stages.push({ input: this.effectsNode, output: this.effectsNode });
+                }
+
+                if ((stages.length > 0 || this.analyser) && !this.routed) {
+                    this.routed = true;
+                    this.routePlayer(this.element);
+                    this.routePlayer(this.standby);
+                }
+
+                this.output.disconnect();
+                stages.forEach((stage) => {
+                    last.connect(stage.input);
+                    last = stage.output;
+                });
+                last.connect(context.destination);
+                if (this.analyser)
+                    last.connect(this.analyser);
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Analysis
+            //
+            // The analyser hears what reaches the speakers. It writes
+            // straight into wasm memory through a view of HEAPF32, kept
+            // while the same buffer is asked for again.
+            ////////////////////////////////////////////////////////////
+
+            getAnalyser: function() {
+                if (!this.analyser) {
+                    this.analyser = this.getContext().createAnalyser();
+                    this.connectOutput();
+                }
+                return this.analyser;
+            },
+
+            heapView: function(ptr, length) {
+                const view = this.analyserView;
+                // Growing memory detaches the old view
+                if (!view || view.buffer !== HEAPF32.buffer || view.byteOffset !== ptr || view.length !== length)
+                    this.analyserView = HEAPF32.subarray(ptr >> 2, (ptr >> 2) + length);
+                return this.analyserView;
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Native effects
+            //
+            // Built-in nodes processing all music on the browser audio
+            // thread. Parameters ramp linearly over "ms", or
+            // exponentially for frequencies.
+            ////////////////////////////////////////////////////////////
+
+            getNativeEffects: function() {
+                if (this.nativeEffects)
+                    return this.nativeEffects;
+
+                const context = this.getContext();
+                const single = (node) => ({ input: node, output: node, enabled: false, generation: 0 });
+                const effects = {
+                    order: ["duck", "filter", "panning", "spatial", "compressor", "reverb"],
+                    duck: Object.assign(single(context.createGain()), {
+                        level: 0.25,
+                        attack: 50,
+                        release: 400,
+                        triggers: new Set(),
+                        until: 0
+                    }),
+                    filter: {
+                        input: context.createGain(),
+                        filter: context.createBiquadFilter(),
+                        wet: context.createGain(),
+                        dry: context.createGain(),
+                        output: context.createGain(),
+                        enabled: false,
+                        generation: 0
+                    },
+                    panning: {
+                        input: context.createChannelSplitter(2),
+                        left: context.createGain(),
+                        right: context.createGain(),
+                        output: context.createChannelMerger(2),
+                        enabled: false,
+                        generation: 0
+                    },
+                    spatial: single(context.createPanner()),
+                    compressor: single(context.createDynamicsCompressor()),
+                    reverb: {
+                        input: context.createGain(),
+                        convolver: context.createConvolver(),
+                        wet: context.createGain(),
+                        output: context.createGain(),
+                        enabled: false,
+                        generation: 0
+                    }
+                };
+
+                // Fades in and out through the dry path, which every
+                // filter type can do
+                const filter = effects.filter;
+                filter.input.connect(filter.filter);
+                filter.filter.connect(filter.wet);
+                filter.wet.connect(filter.output);
+                filter.input.connect(filter.dry);
+                filter.dry.connect(filter.output);
+                filter.wet.gain.value = 0;
+
+                // One gain per side, as SDL Mixer attenuates each channel.
+                // Mono music is spread to both sides first.
+                const panning = effects.panning;
+                panning.input.channelCount = 2;
+                panning.input.channelCountMode = "explicit";
+                panning.input.channelInterpretation = "speakers";
+                panning.input.connect(panning.left, 0);
+                panning.input.connect(panning.right, 1);
+                panning.left.connect(panning.output, 0, 0);
+                panning.right.connect(panning.output, 0, 1);
+
+                // Linear fall off over the distance range, like SDL Mixer
+                const spatial = effects.spatial.input;
+                spatial.panningModel = "equalpower";
+                spatial.distanceModel = "linear";
+                spatial.refDistance = 0;
+                spatial.maxDistance = 255;
+                spatial.rolloffFactor = 1;
+
+                // Dry signal straight through, wet through the convolver
+                const reverb = effects.reverb;
+                reverb.input.connect(reverb.output);
+                reverb.input.connect(reverb.convolver);
+                reverb.convolver.connect(reverb.wet);
+                reverb.wet.connect(reverb.output);
+                reverb.wet.gain.value = 0;
+                reverb.convolver.buffer = this.createImpulse(2, 3);
+
+                this.nativeEffects = effects;
+                return effects;
+            },
+
+            // Decaying noise, a plausible room until a recorded impulse
+            // response is loaded
+            createImpulse: function(seconds, decay) {
+                const context = this.getContext();
+                const length = Math.floor(context.sampleRate * seconds);
+                const impulse = context.createBuffer(2, length, context.sampleRate);
+
+                for (let channel = 0; channel < 2; channel++) {
+                    const data = impulse.getChannelData(channel);
+                    for (let i = 0; i < length; i++)
+                        data[i] = (Math.random() * 2 - 1) * Math.pow(1 - i / length, decay);
+                }
+                return impulse;
+            },
+
+            rampParam: function(param, value, ms, exponential) {
+                const now = this.getContext().currentTime;
+
+                param.cancelScheduledValues(now);
+                param.setValueAtTime(param.value, now);
+                if (!(ms > 0))
+                    param.setValueAtTime(value, now);
+                else if (exponential && value > 0 && param.value > 0)
+                    param.exponentialRampToValueAtTime(value, now + ms / 1000);
+                else
+                    param.linearRampToValueAtTime(value, now + ms / 1000);
+            },
+
+            // Stages leave the chain once their ramp to neutral is done
+            enableStage: function(name, enabled, ms) {
+                const stage = this.getNativeEffects()[name];
+                const generation = ++stage.generation;
+
+                if (enabled) {
+                    if (!stage.enabled) {
+                        stage.enabled = true;
+                        this.connectOutput();
+                    }
+                    return;
+                }
+
+                setTimeout(() => {
+                    if (generation !== stage.generation || !stage.enabled)
+                        return;
+                    stage.enabled = false;
+                    this.connectOutput();
+                }, ms > 0 ? ms : 0);
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Ducking
+            //
+            // Music dips while any trigger is held or a timed duck runs.
+            // Every change is scheduled on the gain's AudioParam, so the
+            // audio thread does the fading and nothing runs per frame.
+            ////////////////////////////////////////////////////////////
+
+            updateDuck: function() {
+                const duck = this.getNativeEffects().duck;
+                const gain = duck.input.gain;
+                const now = this.getContext().currentTime;
+
+                if (duck.triggers.size > 0) {
+                    this.rampParam(gain, duck.level, duck.attack);
+                    this.enableStage("duck", true);
+                    return;
+                }
+
+                if (duck.until > now) {
+                    // Down now, back up once the time is over
+                    const down = now + duck.attack / 1000;
+                    const hold = Math.max(duck.until, down);
+                    this.rampParam(gain, duck.level, duck.attack);
+                    gain.setValueAtTime(duck.level, hold);
+                    gain.linearRampToValueAtTime(1, hold + duck.release / 1000);
+                    this.enableStage("duck", true);
+                    this.enableStage("duck", false, (hold - now) * 1000 + duck.release);
+                    return;
+                }
+
+                this.rampParam(gain, 1, duck.release);
+                this.enableStage("duck", false, duck.release);
+            },
+
+            setPlayerProperty: function (id, property, value) {
+                this.music[id][property] = value;
+                if (this.player.dataset.currentId == id)
+                    this.player[property] = value;
+            },
+
+            setPlayerDatasetProperty: function (id, property, value) {
+                // music objects do not differentiate dataset fields
+                this.music[id][property] = value;
+                if (this.player.dataset.currentId == id)
+                    this.player.dataset[property] = value;
+            },
+
+            setPlayerVolume: function(id, volume) {
+                this.setPlayerProperty(id, "volume", volume);
+            },
+
+            setPlayerLoop: function(id, loop) {
+                this.setPlayerProperty(id, "loop", loop);
+            },
+
+            setPlayerCurrentTime: function(id, currentTime) {
+                this.setPlayerProperty(id, "currentTime", currentTime);
+                if (this.player.dataset.currentId == id)
+                    delete this.player.dataset.nearEnd;
+            },
+
+            setPlayerPlayCount: function(id, playCount) {
+                this.setPlayerDatasetProperty(id, "playCount", playCount);
+            },
+
+            setPlayerSpeed: function(id, rate, preservePitch) {
+                // Browsers reject rates outside of roughly this range
+                rate = Math.min(Math.max(rate, 0.0625), 16);
+                this.setPlayerProperty(id, "preservesPitch", preservePitch);
+                this.setPlayerProperty(id, "playbackRate", rate);
+            },
+
+            getPlayerCurrentTime: function(id) {
+                if (this.player.dataset.currentId == id)
+                    return this.player.currentTime;
+                return this.music[id].currentTime || 0;
+            },
+
+            // Write the range buffered ahead of the play position where C
+            // reads it, and tell C when it changed
+            setMusicBuffered: function(id, start, end) {
+                const music = this.music[id];
+
+                if (!music || !music.wasmBuffered)
+                    return;
+
+                const at = music.wasmBuffered >> 3;
+                if (HEAPF64[at] === start && HEAPF64[at + 1] === end)
+                    return;
+
+                HEAPF64[at] = start;
+                HEAPF64[at + 1] = end;
+                wasmTable.get(wasmMusicBuffered)(music.context || 0);
+            },
+
+            startPlayer: function(id) {
+                const music = this.music[id];
+
+                // Take over the standby element if it buffered this track
+                if (this.playerFor(id) === this.element
+                    && this.standby
+                    && this.standby.dataset.currentId == id
+                    && this.element.dataset.currentId != id
+                )
+                    this.swapPlayers();
+
+                this.selectPlayer(this.playerFor(id));
+
+                delete this.player.dataset.nearEnd;
+
+                if (this.player.dataset.currentId != id) {
+                    this.player.dataset.currentId = id;
+                    // Don't do this in iOS until the first activation
+                    if (this.player === this.element && this.activated) {
+                        // A download of the same file would only compete
+                        // with the element's own
+                        this.cancelPrefetch(id);
+                        this.player.src = this.sourceFor(id);
+                        this.player.load();
+                    }
+                    if ("currentTime" in music)
+                        this.player.currentTime = music.currentTime;
+                }
+
+                // Properties may have been set while another track played.
+                // load() also resets playbackRate to its default.
+                ["volume", "loop", "playbackRate", "preservesPitch"].forEach((property) => {
+                    if (property in music)
+                        this.player[property] = music[property];
+                });
+                if ("playCount" in music)
+                    this.player.dataset.playCount = music.playCount;
+
+                return this.playPlayer(id);
+            },
+
+            playPlayer: function(id) {
+                if (this.player.dataset.currentId != id)
+                    return;
+
+                // For iOS autoplay requirements. This check is not
+                // necessary for Chrome/Firefox, but do it anyway
+                // for parity. unlock() plays it later.
+                if (!allowAutoplay && !this.activated) {
+                    this.intents.push(id);
+                    return;
+                }
+
+                // A hidden page stays silent; pageShown() starts it
+                if (this.hidden && this.player === this.element) {
+                    this.hidden.element = true;
+                    return;
+                }
+
+                const played = this.player.play();
+                // Older browsers do not return a Promise
+                if (played)
+                    played.catch((e) => {
+                        if (e && e.name === "NotAllowedError" && !this.activated)
+                            this.intents.push(id);
+                    });
+                return played;
+            },
+
+            // Follow what became of a play: 0 pending, 1 started,
+            // 2 blocked by autoplay policy, 3 failed. The <audio>
+            // element says so through its promise; Web Audio players
+            // only play once the context runs, which a blocked context
+            // never does.
+            trackPlay: function(played) {
+                const ticket = ++this.playTicket;
+                const entry = { result: 0 };
+                const player = this.player;
+                let outcome;
+
+                this.dropPlayTicket();
+
+                if (!allowAutoplay && !this.activated)
+                    outcome = Promise.resolve(2);
+                else
+                    outcome = Promise.resolve(played).then(
+                        () => player === this.element ? 1 : this.contextRunning(),
+                        (e) => (e && e.name === "NotAllowedError") ? 2 : 3);
+
+                entry.done = outcome.then((result) => {
+                    entry.result = result;
+                    return result;
+                });
+                this.playTickets[ticket] = entry;
+                return ticket;
+            },
+
+            contextRunning: function() {
+                const context = this.context;
+
+                return new Promise((resolve) => {
+                    if (!context || context.state === "running")
+                        return resolve(1);
+
+                    const changed = () => {
+                        if (context.state !== "running")
+                            return;
+                        clearTimeout(timer);
+                        context.removeEventListener("statechange", changed);
+                        resolve(1);
+                    };
+                    const timer = setTimeout(() => {
+                        context.removeEventListener("statechange", changed);
+                        resolve(2);
+                    }, 1000);
+                    context.addEventListener("statechange", changed);
+                });
+            },
+
+            // Nobody asked for the ticket of the last play, so nobody
+            // will read its result
+            dropPlayTicket: function() {
+                if (this.lastPlayTicket)
+                    delete this.playTickets[this.lastPlayTicket];
+                this.lastPlayTicket = 0;
+            },
+
+            // Results are kept until read once they are final
+            takePlayResult: function(ticket) {
+                const entry = this.playTickets[ticket];
+
+                if (!entry)
+                    return -1;
+                if (entry.result !== 0)
+                    delete this.playTickets[ticket];
+                return entry.result;
+            },
+
+            pausePlayer: function(id) {
+                // A play still waiting for the first activation is off
+                this.intents = this.intents.filter((intent) => intent != id);
+                if (this.player.dataset.currentId != id)
+                    return;
+                if (this.hidden && this.player === this.element)
+                    this.hidden.element = false;
+                this.player.pause();
+            },
+
+            // The <audio> element streams cheaply. Decoding is worth it
+            // for loop points, for what the browser can't play, and for
+            // short music looping forever, where <audio> leaves a gap.
+            usesBuffer: function(id) {
+                const music = this.music[id];
+                return music.fallback || music.decode || music.loopStart > 0 || music.loopEnd > 0
+                    || (music.loop && music.short);
+            },
+
+            playerFor: function(id) {
+                const music = this.music[id];
+                if (music.processor)
+                    return this.getWorkletPlayer(music.processor);
+                if (this.usesBuffer(id))
+                    return this.getBufferPlayer();
+                return this.element;
+            },
+
+            getBufferPlayer: function() {
+                if (!this.bufferPlayer)
+                    this.bufferPlayer = this.listenPlayer(new BufferPlayer(this));
+                return this.bufferPlayer;
+            },
+
+            getWorkletPlayer: function(processor) {
+                if (!this.workletPlayers[processor])
+                    this.workletPlayers[processor] = this.listenPlayer(new WorkletPlayer(this, processor));
+                return this.workletPlayers[processor];
+            },
+
+            // Stand-in players raise the <audio> events we handle
+            listenPlayer: function(player) {
+                player.addEventListener("ended", this.musicFinished, false);
+                player.addEventListener("error", this.musicError, false);
+                player.addEventListener("timeupdate", this.musicProgress, false);
+                return player;
+            },
+
+            // Load a registered processor into the context's AudioWorklet
+            loadProcessor: function(processor) {
+                if (!this.processorModules[processor]) {
+                    const source = this.processors[processor];
+
+                    if (!source)
+                        return Promise.reject(new Error("Unknown processor " + processor));
+
+                    const url = URL.createObjectURL(new Blob(["(" + source.toString() + ")();"],
+                        { type: "application/javascript" }));
+                    const module = this.getContext().audioWorklet.addModule(url);
+
+                    module.finally(() => URL.revokeObjectURL(url)).catch(() => {
+                        delete this.processorModules[processor];
+                    });
+                    this.processorModules[processor] = module;
+                }
+                return this.processorModules[processor];
+            },
+
+            selectPlayer: function(target) {
+                const previous = this.player;
+
+                if (target === previous)
+                    return;
+
+                previous.pause();
+                delete previous.dataset.currentId;
+                this.player = target;
+            },
+
+            prefetchPlayer: function(id) {
+                if (!(id in this.music) || this.player.dataset.currentId == id)
+                    return;
+
+                // Load the processor ahead; it renders without buffering
+                if (this.music[id].processor) {
+                    this.getWorkletPlayer(this.music[id].processor).connect().catch(() => {});
+                    return;
+                }
+
+                // The next track is needed within seconds, so what it
+                // waits for doesn't wait its turn behind other downloads.
+                // Decoded music is ready once decoding finishes.
+                if (this.usesBuffer(id)) {
+                    this.decodeMusic(id, prefetchNow);
+                    return;
+                }
+
+                // A download under way finishes, then the standby element
+                // buffers from memory. Range music can only stream to the
+                // playing element, so it always downloads.
+                if (this.isRemote(id)) {
+                    const job = this.prefetches[id];
+
+                    if (this.music[id].range || (job && this.prefetchWaiting.indexOf(job) < 0)) {
+                        this.fetchMusic(id, prefetchNow).then(() => this.prefetchPlayer(id), () => {});
+                        return;
+                    }
+
+                    // Otherwise the standby element streams it at once
+                    this.cancelPrefetch(id);
+                }
+
+                if (!this.standby)
+                    this.standby = this.createPlayer();
+
+                if (this.standby.dataset.currentId == id)
+                    return;
+
+                // Buffer ahead without playing. Events from the standby
+                // element are ignored until it is swapped in.
+                this.standby.dataset.currentId = id;
+                this.standby.preload = "auto";
+                this.standby.src = this.music[id].src;
+                this.standby.load();
+            },
+
+            swapPlayers: function() {
+                const previous = this.element;
+
+                // The stream feeds the element that is swapped out
+                if (this.stream && this.stream.element === previous)
+                    this.stopStream();
+
+                this.element = this.standby;
+                this.standby = previous;
+
+                if (this.player === previous) {
+                    previous.pause();
+                    delete previous.dataset.currentId;
+                    this.player = this.element;
+                }
+            },
+
+            setMusicLoopPoints: function(id, start, end) {
+                const music = this.music[id];
+
+                music.loopStart = start;
+                music.loopEnd = end;
+
+                // Decode ahead so that the first play starts promptly
+                if (this.usesBuffer(id))
+                    this.decodeMusic(id, prefetchBackground);
+
+                // Takes effect immediately if already looping on the
+                // audio thread, otherwise on the next play.
+                if (this.player === this.bufferPlayer && this.player.dataset.currentId == id)
+                    this.player.reschedule();
+            },
+
+            resetMusicState: function(id, halted) {
+                let context = 0;
+
+                if (id && this.music[id]) {
+                    this.pausePlayer(id);
+                    this.setPlayerPlayCount(id, 0);
+                    this.setPlayerCurrentTime(id, 0);
+                    this.setPlayerLoop(id, false);
+                    if (this.music[id].context)
+                        context = this.music[id].context;
+                }
+
+                // Halted music is no longer the player's, so that
+                // isPlaying() and unlock() leave it alone
+                if (halted && this.player.dataset.currentId == id)
+                    delete this.player.dataset.currentId;
+
+                wasmTable.get(wasmMusicStopped)(context);
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Data Management
+            ////////////////////////////////////////////////////////////
+
+            createBlob: function(buf, format) {
+                const type = this.mimeTypes[format];
+                const blob = new Blob([buf], { type: type ? type : "octet/stream" });
+                const url = URL.createObjectURL(blob);
+
+                // TODO: Match blob by ptr and size so we don't duplicate
+
+                if (!(url in this.blob))
+                    this.blob[url] = 0;
+                this.blob[url]++;
+
+                return url;
+            },
+
+            deleteBlob: function(url) {
+                if (url in this.blob && --this.blob[url] <= 0) {
+                    URL.revokeObjectURL(url);
+                    delete this.blob[url];
+                }
+            },
+
+            createMusic: function(url, context, format, fallback, range) {
+                const id = this.getNewId();
+                this.music[id] = {
+                    src: url,
+                    format: format
+                };
+                if (context)
+                    this.music[id].context = context;
+                if (range) {
+                    this.music[id].range = range;
+                    // Formats MSE can't take are downloaded and decoded
+                    if (!this.canStream(format))
+                        this.music[id].decode = true;
+                }
+                if (fallback) {
+                    // Start transcoding now, off the main thread
+                    this.music[id].fallback = true;
+                    this.decodeMusic(id, prefetchBackground);
+                }
+                return id;
+            },
+
+            deleteMusic: function(id) {
+                if (!(id in this.music))
+                    return;
+                this.cancelPrefetch(id);
+                if (this.stream && this.stream.id == id)
+                    this.stopStream();
+                this.resetMusicState(id);
+                if (this.standby && this.standby.dataset.currentId == id)
+                    delete this.standby.dataset.currentId;
+                for (const processor in this.workletPlayers)
+                    this.workletPlayers[processor].unload(id);
+                this.stopSprites(0, id);
+                // The AudioBuffer stays cached for equal music loaded later
+                if (this.music[id].cacheKey in this.decodedCache)
+                    this.decodedCache[this.music[id].cacheKey].users.delete(id);
+                if (this.music[id].src)
+                    this.deleteBlob(this.music[id].src);
+                delete this.music[id];
+            },
+
+            getNewId: function(map) {
+                const min = 1;
+                const max = 2147483647; // INT32_MAX
+
+                map = map || this.music;
+
+                // Guard against collisions
+                let id;
+                do
+                {
+                    id = Math.floor(Math.random() * (max - min + 1) + min);
+                } while(id in map);
+                return id;
+            },
+
+            canPlayType: function(type) {
+                // Allow user to create shortcuts, i.e. just "mp3"
+                const formats = {
+                    mp3: 'audio/mpeg',
+                    ogg: 'audio/ogg',
+                    wav: 'audio/wav',
+                    flac: 'audio/flac',
+                    mp4: 'audio/mp4',
+                    m4a: 'audio/mp4',
+                    aif: 'audio/x-aiff',
+                    webm: 'audio/webm',
+                    adts: 'audio/aac',
+                    mkv: 'video/x-matroska',
+                    mka: 'audio/x-matroska'
+                };
+
+                return !!this.element.canPlayType(formats[type] || type);
+            },
+
+            // Indexed by Mix_MusicFormat, which C detects
+            mimeTypes: [
+                null,
+                "audio/ogg",
+                "audio/flac",
+                "audio/mpeg",
+                "audio/wav",
+                "audio/mp4",
+                "audio/x-aiff",
+                "audio/webm",
+                "audio/ogg; codecs=\"opus\"",
+                "audio/x-matroska",
+                "audio/aac",
+                "audio/x-caf",
+                // Tracker modules and MIDI are rendered by worklet processors
+                null,
+                null,
+                null,
+                null,
+                null
+            ],
+
+            ////////////////////////////////////////////////////////////
+            // Web Audio
+            ////////////////////////////////////////////////////////////
+
+            getContext: function() {
+                if (!this.context) {
+                    const AudioContext = window.AudioContext || window.webkitAudioContext;
+                    this.context = new AudioContext();
+                    this.output = this.context.createGain();
+                    this.output.connect(this.context.destination);
+                }
+
+                // A context created before the first activation starts
+                // suspended. Resuming is harmless once we are allowed to,
+                // unless the page is hidden.
+                if (this.context.state === "suspended"
+                    && (allowAutoplay || this.activated)
+                    && !this.hidden)
+                    this.context.resume();
+
+                return this.context;
+            },
+
+            // Plays need the buffer now; others pass a lower priority
+            decodeMusic: function(id, priority) {
+                const music = this.music[id];
+
+                if (!music)
+                    return Promise.reject(new Error("Invalid music id " + id));
+
+                if (priority === undefined)
+                    priority = prefetchNow;
+
+                if (music.cacheKey in this.decodedCache)
+                    this.decodedCache[music.cacheKey].lastUsed = ++this.decodedClock;
+
+                // Decode once and share the AudioBuffer between all users
+                if (!music.decoded) {
+                    music.decoded = this.fetchMusic(id, priority)
+                        .then((data) => {
+                            const key = this.contentKey(new Uint8Array(data), music.format);
+                            const entry = this.decodedCache[key] || this.cacheDecoded(key, id, data);
+
+                            entry.users.add(id);
+                            entry.lastUsed = ++this.decodedClock;
+                            music.cacheKey = key;
+                            return entry.buffer;
+                        })
+                        .then((buffer) => {
+                            music.buffer = buffer;
+                            this.setMusicBuffered(id, 0, buffer.duration);
+                            return buffer;
+                        });
+
+                    music.decoded.catch((e) => {
+                        // Cancelled when the music was freed
+                        if (e.name !== "AbortError")
+                            err(e);
+                        delete music.decoded;
+                    });
+                } else
+                    this.raisePrefetch(id, priority);
+
+                return music.decoded;
+            },
+
+            // Cheap enough for music worth decoding: FNV-1a and the length
+            contentKey: function(bytes, format) {
+                let hash = 0x811C9DC5;
+                for (let i = 0; i < bytes.length; i++)
+                    hash = Math.imul(hash ^ bytes[i], 0x01000193);
+                return format + ":" + bytes.length + ":" + (hash >>> 0).toString(16);
+            },
+
+            cacheDecoded: function(key, id, data) {
+                const context = this.getContext();
+                const entry = {
+                    users: new Set(),
+                    bytes: 0,
+                    lastUsed: 0
+                };
+
+                entry.buffer = (this.music[id].fallback
+                    ? this.transcodeMusic(id, data)
+                    // Older Safari only supports the callback form
+                    : new Promise((resolve, reject) => {
+                        context.decodeAudioData(data, resolve, reject);
+                    })
+                ).then((buffer) => {
+                    entry.bytes = buffer.length * buffer.numberOfChannels * 4;
+                    this.decodedBytes += entry.bytes;
+                    this.trimDecodedCache(entry);
+                    return buffer;
+                }, (e) => {
+                    delete this.decodedCache[key];
+                    throw e;
+                });
+
+                this.decodedCache[key] = entry;
+                return entry;
+            },
+
+            // Drop the least recently played buffers until the decoded
+            // music fits the budget, unused ones first. Music dropped
+            // while in use decodes again on its next play.
+            trimDecodedCache: function(keep) {
+                // What plays, and sprite sheets, which play at once
+                const busy = new Set([+this.player.dataset.currentId]);
+                for (const handle in this.spriteVoices)
+                    busy.add(+this.spriteVoices[handle].id);
+                for (const id in this.music)
+                    if (this.music[id].sprites)
+                        busy.add(+id);
+
+                const entries = Object.keys(this.decodedCache)
+                    .map((key) => ({ key: key, entry: this.decodedCache[key] }))
+                    .filter((item) => item.entry !== keep && item.entry.bytes > 0
+                        && !Array.from(item.entry.users).some((id) => busy.has(id)))
+                    .sort((a, b) => (a.entry.users.size > 0) - (b.entry.users.size > 0)
+                        || a.entry.lastUsed - b.entry.lastUsed);
+
+                for (const item of entries) {
+                    if (this.decodedBudget <= 0 || this.decodedBytes <= this.decodedBudget)
+                        break;
+
+                    item.entry.users.forEach((id) => {
+                        if (this.music[id]) {
+                            delete this.music[id].decoded;
+                            delete this.music[id].buffer;
+                            delete this.music[id].cacheKey;
+                            this.setMusicBuffered(id, 0, 0);
+                        }
+                    });
+                    this.decodedBytes -= item.entry.bytes;
+                    delete this.decodedCache[item.key];
+                }
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Network prefetch
+            //
+            // Music loaded by URL is downloaded whole, then plays from a
+            // blob URL. At most prefetchLimit downloads run at once, the
+            // most urgent first; those needed now never wait. Freeing
+            // the music aborts its download.
+            ////////////////////////////////////////////////////////////
+
+            isRemote: function(id) {
+                const music = this.music[id];
+                return !!music && !!(music.src || music.range) && !(music.src in this.blob);
+            },
+
+            // Resolves to the music's file as an ArrayBuffer
+            fetchMusic: function(id, priority) {
+                const music = this.music[id];
+                let job = this.prefetches[id];
+
+                if (!this.isRemote(id))
+                    return fetch(music.src).then((response) => response.arrayBuffer());
+
+                if (job) {
+                    this.raisePrefetch(id, priority);
+                    return job.done;
+                }
+
+                job = {
+                    id: id,
+                    priority: priority,
+                    serial: ++this.prefetchSerial,
+                    controller: null
+                };
+                job.done = new Promise((resolve, reject) => {
+                    job.resolve = resolve;
+                    job.reject = reject;
+                });
+                // Whoever waits on it sees failures; nobody has to
+                job.done.catch(() => {});
+                this.prefetches[id] = job;
+                this.prefetchWaiting.push(job);
+                this.runPrefetches();
+
+                return job.done;
+            },
+
+            raisePrefetch: function(id, priority) {
+                const job = this.prefetches[id];
+
+                if (job && priority < job.priority) {
+                    job.priority = priority;
+                    this.runPrefetches();
+                }
+            },
+
+            // Start waiting downloads while there is room
+            runPrefetches: function() {
+                const waiting = this.prefetchWaiting;
+
+                waiting.sort((a, b) => a.priority - b.priority || a.serial - b.serial);
+                while (waiting.length > 0
+                    && (waiting[0].priority === prefetchNow
+                        || this.prefetchLimit <= 0
+                        || this.prefetchRunning < this.prefetchLimit))
+                    this.startPrefetch(waiting.shift());
+            },
+
+            startPrefetch: function(job) {
+                const music = this.music[job.id];
+                const range = music.range;
+
+                job.controller = new AbortController();
+                this.prefetchRunning++;
+
+                const fetched = range
+                    ? this.fetchRange(range, job.controller.signal)
+                        .then((response) => response.arrayBuffer().then((data) => {
+                            const skip = this.rangeSkip(response, range);
+                            return data.slice(skip, skip + range.length);
+                        }))
+                    : this.fetchChecked(music.src, { signal: job.controller.signal })
+                        .then((response) => response.arrayBuffer());
+
+                fetched
+                    .then((data) => {
+                        // Later loads read from memory. The blob keeps a
+                        // copy, as decoding detaches the buffer.
+                        if (this.prefetches[job.id] === job)
+                            music.src = this.createBlob(data, music.format);
+                        return data;
+                    })
+                    .then(job.resolve, job.reject)
+                    .finally(() => {
+                        if (this.prefetches[job.id] === job)
+                            delete this.prefetches[job.id];
+                        this.prefetchRunning--;
+                        this.runPrefetches();
+                    });
+            },
+
+            // Abort the download of a music, or drop it if it hasn't
+            // started
+            cancelPrefetch: function(id) {
+                const job = this.prefetches[id];
+                const index = this.prefetchWaiting.indexOf(job);
+
+                if (!job)
+                    return;
+
+                delete this.prefetches[id];
+                if (index >= 0)
+                    this.prefetchWaiting.splice(index, 1);
+                else
+                    job.controller.abort();
+                job.reject(new DOMException("Prefetch cancelled", "AbortError"));
+            },
+
+            prefetchMusic: function(id, priority) {
+                const music = this.music[id];
+
+                if (!music)
+                    return;
+
+                // Processors render without downloading anything
+                if (music.processor)
+                    this.getWorkletPlayer(music.processor).connect().catch(() => {});
+                else if (this.usesBuffer(id))
+                    this.decodeMusic(id, priority).catch(() => {});
+                else if (this.isRemote(id))
+                    this.fetchMusic(id, priority).catch(() => {});
+            },
+
+            setPreload: function(value) {
+                this.preload = value;
+                // The standby element buffers on purpose
+                this.element.preload = value;
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Archive ranges
+            //
+            // Music can be a byte range of a remote archive. The element
+            // plays it from a MediaSource fed as the range downloads, so
+            // it starts with the first bytes; formats MSE can't take are
+            // downloaded and decoded instead.
+            ////////////////////////////////////////////////////////////
+
+            // The element's MediaSource: { id, url, controller }
+            stream: null,
+
+            // Servers that ignore Range send the whole archive, which
+            // callers cut the range out of, see rangeSkip()
+            fetchRange: function(range, signal) {
+                const last = range.offset + range.length - 1;
+
+                return this.fetchChecked(range.url, {
+                    headers: { "Range": "bytes=" + range.offset + "-" + last },
+                    signal: signal
+                });
+            },
+
+            rangeSkip: function(response, range) {
+                return (response.status !== 206) ? range.offset : 0;
+            },
+
+            fetchChecked: function(url, init) {
+                return fetch(url, init).then((response) => {
+                    if (!response.ok)
+                        throw new Error("Couldn't fetch " + url + ": " + response.status);
+                    return response;
+                });
+            },
+
+            canStream: function(format) {
+                const type = this.mimeTypes[format];
+                return !!type && typeof MediaSource !== "undefined" && MediaSource.isTypeSupported(type);
+            },
+
+            // What the element loads to play a music
+            sourceFor: function(id) {
+                const music = this.music[id];
+
+                this.stopStream();
+                if (music.src || !music.range)
+                    return music.src;
+                return this.streamRange(id);
+            },
+
+            streamRange: function(id) {
+                const music = this.music[id];
+                const range = music.range;
+                const source = new MediaSource();
+                const stream = {
+                    id: id,
+                    element: this.element,
+                    url: URL.createObjectURL(source),
+                    controller: new AbortController(),
+                    restart: null
+                };
+
+                source.addEventListener("sourceopen", () => {
+                    const buffer = source.addSourceBuffer(this.mimeTypes[music.format]);
+                    const signal = stream.controller.signal;
+                    let reader = null;
+                    let skip = 0;
+                    let left = range.length;
+
+                    const append = (bytes) => {
+                        if (signal.aborted)
+                            return Promise.resolve();
+                        try {
+                            buffer.appendBuffer(bytes);
+                        } catch (e) {
+                            if (e.name !== "QuotaExceededError")
+                                throw e;
+                            // Full ahead of the play position; played
+                            // data is evicted as playback moves on. See
+                            // stream.restart for seeking back into it.
+                            return new Promise((resolve) => setTimeout(resolve, 1000))
+                                .then(() => append(bytes));
+                        }
+                        return new Promise((resolve) => {
+                            buffer.addEventListener("updateend", resolve, { once: true });
+                        }).then(() => this.musicBuffered({ target: stream.element }));
+                    };
+
+                    const pump = () => reader.read().then((chunk) => {
+                        if (chunk.done || left <= 0 || signal.aborted) {
+                            if (!chunk.done)
+                                reader.cancel();
+                            if (!signal.aborted)
+                                source.endOfStream();
+                            return;
+                        }
+
+                        let bytes = chunk.value;
+                        const cut = Math.min(skip, bytes.length);
+
+                        skip -= cut;
+                        bytes = bytes.subarray(cut, cut + left);
+                        left -= bytes.length;
+
+                        return (bytes.length > 0 ? append(bytes) : Promise.resolve()).then(pump);
+                    });
+
+                    this.fetchRange(range, signal)
+                        .then((response) => {
+                            skip = this.rangeSkip(response, range);
+                            reader = response.body.getReader();
+                            return pump();
+                        })
+                        .catch((e) => {
+                            if (e.name !== "AbortError")
+                                err(e);
+                        });
+                }, { once: true });
+
+                // Evicted data isn't appended again, so seeking or looping
+                // back before what is left downloads the range again
+                stream.restart = () => {
+                    const element = stream.element;
+                    const buffered = element.buffered;
+                    const time = element.currentTime;
+                    const playing = !element.paused;
+
+                    if (this.stream !== stream || buffered.length === 0 || time + 1 >= buffered.start(0))
+                        return;
+
+                    // Loading resets these, as in startPlayer()
+                    element.src = this.sourceFor(id);
+                    element.currentTime = time;
+                    ["loop", "playbackRate", "preservesPitch"].forEach((property) => {
+                        if (property in music)
+                            element[property] = music[property];
+                    });
+                    if (playing)
+                        element.play().catch(() => {});
+                };
+                stream.element.addEventListener("seeking", stream.restart);
+
+                this.stream = stream;
+                return stream.url;
+            },
+
+            stopStream: function() {
+                if (!this.stream)
+                    return;
+                this.stream.element.removeEventListener("seeking", this.stream.restart);
+                this.stream.controller.abort();
+                URL.revokeObjectURL(this.stream.url);
+                this.stream = null;
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Fallback decoder
+            //
+            // Music in a format the browser can't play is sent to a
+            // worker, which returns PCM for the BufferPlayer.
+            //   request:  { id, format, mime, data: ArrayBuffer }
+            //   response: { id, sampleRate, channels: [Float32Array] }
+            //         or: { id, wav: ArrayBuffer }
+            //         or: { id, error: String }
+            ////////////////////////////////////////////////////////////
+
+            decoder: null,
+            decoderRequests: {},
+
+            getDecoder: function() {
+                if (this.decoder)
+                    return this.decoder;
+
+                this.decoder = new Worker(fallbackDecoder);
+
+                this.decoder.onmessage = (e) => {
+                    const reply = e.data;
+                    const request = this.decoderRequests[reply.id];
+
+                    if (!request)
+                        return;
+
+                    delete this.decoderRequests[reply.id];
+                    if (reply.error)
+                        request.reject(new Error(reply.error));
+                    else
+                        request.resolve(reply);
+                };
+
+                this.decoder.onerror = (e) => {
+                    const requests = this.decoderRequests;
+                    this.decoderRequests = {};
+                    for (const id in requests)
+                        requests[id].reject(new Error(e.message));
+                };
+
+                return this.decoder;
+            },
+
+            transcodeMusic: function(id, data) {
+                const music = this.music[id];
+                const context = this.getContext();
+
+                return new Promise((resolve, reject) => {
+                    this.decoderRequests[id] = { resolve: resolve, reject: reject };
+                    // Transfer rather than copy the encoded data
+                    this.getDecoder().postMessage({
+                        id: id,
+                        format: music.format,
+                        mime: this.mimeTypes[music.format],
+                        data: data
+                    }, [data]);
+                }).then((reply) => {
+                    if (reply.wav)
+                        return new Promise((resolve, reject) => {
+                            context.decodeAudioData(reply.wav, resolve, reject);
+                        });
+
+                    const buffer = context.createBuffer(
+                        reply.channels.length, reply.channels[0].length, reply.sampleRate);
+                    reply.channels.forEach((samples, channel) => {
+                        buffer.copyToChannel(samples, channel);
+                    });
+                    return buffer;
+                });
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Stem groups
+            ////////////////////////////////////////////////////////////
+
+            createStemGroup: function(ids) {
+                const context = this.getContext();
+                const groupId = this.getNewId(this.stemGroups);
+
+                const group = {
+                    stems: ids,
+                    gains: [],
+                    sources: [],
+                    playCount: 0,
+                    duration: 0,
+                    startTime: 0,
+                    offset: 0,
+                    playing: false,
+                    paused: false,
+                    generation: 0
+                };
+
+                ids.forEach((id) => {
+                    const gain = context.createGain();
+                    gain.connect(this.output);
+                    group.gains.push(gain);
+
+                    // Start decoding now so the first play is immediate
+                    this.decodeMusic(id, prefetchBackground);
+                });
+
+                this.stemGroups[groupId] = group;
+                return groupId;
+            },
+
+            deleteStemGroup: function(groupId) {
+                const group = this.stemGroups[groupId];
+
+                if (!group)
+                    return;
+
+                this.stopStemSources(group);
+                group.gains.forEach((gain) => gain.disconnect());
+                delete this.stemGroups[groupId];
+            },
+
+            startStemGroup: function(groupId, playCount) {
+                const group = this.stemGroups[groupId];
+
+                this.stopStemSources(group);
+                group.playCount = playCount;
+                group.offset = 0;
+                group.playing = true;
+                group.paused = false;
+
+                return this.runStemGroup(group);
+            },
+
+            runStemGroup: function(group) {
+                const generation = group.generation;
+
+                return Promise.all(group.stems.map((id) => this.decodeMusic(id)))
+                    .then((buffers) => {
+                        // Halted, paused or restarted while decoding
+                        if (group.generation !== generation)
+                            return;
+
+                        group.duration = Math.max.apply(null, buffers.map((buffer) => buffer.duration));
+                        this.scheduleStemSources(group);
+                    })
+                    .catch((e) => {
+                        err(e);
+                        group.playing = false;
+                    });
+            },
+
+            scheduleStemSources: function(group) {
+                const context = this.getContext();
+
+                // Schedule slightly ahead of the render quantum so that
+                // every stem starts on the same sample frame.
+                const when = context.currentTime + 0.05;
+                const total = (group.playCount > 0) ? group.playCount * group.duration : Infinity;
+                const remaining = total - group.offset;
+                const generation = group.generation;
+
+                if (remaining <= 0) {
+                    group.playing = false;
+                    return;
+                }
+
+                group.sources = group.stems.map((id, index) => {
+                    const source = context.createBufferSource();
+                    source.buffer = this.music[id].buffer;
+                    source.loop = (group.playCount != 1);
+                    source.connect(group.gains[index]);
+                    source.start(when, group.offset % group.duration);
+                    if (remaining !== Infinity)
+                        source.stop(when + remaining);
+                    return source;
+                });
+
+                group.startTime = when - group.offset;
+
+                group.sources[0].onended = () => {
+                    if (group.generation === generation) {
+                        group.sources = [];
+                        group.playing = false;
+                    }
+                };
+            },
+
+            stopStemSources: function(group) {
+                // Invalidates pending decodes and "ended" handlers
+                group.generation++;
+
+                group.sources.forEach((source) => {
+                    source.onended = null;
+                    source.stop();
+                    source.disconnect();
+                });
+                group.sources = [];
+            },
+
+            stopStemGroup: function(groupId) {
+                const group = this.stemGroups[groupId];
+
+                this.stopStemSources(group);
+                group.playing = false;
+                group.paused = false;
+                group.offset = 0;
+            },
+
+            pauseStemGroup: function(groupId) {
+                const group = this.stemGroups[groupId];
+
+                if (!group.playing || group.paused)
+                    return;
+
+                if (group.sources.length)
+                    group.offset = Math.max(0, this.context.currentTime - group.startTime);
+
+                group.paused = true;
+                this.stopStemSources(group);
+            },
+
+            resumeStemGroup: function(groupId) {
+                const group = this.stemGroups[groupId];
+
+                if (!group.playing || !group.paused)
+                    return;
+
+                group.paused = false;
+                this.runStemGroup(group);
+            },
+
+            setStemVolume: function(groupId, stem, volume, seconds) {
+                const group = this.stemGroups[groupId];
+                const now = this.context.currentTime;
+
+                group.gains.forEach((gain, index) => {
+                    if (stem != -1 && stem != index)
+                        return;
+
+                    // Automate on the audio thread; no per-frame work in wasm
+                    const param = gain.gain;
+                    param.cancelScheduledValues(now);
+                    param.setValueAtTime(param.value, now);
+                    if (seconds > 0)
+                        param.linearRampToValueAtTime(volume, now + seconds);
+                    else
+                        param.setValueAtTime(volume, now);
+                });
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Sprites
+            //
+            // Named regions of one decoded file, each play a one-shot
+            // AudioBufferSourceNode started at the region's offset. The
+            // shared player is never seeked, and clips may overlap.
+            ////////////////////////////////////////////////////////////
+
+            setSprite: function(id, name, start, end) {
+                const music = this.music[id];
+
+                music.sprites = music.sprites || {};
+                music.sprites[name] = { start: start, end: end };
+                // Decode ahead, so the first play starts at once
+                this.decodeMusic(id, prefetchBackground).catch(() => {});
+            },
+
+            playSprite: function(id, name) {
+                const music = this.music[id];
+                const region = music && music.sprites && music.sprites[name];
+
+                if (!region)
+                    return 0;
+
+                const handle = ++this.spriteHandle;
+                const voice = { id: id, source: null };
+                this.spriteVoices[handle] = voice;
+
+                this.decodeMusic(id).then((buffer) => {
+                    // Stopped before the buffer was ready
+                    if (this.spriteVoices[handle] !== voice)
+                        return;
+
+                    const context = this.getContext();
+                    const source = context.createBufferSource();
+                    const end = region.end > region.start ? Math.min(region.end, buffer.duration) : buffer.duration;
+
+                    source.buffer = buffer;
+                    source.connect(this.getSpriteOutput());
+                    source.onended = () => {
+                        if (this.spriteVoices[handle] === voice)
+                            delete this.spriteVoices[handle];
+                        source.disconnect();
+                    };
+                    source.start(0, region.start, Math.max(end - region.start, 0));
+                    voice.source = source;
+                }).catch(() => {
+                    delete this.spriteVoices[handle];
+                });
+
+                return handle;
+            },
+
+            // Stop one clip, or with a handle of -1 every clip, or every
+            // clip of a music (id)
+            stopSprites: function(handle, id) {
+                for (const key in this.spriteVoices) {
+                    const voice = this.spriteVoices[key];
+
+                    if ((handle > 0 && key != handle) || (id && voice.id != id))
+                        continue;
+                    delete this.spriteVoices[key];
+                    if (voice.source)
+                        voice.source.stop();
+                }
+            },
+
+            getSpriteOutput: function() {
+                if (!this.spriteOutput) {
+                    const context = this.getContext();
+                    this.spriteOutput = context.createGain();
+                    this.spriteOutput.gain.value = this.spriteVolume;
+                    this.spriteOutput.connect(context.destination);
+                }
+                return this.spriteOutput;
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Unlocking
+            //
+            // On the first user gesture everything that autoplay policy
+            // holds back is started while the gesture still counts: the
+            // AudioContext is created and resumed, idle <audio> elements
+            // are primed with silence, and plays asked for earlier are
+            // replayed in order. The first sound after that starts warm.
+            ////////////////////////////////////////////////////////////
+
+            unlock: function() {
+                if (this.activated || !this.player)
+                    return;
+                this.activated = true;
+
+                // A silent buffer unlocks Web Audio on older iOS
+                const context = this.getContext();
+                const silence = context.createBufferSource();
+                silence.buffer = context.createBuffer(1, 1, context.sampleRate);
+                silence.connect(context.destination);
+                silence.start(0);
+
+                // startPlayer() held back the source until now
+                const id = this.element.dataset.currentId;
+                if (id && this.music[id]) {
+                    this.element.src = this.sourceFor(id);
+                    this.element.load();
+                }
+                this.primeElement(this.element);
+                this.primeElement(this.standby);
+
+                const intents = this.intents;
+                this.intents = [];
+                intents.forEach((id) => {
+                    const played = this.playPlayer(id);
+                    if (played)
+                        played.catch((e) => err(e));
+                });
+
+                HEAPU32[wasmUnlocked >> 2] = 1;
+            },
+
+            // An element played once inside a gesture may play later
+            // without one
+            primeElement: function(element) {
+                if (!element || element.dataset.currentId)
+                    return;
+
+                const reset = () => {
+                    if (!element.dataset.currentId)
+                        element.pause();
+                };
+
+                element.src = this.getSilentUrl();
+                const played = element.play();
+                if (played)
+                    played.then(reset, reset);
+                else
+                    reset();
+            },
+
+            getSilentUrl: function() {
+                if (!this.silentUrl) {
+                    // 8 kHz 8-bit mono; 0x80 is silence
+                    const samples = 4000;
+                    const view = new DataView(new ArrayBuffer(44 + samples));
+                    const text = (offset, value) => {
+                        for (let i = 0; i < value.length; i++)
+                            view.setUint8(offset + i, value.charCodeAt(i));
+                    };
+
+                    text(0, "RIFF");
+                    view.setUint32(4, 36 + samples, true);
+                    text(8, "WAVE");
+                    text(12, "fmt ");
+                    view.setUint32(16, 16, true);
+                    view.setUint16(20, 1, true);
+                    view.setUint16(22, 1, true);
+                    view.setUint32(24, 8000, true);
+                    view.setUint32(28, 8000, true);
+                    view.setUint16(32, 1, true);
+                    view.setUint16(34, 8, true);
+                    text(36, "data");
+                    view.setUint32(40, samples, true);
+                    for (let i = 0; i < samples; i++)
+                        view.setUint8(44 + i, 0x80);
+
+                    this.silentUrl = URL.createObjectURL(new Blob([view.buffer], { type: "audio/wav" }));
+                }
+                return this.silentUrl;
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Page visibility
+            //
+            // Suspending the context freezes everything on its clock:
+            // buffered and worklet music, stems, sprites and any ramp in
+            // progress, which all continue from the same sample. The
+            // <audio> element is paused in place. Neither counts as the
+            // music finishing, so play counts and hooks are untouched.
+            ////////////////////////////////////////////////////////////
+
+            pageHidden: function() {
+                if (!this.suspendHidden || this.hidden)
+                    return;
+
+                const element = this.element;
+                this.hidden = {
+                    element: !!element.dataset.currentId && !element.paused && !element.ended,
+                    context: !!this.context && this.context.state === "running"
+                };
+
+                if (this.hidden.element)
+                    element.pause();
+                if (this.hidden.context)
+                    this.context.suspend();
+            },
+
+            pageShown: function() {
+                const hidden = this.hidden;
+
+                if (!hidden)
+                    return;
+                this.hidden = null;
+
+                if (this.context)
+                    this.getContext();
+                if (hidden.element && this.element.dataset.currentId) {
+                    const played = this.element.play();
+                    // Older browsers do not return a Promise
+                    if (played)
+                        played.catch((e) => err(e));
+                }
+                // Its timer ran on while the context was suspended
+                if (this.player.armProgress)
+                    this.player.armProgress();
+            },
+
+            ////////////////////////////////////////////////////////////
+            // Events
+            ////////////////////////////////////////////////////////////
+
+            musicFinished: function(e) {
+                const audio = e.target;
+                const id = audio.dataset.currentId;
+
+                // Either the <audio> element or a stand-in player; an
+                // element without music is only being primed
+                if (audio !== Module["SDL2Mixer"].player || !audio.dataset.currentId)
+                    return;
+
+                // if playCount == -1, then audio.loop is true and the
+                // "ended" event is not fired (i.e., we never reach this function.)
+
+                const playCount = audio.dataset.playCount - 1;
+                Module["SDL2Mixer"].setPlayerPlayCount(id, playCount);
+
+                if (playCount > 0) {
+                    audio.currentTime = 0;
+                    audio.play();
+                } else
+                    Module["SDL2Mixer"].resetMusicState(id);
+            },
+
+            musicError: function(e) {
+                const audio = e.target;
+
+                if (audio !== Module["SDL2Mixer"].player || !audio.dataset.currentId)
+                    return;
+
+                err("Error " + audio.error.code + "; details: " + audio.error.message);
+
+                Module["SDL2Mixer"].resetMusicState(audio.dataset.currentId);
+            },
+
+            musicInterrupted: function(e) {
+                if (e.target !== Module["SDL2Mixer"].player || !e.target.dataset.currentId)
+                    return;
+
+                Module["SDL2Mixer"].resetMusicState(e.target.dataset.currentId);
+            },
+
+            // Both elements report, so the range of a track buffering
+            // on standby is known before it plays
+            musicBuffered: function(e) {
+                const audio = e.target;
+                const id = audio.dataset.currentId;
+                const ranges = audio.buffered;
+                const time = audio.currentTime;
+                let start = 0;
+                let end = 0;
+
+                if (!id)
+                    return;
+
+                // The range playback continues into, or the next one
+                for (let i = 0; i < ranges.length; i++) {
+                    if (ranges.end(i) >= time) {
+                        start = ranges.start(i);
+                        end = ranges.end(i);
+                        break;
+                    }
+                }
+
+                Module["SDL2Mixer"].setMusicBuffered(id, start, end);
+            },
+
+            musicProgress: function(e) {
+                const audio = e.target;
+                const mixer = Module["SDL2Mixer"];
+
+                if (audio !== mixer.player
+                    || audio.loop
+                    || audio.dataset.nearEnd)
+                    return;
+
+                let remaining;
+
+                if ("remainingTime" in audio)
+                    // Counts loop passes still to play
+                    remaining = audio.remainingTime;
+                else if (audio.dataset.playCount > 1)
+                    // Only the final pass of the current track counts
+                    return;
+                else
+                    remaining = (audio.duration - audio.currentTime) / (audio.playbackRate || 1);
+
+                // Fired early, pageShown() arms it again once visible
+                if (remaining > prefetchSeconds && audio.armProgress && !mixer.hidden)
+                    audio.armProgress();
+
+                if (remaining <= prefetchSeconds) {
+                    const music = mixer.music[audio.dataset.currentId];
+                    audio.dataset.nearEnd = true;
+                    wasmTable.get(wasmMusicNearEnd)(music && music.context ? music.context : 0);
+                }
+            }
+        };
+
+        Module["SDL2Mixer"].element = Module["SDL2Mixer"].createPlayer();
+        Module["SDL2Mixer"].player = Module["SDL2Mixer"].element;
+
+        // Probe every format once; C reads the result from wasm memory
+        let formats = 0;
+        Module["SDL2Mixer"].mimeTypes.forEach(function(type, format) {
+            if (type && Module["SDL2Mixer"].element.canPlayType(type))
+                formats |= 1 << format;
+        });
+        HEAPU32[wasmFormats >> 2] = formats;
+
+        // Hidden covers switching tabs; pagehide covers leaving into the
+        // back/forward cache, where visibilitychange may not fire.
+        document.addEventListener("visibilitychange", function() {
+            const mixer = Module["SDL2Mixer"];
+            if (mixer)
+                document.hidden ? mixer.pageHidden() : mixer.pageShown();
+        });
+        window.addEventListener("pagehide", function() {
+            if (Module["SDL2Mixer"])
+                Module["SDL2Mixer"].pageHidden();
+        });
+        window.addEventListener("pageshow", function() {
+            if (Module["SDL2Mixer"] && !document.hidden)
+                Module["SDL2Mixer"].pageShown();
+        });
+
+        // Satisfy iOS input requirement for autoplay.
+        // Based on https://github.com/emscripten-core/emscripten/pull/10843
+        // touchstart is not a user activation in newer browsers, so wait
+        // for one that is where the browser can tell.
+        ["keydown","mousedown","touchstart","touchend"].forEach(function(event) {
+            [document, document.getElementById("canvas")].forEach(function (element) {
+                if (element)
+                    element.addEventListener(event, function () {
+                        if (navigator.userActivation && !navigator.userActivation.isActive)
+                            return;
+                        if (Module["SDL2Mixer"])
+                            Module["SDL2Mixer"].unlock();
+                    });
+            });
+        });
+    }), html5_handle_music_stopped, SDL_MIXER_HTML5_ALLOW_AUTOPLAY,
+        html5_handle_music_near_end, SDL_MIXER_HTML5_PREFETCH_SECONDS,
+        &html5_formats, SDL_MIXER_HTML5_FALLBACK_DECODER,
+        (html5_decoded_budget >= 0.0) ? html5_decoded_budget : SDL_MIXER_HTML5_DECODED_BUDGET,
+        (html5_suspend_hidden >= 0) ? html5_suspend_hidden : SDL_MIXER_HTML5_SUSPEND_HIDDEN,
+        &html5_unlocked, html5_handle_music_buffered,
+        (html5_max_prefetches >= 0) ? html5_max_prefetches : SDL_MIXER_HTML5_MAX_PREFETCHES,
+        html5_preload ? html5_preload : SDL_MIXER_HTML5_PRELOAD);
+
+    EM_ASM({
+        Module["SDL2Mixer"].spriteVolume = $0;
+    }, (float)html5_sprite_volume / MIX_MAX_VOLUME);
+
+    return 0;
+}
+
+static int MusicHTML5_SetLoopPoints(void *context, double start, double end);
+
+/* Apply what the file header told us, once the music has an id */
+static void html5_apply_music_info(MusicHTML5 *music)
+{
+    EM_ASM({ Module["SDL2Mixer"].music[$0].wasmBuffered = $1; }, music->id, music->buffered);
+
+    if (music->info.duration > 0.0 && music->info.duration <= SDL_MIXER_HTML5_BUFFER_SECONDS)
+        EM_ASM({ Module["SDL2Mixer"].music[$0].short = true; }, music->id);
+
+    if (music->info.loop_start >= 0.0)
+        MusicHTML5_SetLoopPoints(music, music->info.loop_start,
+            (music->info.loop_end > music->info.loop_start) ? music->info.loop_end : 0.0);
+}
+
+static void *MusicHTML5_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    int id = -1;
+    int size = src->size(src);
+    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);
+
+    if (music == NULL) {
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+
+    SDL_bool force = SDL_MIXER_HTML5_DISABLE_TYPE_CHECK;
+
+    music->format = music_header_parse_rw(src, &music->info);
+
+    music->fallback = html5_needs_fallback(music->format);
+
+    if (!force && !music->fallback && !MusicHTML5_HasFormat(music->format)) {
+        Mix_SetError("Unsupported music format");
+        SDL_free(music);
+        return NULL;
+    }
+
+    if (src->type == SDL_RWOPS_STDFILE)
+    {
+        // This violates "private" membership, but this lets us avoid
+        // copying the entire file into a new buffer. Instead, we query
+        // FS for the file's location in MEMFS.
+        FILE *f = src->hidden.stdio.fp;
+        int fd = fileno(f);
+
+        if (f) {
+            id = EM_ASM_INT({
+                const fd = $0;
+                const context = $1;
+                const format = $2;
+                const fallback = $3;
+
+                const stream = SYSCALLS.getStreamFromFD(fd);
+
+                if (!stream || !stream.node || !stream.node.contents)
+                    return -1;
+
+                const buf = stream.node.contents;
+
+                const url = Module["SDL2Mixer"].createBlob(buf, format);
+                const id = Module["SDL2Mixer"].createMusic(url, context, format, fallback);
+
+                return id;
+            }, fd, music, music->format, music->fallback);
+        }
+    }
+    else if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO)
+    {
+        // This violates "private" membership, but it works because
+        // the entire file is loaded in this pointer.
+        void *buf = src->hidden.mem.base;
+
+        if (buf && size > 0)
+        {
+            id = EM_ASM_INT({
+                const ptr = $0;
+                const size = $1;
+                const context = $2;
+                const format = $3;
+                const fallback = $4;
+
+                const buf = new Uint8Array(Module.HEAPU8.buffer, ptr, size);
+
+                const url = Module["SDL2Mixer"].createBlob(buf, format);
+                const id = Module["SDL2Mixer"].createMusic(url, context, format, fallback);
+
+                return id;
+            }, buf, size, music, music->format, music->fallback);
+        }
+    } 
+    else
+    {
+        Mix_SetError("Unsupported RWops type: %d", src->type);
+        if (freesrc)
+            SDL_RWclose(src);
+        return NULL;
+    }
+
+    if (id == -1)
+    {
+        SDL_free(music);
+        return NULL;
+    }
+
+    /* Fill the music structure */
+    music->id = id;
+    music->src = src;
+    music->freesrc = freesrc;
+    music->playing = SDL_TRUE;
+    html5_apply_music_info(music);
+
+    /* We're done */
+    return music;
+}
+
+/* Load a music stream from the given file */
+static void *MusicHTML5_CreateFromFile(const char *file)
+{
+    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);;
+    int id = -1;
+    SDL_bool force = SDL_MIXER_HTML5_DISABLE_TYPE_CHECK;
+
+    if (music == NULL) {
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+
+    // URLs aren't in FS; their info stays unknown and the extension
+    // decides their format
+    music->format = music_header_parse_file(file, &music->info);
+    if (music->format == MUSIC_FORMAT_UNKNOWN)
+        music->format = music_probe_extension(file);
+    if (music->info.type == MUS_NONE)
+        music->info.type = music_probe_type(music->format);
+
+    music->fallback = html5_needs_fallback(music->format);
+
+    if (!force && !music->fallback && !MusicHTML5_HasFormat(music->format)) {
+        Mix_SetError("Unsupported music format");
+        SDL_free(music);
+        return NULL;
+    }
+
+    id = EM_ASM_INT({
+        const file = UTF8ToString($0);
+        const context = $1;
+        const format = $2;
+        const fallback = $3;
+
+        let url;
+        try {
+            // Is path in FS?
+            const buf = FS.readFile(file);
+            url = Module["SDL2Mixer"].createBlob(buf, format);
+        } catch(e) {
+            // Fail silently, presume file not in FS.
+            // Assume it's a relative or absolute URL
+            url = file;
+        }
+
+        const id = Module["SDL2Mixer"].createMusic(url, context, format, fallback);
+        return id;
+    }, file, music, music->format, music->fallback);
+
+    if (id == -1) {
+        SDL_free(music);
+        return NULL;
+    }
+
+    /* Fill the music structure */
+    music->id = id;
+    music->freesrc = SDL_FALSE;
+    music->playing = SDL_TRUE;
+    html5_apply_music_info(music);
+
+    /* We're done */
+    return music;
+}
+
+/* Music in a byte range of a remote archive, fetched with HTTP Range
+   requests. Its format comes from the caller; none of it is here to
+   look at. */
+void *MusicHTML5_CreateFromRange(const char *url, Sint64 offset, Sint64 length, Mix_MusicFormat format)
+{
+    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);
+    SDL_bool force = SDL_MIXER_HTML5_DISABLE_TYPE_CHECK;
+    int id;
+
+    if (music == NULL) {
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+
+    music->format = format;
+    music->info.type = music_probe_type(format);
+    music->info.duration = -1.0;
+    music->info.loop_start = -1.0;
+    music->info.loop_end = -1.0;
+
+    music->fallback = html5_needs_fallback(music->format);
+
+    if (!force && !music->fallback && !MusicHTML5_HasFormat(music->format)) {
+        Mix_SetError("Unsupported music format");
+        SDL_free(music);
+        return NULL;
+    }
+
+    id = EM_ASM_INT(({
+        const range = {
+            url: UTF8ToString($0),
+            offset: $1,
+            length: $2
+        };
+        return Module["SDL2Mixer"].createMusic(null, $3, $4, $5, range);
+    }), url, (double)offset, (double)length, music, music->format, music->fallback);
+
+    /* Fill the music structure */
+    music->id = id;
+    music->freesrc = SDL_FALSE;
+    music->playing = SDL_TRUE;
+    html5_apply_music_info(music);
+
+    return music;
+}
+
+/* Set the volume for a given music stream */
+static void MusicHTML5_SetVolume(void *context, int volume)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+    float normalized_volume = ((float)volume) / MIX_MAX_VOLUME;
+
+    EM_ASM({
+        const id = $0;
+        const volume = Math.min(Math.max(0, $1), 1);
+        Module["SDL2Mixer"].setPlayerVolume(id, volume);
+    }, music->id, normalized_volume);
+}
+
+static void MusicHTML5_Stop(void *context);
+
+/* Start buffering a music stream that is expected to play next */
+static void MusicHTML5_Prefetch(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    EM_ASM({
+        Module["SDL2Mixer"].prefetchPlayer($0);
+    }, music->id);
+}
+
+/* Start playback of a given music stream */
+static int MusicHTML5_Play(void *context, int play_count)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    if (play_count <= 0 && play_count != -1)
+    {
+        // do not play but do not throw errors either.
+        // TODO: What is SDL Mixer's state when passing play_count <= 0?
+        MusicHTML5_Stop(context);
+        return 0;
+    }
+    int status = EM_ASM_INT({
+        try {
+            const id = $0;
+            const playCount = $1;
+
+            // Retain play_count for handling in musicFinished()
+            Module["SDL2Mixer"].setPlayerPlayCount(id, playCount);
+
+            // If play_count == -1, we are looping
+            Module["SDL2Mixer"].setPlayerLoop(id, (playCount == -1));
+
+            // Set up the loop state first: a BufferPlayer schedules
+            // its loops when it starts.
+            const played = Module["SDL2Mixer"].startPlayer(id);
+
+            // Older browsers do not return a Promise
+            if (played)
+                played.catch((e) => err(e));
+
+            // See MusicHTML5_TakePlayTicket()
+            Module["SDL2Mixer"].lastPlayTicket = Module["SDL2Mixer"].trackPlay(played);
+        } catch (e) {
+            err(e);
+            Module["SDL2Mixer"].lastPlayTicket = Module["SDL2Mixer"].trackPlay(Promise.reject(e));
+            return -1;
+        }
+        return 0;
+    }, music->id, play_count);
+
+    if (status < 0)
+        Mix_SetError("Emscripten HTML5 error, see developer console.");
+    
+    return status;
+}
+
+/* Return non-zero if a stream is currently playing */
+static SDL_bool MusicHTML5_IsPlaying(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+    
+    if (!music) {
+        // Call "finished" handler in devappd/html5_mixer
+        html5_handle_music_stopped(context);
+        return SDL_FALSE;
+    }
+
+    // We track a music->playing variable to play nice with music_mixer()'s
+    // IsPlaying() check on every frame. E.g., the check will run when
+    // <audio> is buffering and the music is technically not "playing".
+    // Ergo, the HookMusicFinished() callback is called immediately when
+    // the <audio> has not even begun playback.
+    //
+    // To resolve this, we rely on JavaScript callbacks to reset the
+    // music->playing status on end, on error, etc.
+
+    int safeStatus = EM_ASM_INT({
+        const id = $0;
+        const safeStatus =
+            Module["SDL2Mixer"].player
+            && Module["SDL2Mixer"].player.dataset.currentId == id
+            && !Module["SDL2Mixer"].player.ended
+            // SDL Mixer considers "paused" music as "playing"
+            //&& !Module["SDL2Mixer"].player.paused
+            // These conditions interfere with the "playing" check
+            //&&  Module["SDL2Mixer"].player.readyState > 2;
+            //&&  Module["SDL2Mixer"].player.currentTime > 0
+            ;
+
+        if (!safeStatus)
+            // Reset JS state and falsify music->playing
+            Module["SDL2Mixer"].resetMusicState(id);
+    }, music->id);
+
+    return music->playing;
+}
+
+/* Jump (seek) to a given position (time is in seconds) */
+static int MusicHTML5_Seek(void *context, double time)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    EM_ASM({
+        const id = $0;
+        const time = $1;
+        Module["SDL2Mixer"].setPlayerCurrentTime(id, time);
+    }, music->id, time);
+
+    return 0;
+}
+
+/* Change the playback rate. The pitch follows the rate unless preserved */
+static int MusicHTML5_SetSpeed(void *context, double rate, SDL_bool preserve_pitch)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    if (rate <= 0.0) {
+        Mix_SetError("Invalid playback rate");
+        return -1;
+    }
+
+    EM_ASM({
+        Module["SDL2Mixer"].setPlayerSpeed($0, $1, !!$2);
+    }, music->id, rate, preserve_pitch);
+
+    return 0;
+}
+
+/* Get the play position in seconds. This is media time, so it already
+   accounts for the playback rate. */
+static double MusicHTML5_Tell(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    return EM_ASM_DOUBLE({
+        return Module["SDL2Mixer"].getPlayerCurrentTime($0);
+    }, music->id);
+}
+
+/* Get the length in seconds. Uses the file header, or what the browser
+   knows once the music has been decoded or loaded into <audio>. */
+static double MusicHTML5_Duration(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    if (music->info.duration >= 0.0)
+        return music->info.duration;
+
+    return EM_ASM_DOUBLE({
+        const mixer = Module["SDL2Mixer"];
+        const music = mixer.music[$0];
+
+        if (!music)
+            return -1.0;
+        if (music.buffer)
+            return music.buffer.duration;
+        if (music.duration > 0)
+            return music.duration;
+        if (mixer.player
+            && parseInt(mixer.player.dataset.currentId) === $0
+            && isFinite(mixer.player.duration))
+            return mixer.player.duration;
+        return -1.0;
+    }, music->id);
+}
+
+/* Set the loop region in seconds; an 'end' of 0 loops to the end of the track */
+static int MusicHTML5_SetLoopPoints(void *context, double start, double end)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    if (start < 0.0 || end < 0.0 || (end > 0.0 && end <= start)) {
+        Mix_SetError("Invalid loop points");
+        return -1;
     }
 
-    SDL_bool force = SDL_MIXER_HTML5_DISABLE_TYPE_CHECK;
+    music->loop_start = start;
+    music->loop_end = end;
 
-    if (src->type == SDL_RWOPS_STDFILE)
+    EM_ASM({
+        Module["SDL2Mixer"].setMusicLoopPoints($0, $1, $2);
+    }, music->id, start, end);
+
+    return 0;
+}
+
+static SDL_bool html5_has_loop_points(MusicHTML5 *music)
+{
+    return (music->loop_start > 0.0 || music->loop_end > 0.0) ? SDL_TRUE : SDL_FALSE;
+}
+
+static double MusicHTML5_LoopStart(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+    return html5_has_loop_points(music) ? music->loop_start : -1.0;
+}
+
+static double MusicHTML5_LoopEnd(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    if (!html5_has_loop_points(music))
+        return -1.0;
+
+    if (music->loop_end > 0.0)
+        return music->loop_end;
+
+    // Loops to the end of the track; only known once decoded
+    return EM_ASM_DOUBLE({
+        const music = Module["SDL2Mixer"].music[$0];
+        return (music && music.buffer) ? music.buffer.duration : -1.0;
+    }, music->id);
+}
+
+static double MusicHTML5_LoopLength(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+    double end = MusicHTML5_LoopEnd(context);
+
+    return (end < 0.0) ? -1.0 : end - music->loop_start;
+}
+
+/* Get the detected music type; MUS_HTML5 for formats only the browser plays */
+static Mix_MusicType MusicHTML5_GetType(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    return (music->info.type != MUS_NONE) ? music->info.type : MUS_HTML5;
+}
+
+/* Get a tag from the file header, or "" if there is none */
+static const char *MusicHTML5_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    switch (tag_type)
     {
-        // This violates "private" membership, but this lets us avoid
-        // copying the entire file into a new buffer. Instead, we query
-        // FS for the file's location in MEMFS.
-        FILE *f = src->hidden.stdio.fp;
-        int fd = fileno(f);
+    case MIX_META_TITLE:
+        return music->info.title;
+    case MIX_META_ARTIST:
+        return music->info.artist;
+    case MIX_META_ALBUM:
+        return music->info.album;
+    case MIX_META_COPYRIGHT:
+        return music->info.copyright;
+    default:
+        return "";
+    }
+}
 
-        if (f) {
-            id = EM_ASM_INT({
-                const fd = $0;
-                const context = $1;
-                const force = $2;
+/* Pause playback of a given music stream */
+static void MusicHTML5_Pause(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-                const stream = SYSCALLS.getStreamFromFD(fd);
+    EM_ASM({
+        const id = $0;
+        Module["SDL2Mixer"].pausePlayer(id);
+    }, music->id);
+}
 
-                if (!stream || !stream.node || !stream.node.contents)
-                    return -1;
+/* Resume playback of a given music stream */
+static void MusicHTML5_Resume(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-                const buf = stream.node.contents;
+    EM_ASM({
+        const id = $0;
+        Module["SDL2Mixer"].playPlayer(id);
+    }, music->id);
+}
 
-                const canPlay = force
-                    || Module["SDL2Mixer"].canPlayFile(stream.path)
-                    || Module["SDL2Mixer"].canPlayMagic(buf);
+/* Stop playback of a stream previously started with MusicHTML5_Start() */
+static void MusicHTML5_Stop(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-                if (!canPlay)
-                    return -1;
+    EM_ASM({
+        const id = $0;
+        Module["SDL2Mixer"].resetMusicState(id, true);
+    }, music->id);
+}
 
-                const url = Module["SDL2Mixer"].createBlob(buf);
-                const id = Module["SDL2Mixer"].createMusic(url, context);
+/* Close the given music stream */
+static void MusicHTML5_Delete(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-                return id;
-            }, fd, music, force);
-        }
+    if (html5_opened()) {
+        EM_ASM({
+            const id = $0;
+            if (id in Module["SDL2Mixer"].music)
+                Module["SDL2Mixer"].deleteMusic(id);
+        }, music->id);
     }
-    else if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO)
-    {
-        // This violates "private" membership, but it works because
-        // the entire file is loaded in this pointer.
-        void *buf = src->hidden.mem.base;
 
-        if (buf && size > 0)
-        {
-            id = EM_ASM_INT({
-                const ptr = $0;
-                const size = $1;
-                const context = $2;
-                const force = $3;
+    if (music->freesrc && music->src)
+        SDL_RWclose(music->src);
 
-                const buf = new Uint8Array(Module.HEAPU8.buffer, ptr, size);
+    SDL_free(music->data);
+    SDL_free(music);
+}
+
+static void MusicHTML5_Close(void)
+{
+    if (!html5_opened())
+        return;
 
-                const canPlay = force || Module["SDL2Mixer"].canPlayMagic(buf);
+    EM_ASM({
+        for(const prop in Module["SDL2Mixer"].stemGroups) {
+            Module["SDL2Mixer"].deleteStemGroup(prop);
+        }
 
-                if (!canPlay)
-                    return -1;
+        for(const prop in Module["SDL2Mixer"].music) {
+            Module["SDL2Mixer"].deleteMusic(prop);
+        }
 
-                const url = Module["SDL2Mixer"].createBlob(buf);
-                const id = Module["SDL2Mixer"].createMusic(url, context);
+        Module["SDL2Mixer"].deletePlayer(Module["SDL2Mixer"].element);
+        if (Module["SDL2Mixer"].standby)
+            Module["SDL2Mixer"].deletePlayer(Module["SDL2Mixer"].standby);
 
-                return id;
-            }, buf, size, music, force);
+        if (Module["SDL2Mixer"].bufferPlayer) {
+            Module["SDL2Mixer"].bufferPlayer.pause();
+            Module["SDL2Mixer"].bufferPlayer.output.disconnect();
         }
-    } 
-    else
-    {
-        Mix_SetError("Unsupported RWops type: %d", src->type);
-        if (freesrc)
-            SDL_RWclose(src);
+
+        for (const processor in Module["SDL2Mixer"].workletPlayers)
+            Module["SDL2Mixer"].workletPlayers[processor].close();
+
+        if (Module["SDL2Mixer"].decoder)
+            Module["SDL2Mixer"].decoder.terminate();
+
+        if (Module["SDL2Mixer"].context)
+            Module["SDL2Mixer"].context.close();
+
+        delete Module["SDL2Mixer"];
+    });
+
+    html5_formats = 0;
+}
+
+/* Check the browser's support for a format, without calling into JS */
+SDL_bool MusicHTML5_HasFormat(Mix_MusicFormat format)
+{
+    if (format <= MUSIC_FORMAT_UNKNOWN || format >= MUSIC_FORMAT_LAST)
+        return SDL_FALSE;
+
+    return (html5_formats & (1u << format)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Play the music from a decoded AudioBuffer from now on, and decode it
+   now so that the first play starts at once */
+void MusicHTML5_Decode(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        mixer.music[$0].decode = true;
+        // decodeMusic() reports errors itself
+        mixer.decodeMusic($0, $1).catch(() => {});
+    }, music->id, HTML5_MIX_PREFETCH_BACKGROUND);
+}
+
+void MusicHTML5_SetDecodedBudget(double bytes)
+{
+    html5_decoded_budget = bytes;
+
+    if (html5_opened())
+        EM_ASM({
+            const mixer = Module["SDL2Mixer"];
+            mixer.decodedBudget = $0;
+            mixer.trimDecodedCache(null);
+        }, bytes);
+}
+
+SDL_bool MusicHTML5_IsUnlocked(void)
+{
+    return html5_unlocked ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Unlock from a gesture handler of the caller's own */
+void MusicHTML5_Unlock(void)
+{
+    if (html5_opened())
+        EM_ASM({
+            Module["SDL2Mixer"].unlock();
+        });
+}
+
+/* The ticket of the last play, or 0 if none was made since the last call */
+int MusicHTML5_TakePlayTicket(void)
+{
+    if (!html5_opened())
+        return 0;
+
+    return EM_ASM_INT({
+        const ticket = Module["SDL2Mixer"].lastPlayTicket;
+        Module["SDL2Mixer"].lastPlayTicket = 0;
+        return ticket;
+    });
+}
+
+/* Forget the last play's ticket, which the caller doesn't want */
+void MusicHTML5_DropPlayTicket(void)
+{
+    if (html5_opened())
+        EM_ASM({
+            Module["SDL2Mixer"].dropPlayTicket();
+        });
+}
+
+int MusicHTML5_GetPlayResult(int ticket)
+{
+    if (!html5_opened())
+        return -1;
+
+    return EM_ASM_INT({
+        return Module["SDL2Mixer"].takePlayResult($0);
+    }, ticket);
+}
+
+#ifdef HTML5_MIXER_ASYNCIFY
+/* Needs -sASYNCIFY or -sJSPI; the caller's stack unwinds while waiting */
+EM_ASYNC_JS(int, html5_await_play_result, (int ticket), {
+    const mixer = Module["SDL2Mixer"];
+    const entry = mixer && mixer.playTickets[ticket];
+
+    if (!entry)
+        return -1;
+    await entry.done;
+    return mixer.takePlayResult(ticket);
+});
+
+int MusicHTML5_AwaitPlayResult(int ticket)
+{
+    if (!html5_opened())
+        return -1;
+
+    return html5_await_play_result(ticket);
+}
+#endif
+
+void MusicHTML5_SetSuspendWhenHidden(SDL_bool enable)
+{
+    html5_suspend_hidden = enable ? 1 : 0;
+
+    if (html5_opened())
+        EM_ASM({
+            const mixer = Module["SDL2Mixer"];
+            mixer.suspendHidden = !!$0;
+            if (!mixer.suspendHidden)
+                mixer.pageShown();
+            else if (document.hidden)
+                mixer.pageHidden();
+        }, enable);
+}
+
+double MusicHTML5_GetDecodedBytes(void)
+{
+    if (!html5_opened())
+        return 0.0;
+
+    return EM_ASM_DOUBLE({ return Module["SDL2Mixer"].decodedBytes; });
+}
+
+/* Create music rendered by an AudioWorkletProcessor that a backend
+   registered in Module["SDL2Mixer"].processors. Memory streams are passed
+   by address; other streams are read into the heap first. */
+void *MusicHTML5_CreateWorkletMusic(SDL_RWops *src, int freesrc, const char *processor)
+{
+    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);
+    const Uint8 *buf = NULL;
+    Sint64 size;
+    int id;
+
+    if (music == NULL) {
+        Mix_SetError("Out of memory");
         return NULL;
     }
 
-    if (id == -1)
-    {
-        SDL_free(music);
-        return NULL;
+    music->format = music_header_parse_rw(src, &music->info);
+
+    if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO) {
+        buf = src->hidden.mem.here;
+        size = src->hidden.mem.stop - src->hidden.mem.here;
+    } else {
+        size = SDL_RWsize(src) - SDL_RWtell(src);
+        if (size > 0)
+            music->data = SDL_malloc((size_t)size);
+        if (music->data == NULL || SDL_RWread(src, music->data, 1, (size_t)size) != (size_t)size) {
+            Mix_SetError("Couldn't read music data");
+            SDL_free(music->data);
+            SDL_free(music);
+            return NULL;
+        }
+        buf = (const Uint8 *)music->data;
+    }
+
+    id = EM_ASM_INT({
+        const ptr = $0;
+        const size = $1;
+        const context = $2;
+        const format = $3;
+        const processor = UTF8ToString($4);
+        const mixer = Module["SDL2Mixer"];
+        const heap = Module.HEAPU8;
+
+        const id = mixer.createMusic(null, context, format, false);
+        mixer.music[id].processor = processor;
+
+        // Shared wasm memory is handed to the audio thread as is.
+        // Otherwise keep a copy that survives memory growth.
+        if (typeof SharedArrayBuffer !== "undefined" && heap.buffer instanceof SharedArrayBuffer)
+            mixer.music[id].data = new Uint8Array(heap.buffer, ptr, size);
+        else
+            mixer.music[id].data = heap.slice(ptr, ptr + size);
+
+        // Warm up the processor while the game loads
+        mixer.getWorkletPlayer(processor).connect().catch(() => {});
+
+        return id;
+    }, buf, (int)size, music, music->format, processor);
+
+    // JS took a copy
+    if (!EM_ASM_INT({ return Module["SDL2Mixer"].music[$0].data.buffer === Module.HEAPU8.buffer; }, id)) {
+        SDL_free(music->data);
+        music->data = NULL;
     }
 
-    /* Fill the music structure */
     music->id = id;
     music->src = src;
     music->freesrc = freesrc;
     music->playing = SDL_TRUE;
 
-    /* We're done */
     return music;
 }
 
-/* Load a music stream from the given file */
-static void *MusicHTML5_CreateFromFile(const char *file)
+/* Download music loaded by URL, or decode music that plays decoded */
+void MusicHTML5_PrefetchMusic(void *context, int priority)
 {
-    MusicHTML5 *music = (MusicHTML5 *)SDL_calloc(1, sizeof *music);;
-    int id = -1;
-    SDL_bool force = SDL_MIXER_HTML5_DISABLE_TYPE_CHECK;
-
-    if (music == NULL) {
-        Mix_SetError("Out of memory");
-        return NULL;
-    }
-
-    id = EM_ASM_INT({
-        const file = UTF8ToString($0);
-        const context = $1;
-        const force = $2;
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-        let url;
-        try {
-            // Is path in FS?
-            const buf = FS.readFile(file);
-            url = Module["SDL2Mixer"].createBlob(buf);
+    EM_ASM({
+        Module["SDL2Mixer"].prefetchMusic($0, $1);
+    }, music->id, priority);
+}
 
-            const canPlay = force 
-                || Module["SDL2Mixer"].canPlayFile(file)
-                || Module["SDL2Mixer"].canPlayMagic(buf);
+void MusicHTML5_CancelPrefetch(void *context)
+{
+    MusicHTML5 *music = (MusicHTML5 *)context;
 
-            if (!canPlay) {
-                Module["SDL2Mixer"].deleteBlob(url);
-                return -1;
-            }
-        } catch(e) {
-            // Fail silently, presume file not in FS.
-            // Assume it's a relative or absolute URL
-            url = file;
+    EM_ASM({
+        Module["SDL2Mixer"].cancelPrefetch($0);
+    }, music->id);
+}
 
-            // Check audio capability by file extension
-            if (!force && !Module["SDL2Mixer"].canPlayFile(url))
-                return -1;
-        }
+void MusicHTML5_SetMaxPrefetches(int count)
+{
+    html5_max_prefetches = (count > 0) ? count : 0;
 
-        const id = Module["SDL2Mixer"].createMusic(url, context);
-        return id;
-    }, file, music, force);
+    if (html5_opened())
+        EM_ASM({
+            const mixer = Module["SDL2Mixer"];
+            mixer.prefetchLimit = $0;
+            mixer.runPrefetches();
+        }, html5_max_prefetches);
+}
 
-    if (id == -1) {
-        SDL_free(music);
-        return NULL;
-    }
+void MusicHTML5_SetPreload(int preload)
+{
+    if (preload < 0 || preload >= (int)SDL_arraysize(html5_preload_names))
+        return;
 
-    /* Fill the music structure */
-    music->id = id;
-    music->freesrc = SDL_FALSE;
-    music->playing = SDL_TRUE;
+    html5_preload = html5_preload_names[preload];
 
-    /* We're done */
-    return music;
+    if (html5_opened())
+        EM_ASM({
+            Module["SDL2Mixer"].setPreload(UTF8ToString($0));
+        }, html5_preload);
 }
 
-/* Set the volume for a given music stream */
-static void MusicHTML5_SetVolume(void *context, int volume)
+/* Read the range buffered ahead of the play position, as last mirrored */
+SDL_bool MusicHTML5_GetBuffered(void *context, double *start, double *end)
 {
     MusicHTML5 *music = (MusicHTML5 *)context;
-    float normalized_volume = ((float)volume) / MIX_MAX_VOLUME;
 
-    EM_ASM({
-        const id = $0;
-        const volume = Math.min(Math.max(0, $1), 1);
-        Module["SDL2Mixer"].setPlayerVolume(id, volume);
-    }, music->id, normalized_volume);
+    *start = music->buffered[0];
+    *end = music->buffered[1];
+    return SDL_TRUE;
 }
 
-static void MusicHTML5_Stop(void *context);
-
-/* Start playback of a given music stream */
-static int MusicHTML5_Play(void *context, int play_count)
+/* Create a group of music streams that play on one Web Audio timeline */
+int MusicHTML5_CreateStemGroup(void **contexts, int num_stems)
 {
-    MusicHTML5 *music = (MusicHTML5 *)context;
+    int i, group;
+    int *ids = (int *)SDL_malloc(num_stems * sizeof *ids);
 
-    if (play_count <= 0 && play_count != -1)
-    {
-        // do not play but do not throw errors either.
-        // TODO: What is SDL Mixer's state when passing play_count <= 0?
-        MusicHTML5_Stop(context);
-        return 0;
+    if (ids == NULL) {
+        Mix_SetError("Out of memory");
+        return -1;
     }
-    int status = EM_ASM_INT({
-        try {
-            const id = $0;
-            const playCount = $1;
-
-            // TODO: Asyncify Promise
-            const played = Module["SDL2Mixer"].startPlayer(id);
 
-            // Older browsers do not return a Promise
-            if (played)
-                played.catch((e) => err(e));
+    for (i = 0; i < num_stems; ++i)
+        ids[i] = ((MusicHTML5 *)contexts[i])->id;
 
-            // Retain play_count for handling in musicFinished()
-            Module["SDL2Mixer"].setPlayerPlayCount(id, playCount);
+    group = EM_ASM_INT({
+        const ptr = $0;
+        const count = $1;
 
-            // If play_count == -1, we are looping
-            Module["SDL2Mixer"].setPlayerLoop(id, (playCount == -1));
+        try {
+            const ids = Array.from(HEAP32.subarray(ptr >> 2, (ptr >> 2) + count));
+            return Module["SDL2Mixer"].createStemGroup(ids);
         } catch (e) {
             err(e);
             return -1;
         }
-        return 0;
-    }, music->id, play_count);
+    }, ids, num_stems);
 
-    if (status < 0)
+    SDL_free(ids);
+
+    if (group == -1)
         Mix_SetError("Emscripten HTML5 error, see developer console.");
-    
-    return status;
+
+    return group;
 }
 
-/* Return non-zero if a stream is currently playing */
-static SDL_bool MusicHTML5_IsPlaying(void *context)
+void MusicHTML5_DeleteStemGroup(int group)
 {
-    MusicHTML5 *music = (MusicHTML5 *)context;
-    
-    if (!music) {
-        // Call "finished" handler in devappd/html5_mixer
-        html5_handle_music_stopped(context);
-        return SDL_FALSE;
-    }
-
-    // We track a music->playing variable to play nice with music_mixer()'s
-    // IsPlaying() check on every frame. E.g., the check will run when
-    // <audio> is buffering and the music is technically not "playing".
-    // Ergo, the HookMusicFinished() callback is called immediately when
-    // the <audio> has not even begun playback.
-    //
-    // To resolve this, we rely on JavaScript callbacks to reset the
-    // music->playing status on end, on error, etc.
-
-    int safeStatus = EM_ASM_INT({
-        const id = $0;
-        const safeStatus =
-            Module["SDL2Mixer"].player
-            && Module["SDL2Mixer"].player.dataset.currentId == id
-            && !Module["SDL2Mixer"].player.ended
-            // SDL Mixer considers "paused" music as "playing"
-            //&& !Module["SDL2Mixer"].player.paused
-            // These conditions interfere with the "playing" check
-            //&&  Module["SDL2Mixer"].player.readyState > 2;
-            //&&  Module["SDL2Mixer"].player.currentTime > 0
-            ;
-
-        if (!safeStatus)
-            // Reset JS state and falsify music->playing
-            Module["SDL2Mixer"].resetMusicState(id);
-    }, music->id);
+    if (!html5_opened())
+        return;
 
-    return music->playing;
+    EM_ASM({
+        Module["SDL2Mixer"].deleteStemGroup($0);
+    }, group);
 }
 
-/* Jump (seek) to a given position (time is in seconds) */
-static int MusicHTML5_Seek(void *context, double time)
+/* Start all stems of a group from the beginning, sample-locked */
+int MusicHTML5_PlayStemGroup(int group, int play_count)
 {
-    MusicHTML5 *music = (MusicHTML5 *)context;
+    return EM_ASM_INT({
+        try {
+            Module["SDL2Mixer"].startStemGroup($0, $1);
+        } catch (e) {
+            err(e);
+            return -1;
+        }
+        return 0;
+    }, group, play_count);
+}
 
+void MusicHTML5_StopStemGroup(int group)
+{
     EM_ASM({
-        const id = $0;
-        const time = $1;
-        Module["SDL2Mixer"].setPlayerCurrentTime(id, time);
-    }, music->id, time);
-
-    return 0;
+        Module["SDL2Mixer"].stopStemGroup($0);
+    }, group);
 }
 
-/* Pause playback of a given music stream */
-static void MusicHTML5_Pause(void *context)
+void MusicHTML5_PauseStemGroup(int group)
 {
-    MusicHTML5 *music = (MusicHTML5 *)context;
+    EM_ASM({
+        Module["SDL2Mixer"].pauseStemGroup($0);
+    }, group);
+}
 
+void MusicHTML5_ResumeStemGroup(int group)
+{
     EM_ASM({
-        const id = $0;
-        Module["SDL2Mixer"].pausePlayer(id);
-    }, music->id);
+        Module["SDL2Mixer"].resumeStemGroup($0);
+    }, group);
 }
 
-/* Resume playback of a given music stream */
-static void MusicHTML5_Resume(void *context)
+SDL_bool MusicHTML5_IsStemGroupPlaying(int group)
 {
-    MusicHTML5 *music = (MusicHTML5 *)context;
+    return EM_ASM_INT({
+        return Module["SDL2Mixer"].stemGroups[$0].playing;
+    }, group) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Ramp the volume of one stem, or all stems if 'stem' is -1 */
+void MusicHTML5_SetStemVolume(int group, int stem, int volume, int ms)
+{
+    float normalized_volume = ((float)volume) / MIX_MAX_VOLUME;
 
     EM_ASM({
-        const id = $0;
-        Module["SDL2Mixer"].playPlayer(id);
-    }, music->id);
+        const volume = Math.min(Math.max(0, $2), 1);
+        Module["SDL2Mixer"].setStemVolume($0, $1, volume, $3 / 1000);
+    }, group, stem, normalized_volume, ms);
 }
 
-/* Stop playback of a stream previously started with MusicHTML5_Start() */
-static void MusicHTML5_Stop(void *context)
+int MusicHTML5_SetSprite(void *context, const char *name, double start, double end)
 {
     MusicHTML5 *music = (MusicHTML5 *)context;
 
+    if (!name || start < 0.0) {
+        Mix_SetError("Invalid sprite region");
+        return -1;
+    }
+
     EM_ASM({
-        const id = $0;
-        Module["SDL2Mixer"].resetMusicState(id);
-    }, music->id);
+        Module["SDL2Mixer"].setSprite($0, UTF8ToString($1), $2, $3);
+    }, music->id, name, start, end);
+
+    return 0;
 }
 
-/* Close the given music stream */
-static void MusicHTML5_Delete(void *context)
+int MusicHTML5_PlaySprite(void *context, const char *name)
 {
     MusicHTML5 *music = (MusicHTML5 *)context;
+    int handle;
 
-    if (html5_opened()) {
-        EM_ASM({
-            const id = $0;
-            if (id in Module["SDL2Mixer"].music)
-                Module["SDL2Mixer"].deleteMusic(id);
-        }, music->id);
+    if (!name) {
+        Mix_SetError("No sprite region given");
+        return -1;
     }
 
-    if (music->freesrc && music->src)
-        SDL_RWclose(music->src);
+    handle = EM_ASM_INT({
+        return Module["SDL2Mixer"].playSprite($0, UTF8ToString($1));
+    }, music->id, name);
 
-    SDL_free(music);
+    if (handle == 0) {
+        Mix_SetError("No sprite region named \"%s\"", name);
+        return -1;
+    }
+
+    return handle;
 }
 
-static void MusicHTML5_Close(void)
+void MusicHTML5_StopSprite(int handle)
 {
     if (!html5_opened())
         return;
 
     EM_ASM({
-        for(const prop in Module["SDL2Mixer"].music) {
-            Module["SDL2Mixer"].deleteMusic(prop);
-        }
+        Module["SDL2Mixer"].stopSprites($0, 0);
+    }, handle);
+}
+
+int MusicHTML5_VolumeSprites(int volume)
+{
+    int previous = html5_sprite_volume;
 
-        Module["SDL2Mixer"].player.pause();
-        Module["SDL2Mixer"].player.removeAttribute("src");
-        Module["SDL2Mixer"].player.load();
-        Module["SDL2Mixer"].player.remove();
+    if (volume < 0)
+        return previous;
 
-        Module["SDL2Mixer"].player.removeEventListener("ended", Module["SDL2Mixer"].musicFinished, false);
-        Module["SDL2Mixer"].player.removeEventListener("error", Module["SDL2Mixer"].musicError, false);
-        Module["SDL2Mixer"].player.removeEventListener("abort", Module["SDL2Mixer"].musicInterrupted, false);
-        //Module["SDL2Mixer"].player.removeEventListener("stalled", Module["SDL2Mixer"].musicInterrupted, false);
-        //Module["SDL2Mixer"].player.removeEventListener("suspend", Module["SDL2Mixer"].musicInterrupted, false);
+    html5_sprite_volume = SDL_min(volume, MIX_MAX_VOLUME);
 
-        delete Module["SDL2Mixer"];
-    });
+    if (html5_opened())
+        EM_ASM({
+            const mixer = Module["SDL2Mixer"];
+            mixer.spriteVolume = $0;
+            if (mixer.spriteOutput)
+                mixer.spriteOutput.gain.value = $0;
+        }, (float)html5_sprite_volume / MIX_MAX_VOLUME);
+
+    return previous;
 }
 
 Mix_MusicInterface Mix_MusicInterface_HTML5 =
@@ -757,9 +3796,19 @@ Mix_MusicInterface Mix_MusicInterface_HTML5 =
     MusicHTML5_CreateFromFile,
     MusicHTML5_SetVolume,
     MusicHTML5_Play,
+    MusicHTML5_Prefetch,
     MusicHTML5_IsPlaying,
     NULL,   /* GetAudio */
     MusicHTML5_Seek,
+    MusicHTML5_Tell,
+    MusicHTML5_Duration,
+    MusicHTML5_SetSpeed,
+    MusicHTML5_SetLoopPoints,
+    MusicHTML5_LoopStart,
+    MusicHTML5_LoopEnd,
+    MusicHTML5_LoopLength,
+    MusicHTML5_GetMetaTag,
+    MusicHTML5_GetType,
     MusicHTML5_Pause,
     MusicHTML5_Resume,
     MusicHTML5_Stop,
@@ -768,6 +3817,186 @@ Mix_MusicInterface Mix_MusicInterface_HTML5 =
     NULL,   /* Unload */
 };
 
+#else
+
+/* Without a browser, the native interface plays the music. What needs
+   Web Audio fails as it would before the HTML5 interface opens. */
+
+/* Native music is decoded as it loads */
+void MusicHTML5_Decode(void *context)
+{
+    (void)context;
+}
+
+void MusicHTML5_SetDecodedBudget(double bytes)
+{
+    (void)bytes;
+}
+
+double MusicHTML5_GetDecodedBytes(void)
+{
+    return 0.0;
+}
+
+/* Desktop audio needs no user gesture */
+SDL_bool MusicHTML5_IsUnlocked(void)
+{
+    return SDL_TRUE;
+}
+
+void MusicHTML5_Unlock(void)
+{
+}
+
+/* Nothing blocks a play, so every ticket reports it started */
+static int html5_last_ticket = 0;
+
+int MusicHTML5_TakePlayTicket(void)
+{
+    return ++html5_last_ticket;
+}
+
+void MusicHTML5_DropPlayTicket(void)
+{
+}
+
+int MusicHTML5_GetPlayResult(int ticket)
+{
+    return (ticket > 0 && ticket <= html5_last_ticket) ? HTML5_MIX_PLAY_STARTED : -1;
+}
+
+#ifdef HTML5_MIXER_ASYNCIFY
+int MusicHTML5_AwaitPlayResult(int ticket)
+{
+    return MusicHTML5_GetPlayResult(ticket);
+}
+#endif
+
+void MusicHTML5_SetSuspendWhenHidden(SDL_bool enable)
+{
+    (void)enable;
+}
+
+/* Native music is read whole as it loads, so there's nothing to fetch */
+void MusicHTML5_PrefetchMusic(void *context, int priority)
+{
+    (void)context;
+    (void)priority;
+}
+
+void MusicHTML5_CancelPrefetch(void *context)
+{
+    (void)context;
+}
+
+void MusicHTML5_SetMaxPrefetches(int count)
+{
+    (void)count;
+}
+
+void MusicHTML5_SetPreload(int preload)
+{
+    (void)preload;
+}
+
+void *MusicHTML5_CreateFromRange(const char *url, Sint64 offset, Sint64 length, Mix_MusicFormat format)
+{
+    (void)url;
+    (void)offset;
+    (void)length;
+    (void)format;
+    Mix_SetError("Archive ranges need the HTML5 backend");
+    return NULL;
+}
+
+/* Nothing is mirrored either */
+SDL_bool MusicHTML5_GetBuffered(void *context, double *start, double *end)
+{
+    (void)context;
+    (void)start;
+    (void)end;
+    return SDL_FALSE;
+}
+
+int MusicHTML5_CreateStemGroup(void **contexts, int num_stems)
+{
+    (void)contexts;
+    (void)num_stems;
+    Mix_SetError("Stem groups need the HTML5 backend");
+    return -1;
+}
+
+void MusicHTML5_DeleteStemGroup(int group)
+{
+    (void)group;
+}
+
+int MusicHTML5_PlayStemGroup(int group, int play_count)
+{
+    (void)group;
+    (void)play_count;
+    Mix_SetError("Stem groups need the HTML5 backend");
+    return -1;
+}
+
+void MusicHTML5_StopStemGroup(int group)
+{
+    (void)group;
+}
+
+void MusicHTML5_PauseStemGroup(int group)
+{
+    (void)group;
+}
+
+void MusicHTML5_ResumeStemGroup(int group)
+{
+    (void)group;
+}
+
+SDL_bool MusicHTML5_IsStemGroupPlaying(int group)
+{
+    (void)group;
+    return SDL_FALSE;
+}
+
+void MusicHTML5_SetStemVolume(int group, int stem, int volume, int ms)
+{
+    (void)group;
+    (void)stem;
+    (void)volume;
+    (void)ms;
+}
+
+int MusicHTML5_SetSprite(void *context, const char *name, double start, double end)
+{
+    (void)context;
+    (void)name;
+    (void)start;
+    (void)end;
+    Mix_SetError("Sprites need the HTML5 backend");
+    return -1;
+}
+
+int MusicHTML5_PlaySprite(void *context, const char *name)
+{
+    (void)context;
+    (void)name;
+    Mix_SetError("Sprites need the HTML5 backend");
+    return -1;
+}
+
+void MusicHTML5_StopSprite(int handle)
+{
+    (void)handle;
+}
+
+int MusicHTML5_VolumeSprites(int volume)
+{
+    (void)volume;
+    return 0;
+}
+
 #endif /* MUSIC_HTML5 */
 
 /* vi: set ts=4 sw=4 expandtab: */
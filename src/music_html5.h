@@ -25,7 +25,64 @@
 #define MUSIC_HTML5_H_
 
 #include "music.h"
+#include "music_probe.h"
 
 extern Mix_MusicInterface Mix_MusicInterface_HTML5;
 
+/* Formats the browser can play, probed once when the interface opens */
+extern SDL_bool MusicHTML5_HasFormat(Mix_MusicFormat format);
+
+/* Decoded playback: music played from an AudioBuffer, cached by content
+   and counted against a budget in bytes of PCM */
+extern void MusicHTML5_Decode(void *context);
+extern void MusicHTML5_SetDecodedBudget(double bytes);
+extern double MusicHTML5_GetDecodedBytes(void);
+
+/* The unlock manager: set up audio on the first user gesture */
+extern SDL_bool MusicHTML5_IsUnlocked(void);
+extern void MusicHTML5_Unlock(void);
+
+/* Play tickets: what became of a play, as an HTML5_Mix_PlayResult */
+extern int MusicHTML5_TakePlayTicket(void);
+extern void MusicHTML5_DropPlayTicket(void);
+extern int MusicHTML5_GetPlayResult(int ticket);
+#ifdef HTML5_MIXER_ASYNCIFY
+extern int MusicHTML5_AwaitPlayResult(int ticket);
+#endif
+
+/* Pause music and suspend the audio graph while the page is hidden */
+extern void MusicHTML5_SetSuspendWhenHidden(SDL_bool enable);
+
+/* Network prefetch of music loaded by URL, by HTML5_Mix_PrefetchPriority */
+extern void MusicHTML5_PrefetchMusic(void *context, int priority);
+extern void MusicHTML5_CancelPrefetch(void *context);
+extern void MusicHTML5_SetMaxPrefetches(int count);
+extern void MusicHTML5_SetPreload(int preload);
+
+/* Range loaded ahead of the play position, mirrored from JS. Returns
+   SDL_FALSE when the backend doesn't stream. */
+extern SDL_bool MusicHTML5_GetBuffered(void *context, double *start, double *end);
+
+/* Music rendered by a registered AudioWorkletProcessor, e.g. "html5-mixer-mod" */
+extern void *MusicHTML5_CreateWorkletMusic(SDL_RWops *src, int freesrc, const char *processor);
+
+/* Music in a byte range of a remote archive */
+extern void *MusicHTML5_CreateFromRange(const char *url, Sint64 offset, Sint64 length, Mix_MusicFormat format);
+
+/* Stem groups: several music streams sample-locked on one Web Audio clock */
+extern int MusicHTML5_CreateStemGroup(void **contexts, int num_stems);
+extern void MusicHTML5_DeleteStemGroup(int group);
+extern int MusicHTML5_PlayStemGroup(int group, int play_count);
+extern void MusicHTML5_StopStemGroup(int group);
+extern void MusicHTML5_PauseStemGroup(int group);
+extern void MusicHTML5_ResumeStemGroup(int group);
+extern SDL_bool MusicHTML5_IsStemGroupPlaying(int group);
+extern void MusicHTML5_SetStemVolume(int group, int stem, int volume, int ms);
+
+/* Sprites: named regions of one decoded music, played as one-shot clips */
+extern int MusicHTML5_SetSprite(void *context, const char *name, double start, double end);
+extern int MusicHTML5_PlaySprite(void *context, const char *name);
+extern void MusicHTML5_StopSprite(int handle);
+extern int MusicHTML5_VolumeSprites(int volume);
+
 #endif // MUSIC_HTML5_H_
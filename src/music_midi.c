@@ -0,0 +1,970 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports MIDI music synthesized from SoundFonts on an AudioWorklet */
+
+#include "music_midi.h"
+#include "music_html5.h"
+#include "music_worklet.h"
+
+#ifdef MUSIC_MID_WORKLET
+
+#include <emscripten.h>
+
+#define MIDI_PROCESSOR "html5-mixer-midi"
+
+/* Paths given to MusicMIDI_SetSoundFonts(), and whether the synth has any */
+static char *midi_soundfonts = NULL;
+static SDL_bool midi_has_soundfonts = SDL_FALSE;
+
+static int MIDI_SendSoundFonts(void);
+
+/* Register the synth. It runs in the AudioWorkletGlobalScope, so it is
+   serialized with toString() and must not use anything from this scope.
+   Besides the messages of WorkletPlayer in music_html5.c, it takes
+   { type: "soundfonts", fonts } with the SoundFont files to use, first
+   match first. They stay on the audio thread and serve every song. */
+static int MIDI_Open(const SDL_AudioSpec *spec)
+{
+    (void)spec;
+
+    if (!EM_ASM_INT({ return !!Module["SDL2Mixer"]; })) {
+        Mix_SetError("HTML5 music must be opened first");
+        return -1;
+    }
+
+    EM_ASM(({
+        Module["SDL2Mixer"].processors[UTF8ToString($0)] = function() {
+            // Generators of the SoundFont 2.04 specification
+            const START = 0, END = 1, LOOP_START = 2, LOOP_END = 3, START_COARSE = 4,
+                END_COARSE = 12, PAN = 17, DELAY = 33, ATTACK = 34, HOLD = 35, DECAY = 36,
+                SUSTAIN = 37, RELEASE = 38, INSTRUMENT = 41, KEY_RANGE = 43, VEL_RANGE = 44,
+                LOOP_START_COARSE = 45, KEYNUM = 46, VELOCITY = 47, ATTENUATION = 48,
+                LOOP_END_COARSE = 50, COARSE_TUNE = 51, FINE_TUNE = 52, SAMPLE_ID = 53,
+                SAMPLE_MODES = 54, SCALE_TUNING = 56, EXCLUSIVE_CLASS = 57, ROOT_KEY = 58;
+            const GENERATORS = 61;
+
+            // Generators only meaningful in instrument zones
+            const INSTRUMENT_ONLY = [START, END, LOOP_START, LOOP_END, START_COARSE, END_COARSE,
+                LOOP_START_COARSE, LOOP_END_COARSE, KEYNUM, VELOCITY, SAMPLE_ID, SAMPLE_MODES,
+                EXCLUSIVE_CLASS, ROOT_KEY];
+
+            const DEFAULTS = new Int16Array(GENERATORS);
+            [DELAY, ATTACK, HOLD, DECAY, RELEASE].forEach((gen) => { DEFAULTS[gen] = -12000; });
+            DEFAULTS[SCALE_TUNING] = 100;
+            DEFAULTS[ROOT_KEY] = -1;
+            DEFAULTS[KEYNUM] = -1;
+            DEFAULTS[VELOCITY] = -1;
+
+            const MAX_VOICES = 64;
+            // Leaves headroom for chords on several channels
+            const MASTER_GAIN = 0.4;
+            // A released note is inaudible this far down
+            const SILENCE_DB = 96;
+
+            const ENV_DELAY = 0, ENV_ATTACK = 1, ENV_HOLD = 2, ENV_DECAY = 3, ENV_SUSTAIN = 4,
+                ENV_RELEASE = 5, ENV_DONE = 6;
+
+            const timecents = (value) => (value <= -32768) ? 0 : Math.pow(2, value / 1200);
+
+            function parseSoundFont(data) {
+                const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+                const text = (offset) => String.fromCharCode(data[offset], data[offset + 1], data[offset + 2], data[offset + 3]);
+                const chunks = {};
+
+                if (data.length < 12 || text(0) !== "RIFF" || text(8) !== "sfbk")
+                    throw new Error("Not a SoundFont");
+
+                const walk = (offset, end) => {
+                    while (offset + 8 <= end) {
+                        const id = text(offset);
+                        const size = view.getUint32(offset + 4, true);
+                        const body = offset + 8;
+                        if (id === "LIST")
+                            walk(body + 4, Math.min(body + size, end));
+                        else
+                            chunks[id] = { offset: body, size: Math.min(size, end - body) };
+                        offset = body + size + (size & 1);
+                    }
+                };
+                walk(12, data.length);
+
+                ["smpl", "phdr", "pbag", "pgen", "inst", "ibag", "igen", "shdr"].forEach((id) => {
+                    if (!chunks[id])
+                        throw new Error("SoundFont has no " + id + " chunk");
+                });
+
+                // 16-bit samples; a view needs an even offset
+                const smpl = chunks.smpl;
+                const samples = ((data.byteOffset + smpl.offset) & 1)
+                    ? new Int16Array(data.slice(smpl.offset, smpl.offset + (smpl.size & ~1)).buffer)
+                    : new Int16Array(data.buffer, data.byteOffset + smpl.offset, smpl.size >> 1);
+
+                const records = (id, size, read) => {
+                    const chunk = chunks[id];
+                    const list = [];
+                    for (let offset = chunk.offset; offset + size <= chunk.offset + chunk.size; offset += size)
+                        list.push(read(offset));
+                    return list;
+                };
+                const bags = (id) => records(id, 4, (offset) => view.getUint16(offset, true));
+                const generators = (id) => records(id, 4, (offset) => ({
+                    oper: view.getUint16(offset, true),
+                    amount: view.getInt16(offset + 2, true),
+                    lo: data[offset + 2],
+                    hi: data[offset + 3]
+                }));
+
+                // Zones of each preset or instrument; a first zone that
+                // doesn't end with "link" is the global zone
+                const zones = (headers, bagList, generatorList, link) => {
+                    const result = [];
+                    for (let i = 0; i + 1 < headers.length; i++) {
+                        const item = { global: {}, zones: [] };
+                        for (let bag = headers[i].bag; bag < headers[i + 1].bag && bag + 1 < bagList.length; bag++) {
+                            const zone = { keyLo: 0, keyHi: 127, velLo: 0, velHi: 127, gen: {} };
+                            let linked = false;
+                            for (let g = bagList[bag]; g < bagList[bag + 1] && g < generatorList.length; g++) {
+                                const gen = generatorList[g];
+                                if (gen.oper === KEY_RANGE) {
+                                    zone.keyLo = gen.lo;
+                                    zone.keyHi = gen.hi;
+                                } else if (gen.oper === VEL_RANGE) {
+                                    zone.velLo = gen.lo;
+                                    zone.velHi = gen.hi;
+                                } else if (gen.oper < GENERATORS) {
+                                    zone.gen[gen.oper] = (gen.oper === link) ? (gen.amount & 0xFFFF) : gen.amount;
+                                    linked = (gen.oper === link);
+                                }
+                            }
+                            if (linked)
+                                item.zones.push(zone);
+                            else if (bag === headers[i].bag)
+                                item.global = zone.gen;
+                        }
+                        result.push(item);
+                    }
+                    return result;
+                };
+
+                const u16 = (offset) => view.getUint16(offset, true);
+                const u32 = (offset) => view.getUint32(offset, true);
+
+                const instruments = zones(records("inst", 22, (offset) => ({ bag: u16(offset + 20) })),
+                    bags("ibag"), generators("igen"), SAMPLE_ID);
+
+                const presetHeaders = records("phdr", 38, (offset) => ({
+                    program: u16(offset + 20),
+                    bank: u16(offset + 22),
+                    bag: u16(offset + 24)
+                }));
+                const presetZones = zones(presetHeaders, bags("pbag"), generators("pgen"), INSTRUMENT);
+                const presets = new Map();
+                presetZones.forEach((preset, i) => {
+                    const key = presetHeaders[i].bank * 128 + presetHeaders[i].program;
+                    if (!presets.has(key))
+                        presets.set(key, preset);
+                });
+
+                const sampleHeaders = records("shdr", 46, (offset) => ({
+                    start: u32(offset + 20),
+                    end: u32(offset + 24),
+                    loopStart: u32(offset + 28),
+                    loopEnd: u32(offset + 32),
+                    rate: u32(offset + 36),
+                    root: data[offset + 40],
+                    correction: view.getInt8(offset + 41)
+                }));
+
+                return { samples: samples, presets: presets, instruments: instruments, sampleHeaders: sampleHeaders };
+            }
+
+            // Events of all tracks, in seconds
+            function parseMidi(data) {
+                const text = (offset) => String.fromCharCode(data[offset], data[offset + 1], data[offset + 2], data[offset + 3]);
+                const be32 = (offset) => ((data[offset] << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3]) >>> 0;
+                const le32 = (offset) => (data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (data[offset + 3] << 24)) >>> 0;
+                let pos = 0;
+
+                if (!data || data.length < 14)
+                    throw new Error("MIDI file is truncated");
+
+                // RIFF MIDI keeps the standard file in its "data" chunk
+                if (text(0) === "RIFF" && text(8) === "RMID") {
+                    pos = 12;
+                    while (pos + 8 <= data.length && text(pos) !== "data")
+                        pos += 8 + le32(pos + 4) + (le32(pos + 4) & 1);
+                    pos += 8;
+                }
+
+                if (pos + 14 > data.length || text(pos) !== "MThd")
+                    throw new Error("Not a MIDI file");
+
+                const tracks = (data[pos + 10] << 8) | data[pos + 11];
+                const division = (data[pos + 12] << 8) | data[pos + 13];
+                const events = [];
+
+                pos += 8 + be32(pos + 4);
+
+                for (let track = 0; track < tracks && pos + 8 <= data.length; ) {
+                    const isTrack = text(pos) === "MTrk";
+                    const end = Math.min(pos + 8 + be32(pos + 4), data.length);
+                    let p = pos + 8;
+                    let tick = 0;
+                    let status = 0;
+
+                    pos = end;
+                    if (!isTrack)
+                        continue;
+                    track++;
+
+                    const length = () => {
+                        let value = 0;
+                        for (let i = 0; i < 4 && p < end; i++) {
+                            const c = data[p++];
+                            value = (value << 7) | (c & 0x7F);
+                            if (!(c & 0x80))
+                                break;
+                        }
+                        return value;
+                    };
+
+                    while (p < end) {
+                        tick += length();
+                        if (p >= end)
+                            break;
+
+                        const c = data[p];
+                        if (c === 0xFF) {
+                            const type = data[p + 1];
+                            p += 2;
+                            const size = length();
+                            if (type === 0x51 && size >= 3)
+                                events.push({ tick: tick, order: events.length, tempo: (data[p] << 16) | (data[p + 1] << 8) | data[p + 2] });
+                            else if (type === 0x2F)
+                                events.push({ tick: tick, order: events.length });
+                            p += size;
+                            if (type === 0x2F)
+                                break;
+                        } else if (c === 0xF0 || c === 0xF7) {
+                            p++;
+                            p += length();
+                        } else if (c > 0xF0) {
+                            // System common and real time messages carry no song data
+                            p++;
+                        } else {
+                            if (c & 0x80) {
+                                status = c;
+                                p++;
+                            } else if (!status)
+                                break;
+                            const a = data[p];
+                            const b = ((status & 0xE0) === 0xC0) ? 0 : data[p + 1];
+                            p += ((status & 0xE0) === 0xC0) ? 1 : 2;
+                            events.push({ tick: tick, order: events.length, message: status | (a << 8) | (b << 16) });
+                        }
+                    }
+                }
+
+                events.sort((x, y) => (x.tick - y.tick) || (x.order - y.order));
+
+                // SMPTE divisions count frames, otherwise quarter notes
+                const smpte = (division & 0x8000) !== 0;
+                let tempo = 500000;
+                let tick = 0;
+                let time = 0;
+                const times = [];
+                const messages = [];
+
+                events.forEach((event) => {
+                    time += (event.tick - tick) * (smpte
+                        ? 1 / ((256 - (division >> 8)) * (division & 0xFF))
+                        : tempo / 1e6 / (division || 96));
+                    tick = event.tick;
+                    if (event.tempo)
+                        tempo = event.tempo;
+                    else if (event.message !== undefined) {
+                        times.push(time);
+                        messages.push(event.message);
+                    }
+                });
+
+                return { times: Float64Array.from(times), messages: Uint32Array.from(messages), duration: time };
+            }
+
+            class MidiProcessor extends AudioWorkletProcessor {
+                constructor() {
+                    super();
+                    this.fonts = [];
+                    this.song = null;
+                    // Next event and song position in seconds
+                    this.index = 0;
+                    this.time = 0;
+                    this.voices = [];
+                    this.channels = [];
+                    this.playing = false;
+                    this.alive = true;
+                    this.serial = 0;
+                    this.passes = 0;
+                    this.rate = 1;
+                    this.reportFrames = 0;
+                    this.resetChannels();
+                    this.port.onmessage = (e) => this.receive(e.data);
+                }
+
+                receive(message) {
+                    switch (message.type) {
+                    case "soundfonts":
+                        this.voices = [];
+                        this.fonts = [];
+                        message.fonts.forEach((font) => {
+                            try {
+                                this.fonts.push(parseSoundFont(font));
+                            } catch (e) {
+                                this.port.postMessage({ type: "error", message: String(e) });
+                            }
+                        });
+                        break;
+                    case "load":
+                        this.playing = false;
+                        try {
+                            this.song = parseMidi(message.data);
+                            this.seek(0);
+                            this.port.postMessage({ type: "loaded", duration: this.song.duration });
+                        } catch (e) {
+                            this.song = null;
+                            this.port.postMessage({ type: "error", message: String(e) });
+                        }
+                        break;
+                    case "unload":
+                        this.song = null;
+                        this.voices = [];
+                        this.playing = false;
+                        break;
+                    case "play":
+                        this.serial = message.serial;
+                        this.passes = message.passes;
+                        this.rate = message.rate;
+                        if (!this.song)
+                            break;
+                        if (message.position >= 0)
+                            this.seek(message.position);
+                        this.playing = true;
+                        this.report(0);
+                        break;
+                    case "update":
+                        this.passes = message.passes;
+                        this.rate = message.rate;
+                        break;
+                    case "pause":
+                        this.playing = false;
+                        break;
+                    case "close":
+                        this.song = null;
+                        this.fonts = [];
+                        this.voices = [];
+                        this.playing = false;
+                        this.alive = false;
+                        break;
+                    }
+                }
+
+                resetChannels() {
+                    for (let i = 0; i < 16; i++) {
+                        this.channels[i] = {
+                            program: 0,
+                            // Channel 10 plays drums
+                            bank: (i === 9) ? 128 : 0,
+                            volume: 100,
+                            expression: 127,
+                            pan: 64,
+                            sustain: false,
+                            bend: 0,
+                            bendRange: 2,
+                            rpn: 0x3FFF
+                        };
+                    }
+                }
+
+                // Replay everything but notes up to the new position
+                seek(position) {
+                    const song = this.song;
+                    let i = 0;
+
+                    this.voices = [];
+                    this.resetChannels();
+                    for (; i < song.times.length && song.times[i] < position; i++) {
+                        const status = song.messages[i] & 0xF0;
+                        if (status !== 0x80 && status !== 0x90)
+                            this.dispatch(song.messages[i]);
+                    }
+                    this.index = i;
+                    this.time = position;
+                }
+
+                dispatch(message) {
+                    const status = message & 0xF0;
+                    const channel = this.channels[message & 0x0F];
+                    const a = (message >> 8) & 0x7F;
+                    const b = (message >> 16) & 0x7F;
+
+                    switch (status) {
+                    case 0x90:
+                        if (b) {
+                            this.noteOn(message & 0x0F, a, b);
+                            break;
+                        }
+                        this.noteOff(message & 0x0F, a);
+                        break;
+                    case 0x80:
+                        this.noteOff(message & 0x0F, a);
+                        break;
+                    case 0xB0:
+                        this.controller(message & 0x0F, a, b);
+                        break;
+                    case 0xC0:
+                        channel.program = a;
+                        break;
+                    case 0xE0:
+                        channel.bend = ((b << 7) | a) - 8192;
+                        break;
+                    }
+                }
+
+                controller(index, number, value) {
+                    const channel = this.channels[index];
+
+                    switch (number) {
+                    case 0:
+                        if (index !== 9)
+                            channel.bank = value;
+                        break;
+                    case 6:
+                        // Data entry for RPN 0, the pitch bend range
+                        if (channel.rpn === 0)
+                            channel.bendRange = value;
+                        break;
+                    case 7:
+                        channel.volume = value;
+                        break;
+                    case 10:
+                        channel.pan = value;
+                        break;
+                    case 11:
+                        channel.expression = value;
+                        break;
+                    case 64:
+                        channel.sustain = value >= 64;
+                        if (!channel.sustain)
+                            this.voices.forEach((voice) => {
+                                if (voice.channel === index && voice.held)
+                                    this.release(voice);
+                            });
+                        break;
+                    case 100:
+                        channel.rpn = (channel.rpn & 0x3F80) | value;
+                        break;
+                    case 101:
+                        channel.rpn = (channel.rpn & 0x7F) | (value << 7);
+                        break;
+                    case 120:
+                        this.voices = this.voices.filter((voice) => voice.channel !== index);
+                        break;
+                    case 121:
+                        channel.volume = 100;
+                        channel.expression = 127;
+                        channel.pan = 64;
+                        channel.sustain = false;
+                        channel.bend = 0;
+                        channel.rpn = 0x3FFF;
+                        break;
+                    case 123:
+                        this.voices.forEach((voice) => {
+                            if (voice.channel === index)
+                                this.release(voice);
+                        });
+                        break;
+                    }
+                }
+
+                // First SoundFont with the preset wins. Missing banks fall
+                // back to the General MIDI one.
+                findPreset(bank, program) {
+                    const keys = [bank * 128 + program, (bank === 128) ? 128 * 128 : program];
+                    for (const key of keys)
+                        for (const font of this.fonts)
+                            if (font.presets.has(key))
+                                return { font: font, preset: font.presets.get(key) };
+                    return null;
+                }
+
+                noteOn(index, key, velocity) {
+                    const channel = this.channels[index];
+                    const found = this.findPreset(channel.bank, channel.program);
+
+                    if (!found)
+                        return;
+
+                    const font = found.font;
+                    const preset = found.preset;
+                    const inRange = (zone) => key >= zone.keyLo && key <= zone.keyHi
+                        && velocity >= zone.velLo && velocity <= zone.velHi;
+
+                    preset.zones.forEach((presetZone) => {
+                        const instrument = font.instruments[presetZone.gen[INSTRUMENT]];
+                        if (!inRange(presetZone) || !instrument)
+                            return;
+
+                        const presetGen = Object.assign({}, preset.global, presetZone.gen);
+
+                        instrument.zones.forEach((zone) => {
+                            if (!inRange(zone))
+                                return;
+
+                            // Instrument values are absolute, preset values add to them
+                            const gen = DEFAULTS.slice();
+                            for (const oper in instrument.global)
+                                gen[oper] = instrument.global[oper];
+                            for (const oper in zone.gen)
+                                gen[oper] = zone.gen[oper];
+                            for (const oper in presetGen)
+                                if (oper != INSTRUMENT && INSTRUMENT_ONLY.indexOf(+oper) < 0)
+                                    gen[oper] += presetGen[oper];
+
+                            const sample = font.sampleHeaders[gen[SAMPLE_ID] & 0xFFFF];
+                            if (sample)
+                                this.startVoice(index, key, velocity, gen, sample, font.samples);
+                        });
+                    });
+                }
+
+                startVoice(index, key, velocity, gen, sample, data) {
+                    const limit = data.length;
+                    const clamp = (value) => Math.min(Math.max(value, 0), limit);
+                    const start = clamp(sample.start + gen[START] + gen[START_COARSE] * 32768);
+                    const end = clamp(sample.end + gen[END] + gen[END_COARSE] * 32768);
+                    const loopStart = clamp(sample.loopStart + gen[LOOP_START] + gen[LOOP_START_COARSE] * 32768);
+                    const loopEnd = Math.min(clamp(sample.loopEnd + gen[LOOP_END] + gen[LOOP_END_COARSE] * 32768), end);
+                    const mode = gen[SAMPLE_MODES] & 3;
+                    const root = (gen[ROOT_KEY] >= 0) ? gen[ROOT_KEY] : sample.root;
+                    const note = (gen[KEYNUM] >= 0) ? gen[KEYNUM] : key;
+                    const level = (gen[VELOCITY] >= 0) ? gen[VELOCITY] : velocity;
+                    const cents = (note - root) * gen[SCALE_TUNING] + gen[COARSE_TUNE] * 100 + gen[FINE_TUNE] + sample.correction;
+
+                    if (end <= start || !sample.rate)
+                        return;
+
+                    // Hi-hats and the like cut each other off
+                    if (gen[EXCLUSIVE_CLASS])
+                        this.voices = this.voices.filter((voice) =>
+                            voice.channel !== index || voice.exclusive !== gen[EXCLUSIVE_CLASS]);
+
+                    if (this.voices.length >= MAX_VOICES) {
+                        // Steal the quietest voice, preferring released ones
+                        let victim = 0;
+                        this.voices.forEach((voice, i) => {
+                            const other = this.voices[victim];
+                            if ((voice.stage >= ENV_RELEASE) > (other.stage >= ENV_RELEASE)
+                                || ((voice.stage >= ENV_RELEASE) === (other.stage >= ENV_RELEASE) && voice.level < other.level))
+                                victim = i;
+                        });
+                        this.voices.splice(victim, 1);
+                    }
+
+                    this.voices.push({
+                        channel: index,
+                        key: key,
+                        data: data,
+                        position: start,
+                        end: end,
+                        loopStart: loopStart,
+                        loopEnd: loopEnd,
+                        looping: (mode === 1 || mode === 3) && loopEnd > loopStart + 1,
+                        // Mode 3 plays the rest of the sample on release
+                        releaseLoop: mode === 3,
+                        step: Math.pow(2, cents / 1200) * sample.rate / sampleRate,
+                        // The default modulators are concave; this is close
+                        gain: Math.pow(10, -gen[ATTENUATION] / 200) * (level / 127) * (level / 127),
+                        pan: Math.min(Math.max(gen[PAN], -500), 500) / 1000,
+                        exclusive: gen[EXCLUSIVE_CLASS],
+                        held: false,
+                        stage: ENV_DELAY,
+                        stageTime: 0,
+                        delay: timecents(gen[DELAY]),
+                        attack: timecents(gen[ATTACK]),
+                        hold: timecents(gen[HOLD]),
+                        decay: timecents(gen[DECAY]),
+                        sustain: Math.min(Math.max(gen[SUSTAIN], 0), 1440) / 10,
+                        releaseTime: timecents(gen[RELEASE]),
+                        // Linear amplitude, and attenuation in dB once decaying
+                        level: 0,
+                        attenuation: 0
+                    });
+                }
+
+                noteOff(index, key) {
+                    const channel = this.channels[index];
+                    this.voices.forEach((voice) => {
+                        if (voice.channel !== index || voice.key !== key || voice.held || voice.stage >= ENV_RELEASE)
+                            return;
+                        if (channel.sustain)
+                            voice.held = true;
+                        else
+                            this.release(voice);
+                    });
+                }
+
+                release(voice) {
+                    voice.held = false;
+                    if (voice.stage >= ENV_RELEASE)
+                        return;
+                    // Release from the current level
+                    voice.attenuation = (voice.level > 0) ? -20 * Math.log10(voice.level) : SILENCE_DB;
+                    voice.stage = ENV_RELEASE;
+                    voice.stageTime = 0;
+                    if (voice.releaseLoop)
+                        voice.looping = false;
+                }
+
+                // Advance the volume envelope by "seconds"; returns the level
+                envelope(voice, seconds) {
+                    voice.stageTime += seconds;
+
+                    switch (voice.stage) {
+                    case ENV_DELAY:
+                        if (voice.stageTime < voice.delay)
+                            return 0;
+                        voice.stage = ENV_ATTACK;
+                        voice.stageTime -= voice.delay;
+                    case ENV_ATTACK:
+                        if (voice.stageTime < voice.attack)
+                            return voice.stageTime / voice.attack;
+                        voice.stage = ENV_HOLD;
+                        voice.stageTime -= voice.attack;
+                    case ENV_HOLD:
+                        if (voice.stageTime < voice.hold)
+                            return 1;
+                        voice.stage = ENV_DECAY;
+                        voice.stageTime -= voice.hold;
+                    case ENV_DECAY:
+                        // The decay time covers the full 96 dB range
+                        voice.attenuation = SILENCE_DB * voice.stageTime / Math.max(voice.decay, 0.001);
+                        if (voice.attenuation < voice.sustain)
+                            return Math.pow(10, -voice.attenuation / 20);
+                        voice.stage = ENV_SUSTAIN;
+                        voice.attenuation = voice.sustain;
+                    case ENV_SUSTAIN:
+                        if (voice.attenuation >= SILENCE_DB)
+                            voice.stage = ENV_DONE;
+                        return Math.pow(10, -voice.attenuation / 20);
+                    case ENV_RELEASE:
+                        voice.attenuation += SILENCE_DB * seconds / Math.max(voice.releaseTime, 0.001);
+                        if (voice.attenuation >= SILENCE_DB) {
+                            voice.stage = ENV_DONE;
+                            return 0;
+                        }
+                        return Math.pow(10, -voice.attenuation / 20);
+                    default:
+                        return 0;
+                    }
+                }
+
+                render(left, right, start, end) {
+                    const seconds = (end - start) / sampleRate;
+
+                    this.voices.forEach((voice) => {
+                        const channel = this.channels[voice.channel];
+                        const from = voice.level;
+                        const to = this.envelope(voice, seconds);
+                        const amplitude = MASTER_GAIN * voice.gain
+                            * (channel.volume / 127) * (channel.volume / 127)
+                            * (channel.expression / 127) * (channel.expression / 127);
+                        const pan = Math.min(Math.max(voice.pan + (channel.pan - 64) / 128, -0.5), 0.5);
+                        const leftGain = amplitude * Math.cos((pan + 0.5) * Math.PI / 2);
+                        const rightGain = amplitude * Math.sin((pan + 0.5) * Math.PI / 2);
+                        const step = voice.step * Math.pow(2, channel.bend / 8192 * channel.bendRange / 12);
+                        const data = voice.data;
+                        const ramp = (to - from) / (end - start);
+                        let level = from;
+                        let position = voice.position;
+
+                        voice.level = to;
+
+                        for (let i = start; i < end; i++) {
+                            if (voice.looping) {
+                                while (position >= voice.loopEnd)
+                                    position -= voice.loopEnd - voice.loopStart;
+                            } else if (position >= voice.end - 1) {
+                                voice.stage = ENV_DONE;
+                                break;
+                            }
+
+                            // Linear interpolation, wrapping into the loop
+                            const index = position | 0;
+                            const a = data[index];
+                            const b = (voice.looping && index + 1 >= voice.loopEnd) ? data[voice.loopStart] : data[index + 1];
+                            const value = (a + (b - a) * (position - index)) / 32768 * level;
+
+                            left[i] += value * leftGain;
+                            right[i] += value * rightGain;
+                            position += step;
+                            level += ramp;
+                        }
+                        voice.position = position;
+                    });
+
+                    this.voices = this.voices.filter((voice) => voice.stage !== ENV_DONE);
+                }
+
+                // Start the next pass, or finish after the last one
+                nextPass() {
+                    if (this.passes <= 0) {
+                        this.playing = false;
+                        this.voices = [];
+                        this.port.postMessage({ type: "ended", serial: this.serial });
+                        return false;
+                    }
+                    this.passes--;
+                    this.seek(0);
+                    return true;
+                }
+
+                // Tell the main thread where we are "frames" from now
+                report(frames) {
+                    this.port.postMessage({
+                        type: "position",
+                        serial: this.serial,
+                        time: currentTime + frames / sampleRate,
+                        position: this.time,
+                        remaining: (this.passes > 0) ? Infinity : Math.max(0, this.song.duration - this.time) / this.rate,
+                        passes: this.passes
+                    });
+                }
+
+                process(inputs, outputs) {
+                    const output = outputs[0];
+
+                    if (!this.playing || !this.song)
+                        return this.alive;
+
+                    const left = output[0];
+                    const right = output[1] || output[0];
+                    const frames = left.length;
+                    let done = 0;
+
+                    while (done < frames) {
+                        const song = this.song;
+
+                        while (this.index < song.times.length && song.times[this.index] <= this.time)
+                            this.dispatch(song.messages[this.index++]);
+
+                        if (this.index >= song.times.length && this.time >= song.duration) {
+                            if (!this.nextPass())
+                                break;
+                            continue;
+                        }
+
+                        // Render up to the next event; tempo follows the rate
+                        const next = (this.index < song.times.length) ? song.times[this.index] : song.duration;
+                        const count = Math.max(1, Math.min(frames - done, Math.ceil((next - this.time) * sampleRate / this.rate)));
+                        this.render(left, right, done, done + count);
+                        this.time += count * this.rate / sampleRate;
+                        done += count;
+                    }
+
+                    this.reportFrames += frames;
+                    if (this.playing && this.reportFrames >= sampleRate / 4) {
+                        this.reportFrames = 0;
+                        this.report(frames);
+                    }
+
+                    return this.alive;
+                }
+            };
+
+            registerProcessor("html5-mixer-midi", MidiProcessor);
+        };
+    }), MIDI_PROCESSOR);
+
+    // Fonts set before the mixer was opened
+    if (midi_has_soundfonts)
+        MIDI_SendSoundFonts();
+
+    return 0;
+}
+
+/* Read the SoundFonts named in midi_soundfonts and hand them to the synth.
+   The files are transferred, so the main thread keeps no copy. */
+static int MIDI_SendSoundFonts(void)
+{
+    char *paths = SDL_strdup(midi_soundfonts);
+    char *path = paths;
+    int count = 0;
+
+    if (paths == NULL) {
+        Mix_SetError("Out of memory");
+        return 0;
+    }
+
+    EM_ASM({ Module["SDL2Mixer"].soundFonts = []; });
+
+    while (path != NULL && *path) {
+        char *next = path;
+        SDL_RWops *rw;
+
+        while (*next && *next != ';' && *next != ':')
+            next++;
+        if (*next)
+            *next++ = '\0';
+        else
+            next = NULL;
+
+        rw = SDL_RWFromFile(path, "rb");
+        if (rw != NULL) {
+            Sint64 size = SDL_RWsize(rw);
+            Uint8 *data = (size > 0) ? SDL_malloc((size_t)size) : NULL;
+
+            if (data != NULL && SDL_RWread(rw, data, (size_t)size, 1) == 1) {
+                EM_ASM({
+                    Module["SDL2Mixer"].soundFonts.push(HEAPU8.slice($0, $0 + $1));
+                }, data, (int)size);
+                count++;
+            }
+            SDL_free(data);
+            SDL_RWclose(rw);
+        }
+
+        path = next;
+    }
+
+    SDL_free(paths);
+
+    if (count == 0) {
+        Mix_SetError("No SoundFont could be read");
+        return 0;
+    }
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const fonts = mixer.soundFonts;
+        delete mixer.soundFonts;
+        mixer.getWorkletPlayer(UTF8ToString($0)).send({ type: "soundfonts", fonts: fonts }, fonts.map((font) => font.buffer))
+            .catch((e) => console.error("SoundFonts not loaded:", e));
+    }, MIDI_PROCESSOR);
+
+    return 1;
+}
+
+static void *MIDI_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    if (music_probe_rw(src) != MUSIC_FORMAT_MIDI) {
+        Mix_SetError("Not a MIDI file");
+        return NULL;
+    }
+
+    if (!midi_has_soundfonts) {
+        Mix_SetError("MIDI needs a SoundFont, see Mix_SetSoundFonts()");
+        return NULL;
+    }
+
+    return MusicHTML5_CreateWorkletMusic(src, freesrc, MIDI_PROCESSOR);
+}
+
+static void *MIDI_CreateFromFile(const char *file)
+{
+    SDL_RWops *src = SDL_RWFromFile(file, "rb");
+    void *music;
+
+    if (src == NULL)
+        return NULL;
+
+    music = MIDI_CreateFromRW(src, SDL_TRUE);
+    if (music == NULL)
+        SDL_RWclose(src);
+
+    return music;
+}
+
+int MusicMIDI_SetSoundFonts(const char *paths)
+{
+    SDL_free(midi_soundfonts);
+    midi_soundfonts = NULL;
+    midi_has_soundfonts = SDL_FALSE;
+
+    if (paths == NULL || !*paths)
+        return 1;
+
+    midi_soundfonts = SDL_strdup(paths);
+    if (midi_soundfonts == NULL) {
+        Mix_SetError("Out of memory");
+        return 0;
+    }
+    midi_has_soundfonts = SDL_TRUE;
+
+    if (Mix_MusicInterface_MIDI.opened)
+        return MIDI_SendSoundFonts();
+
+    return 1;
+}
+
+const char *MusicMIDI_GetSoundFonts(void)
+{
+    return midi_soundfonts;
+}
+
+Mix_MusicInterface Mix_MusicInterface_MIDI =
+{
+    "MIDI",
+    MIX_MUSIC_FLUIDSYNTH,
+    MUS_MID,
+    SDL_FALSE,
+    SDL_FALSE,
+
+    NULL,   /* Load */
+    MIDI_Open,
+    MIDI_CreateFromRW,
+    MIDI_CreateFromFile,
+    MusicWorklet_SetVolume,
+    MusicWorklet_Play,
+    MusicWorklet_Prefetch,
+    MusicWorklet_IsPlaying,
+    NULL,   /* GetAudio */
+    MusicWorklet_Seek,
+    MusicWorklet_Tell,
+    MusicWorklet_Duration,
+    MusicWorklet_SetSpeed,
+    NULL,   /* SetLoopPoints */
+    NULL,   /* LoopStart */
+    NULL,   /* LoopEnd */
+    NULL,   /* LoopLength */
+    MusicWorklet_GetMetaTag,
+    MusicWorklet_GetType,
+    MusicWorklet_Pause,
+    MusicWorklet_Resume,
+    MusicWorklet_Stop,
+    MusicWorklet_Delete,
+    NULL,   /* Close: the processor goes away with the HTML5 interface */
+    NULL,   /* Unload */
+};
+
+#endif /* MUSIC_MID_WORKLET */
+
+/* vi: set ts=4 sw=4 expandtab: */
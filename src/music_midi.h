@@ -0,0 +1,35 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports MIDI music synthesized from SoundFonts on an AudioWorklet */
+
+#ifndef MUSIC_MIDI_H_
+#define MUSIC_MIDI_H_
+
+#include "music.h"
+
+extern Mix_MusicInterface Mix_MusicInterface_MIDI;
+
+/* Set the SoundFonts, separated by ';' or ':', or NULL to forget them */
+extern int MusicMIDI_SetSoundFonts(const char *paths);
+extern const char *MusicMIDI_GetSoundFonts(void);
+
+#endif // MUSIC_MIDI_H_
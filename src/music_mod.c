@@ -0,0 +1,734 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports ProTracker modules rendered on an AudioWorklet */
+
+#include "music_mod.h"
+#include "music_html5.h"
+#include "music_worklet.h"
+
+#ifdef MUSIC_MOD_WORKLET
+
+#include <emscripten.h>
+
+#define MOD_PROCESSOR "html5-mixer-mod"
+
+/* Register the module renderer. It runs in the AudioWorkletGlobalScope,
+   so it is serialized with toString() and must not use anything from
+   this scope. See WorkletPlayer in music_html5.c for the messages. */
+static int MOD_Open(const SDL_AudioSpec *spec)
+{
+    (void)spec;
+
+    if (!EM_ASM_INT({ return !!Module["SDL2Mixer"]; })) {
+        Mix_SetError("HTML5 music must be opened first");
+        return -1;
+    }
+
+    EM_ASM(({
+        Module["SDL2Mixer"].processors[UTF8ToString($0)] = function() {
+            // Amiga Paula clock (PAL); a note plays at PAULA_CLOCK / period Hz
+            const PAULA_CLOCK = 3546894.6;
+            const SINE = [
+                0, 24, 49, 74, 97, 120, 141, 161, 180, 197, 212, 224, 235, 244, 250, 253,
+                255, 253, 250, 244, 235, 224, 212, 197, 180, 161, 141, 120, 97, 74, 49, 24
+            ];
+            const TAGS = { "M.K.": 4, "M!K!": 4, "M&K!": 4, "FLT4": 4, "FLT8": 8, "OCTA": 8, "CD81": 8 };
+            // Songs that never repeat a row are cut off here
+            const MAX_DURATION = 3600;
+
+            const isDigit = (c) => c >= 48 && c <= 57;
+
+            // Samples are views into "data", which may be shared wasm memory
+            function parseModule(data) {
+                if (!data || data.length < 1084)
+                    throw new Error("Module is truncated");
+
+                const word = (offset) => (data[offset] << 8) | data[offset + 1];
+                const tag = String.fromCharCode(data[1080], data[1081], data[1082], data[1083]);
+                let channels = TAGS[tag] || 0;
+
+                if (!channels && isDigit(data[1080]) && tag.substring(1) === "CHN")
+                    channels = data[1080] - 48;
+                else if (!channels && isDigit(data[1080]) && isDigit(data[1081])
+                    && (tag.substring(2) === "CH" || tag.substring(2) === "CN"))
+                    channels = (data[1080] - 48) * 10 + data[1081] - 48;
+                if (!channels)
+                    throw new Error("Unsupported module type " + JSON.stringify(tag));
+
+                // Patterns stored in the file include unused ones
+                const orders = [];
+                let patterns = 0;
+                for (let i = 0; i < 128; i++) {
+                    if (i < data[950])
+                        orders.push(data[952 + i]);
+                    patterns = Math.max(patterns, data[952 + i] + 1);
+                }
+                if (!orders.length)
+                    throw new Error("Module has no orders");
+
+                const rowSize = channels * 4;
+                const patternSize = rowSize * 64;
+                const patternData = data.subarray(1084, 1084 + patterns * patternSize);
+                if (patternData.length < patterns * patternSize)
+                    throw new Error("Module is truncated");
+
+                const samples = [];
+                let offset = 1084 + patterns * patternSize;
+                for (let i = 0; i < 31; i++) {
+                    const header = 20 + i * 30;
+                    const length = word(header + 22) * 2;
+                    const start = Math.min(offset, data.length);
+                    const available = Math.min(length, data.length - start);
+                    const finetune = data[header + 24] & 15;
+                    const sample = {
+                        data: new Int8Array(data.buffer, data.byteOffset + start, available),
+                        finetune: finetune > 7 ? finetune - 16 : finetune,
+                        volume: Math.min(data[header + 25], 64),
+                        loopStart: word(header + 26) * 2,
+                        loopLength: word(header + 28) * 2,
+                        end: available
+                    };
+                    // A loop of one word marks a sample that plays once
+                    if (sample.loopLength > 2 && sample.loopStart < available) {
+                        sample.loopLength = Math.min(sample.loopLength, available - sample.loopStart);
+                        sample.end = sample.loopStart + sample.loopLength;
+                    } else
+                        sample.loopLength = 0;
+                    samples.push(sample);
+                    offset += length;
+                }
+
+                return {
+                    channels: channels,
+                    orders: orders,
+                    patterns: patternData,
+                    rowSize: rowSize,
+                    patternSize: patternSize,
+                    samples: samples
+                };
+            }
+
+            // Song state, advanced one tick at a time. "time" is the song
+            // position in seconds at the end of the last tick.
+            class ModSong {
+                constructor(module) {
+                    this.module = module;
+                    // Song position of each row when first played
+                    this.rowTimes = new Map();
+                    this.reset();
+                }
+
+                reset() {
+                    this.speed = 6;
+                    this.tempo = 125;
+                    this.order = 0;
+                    this.row = 0;
+                    this.tick = 0;
+                    this.rowTicks = this.speed;
+                    this.delay = 0;
+                    this.breakRow = -1;
+                    this.jumpOrder = -1;
+                    this.loopRow = -1;
+                    this.stopped = false;
+                    this.ended = false;
+                    this.time = 0;
+                    // Rows played in this pass
+                    this.rows = new Set();
+                    this.channels = [];
+                    for (let i = 0; i < this.module.channels; i++) {
+                        this.channels.push({
+                            sample: null, next: null, active: false, position: 0, step: 0,
+                            period: 0, volume: 0, finetune: 0, effect: 0, param: 0,
+                            target: 0, portaSpeed: 0, offset: 0, delayed: 0,
+                            vibrato: 0, vibratoPos: 0, vibratoSpeed: 0, vibratoDepth: 0,
+                            tremolo: 0, tremoloPos: 0, tremoloSpeed: 0, tremoloDepth: 0,
+                            loopRow: 0, loopCount: 0, outVolume: 0,
+                            // Amiga channels are hard panned LRRL; blend a little
+                            pan: (i % 4 === 0 || i % 4 === 3) ? 0.2 : 0.8
+                        });
+                    }
+                }
+
+                // Play through the first pass without mixing
+                measure() {
+                    this.reset();
+                    while (!this.ended && this.time < MAX_DURATION)
+                        this.step();
+                    const duration = this.time;
+                    this.reset();
+                    return duration;
+                }
+
+                seek(position) {
+                    this.reset();
+                    while (!this.ended && this.time < position) {
+                        const time = this.time;
+                        this.step();
+                        this.skip((this.time - time) * sampleRate);
+                    }
+                }
+
+                // Continue after the end of a pass, at the row it returned to
+                nextPass() {
+                    if (this.stopped) {
+                        this.reset();
+                        return;
+                    }
+                    this.time = this.rowTimes.get(this.order * 64 + this.row) || 0;
+                    this.rows = new Set();
+                    this.ended = false;
+                }
+
+                step() {
+                    if (this.tick === 0)
+                        this.playRow();
+                    else
+                        this.updateEffects();
+                    this.updateChannels();
+                    this.time += 2.5 / this.tempo;
+                    if (++this.tick >= this.rowTicks)
+                        this.nextRow();
+                }
+
+                playRow() {
+                    const module = this.module;
+                    const patterns = module.patterns;
+                    const key = this.order * 64 + this.row;
+                    let offset = module.orders[this.order] * module.patternSize + this.row * module.rowSize;
+
+                    this.rows.add(key);
+                    if (!this.rowTimes.has(key))
+                        this.rowTimes.set(key, this.time);
+
+                    this.delay = 0;
+                    this.channels.forEach((channel) => {
+                        this.playNote(channel,
+                            (patterns[offset] & 0xF0) | (patterns[offset + 2] >> 4),
+                            ((patterns[offset] & 0x0F) << 8) | patterns[offset + 1],
+                            patterns[offset + 2] & 0x0F,
+                            patterns[offset + 3]);
+                        offset += 4;
+                    });
+                    this.rowTicks = this.speed * (1 + this.delay);
+                }
+
+                playNote(channel, number, period, effect, param) {
+                    const x = param >> 4;
+                    const y = param & 15;
+
+                    channel.effect = effect;
+                    channel.param = param;
+                    channel.vibrato = 0;
+                    channel.tremolo = 0;
+
+                    // A new sample takes effect with the next note
+                    if (number > 0 && number <= 31) {
+                        const sample = this.module.samples[number - 1];
+                        channel.next = sample;
+                        channel.volume = sample.volume;
+                        channel.finetune = sample.finetune;
+                    }
+                    if (effect === 0xE && x === 0x5)
+                        channel.finetune = y > 7 ? y - 16 : y;
+
+                    if (period) {
+                        // Finetune steps are eighths of a semitone
+                        const tuned = period * Math.pow(2, -channel.finetune / 96);
+                        if (effect === 0x3 || effect === 0x5)
+                            channel.target = tuned;
+                        else if (effect === 0xE && x === 0xD && y > 0)
+                            channel.delayed = tuned;
+                        else
+                            this.trigger(channel, tuned);
+                    }
+
+                    switch (effect) {
+                    case 0x3:
+                        if (param)
+                            channel.portaSpeed = param;
+                        break;
+                    case 0x4:
+                        if (x)
+                            channel.vibratoSpeed = x;
+                        if (y)
+                            channel.vibratoDepth = y;
+                        break;
+                    case 0x7:
+                        if (x)
+                            channel.tremoloSpeed = x;
+                        if (y)
+                            channel.tremoloDepth = y;
+                        break;
+                    case 0x9:
+                        if (param)
+                            channel.offset = param * 256;
+                        if (period)
+                            channel.position = channel.offset;
+                        break;
+                    case 0xB:
+                        this.jumpOrder = param;
+                        if (this.breakRow < 0)
+                            this.breakRow = 0;
+                        break;
+                    case 0xC:
+                        channel.volume = Math.min(param, 64);
+                        break;
+                    case 0xD:
+                        this.breakRow = x * 10 + y;
+                        break;
+                    case 0xE:
+                        this.playExtended(channel, x, y);
+                        break;
+                    case 0xF:
+                        if (param === 0)
+                            this.stopped = true;
+                        else if (param < 32)
+                            this.speed = param;
+                        else
+                            this.tempo = param;
+                        break;
+                    }
+                }
+
+                playExtended(channel, x, y) {
+                    switch (x) {
+                    case 0x1:
+                        channel.period = Math.max(channel.period - y, 113);
+                        break;
+                    case 0x2:
+                        channel.period = Math.min(channel.period + y, 856);
+                        break;
+                    case 0x6:
+                        if (y === 0)
+                            channel.loopRow = this.row;
+                        else {
+                            channel.loopCount = channel.loopCount ? channel.loopCount - 1 : y;
+                            if (channel.loopCount)
+                                this.loopRow = channel.loopRow;
+                        }
+                        break;
+                    case 0xA:
+                        channel.volume = Math.min(channel.volume + y, 64);
+                        break;
+                    case 0xB:
+                        channel.volume = Math.max(channel.volume - y, 0);
+                        break;
+                    case 0xC:
+                        if (y === 0)
+                            channel.volume = 0;
+                        break;
+                    case 0xE:
+                        this.delay = y;
+                        break;
+                    }
+                }
+
+                trigger(channel, period) {
+                    if (channel.next)
+                        channel.sample = channel.next;
+                    channel.period = period;
+                    channel.position = 0;
+                    channel.active = !!channel.sample && channel.sample.end > 0;
+                    channel.vibratoPos = 0;
+                    channel.tremoloPos = 0;
+                }
+
+                updateEffects() {
+                    const tick = this.tick % this.speed;
+
+                    this.channels.forEach((channel) => {
+                        const param = channel.param;
+                        const x = param >> 4;
+                        const y = param & 15;
+
+                        switch (channel.effect) {
+                        case 0x1:
+                            channel.period = Math.max(channel.period - param, 113);
+                            break;
+                        case 0x2:
+                            channel.period = Math.min(channel.period + param, 856);
+                            break;
+                        case 0x3:
+                            this.portamento(channel);
+                            break;
+                        case 0x4:
+                            this.vibrato(channel);
+                            break;
+                        case 0x5:
+                            this.portamento(channel);
+                            this.volumeSlide(channel, x, y);
+                            break;
+                        case 0x6:
+                            this.vibrato(channel);
+                            this.volumeSlide(channel, x, y);
+                            break;
+                        case 0x7:
+                            this.tremolo(channel);
+                            break;
+                        case 0xA:
+                            this.volumeSlide(channel, x, y);
+                            break;
+                        case 0xE:
+                            if (x === 0x9 && y && tick % y === 0) {
+                                channel.position = 0;
+                                channel.active = !!channel.sample && channel.sample.end > 0;
+                            } else if (x === 0xC && tick === y)
+                                channel.volume = 0;
+                            else if (x === 0xD && tick === y && channel.delayed) {
+                                this.trigger(channel, channel.delayed);
+                                channel.delayed = 0;
+                            }
+                            break;
+                        }
+                    });
+                }
+
+                portamento(channel) {
+                    if (!channel.target)
+                        return;
+                    if (channel.period < channel.target)
+                        channel.period = Math.min(channel.period + channel.portaSpeed, channel.target);
+                    else
+                        channel.period = Math.max(channel.period - channel.portaSpeed, channel.target);
+                }
+
+                vibrato(channel) {
+                    const value = (SINE[channel.vibratoPos & 31] * channel.vibratoDepth) >> 7;
+                    channel.vibrato = (channel.vibratoPos & 32) ? -value : value;
+                    channel.vibratoPos = (channel.vibratoPos + channel.vibratoSpeed) & 63;
+                }
+
+                tremolo(channel) {
+                    const value = (SINE[channel.tremoloPos & 31] * channel.tremoloDepth) >> 6;
+                    channel.tremolo = (channel.tremoloPos & 32) ? -value : value;
+                    channel.tremoloPos = (channel.tremoloPos + channel.tremoloSpeed) & 63;
+                }
+
+                volumeSlide(channel, x, y) {
+                    if (x)
+                        channel.volume = Math.min(channel.volume + x, 64);
+                    else
+                        channel.volume = Math.max(channel.volume - y, 0);
+                }
+
+                // Work out what each channel plays during this tick
+                updateChannels() {
+                    this.channels.forEach((channel) => {
+                        let period = channel.period;
+                        if (channel.effect === 0x0 && channel.param) {
+                            const arpeggio = [0, channel.param >> 4, channel.param & 15];
+                            period /= Math.pow(2, arpeggio[this.tick % 3] / 12);
+                        }
+                        period += channel.vibrato;
+                        channel.step = (period > 0) ? PAULA_CLOCK / period / sampleRate : 0;
+                        channel.outVolume = Math.min(Math.max(channel.volume + channel.tremolo, 0), 64);
+                    });
+                }
+
+                nextRow() {
+                    const module = this.module;
+
+                    this.tick = 0;
+
+                    if (this.loopRow >= 0) {
+                        // Pattern loops (E6x) play rows again on purpose
+                        for (let row = this.loopRow; row <= this.row; row++)
+                            this.rows.delete(this.order * 64 + row);
+                        this.row = this.loopRow;
+                    } else if (this.jumpOrder >= 0 || this.breakRow >= 0) {
+                        this.order = (this.jumpOrder >= 0) ? this.jumpOrder : this.order + 1;
+                        this.row = (this.breakRow > 63) ? 0 : Math.max(this.breakRow, 0);
+                    } else if (++this.row >= 64) {
+                        this.row = 0;
+                        this.order++;
+                    }
+                    this.loopRow = -1;
+                    this.jumpOrder = -1;
+                    this.breakRow = -1;
+
+                    if (this.order >= module.orders.length)
+                        this.order = 0;
+
+                    // Returning to a row played in this pass starts the next one
+                    if (this.stopped || this.rows.has(this.order * 64 + this.row))
+                        this.ended = true;
+                }
+
+                // Advance the channels by "frames" without mixing
+                skip(frames) {
+                    this.channels.forEach((channel) => {
+                        if (channel.active)
+                            this.advance(channel, channel.position + channel.step * frames);
+                    });
+                }
+
+                advance(channel, position) {
+                    const sample = channel.sample;
+                    if (position >= sample.end) {
+                        if (sample.loopLength)
+                            position = sample.loopStart + (position - sample.end) % sample.loopLength;
+                        else
+                            channel.active = false;
+                    }
+                    channel.position = position;
+                }
+
+                mix(left, right, start, end) {
+                    // Full volume on every channel peaks at 1.0 on each side
+                    const gain = 2 / this.module.channels / 64;
+
+                    this.channels.forEach((channel) => {
+                        if (!channel.active)
+                            return;
+                        if (!channel.outVolume || !channel.step) {
+                            this.advance(channel, channel.position + channel.step * (end - start));
+                            return;
+                        }
+
+                        const sample = channel.sample;
+                        const data = sample.data;
+                        const volume = channel.outVolume * gain;
+                        const leftVolume = volume * (1 - channel.pan);
+                        const rightVolume = volume * channel.pan;
+                        let position = channel.position;
+
+                        for (let i = start; i < end; i++) {
+                            if (position >= sample.end) {
+                                if (!sample.loopLength) {
+                                    channel.active = false;
+                                    break;
+                                }
+                                position = sample.loopStart + (position - sample.end) % sample.loopLength;
+                            }
+
+                            // Linear interpolation, wrapping into the loop
+                            const index = position | 0;
+                            const a = data[index];
+                            const b = (index + 1 < sample.end) ? data[index + 1]
+                                : (sample.loopLength ? data[sample.loopStart] : 0);
+                            const value = (a + (b - a) * (position - index)) / 128;
+
+                            left[i] += value * leftVolume;
+                            right[i] += value * rightVolume;
+                            position += channel.step;
+                        }
+                        channel.position = position;
+                    });
+                }
+            };
+
+            class ModProcessor extends AudioWorkletProcessor {
+                constructor() {
+                    super();
+                    this.song = null;
+                    this.duration = 0;
+                    this.playing = false;
+                    this.alive = true;
+                    this.serial = 0;
+                    this.passes = 0;
+                    this.rate = 1;
+                    // Frames left of the current tick, may be fractional
+                    this.tickFrames = 0;
+                    this.reportFrames = 0;
+                    this.port.onmessage = (e) => this.receive(e.data);
+                }
+
+                receive(message) {
+                    switch (message.type) {
+                    case "load":
+                        this.playing = false;
+                        try {
+                            this.song = new ModSong(parseModule(message.data));
+                            this.duration = this.song.measure();
+                            this.port.postMessage({ type: "loaded", duration: this.duration });
+                        } catch (e) {
+                            this.song = null;
+                            this.port.postMessage({ type: "error", message: String(e) });
+                        }
+                        break;
+                    case "unload":
+                        this.song = null;
+                        this.playing = false;
+                        break;
+                    case "play":
+                        this.serial = message.serial;
+                        this.passes = message.passes;
+                        this.rate = message.rate;
+                        if (!this.song)
+                            break;
+                        if (message.position >= 0) {
+                            this.song.seek(message.position);
+                            this.tickFrames = 0;
+                        }
+                        this.playing = true;
+                        this.report(0);
+                        break;
+                    case "update":
+                        this.passes = message.passes;
+                        this.rate = message.rate;
+                        break;
+                    case "pause":
+                        this.playing = false;
+                        break;
+                    case "close":
+                        this.song = null;
+                        this.playing = false;
+                        this.alive = false;
+                        break;
+                    }
+                }
+
+                // Start the next tick, or finish after the last pass
+                nextTick() {
+                    const song = this.song;
+
+                    if (song.ended) {
+                        if (this.passes <= 0) {
+                            this.playing = false;
+                            this.port.postMessage({ type: "ended", serial: this.serial });
+                            return false;
+                        }
+                        this.passes--;
+                        song.nextPass();
+                    }
+
+                    song.step();
+                    // Tempo, not pitch, follows the playback rate
+                    this.tickFrames += sampleRate * 2.5 / song.tempo / this.rate;
+                    return true;
+                }
+
+                // Tell the main thread where we are "frames" from now
+                report(frames) {
+                    const position = Math.max(0, this.song.time - Math.max(0, this.tickFrames) * this.rate / sampleRate);
+                    this.port.postMessage({
+                        type: "position",
+                        serial: this.serial,
+                        time: currentTime + frames / sampleRate,
+                        position: position,
+                        remaining: (this.passes > 0) ? Infinity : Math.max(0, this.duration - position) / this.rate,
+                        passes: this.passes
+                    });
+                }
+
+                process(inputs, outputs) {
+                    const output = outputs[0];
+
+                    if (!this.playing || !this.song)
+                        return this.alive;
+
+                    const left = output[0];
+                    const right = output[1] || output[0];
+                    const frames = left.length;
+                    let done = 0;
+
+                    while (done < frames) {
+                        if (this.tickFrames <= 0 && !this.nextTick())
+                            break;
+                        const count = Math.min(frames - done, Math.ceil(this.tickFrames));
+                        this.song.mix(left, right, done, done + count);
+                        done += count;
+                        this.tickFrames -= count;
+                    }
+
+                    this.reportFrames += frames;
+                    if (this.playing && this.reportFrames >= sampleRate / 4) {
+                        this.reportFrames = 0;
+                        this.report(frames);
+                    }
+
+                    return this.alive;
+                }
+            };
+
+            registerProcessor("html5-mixer-mod", ModProcessor);
+        };
+    }), MOD_PROCESSOR);
+
+    return 0;
+}
+
+static void *MOD_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    // Only ProTracker modules are rendered; other trackers go to the
+    // browser, which will refuse them.
+    if (music_probe_rw(src) != MUSIC_FORMAT_MOD) {
+        Mix_SetError("Not a ProTracker module");
+        return NULL;
+    }
+
+    return MusicHTML5_CreateWorkletMusic(src, freesrc, MOD_PROCESSOR);
+}
+
+static void *MOD_CreateFromFile(const char *file)
+{
+    SDL_RWops *src = SDL_RWFromFile(file, "rb");
+    void *music;
+
+    if (src == NULL)
+        return NULL;
+
+    music = MOD_CreateFromRW(src, SDL_TRUE);
+    if (music == NULL)
+        SDL_RWclose(src);
+
+    return music;
+}
+
+Mix_MusicInterface Mix_MusicInterface_MOD =
+{
+    "MOD",
+    MIX_MUSIC_MODPLUG,
+    MUS_MOD,
+    SDL_FALSE,
+    SDL_FALSE,
+
+    NULL,   /* Load */
+    MOD_Open,
+    MOD_CreateFromRW,
+    MOD_CreateFromFile,
+    MusicWorklet_SetVolume,
+    MusicWorklet_Play,
+    MusicWorklet_Prefetch,
+    MusicWorklet_IsPlaying,
+    NULL,   /* GetAudio */
+    MusicWorklet_Seek,
+    MusicWorklet_Tell,
+    MusicWorklet_Duration,
+    MusicWorklet_SetSpeed,
+    NULL,   /* SetLoopPoints: songs loop by their pattern order */
+    NULL,   /* LoopStart */
+    NULL,   /* LoopEnd */
+    NULL,   /* LoopLength */
+    MusicWorklet_GetMetaTag,
+    MusicWorklet_GetType,
+    MusicWorklet_Pause,
+    MusicWorklet_Resume,
+    MusicWorklet_Stop,
+    MusicWorklet_Delete,
+    NULL,   /* Close: the processor goes away with the HTML5 interface */
+    NULL,   /* Unload */
+};
+
+#endif /* MUSIC_MOD_WORKLET */
+
+/* vi: set ts=4 sw=4 expandtab: */
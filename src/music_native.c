@@ -0,0 +1,822 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports music played natively through an SDL audio device.
+   A decode thread converts the music into a lock-free ring of stereo
+   float frames, which the audio callback drains. Only the decode thread
+   writes the ring and only the callback reads it, so neither waits on
+   the other. Control calls from the application take the decoder lock,
+   never the callback. */
+
+#include "music_native.h"
+#include "music_header.h"
+#include "music_effects.h"
+
+#ifdef MUSIC_NATIVE
+
+#ifdef HTML5_MIXER
+
+// Output rate asked of the audio device, which may pick another
+#ifdef HTML5_MIXER_NATIVE_FREQUENCY
+#define SDL_MIXER_NATIVE_FREQUENCY (HTML5_MIXER_NATIVE_FREQUENCY)
+#else
+#define SDL_MIXER_NATIVE_FREQUENCY (48000)
+#endif
+
+// Frames per audio callback
+#ifdef HTML5_MIXER_NATIVE_SAMPLES
+#define SDL_MIXER_NATIVE_SAMPLES (HTML5_MIXER_NATIVE_SAMPLES)
+#else
+#define SDL_MIXER_NATIVE_SAMPLES (1024)
+#endif
+
+#else
+#define SDL_MIXER_NATIVE_FREQUENCY (SDL_GetHint("SDL_MIXER_NATIVE_FREQUENCY") ? SDL_atoi(SDL_GetHint("SDL_MIXER_NATIVE_FREQUENCY")) : 48000)
+#define SDL_MIXER_NATIVE_SAMPLES (SDL_GetHint("SDL_MIXER_NATIVE_SAMPLES") ? SDL_atoi(SDL_GetHint("SDL_MIXER_NATIVE_SAMPLES")) : 1024)
+#endif
+
+/* The ring holds whole blocks, each stamped with the music time of its
+   first frame. Both sizes are powers of two, so the frame counters can
+   wrap. 64 blocks of 256 frames is about 340 ms at 48 kHz. */
+#define NATIVE_BLOCK_FRAMES 256
+#define NATIVE_RING_BLOCKS 64
+#define NATIVE_RING_FRAMES (NATIVE_BLOCK_FRAMES * NATIVE_RING_BLOCKS)
+#define NATIVE_FRAME_SIZE (2 * (int)sizeof(float))
+
+/* Source frames handed to the converter at a time */
+#define NATIVE_CHUNK_FRAMES 1024
+
+/* How long the decode thread sleeps with the ring full, or with nothing
+   to play, in milliseconds */
+#define NATIVE_BUSY_WAIT 5
+#define NATIVE_IDLE_WAIT 100
+
+typedef struct {
+    Uint8 *data;                /* PCM as loaded */
+    Uint32 frames;
+    int frame_size;
+    SDL_AudioSpec spec;
+    int volume;
+    double speed;
+    double start;               /* Where the next play starts, in seconds */
+    double loop_start;
+    double loop_end;
+    HTML5_Mix_MusicInfo info;
+} MusicNative;
+
+typedef struct {
+    double position;            /* Music time of the first frame */
+    double step;                /* Music time per frame */
+    int generation;
+} NativeStamp;
+
+static SDL_AudioDeviceID native_device = 0;
+static SDL_AudioSpec native_spec;
+static SDL_Thread *native_thread = NULL;
+static SDL_mutex *native_lock = NULL;
+static SDL_cond *native_wake = NULL;
+
+/* Under native_lock */
+static SDL_bool native_quit = SDL_FALSE;
+static MusicNative *native_music = NULL;    /* Playing, until its last frame is heard */
+static SDL_bool native_decoding = SDL_FALSE;
+static SDL_AudioStream *native_stream = NULL;
+static Uint32 native_frame = 0;             /* Next source frame */
+static int native_plays_left = 0;           /* -1 plays forever */
+static SDL_bool native_flushed = SDL_FALSE; /* Converter drained at the end of a pass */
+static double native_position = 0.0;        /* Music time of the next frame decoded */
+
+/* Written by the decode thread, read by the callback */
+static float native_ring[NATIVE_RING_FRAMES * 2];
+static NativeStamp native_stamps[NATIVE_RING_BLOCKS];
+static SDL_atomic_t native_written;         /* Frames ever written */
+static SDL_atomic_t native_ending;          /* Generation whose last block is written, or 0 */
+static SDL_atomic_t native_ending_at;       /* Frame count after that block */
+
+/* Written by the callback */
+static SDL_atomic_t native_read;            /* Frames ever read */
+static SDL_atomic_t native_finished;        /* Generation heard to the end, or 0 */
+
+/* Written by the application. Each play, seek and stop starts a new
+   generation and drops what the ring holds of the previous one. */
+static SDL_atomic_t native_generation;
+static SDL_atomic_t native_flush;
+static SDL_atomic_t native_flush_to;
+static SDL_atomic_t native_paused;
+static SDL_atomic_t native_volume;
+static SDL_atomic_t native_waiting;         /* Calls waiting for native_lock */
+
+/* What the listener hears, for MusicNative_Tell() */
+static SDL_SpinLock native_heard_lock = 0;
+static double native_heard = 0.0;
+
+SDL_bool MusicNative_HasFormat(Mix_MusicFormat format)
+{
+    return (format == MUSIC_FORMAT_WAV) ? SDL_TRUE : SDL_FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Audio callback
+////////////////////////////////////////////////////////////////////////
+
+static void SDLCALL native_mix(void *userdata, Uint8 *stream, int len)
+{
+    float *out = (float *)stream;
+    int frames = len / NATIVE_FRAME_SIZE;
+    int done = 0;
+    Uint32 read;
+
+    (void)userdata;
+
+    // A new generation starts where the application asked
+    if (SDL_AtomicCAS(&native_flush, 1, 0))
+        SDL_AtomicSet(&native_read, SDL_AtomicGet(&native_flush_to));
+
+    read = (Uint32)SDL_AtomicGet(&native_read);
+
+    if (!SDL_AtomicGet(&native_paused))
+    {
+        Uint32 available = (Uint32)SDL_AtomicGet(&native_written) - read;
+        float gain = (float)SDL_AtomicGet(&native_volume) / MIX_MAX_VOLUME;
+        int ending;
+
+        SDL_MemoryBarrierAcquire();
+
+        while (done < frames && available > 0) {
+            int offset = (int)(read % NATIVE_RING_FRAMES);
+            int n = SDL_min(frames - done, (int)SDL_min(available, (Uint32)(NATIVE_RING_FRAMES - offset)));
+            const float *src = &native_ring[offset * 2];
+            int i;
+
+            for (i = 0; i < n * 2; ++i)
+                out[done * 2 + i] = src[i] * gain;
+
+            done += n;
+            read += n;
+            available -= n;
+        }
+
+        if (done > 0) {
+            Uint32 last = read - 1;
+            const NativeStamp *stamp = &native_stamps[(last / NATIVE_BLOCK_FRAMES) % NATIVE_RING_BLOCKS];
+            double heard = stamp->position + (last % NATIVE_BLOCK_FRAMES + 1) * stamp->step;
+
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicSet(&native_read, (int)read);
+
+            SDL_AtomicLock(&native_heard_lock);
+            if (stamp->generation == SDL_AtomicGet(&native_generation))
+                native_heard = heard;
+            SDL_AtomicUnlock(&native_heard_lock);
+        }
+
+        ending = SDL_AtomicGet(&native_ending);
+        if (ending && (Sint32)(read - (Uint32)SDL_AtomicGet(&native_ending_at)) >= 0
+            && SDL_AtomicCAS(&native_ending, ending, 0))
+            SDL_AtomicSet(&native_finished, ending);
+    }
+
+    SDL_memset(out + done * 2, 0, (frames - done) * NATIVE_FRAME_SIZE);
+
+    MusicEffects_Process(out, frames, native_spec.freq);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Decode thread
+////////////////////////////////////////////////////////////////////////
+
+/* Last source frame of this pass: the loop end if the music goes round
+   again, else the end of the music */
+static Uint32 native_pass_end(MusicNative *music)
+{
+    if (native_plays_left != 1 && music->loop_end > 0.0)
+        return SDL_min(music->frames, (Uint32)(music->loop_end * music->spec.freq));
+    return music->frames;
+}
+
+/* Give the converter more of the music. Returns SDL_FALSE at the end of
+   the last pass. */
+static SDL_bool native_feed(MusicNative *music)
+{
+    Uint32 end = native_pass_end(music);
+
+    if (native_frame < end) {
+        Uint32 n = SDL_min(end - native_frame, NATIVE_CHUNK_FRAMES);
+
+        SDL_AudioStreamPut(native_stream, music->data + native_frame * music->frame_size,
+            (int)(n * music->frame_size));
+        native_frame += n;
+        return SDL_TRUE;
+    }
+
+    if (!native_flushed) {
+        SDL_AudioStreamFlush(native_stream);
+        native_flushed = SDL_TRUE;
+        return SDL_TRUE;
+    }
+
+    if (native_plays_left > 0)
+        --native_plays_left;
+    if (native_plays_left == 0)
+        return SDL_FALSE;
+
+    native_frame = (music->loop_start > 0.0 || music->loop_end > 0.0)
+        ? SDL_min(music->frames, (Uint32)(music->loop_start * music->spec.freq))
+        : 0;
+    native_position = (double)native_frame / music->spec.freq;
+    native_flushed = SDL_FALSE;
+    SDL_AudioStreamClear(native_stream);
+    return SDL_TRUE;
+}
+
+/* Decode the next block into the ring, which has room for it */
+static void native_decode_block(void)
+{
+    MusicNative *music = native_music;
+    Uint32 written = (Uint32)SDL_AtomicGet(&native_written);
+    float *block = &native_ring[(written % NATIVE_RING_FRAMES) * 2];
+    NativeStamp *stamp = &native_stamps[(written / NATIVE_BLOCK_FRAMES) % NATIVE_RING_BLOCKS];
+    double step = music->speed / native_spec.freq;
+    SDL_bool more = SDL_TRUE;
+    int frames = 0;
+
+    stamp->position = native_position;
+    stamp->step = step;
+    stamp->generation = SDL_AtomicGet(&native_generation);
+
+    while (frames < NATIVE_BLOCK_FRAMES && more)
+    {
+        int got = SDL_AudioStreamGet(native_stream, block + frames * 2,
+            (NATIVE_BLOCK_FRAMES - frames) * NATIVE_FRAME_SIZE);
+
+        if (got > 0) {
+            frames += got / NATIVE_FRAME_SIZE;
+            native_position += (got / NATIVE_FRAME_SIZE) * step;
+        } else if (got < 0) {
+            more = SDL_FALSE;
+        } else {
+            more = native_feed(music);
+        }
+    }
+
+    // The last block is padded, so blocks stay aligned with their stamps
+    SDL_memset(block + frames * 2, 0, (NATIVE_BLOCK_FRAMES - frames) * NATIVE_FRAME_SIZE);
+    written += NATIVE_BLOCK_FRAMES;
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&native_written, (int)written);
+
+    if (!more) {
+        native_decoding = SDL_FALSE;
+        SDL_AtomicSet(&native_ending_at, (int)written);
+        SDL_AtomicSet(&native_ending, stamp->generation);
+    }
+}
+
+static SDL_bool native_ring_has_room(void)
+{
+    Uint32 used = (Uint32)SDL_AtomicGet(&native_written) - (Uint32)SDL_AtomicGet(&native_read);
+    return (used <= NATIVE_RING_FRAMES - NATIVE_BLOCK_FRAMES) ? SDL_TRUE : SDL_FALSE;
+}
+
+static int SDLCALL native_decode_thread(void *data)
+{
+    (void)data;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+    SDL_LockMutex(native_lock);
+
+    while (!native_quit)
+    {
+        // The application waiting on the lock gets it between blocks,
+        // rather than when the ring is full
+        if (native_decoding && native_ring_has_room()) {
+            native_decode_block();
+            if (SDL_AtomicGet(&native_waiting))
+                SDL_CondWaitTimeout(native_wake, native_lock, NATIVE_BUSY_WAIT);
+            continue;
+        }
+
+        SDL_CondWaitTimeout(native_wake, native_lock,
+            native_decoding ? NATIVE_BUSY_WAIT : NATIVE_IDLE_WAIT);
+    }
+
+    SDL_UnlockMutex(native_lock);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Control, under the decoder lock
+////////////////////////////////////////////////////////////////////////
+
+/* Take native_lock for the application. The decode thread lets go of it
+   between blocks while this waits. */
+static void native_enter(void)
+{
+    SDL_AtomicAdd(&native_waiting, 1);
+    SDL_LockMutex(native_lock);
+    SDL_AtomicAdd(&native_waiting, -1);
+}
+
+/* Start a new generation: what the ring holds is dropped, and what is
+   heard is 'position' until the callback catches up */
+static void native_new_generation(double position)
+{
+    SDL_AtomicLock(&native_heard_lock);
+    SDL_AtomicIncRef(&native_generation);
+    native_heard = position;
+    SDL_AtomicUnlock(&native_heard_lock);
+
+    SDL_AtomicSet(&native_ending, 0);
+    SDL_AtomicSet(&native_flush_to, SDL_AtomicGet(&native_written));
+    SDL_AtomicSet(&native_flush, 1);
+}
+
+/* Decode 'music' from 'position', as a fresh stream at its speed */
+static int native_restart(MusicNative *music, double position)
+{
+    int rate = (int)(music->spec.freq * music->speed + 0.5);
+
+    if (native_stream)
+        SDL_FreeAudioStream(native_stream);
+    native_stream = SDL_NewAudioStream(music->spec.format, music->spec.channels, rate,
+        AUDIO_F32SYS, 2, native_spec.freq);
+    if (native_stream == NULL) {
+        native_music = NULL;
+        native_decoding = SDL_FALSE;
+        native_new_generation(0.0);
+        return -1;
+    }
+
+    if (position < 0.0)
+        position = 0.0;
+    native_frame = SDL_min(music->frames, (Uint32)(position * music->spec.freq));
+    native_position = (double)native_frame / music->spec.freq;
+    native_flushed = SDL_FALSE;
+    native_music = music;
+    native_decoding = SDL_TRUE;
+    native_new_generation(native_position);
+
+    SDL_CondSignal(native_wake);
+    return 0;
+}
+
+static void native_stop(void)
+{
+    native_music = NULL;
+    native_decoding = SDL_FALSE;
+    native_new_generation(0.0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Interface
+////////////////////////////////////////////////////////////////////////
+
+static int MusicNative_Open(const SDL_AudioSpec *spec)
+{
+    SDL_AudioSpec want;
+
+    (void)spec;
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+        return -1;
+
+    SDL_zero(want);
+    want.freq = SDL_MIXER_NATIVE_FREQUENCY;
+    want.format = AUDIO_F32SYS;
+    want.channels = 2;
+    want.samples = SDL_MIXER_NATIVE_SAMPLES;
+    want.callback = native_mix;
+
+    // SDL converts to whatever the device takes, except the rate, which
+    // the decode thread resamples to
+    native_device = SDL_OpenAudioDevice(NULL, 0, &want, &native_spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (native_device == 0) {
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return -1;
+    }
+
+    SDL_AtomicSet(&native_written, 0);
+    SDL_AtomicSet(&native_read, 0);
+    SDL_AtomicSet(&native_ending, 0);
+    SDL_AtomicSet(&native_finished, 0);
+    SDL_AtomicSet(&native_flush, 0);
+    SDL_AtomicSet(&native_paused, 0);
+    SDL_AtomicSet(&native_volume, MIX_MAX_VOLUME);
+    native_quit = SDL_FALSE;
+
+    native_lock = SDL_CreateMutex();
+    native_wake = SDL_CreateCond();
+    if (native_lock && native_wake)
+        native_thread = SDL_CreateThread(native_decode_thread, "html5_mixer decoder", NULL);
+
+    if (native_thread == NULL) {
+        SDL_CloseAudioDevice(native_device);
+        native_device = 0;
+        if (native_wake)
+            SDL_DestroyCond(native_wake);
+        if (native_lock)
+            SDL_DestroyMutex(native_lock);
+        native_wake = NULL;
+        native_lock = NULL;
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return -1;
+    }
+
+    SDL_PauseAudioDevice(native_device, 0);
+    return 0;
+}
+
+static void *MusicNative_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    MusicNative *music = (MusicNative *)SDL_calloc(1, sizeof *music);
+    Uint32 length;
+
+    if (music == NULL) {
+        if (freesrc)
+            SDL_RWclose(src);
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+
+    music_header_parse_rw(src, &music->info);
+
+    // Closes 'src' when asked to, whether or not it loads
+    if (SDL_LoadWAV_RW(src, freesrc, &music->spec, &music->data, &length) == NULL) {
+        SDL_free(music);
+        return NULL;
+    }
+
+    music->frame_size = (SDL_AUDIO_BITSIZE(music->spec.format) / 8) * music->spec.channels;
+    music->frames = length / music->frame_size;
+    music->volume = MIX_MAX_VOLUME;
+    music->speed = 1.0;
+
+    if (music->info.loop_start >= 0.0) {
+        music->loop_start = music->info.loop_start;
+        music->loop_end = (music->info.loop_end > music->info.loop_start) ? music->info.loop_end : 0.0;
+    }
+
+    return music;
+}
+
+static void *MusicNative_CreateFromFile(const char *file)
+{
+    SDL_RWops *src = SDL_RWFromFile(file, "rb");
+
+    if (src == NULL)
+        return NULL;
+
+    return MusicNative_CreateFromRW(src, SDL_TRUE);
+}
+
+static void MusicNative_SetVolume(void *context, int volume)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    music->volume = SDL_max(0, SDL_min(volume, MIX_MAX_VOLUME));
+
+    if (native_lock == NULL)
+        return;
+
+    native_enter();
+    if (native_music == music)
+        SDL_AtomicSet(&native_volume, music->volume);
+    SDL_UnlockMutex(native_lock);
+}
+
+static void MusicNative_Stop(void *context);
+
+/* Start playback, play_count times over or forever if -1 */
+static int MusicNative_Play(void *context, int play_count)
+{
+    MusicNative *music = (MusicNative *)context;
+    int result;
+
+    if (play_count <= 0 && play_count != -1)
+    {
+        // As the HTML5 interface: do not play, and do not fail
+        MusicNative_Stop(context);
+        return 0;
+    }
+
+    if (native_lock == NULL) {
+        Mix_SetError("Audio device not opened");
+        return -1;
+    }
+
+    native_enter();
+    native_plays_left = play_count;
+    SDL_AtomicSet(&native_paused, 0);
+    SDL_AtomicSet(&native_volume, music->volume);
+    result = native_restart(music, music->start);
+    music->start = 0.0;
+    SDL_UnlockMutex(native_lock);
+
+    return result;
+}
+
+/* Music heard to the end stops here, on the application's thread, at
+   its next call into the mixer, so the finished hook runs in step with
+   the rest of it */
+static SDL_bool MusicNative_IsPlaying(void *context)
+{
+    SDL_bool playing;
+    int finished;
+
+    if (native_lock == NULL)
+        return SDL_FALSE;
+
+    native_enter();
+    finished = SDL_AtomicSet(&native_finished, 0);
+    if (finished && finished == SDL_AtomicGet(&native_generation) && native_music)
+        native_music = NULL;
+    else
+        finished = 0;
+    playing = (native_music == context) ? SDL_TRUE : SDL_FALSE;
+    SDL_UnlockMutex(native_lock);
+
+    if (finished)
+        run_music_finished_hook();
+
+    return playing;
+}
+
+/* Jump to a position in seconds. Music that isn't playing starts there. */
+static int MusicNative_Seek(void *context, double position)
+{
+    MusicNative *music = (MusicNative *)context;
+    int result = 0;
+
+    if (native_lock == NULL) {
+        music->start = position;
+        return 0;
+    }
+
+    native_enter();
+    if (native_music == music)
+        result = native_restart(music, position);
+    else
+        music->start = position;
+    SDL_UnlockMutex(native_lock);
+
+    return result;
+}
+
+/* The pitch follows the rate; keeping it would need a time stretcher */
+static int MusicNative_SetSpeed(void *context, double rate, SDL_bool preserve_pitch)
+{
+    MusicNative *music = (MusicNative *)context;
+    double position;
+    int result = 0;
+
+    if (rate <= 0.0) {
+        Mix_SetError("Invalid playback rate");
+        return -1;
+    }
+    if (preserve_pitch && rate != 1.0) {
+        Mix_SetError("Preserving the pitch needs the HTML5 backend");
+        return -1;
+    }
+
+    if (native_lock == NULL) {
+        music->speed = rate;
+        return 0;
+    }
+
+    native_enter();
+    music->speed = rate;
+    if (native_music == music && native_decoding) {
+        SDL_AtomicLock(&native_heard_lock);
+        position = native_heard;
+        SDL_AtomicUnlock(&native_heard_lock);
+        result = native_restart(music, position);
+    }
+    SDL_UnlockMutex(native_lock);
+
+    return result;
+}
+
+/* Music time heard so far, in seconds */
+static double MusicNative_Tell(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+    double position;
+
+    if (native_lock == NULL)
+        return music->start;
+
+    native_enter();
+    if (native_music == music) {
+        SDL_AtomicLock(&native_heard_lock);
+        position = native_heard;
+        SDL_AtomicUnlock(&native_heard_lock);
+    } else {
+        position = music->start;
+    }
+    SDL_UnlockMutex(native_lock);
+
+    return position;
+}
+
+static double MusicNative_Duration(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    return (double)music->frames / music->spec.freq;
+}
+
+/* Set the loop region in seconds; an 'end' of 0 loops to the end of the track */
+static int MusicNative_SetLoopPoints(void *context, double start, double end)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    if (start < 0.0 || end < 0.0 || (end > 0.0 && end <= start)) {
+        Mix_SetError("Invalid loop points");
+        return -1;
+    }
+
+    // The decode thread reads them at the end of each pass
+    if (native_lock)
+        native_enter();
+    music->loop_start = start;
+    music->loop_end = end;
+    if (native_lock)
+        SDL_UnlockMutex(native_lock);
+
+    return 0;
+}
+
+static SDL_bool native_has_loop_points(MusicNative *music)
+{
+    return (music->loop_start > 0.0 || music->loop_end > 0.0) ? SDL_TRUE : SDL_FALSE;
+}
+
+static double MusicNative_LoopStart(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+    return native_has_loop_points(music) ? music->loop_start : -1.0;
+}
+
+static double MusicNative_LoopEnd(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    if (!native_has_loop_points(music))
+        return -1.0;
+
+    return (music->loop_end > 0.0) ? music->loop_end : MusicNative_Duration(context);
+}
+
+static double MusicNative_LoopLength(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+    double end = MusicNative_LoopEnd(context);
+
+    return (end < 0.0) ? -1.0 : end - music->loop_start;
+}
+
+static const char *MusicNative_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    switch (tag_type)
+    {
+    case MIX_META_TITLE:
+        return music->info.title;
+    case MIX_META_ARTIST:
+        return music->info.artist;
+    case MIX_META_ALBUM:
+        return music->info.album;
+    case MIX_META_COPYRIGHT:
+        return music->info.copyright;
+    default:
+        return "";
+    }
+}
+
+static Mix_MusicType MusicNative_GetType(void *context)
+{
+    (void)context;
+    return MUS_WAV;
+}
+
+/* Paused music keeps its place in the ring; the callback plays silence */
+static void MusicNative_Pause(void *context)
+{
+    if (MusicNative_IsPlaying(context))
+        SDL_AtomicSet(&native_paused, 1);
+}
+
+static void MusicNative_Resume(void *context)
+{
+    if (MusicNative_IsPlaying(context))
+        SDL_AtomicSet(&native_paused, 0);
+}
+
+static void MusicNative_Stop(void *context)
+{
+    if (native_lock == NULL)
+        return;
+
+    native_enter();
+    if (native_music == context)
+        native_stop();
+    SDL_UnlockMutex(native_lock);
+}
+
+static void MusicNative_Delete(void *context)
+{
+    MusicNative *music = (MusicNative *)context;
+
+    MusicNative_Stop(context);
+
+    SDL_FreeWAV(music->data);
+    SDL_free(music);
+}
+
+static void MusicNative_Close(void)
+{
+    if (native_thread == NULL)
+        return;
+
+    native_enter();
+    native_stop();
+    native_quit = SDL_TRUE;
+    SDL_CondSignal(native_wake);
+    SDL_UnlockMutex(native_lock);
+
+    SDL_WaitThread(native_thread, NULL);
+    native_thread = NULL;
+
+    SDL_CloseAudioDevice(native_device);
+    native_device = 0;
+
+    if (native_stream)
+        SDL_FreeAudioStream(native_stream);
+    native_stream = NULL;
+
+    SDL_DestroyCond(native_wake);
+    SDL_DestroyMutex(native_lock);
+    native_wake = NULL;
+    native_lock = NULL;
+
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+Mix_MusicInterface Mix_MusicInterface_NATIVE =
+{
+    "NATIVE",
+    MIX_MUSIC_NATIVE,
+    MUS_WAV,
+    SDL_FALSE,
+    SDL_FALSE,
+
+    NULL,   /* Load */
+    MusicNative_Open,
+    MusicNative_CreateFromRW,
+    MusicNative_CreateFromFile,
+    MusicNative_SetVolume,
+    MusicNative_Play,
+    NULL,   /* Prefetch */
+    MusicNative_IsPlaying,
+    NULL,   /* GetAudio */
+    MusicNative_Seek,
+    MusicNative_Tell,
+    MusicNative_Duration,
+    MusicNative_SetSpeed,
+    MusicNative_SetLoopPoints,
+    MusicNative_LoopStart,
+    MusicNative_LoopEnd,
+    MusicNative_LoopLength,
+    MusicNative_GetMetaTag,
+    MusicNative_GetType,
+    MusicNative_Pause,
+    MusicNative_Resume,
+    MusicNative_Stop,
+    MusicNative_Delete,
+    MusicNative_Close,
+    NULL,   /* Unload */
+};
+
+#endif /* MUSIC_NATIVE */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,481 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports native Web Audio effects and analysis on music.
+   The nodes are built once by getNativeEffects() in music_html5.c and
+   process whatever music plays, so changing tracks leaves them alone.
+   They cost no wasm time: all processing happens on the browser's audio
+   thread. */
+
+#include "music_nodes.h"
+#include "music_html5.h"
+
+#ifdef MUSIC_HTML5
+
+#include <emscripten.h>
+
+/* Last direction, for MusicNodes_SetDistance() */
+static Sint16 nodes_angle = 0;
+
+static int nodes_check(void)
+{
+    if (!EM_ASM_INT({ return !!Module["SDL2Mixer"]; })) {
+        Mix_SetError("HTML5 music must be opened first");
+        return -1;
+    }
+    return 0;
+}
+
+int MusicNodes_SetFilter(HTML5_Mix_FilterType type, float frequency, float q, float gain, int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    if (type < HTML5_MIX_FILTER_NONE || type > HTML5_MIX_FILTER_ALLPASS) {
+        Mix_SetError("Unknown filter type %d", (int)type);
+        return -1;
+    }
+
+    EM_ASM(({
+        const mixer = Module["SDL2Mixer"];
+        const stage = mixer.getNativeEffects().filter;
+        const filter = stage.filter;
+        const types = [null, "lowpass", "highpass", "bandpass", "lowshelf", "highshelf", "peaking", "notch", "allpass"];
+        const type = types[$0];
+        const ms = $4;
+        let change = ms;
+
+        if (!type) {
+            // Fade to the dry signal
+            mixer.rampParam(stage.wet.gain, 0, ms);
+            mixer.rampParam(stage.dry.gain, 1, ms);
+            mixer.enableStage("filter", false, ms);
+            return;
+        }
+
+        // A new type starts with its settings; a new stage fades in
+        if (filter.type !== type || !stage.enabled) {
+            filter.type = type;
+            change = 0;
+        }
+        mixer.rampParam(filter.frequency, $1, change, true);
+        mixer.rampParam(filter.Q, $2, change);
+        mixer.rampParam(filter.gain, $3, change);
+        mixer.rampParam(stage.wet.gain, 1, ms);
+        mixer.rampParam(stage.dry.gain, 0, ms);
+        mixer.enableStage("filter", true, ms);
+    }), type, frequency, q, gain, ms);
+
+    return 0;
+}
+
+/* As Mix_SetPanning(): each side's volume, 255 being full */
+int MusicNodes_SetPanning(Uint8 left, Uint8 right, int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const panning = mixer.getNativeEffects().panning;
+        const left = $0;
+        const right = $1;
+        const ms = $2;
+
+        mixer.rampParam(panning.left.gain, left / 255, ms);
+        mixer.rampParam(panning.right.gain, right / 255, ms);
+        mixer.enableStage("panning", left !== 255 || right !== 255, ms);
+    }, left, right, ms);
+
+    return 0;
+}
+
+/* As Mix_SetPosition(): 0 degrees is ahead, 90 to the right. Distance
+   fades the music linearly, 255 being inaudible. */
+int MusicNodes_SetDirection(Sint16 angle, Uint8 distance, int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    nodes_angle = angle;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const panner = mixer.getNativeEffects().spatial.input;
+        const angle = $0 * Math.PI / 180;
+        // Zero distance still pans by the angle
+        const distance = Math.max($1, 1);
+        const ms = $2;
+        const x = Math.sin(angle) * distance;
+        const z = -Math.cos(angle) * distance;
+
+        if (panner.positionX) {
+            mixer.rampParam(panner.positionX, x, ms);
+            mixer.rampParam(panner.positionZ, z, ms);
+        } else {
+            panner.setPosition(x, 0, z);
+        }
+        mixer.enableStage("spatial", $0 % 360 !== 0 || $1 !== 0, ms);
+    }, angle, distance, ms);
+
+    return 0;
+}
+
+int MusicNodes_SetDistance(Uint8 distance, int ms)
+{
+    return MusicNodes_SetDirection(nodes_angle, distance, ms);
+}
+
+/* Thresholds and knee in dB, attack and release in seconds. A ratio of
+   1 or less removes the compressor. */
+int MusicNodes_SetCompressor(float threshold, float knee, float ratio, float attack, float release, int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const compressor = mixer.getNativeEffects().compressor.input;
+        const ms = $5;
+
+        if ($2 <= 1) {
+            mixer.rampParam(compressor.ratio, 1, ms);
+            mixer.enableStage("compressor", false, ms);
+            return;
+        }
+
+        mixer.rampParam(compressor.threshold, $0, ms);
+        mixer.rampParam(compressor.knee, $1, ms);
+        mixer.rampParam(compressor.ratio, $2, ms);
+        mixer.rampParam(compressor.attack, $3, 0);
+        mixer.rampParam(compressor.release, $4, 0);
+        mixer.enableStage("compressor", true, ms);
+    }, threshold, knee, ratio, attack, release, ms);
+
+    return 0;
+}
+
+/* Use a recorded impulse response from FS or a URL, or NULL for the
+   built-in room. It is decoded in the background. */
+int MusicNodes_LoadReverb(const char *file)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const reverb = mixer.getNativeEffects().reverb;
+        const context = mixer.getContext();
+
+        if (!$0) {
+            reverb.convolver.buffer = mixer.createImpulse(2, 3);
+            return;
+        }
+
+        const file = UTF8ToString($0);
+        let data;
+        try {
+            data = Promise.resolve(FS.readFile(file).slice().buffer);
+        } catch (e) {
+            // Not in FS, so a URL
+            data = fetch(file).then((response) => response.arrayBuffer());
+        }
+
+        data.then((buffer) => new Promise((resolve, reject) => {
+            context.decodeAudioData(buffer, resolve, reject);
+        })).then((impulse) => {
+            reverb.convolver.buffer = impulse;
+        }).catch((e) => err("Reverb impulse " + file + ": " + e));
+    }, file);
+
+    return 0;
+}
+
+/* Mix in the reverberated signal at "wet" (0 to 1), 0 removing it */
+int MusicNodes_SetReverb(float wet, int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const wet = Math.min(Math.max($0, 0), 1);
+
+        mixer.rampParam(mixer.getNativeEffects().reverb.wet.gain, wet, $1);
+        mixer.enableStage("reverb", wet > 0, $1);
+    }, wet, ms);
+
+    return 0;
+}
+
+/* Duck to "volume" (0 to 1 of normal), fading down over attack_ms and
+   back up over release_ms */
+int MusicNodes_SetDucking(float volume, int attack_ms, int release_ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const duck = mixer.getNativeEffects().duck;
+
+        duck.level = Math.min(Math.max($0, 0), 1);
+        duck.attack = Math.max($1, 0);
+        duck.release = Math.max($2, 0);
+        if (duck.enabled)
+            mixer.updateDuck();
+    }, volume, attack_ms, release_ms);
+
+    return 0;
+}
+
+/* Triggers are any numbers the caller likes, e.g. the channels playing
+   voice. Holding one twice takes one release. */
+int MusicNodes_Duck(int trigger)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const duck = mixer.getNativeEffects().duck;
+
+        if (!duck.triggers.has($0)) {
+            duck.triggers.add($0);
+            mixer.updateDuck();
+        }
+    }, trigger);
+
+    return 0;
+}
+
+int MusicNodes_Unduck(int trigger)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+
+        if (mixer.getNativeEffects().duck.triggers.delete($0))
+            mixer.updateDuck();
+    }, trigger);
+
+    return 0;
+}
+
+/* Duck for "ms" from now, e.g. the length of a voice line. The whole
+   envelope is scheduled at once. */
+int MusicNodes_DuckFor(int ms)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    EM_ASM({
+        const mixer = Module["SDL2Mixer"];
+        const duck = mixer.getNativeEffects().duck;
+        const until = mixer.getContext().currentTime + Math.max($0, 0) / 1000;
+
+        if (until > duck.until) {
+            duck.until = until;
+            mixer.updateDuck();
+        }
+    }, ms);
+
+    return 0;
+}
+
+/* FFT size a power of two from 32 to 32768, smoothing over time from
+   0 to 1 */
+int MusicNodes_SetAnalyser(int fft_size, float smoothing)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    if (fft_size < 32 || fft_size > 32768 || (fft_size & (fft_size - 1))) {
+        Mix_SetError("FFT size must be a power of two from 32 to 32768");
+        return -1;
+    }
+
+    EM_ASM({
+        const analyser = Module["SDL2Mixer"].getAnalyser();
+
+        analyser.fftSize = $0;
+        analyser.smoothingTimeConstant = Math.min(Math.max($1, 0), 1);
+    }, fft_size, smoothing);
+
+    return 0;
+}
+
+/* Decibels per bin, up to half the FFT size. Returns the bins written. */
+int MusicNodes_GetSpectrum(float *out, int bins)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    if (!out || bins <= 0)
+        return 0;
+
+    return EM_ASM_INT({
+        const mixer = Module["SDL2Mixer"];
+        const analyser = mixer.getAnalyser();
+        const length = Math.min($1, analyser.frequencyBinCount);
+
+        analyser.getFloatFrequencyData(mixer.heapView($0, length));
+        return length;
+    }, out, bins);
+}
+
+/* Samples from -1 to 1, up to the FFT size. Returns the samples written. */
+int MusicNodes_GetWaveform(float *out, int samples)
+{
+    if (nodes_check() < 0)
+        return -1;
+
+    if (!out || samples <= 0)
+        return 0;
+
+    return EM_ASM_INT({
+        const mixer = Module["SDL2Mixer"];
+        const analyser = mixer.getAnalyser();
+        const length = Math.min($1, analyser.fftSize);
+
+        analyser.getFloatTimeDomainData(mixer.heapView($0, length));
+        return length;
+    }, out, samples);
+}
+
+#else
+
+/* There is no audio graph without a browser */
+static int nodes_check(void)
+{
+    Mix_SetError("Web Audio effects need the HTML5 backend");
+    return -1;
+}
+
+int MusicNodes_SetFilter(HTML5_Mix_FilterType type, float frequency, float q, float gain, int ms)
+{
+    (void)type;
+    (void)frequency;
+    (void)q;
+    (void)gain;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetPanning(Uint8 left, Uint8 right, int ms)
+{
+    (void)left;
+    (void)right;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetDirection(Sint16 angle, Uint8 distance, int ms)
+{
+    (void)angle;
+    (void)distance;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetDistance(Uint8 distance, int ms)
+{
+    (void)distance;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetCompressor(float threshold, float knee, float ratio, float attack, float release, int ms)
+{
+    (void)threshold;
+    (void)knee;
+    (void)ratio;
+    (void)attack;
+    (void)release;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_LoadReverb(const char *file)
+{
+    (void)file;
+    return nodes_check();
+}
+
+int MusicNodes_SetReverb(float wet, int ms)
+{
+    (void)wet;
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetDucking(float volume, int attack_ms, int release_ms)
+{
+    (void)volume;
+    (void)attack_ms;
+    (void)release_ms;
+    return nodes_check();
+}
+
+int MusicNodes_Duck(int trigger)
+{
+    (void)trigger;
+    return nodes_check();
+}
+
+int MusicNodes_Unduck(int trigger)
+{
+    (void)trigger;
+    return nodes_check();
+}
+
+int MusicNodes_DuckFor(int ms)
+{
+    (void)ms;
+    return nodes_check();
+}
+
+int MusicNodes_SetAnalyser(int fft_size, float smoothing)
+{
+    (void)fft_size;
+    (void)smoothing;
+    return nodes_check();
+}
+
+int MusicNodes_GetSpectrum(float *out, int bins)
+{
+    (void)out;
+    (void)bins;
+    return nodes_check();
+}
+
+int MusicNodes_GetWaveform(float *out, int samples)
+{
+    (void)out;
+    (void)samples;
+    return nodes_check();
+}
+
+#endif /* MUSIC_HTML5 */
+
+/* vi: set ts=4 sw=4 expandtab: */
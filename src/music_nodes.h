@@ -0,0 +1,62 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports native Web Audio effects and analysis on music */
+
+#ifndef MUSIC_NODES_H_
+#define MUSIC_NODES_H_
+
+#include "prerequisites.h"
+
+/* BiquadFilterNode types */
+typedef enum
+{
+    HTML5_MIX_FILTER_NONE,
+    HTML5_MIX_FILTER_LOWPASS,
+    HTML5_MIX_FILTER_HIGHPASS,
+    HTML5_MIX_FILTER_BANDPASS,
+    HTML5_MIX_FILTER_LOWSHELF,
+    HTML5_MIX_FILTER_HIGHSHELF,
+    HTML5_MIX_FILTER_PEAKING,
+    HTML5_MIX_FILTER_NOTCH,
+    HTML5_MIX_FILTER_ALLPASS
+} HTML5_Mix_FilterType;
+
+extern int MusicNodes_SetFilter(HTML5_Mix_FilterType type, float frequency, float q, float gain, int ms);
+extern int MusicNodes_SetPanning(Uint8 left, Uint8 right, int ms);
+extern int MusicNodes_SetDirection(Sint16 angle, Uint8 distance, int ms);
+extern int MusicNodes_SetDistance(Uint8 distance, int ms);
+extern int MusicNodes_SetCompressor(float threshold, float knee, float ratio, float attack, float release, int ms);
+extern int MusicNodes_LoadReverb(const char *file);
+extern int MusicNodes_SetReverb(float wet, int ms);
+
+/* Ducking: music dips while a trigger is held or for a given time */
+extern int MusicNodes_SetDucking(float volume, int attack_ms, int release_ms);
+extern int MusicNodes_Duck(int trigger);
+extern int MusicNodes_Unduck(int trigger);
+extern int MusicNodes_DuckFor(int ms);
+
+/* Analysis, written straight into the caller's buffer */
+extern int MusicNodes_SetAnalyser(int fft_size, float smoothing);
+extern int MusicNodes_GetSpectrum(float *out, int bins);
+extern int MusicNodes_GetWaveform(float *out, int samples);
+
+#endif // MUSIC_NODES_H_
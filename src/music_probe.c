@@ -0,0 +1,288 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Format detection shared by the header parser and the HTML5 backend.
+// Everything is decided here, so JS only receives a Mix_MusicFormat.
+
+#include "music_probe.h"
+
+typedef struct {
+	Mix_MusicFormat format;
+	Uint8 length;
+	const char *magic;
+	const char *mask;       // NULL to compare all bytes
+} MusicSignature;
+
+// Checked in order; the first match wins.
+static const MusicSignature music_signatures[] = {
+	{ MUSIC_FORMAT_OGG,   4,  "OggS", NULL },
+	{ MUSIC_FORMAT_FLAC,  4,  "fLaC", NULL },
+	{ MUSIC_FORMAT_MP3,   3,  "ID3", NULL },
+	{ MUSIC_FORMAT_WAV,   12, "RIFF\0\0\0\0WAVE", "\xFF\xFF\xFF\xFF\0\0\0\0\xFF\xFF\xFF\xFF" },
+	{ MUSIC_FORMAT_MP4,   8,  "\0\0\0\0ftyp", "\0\0\0\0\xFF\xFF\xFF\xFF" },
+	{ MUSIC_FORMAT_AIFF,  12, "FORM\0\0\0\0AIFF", "\xFF\xFF\xFF\xFF\0\0\0\0\xFF\xFF\xFF\xFF" },
+	{ MUSIC_FORMAT_AIFF,  12, "FORM\0\0\0\0AIFC", "\xFF\xFF\xFF\xFF\0\0\0\0\xFF\xFF\xFF\xFF" },
+	{ MUSIC_FORMAT_WEBM,  4,  "\x1A\x45\xDF\xA3", NULL },
+	{ MUSIC_FORMAT_CAF,   4,  "caff", NULL },
+	{ MUSIC_FORMAT_XM,    17, "Extended Module: ", NULL },
+	{ MUSIC_FORMAT_IT,    4,  "IMPM", NULL },
+	{ MUSIC_FORMAT_MIDI,  4,  "MThd", NULL },
+	{ MUSIC_FORMAT_MIDI,  12, "RIFF\0\0\0\0RMID", "\xFF\xFF\xFF\xFF\0\0\0\0\xFF\xFF\xFF\xFF" },
+	{ MUSIC_FORMAT_MP3,   2,  "\xFF\xE2", "\xFF\xE6" },     // MPEG Layer III frame sync
+	{ MUSIC_FORMAT_AAC,   2,  "\xFF\xF0", "\xFF\xF6" }      // ADTS frame sync
+};
+
+typedef struct {
+	const char *extension;
+	Mix_MusicFormat format;
+} MusicExtension;
+
+static const MusicExtension music_extensions[] = {
+	{ "ogg",  MUSIC_FORMAT_OGG },
+	{ "oga",  MUSIC_FORMAT_OGG },
+	{ "opus", MUSIC_FORMAT_OPUS },
+	{ "flac", MUSIC_FORMAT_FLAC },
+	{ "mp3",  MUSIC_FORMAT_MP3 },
+	{ "wav",  MUSIC_FORMAT_WAV },
+	{ "wave", MUSIC_FORMAT_WAV },
+	{ "mp4",  MUSIC_FORMAT_MP4 },
+	{ "m4a",  MUSIC_FORMAT_MP4 },
+	{ "aif",  MUSIC_FORMAT_AIFF },
+	{ "aiff", MUSIC_FORMAT_AIFF },
+	{ "aifc", MUSIC_FORMAT_AIFF },
+	{ "webm", MUSIC_FORMAT_WEBM },
+	{ "weba", MUSIC_FORMAT_WEBM },
+	{ "mka",  MUSIC_FORMAT_MATROSKA },
+	{ "mkv",  MUSIC_FORMAT_MATROSKA },
+	{ "aac",  MUSIC_FORMAT_AAC },
+	{ "adts", MUSIC_FORMAT_AAC },
+	{ "caf",  MUSIC_FORMAT_CAF },
+	{ "mod",  MUSIC_FORMAT_MOD },
+	{ "s3m",  MUSIC_FORMAT_S3M },
+	{ "xm",   MUSIC_FORMAT_XM },
+	{ "it",   MUSIC_FORMAT_IT },
+	{ "mid",  MUSIC_FORMAT_MIDI },
+	{ "midi", MUSIC_FORMAT_MIDI },
+	{ "rmi",  MUSIC_FORMAT_MIDI }
+};
+
+// Indexed by Mix_MusicFormat
+static const char *music_format_names[MUSIC_FORMAT_LAST][2] = {
+	{ "",         "" },
+	{ "OGG",      "ogg" },
+	{ "FLAC",     "flac" },
+	{ "MP3",      "mp3" },
+	{ "WAVE",     "wav" },
+	{ "MP4",      "m4a" },
+	{ "AIFF",     "aiff" },
+	{ "WEBM",     "webm" },
+	{ "OPUS",     "opus" },
+	{ "MATROSKA", "mka" },
+	{ "AAC",      "aac" },
+	{ "CAF",      "caf" },
+	{ "MOD",      "mod" },
+	{ "S3M",      "s3m" },
+	{ "XM",       "xm" },
+	{ "IT",       "it" },
+	{ "MIDI",     "mid" }
+};
+
+#define MUSIC_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+static SDL_bool music_probe_signature(const MusicSignature *signature, const Uint8 *buf, size_t size)
+{
+	size_t i;
+
+	if (size < signature->length)
+		return SDL_FALSE;
+
+	for (i = 0; i < signature->length; ++i)
+	{
+		Uint8 mask = signature->mask ? (Uint8)signature->mask[i] : 0xFF;
+		if ((buf[i] & mask) != (Uint8)signature->magic[i])
+			return SDL_FALSE;
+	}
+
+	return SDL_TRUE;
+}
+
+// ProTracker and compatible modules have no magic, only a tag naming
+// the channel count after the sample and order tables.
+static SDL_bool music_probe_mod_tag(const Uint8 *tag)
+{
+	static const char *tags[] = { "M.K.", "M!K!", "M&K!", "FLT4", "FLT8", "OCTA", "CD81" };
+	size_t i;
+
+	for (i = 0; i < MUSIC_ARRAY_SIZE(tags); ++i)
+		if (SDL_memcmp(tag, tags[i], 4) == 0)
+			return SDL_TRUE;
+
+	// "xCHN", "xxCH" and "xxCN"
+	if (tag[0] >= '1' && tag[0] <= '9' && SDL_memcmp(tag + 1, "CHN", 3) == 0)
+		return SDL_TRUE;
+	return (tag[0] >= '0' && tag[0] <= '9' && tag[1] >= '0' && tag[1] <= '9'
+		&& tag[2] == 'C' && (tag[3] == 'H' || tag[3] == 'N')) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_bool music_probe_contains(const Uint8 *buf, size_t size, const char *text)
+{
+	size_t len = SDL_strlen(text), i;
+
+	for (i = 0; i + len <= size; ++i)
+		if (SDL_memcmp(buf + i, text, len) == 0)
+			return SDL_TRUE;
+
+	return SDL_FALSE;
+}
+
+Mix_MusicFormat music_probe_magic(const Uint8 *buf, size_t size)
+{
+	Mix_MusicFormat format = MUSIC_FORMAT_UNKNOWN;
+	size_t window = SDL_min(size, 64);
+	size_t i;
+
+	for (i = 0; i < MUSIC_ARRAY_SIZE(music_signatures); ++i)
+	{
+		if (music_probe_signature(&music_signatures[i], buf, window)) {
+			format = music_signatures[i].format;
+			break;
+		}
+	}
+
+	// The first Ogg page holds the codec's identification header, and
+	// the EBML header holds the document type.
+	if (format == MUSIC_FORMAT_OGG && window >= 36 && SDL_memcmp(buf + 28, "OpusHead", 8) == 0)
+		format = MUSIC_FORMAT_OPUS;
+	else if (format == MUSIC_FORMAT_WEBM && music_probe_contains(buf, window, "matroska"))
+		format = MUSIC_FORMAT_MATROSKA;
+	else if (format == MUSIC_FORMAT_UNKNOWN && window >= 48 && SDL_memcmp(buf + 44, "SCRM", 4) == 0)
+		format = MUSIC_FORMAT_S3M;
+	else if (format == MUSIC_FORMAT_UNKNOWN && size >= MUSIC_PROBE_SIZE && music_probe_mod_tag(buf + 1080))
+		format = MUSIC_FORMAT_MOD;
+
+	return format;
+}
+
+Mix_MusicFormat music_probe_rw(SDL_RWops *src)
+{
+	Uint8 head[MUSIC_PROBE_SIZE];
+	Sint64 start;
+	size_t size;
+
+	if (src == NULL || (start = SDL_RWtell(src)) < 0)
+		return MUSIC_FORMAT_UNKNOWN;
+
+	size = SDL_RWread(src, head, 1, sizeof head);
+	SDL_RWseek(src, start, RW_SEEK_SET);
+
+	return music_probe_magic(head, size);
+}
+
+Mix_MusicFormat music_probe_extension(const char *file)
+{
+	const char *extension = NULL;
+	size_t len, i, j;
+
+	if (file == NULL)
+		return MUSIC_FORMAT_UNKNOWN;
+
+	// Last '.' of the last path component, ignoring a URL query or fragment
+	for (len = 0; file[len] && file[len] != '?' && file[len] != '#'; ++len)
+	{
+		if (file[len] == '.')
+			extension = file + len + 1;
+		else if (file[len] == '/' || file[len] == '\\')
+			extension = NULL;
+	}
+
+	if (extension == NULL)
+		return MUSIC_FORMAT_UNKNOWN;
+
+	len = (size_t)(file + len - extension);
+
+	for (i = 0; i < MUSIC_ARRAY_SIZE(music_extensions); ++i)
+	{
+		const char *name = music_extensions[i].extension;
+
+		for (j = 0; j < len; ++j)
+		{
+			char c = extension[j];
+			if (c >= 'A' && c <= 'Z')
+				c = (char)(c - 'A' + 'a');
+			if (c != name[j])
+				break;
+		}
+
+		if (j == len && name[len] == '\0')
+			return music_extensions[i].format;
+	}
+
+	return MUSIC_FORMAT_UNKNOWN;
+}
+
+const char *music_probe_name(Mix_MusicFormat format)
+{
+	if (format < MUSIC_FORMAT_UNKNOWN || format >= MUSIC_FORMAT_LAST)
+		format = MUSIC_FORMAT_UNKNOWN;
+
+	return music_format_names[format][0];
+}
+
+const char *music_probe_extension_name(Mix_MusicFormat format)
+{
+	if (format < MUSIC_FORMAT_UNKNOWN || format >= MUSIC_FORMAT_LAST)
+		format = MUSIC_FORMAT_UNKNOWN;
+
+	return music_format_names[format][1];
+}
+
+Mix_MusicType music_probe_type(Mix_MusicFormat format)
+{
+	switch (format)
+	{
+	case MUSIC_FORMAT_OGG:
+		return MUS_OGG;
+	case MUSIC_FORMAT_OPUS:
+		return MUS_OPUS;
+	case MUSIC_FORMAT_FLAC:
+		return MUS_FLAC;
+	case MUSIC_FORMAT_MP3:
+		return MUS_MP3;
+	case MUSIC_FORMAT_WAV:
+	case MUSIC_FORMAT_AIFF:
+		return MUS_WAV;
+	case MUSIC_FORMAT_MOD:
+	case MUSIC_FORMAT_S3M:
+	case MUSIC_FORMAT_XM:
+	case MUSIC_FORMAT_IT:
+		return MUS_MOD;
+	case MUSIC_FORMAT_MIDI:
+		return MUS_MID;
+	case MUSIC_FORMAT_UNKNOWN:
+	case MUSIC_FORMAT_LAST:
+		return MUS_NONE;
+	default:
+		// No SDL_mixer decoder; only the browser plays these
+		return MUS_HTML5;
+	}
+}
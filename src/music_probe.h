@@ -0,0 +1,75 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef HTML5_MUSIC_PROBE_H_
+#define HTML5_MUSIC_PROBE_H_
+
+#include "prerequisites.h"
+
+/* Containers recognized from their leading bytes or file extension.
+   The order matches the MIME type table in music_html5.c.
+ */
+typedef enum
+{
+	MUSIC_FORMAT_UNKNOWN,
+	MUSIC_FORMAT_OGG,
+	MUSIC_FORMAT_FLAC,
+	MUSIC_FORMAT_MP3,
+	MUSIC_FORMAT_WAV,
+	MUSIC_FORMAT_MP4,
+	MUSIC_FORMAT_AIFF,
+	MUSIC_FORMAT_WEBM,
+	MUSIC_FORMAT_OPUS,
+	MUSIC_FORMAT_MATROSKA,
+	MUSIC_FORMAT_AAC,
+	MUSIC_FORMAT_CAF,
+	MUSIC_FORMAT_MOD,
+	MUSIC_FORMAT_S3M,
+	MUSIC_FORMAT_XM,
+	MUSIC_FORMAT_IT,
+	MUSIC_FORMAT_MIDI,
+	MUSIC_FORMAT_LAST
+} Mix_MusicFormat;
+
+/* Bytes needed by music_probe_magic(). Signatures fit in the first 64
+   bytes, except the tag of ProTracker modules at offset 1080. */
+#define MUSIC_PROBE_SIZE 1084
+
+/* Detect the container from the first bytes of a file */
+extern Mix_MusicFormat music_probe_magic(const Uint8 *buf, size_t size);
+
+/* Detect the container of a stream, leaving its position unchanged */
+extern Mix_MusicFormat music_probe_rw(SDL_RWops *src);
+
+/* Detect the container from a file name or URL */
+extern Mix_MusicFormat music_probe_extension(const char *file);
+
+/* Decoder name, as reported by HTML5_Mix_GetMusicDecoder(), e.g. "OGG" */
+extern const char *music_probe_name(Mix_MusicFormat format);
+
+/* Usual file extension, without the dot, e.g. "m4a" */
+extern const char *music_probe_extension_name(Mix_MusicFormat format);
+
+/* The SDL_mixer music type for a container */
+extern Mix_MusicType music_probe_type(Mix_MusicFormat format);
+
+#endif // HTML5_MUSIC_PROBE_H_
@@ -0,0 +1,380 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file hands music the native interface can't decode to SDL_mixer,
+   which plays it on its own audio device. SDL_mixer's header comes first,
+   so its types stand in for the ones prerequisites.h would declare. Its
+   music is held as an opaque pointer. */
+
+#if defined(HTML5_MIXER_NATIVE) && defined(HTML5_MIXER_NATIVE_SDL_MIXER)
+#include <SDL_mixer.h>
+#endif
+
+#include "music_sdl_mixer.h"
+
+#ifdef MUSIC_SDL_MIXER
+
+typedef struct {
+    Mix_Music *music;           /* SDL_mixer's own */
+    SDL_RWops *src;             /* Closed with the music, if ours to close */
+    int volume;
+    double start;               /* Where the next play starts, in seconds */
+} MusicSDLMixer;
+
+static MusicSDLMixer *mixer_music = NULL;   /* Playing, until polled as ended */
+static SDL_bool mixer_opened = SDL_FALSE;   /* We opened SDL_mixer's device */
+
+SDL_bool MusicSDLMixer_HasFormat(Mix_MusicFormat format)
+{
+    int flag;
+
+    switch (format)
+    {
+    case MUSIC_FORMAT_WAV:
+    case MUSIC_FORMAT_AIFF:
+        return SDL_TRUE;
+    case MUSIC_FORMAT_OGG:
+        flag = MIX_INIT_OGG;
+        break;
+    case MUSIC_FORMAT_OPUS:
+        flag = MIX_INIT_OPUS;
+        break;
+    case MUSIC_FORMAT_FLAC:
+        flag = MIX_INIT_FLAC;
+        break;
+    case MUSIC_FORMAT_MP3:
+        flag = MIX_INIT_MP3;
+        break;
+    case MUSIC_FORMAT_MOD:
+    case MUSIC_FORMAT_S3M:
+    case MUSIC_FORMAT_XM:
+    case MUSIC_FORMAT_IT:
+        flag = MIX_INIT_MOD;
+        break;
+    case MUSIC_FORMAT_MIDI:
+        flag = MIX_INIT_MID;
+        break;
+    default:
+        return SDL_FALSE;
+    }
+
+    return (Mix_Init(flag) & flag) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Share the device of an application that opened SDL_mixer itself */
+static int MusicSDLMixer_Open(const SDL_AudioSpec *spec)
+{
+    (void)spec;
+
+    if (Mix_QuerySpec(NULL, NULL, NULL))
+        return 0;
+
+    if (Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, 2048) < 0)
+        return -1;
+
+    mixer_opened = SDL_TRUE;
+    return 0;
+}
+
+static void *mixer_wrap(Mix_Music *music, SDL_RWops *src)
+{
+    MusicSDLMixer *context;
+
+    if (music == NULL)
+        return NULL;
+
+    context = (MusicSDLMixer *)SDL_calloc(1, sizeof *context);
+    if (context == NULL) {
+        Mix_FreeMusic(music);
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+
+    context->music = music;
+    context->src = src;
+    context->volume = MIX_MAX_VOLUME;
+    return context;
+}
+
+/* SDL_mixer streams from 'src' while playing, so it stays open until
+   Delete(). On failure, the caller closes it. */
+static void *MusicSDLMixer_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    return mixer_wrap(Mix_LoadMUS_RW(src, 0), freesrc ? src : NULL);
+}
+
+static void *MusicSDLMixer_CreateFromFile(const char *file)
+{
+    return mixer_wrap(Mix_LoadMUS(file), NULL);
+}
+
+static void MusicSDLMixer_SetVolume(void *context, int volume)
+{
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+
+    music->volume = SDL_max(0, SDL_min(volume, MIX_MAX_VOLUME));
+    if (mixer_music == music)
+        Mix_VolumeMusic(music->volume);
+}
+
+static void MusicSDLMixer_Stop(void *context);
+
+/* Start playback, play_count times over or forever if -1 */
+static int MusicSDLMixer_Play(void *context, int play_count)
+{
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+    int result;
+
+    if (play_count <= 0 && play_count != -1)
+    {
+        // As the HTML5 interface: do not play, and do not fail
+        MusicSDLMixer_Stop(context);
+        return 0;
+    }
+
+    // SDL_mixer counts plays the same way
+    Mix_VolumeMusic(music->volume);
+    if (music->start > 0.0)
+        result = Mix_FadeInMusicPos(music->music, play_count, 0, music->start);
+    else
+        result = Mix_PlayMusic(music->music, play_count);
+
+    music->start = 0.0;
+    mixer_music = (result == 0) ? music : NULL;
+    return result;
+}
+
+/* SDL_mixer ends music on its audio thread. The end is noticed here, on
+   the application's, at its next call into the mixer, so the finished
+   hook runs in step with the rest of it, as with the native interface. */
+static SDL_bool MusicSDLMixer_IsPlaying(void *context)
+{
+    if (mixer_music != context)
+        return SDL_FALSE;
+
+    // Paused music counts as playing, as in SDL_mixer
+    if (Mix_PlayingMusic())
+        return SDL_TRUE;
+
+    mixer_music = NULL;
+    run_music_finished_hook();
+    return SDL_FALSE;
+}
+
+/* Jump to a position in seconds. Music that isn't playing starts there. */
+static int MusicSDLMixer_Seek(void *context, double position)
+{
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+
+    if (mixer_music == music)
+        return Mix_SetMusicPosition(position);
+
+    music->start = position;
+    return 0;
+}
+
+/* Getters added in SDL_mixer 2.6; earlier versions report nothing */
+static double MusicSDLMixer_Tell(void *context)
+{
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+
+    if (mixer_music != music)
+        return music->start;
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    return Mix_GetMusicPosition(music->music);
+#else
+    return -1.0;
+#endif
+}
+
+static double MusicSDLMixer_Duration(void *context)
+{
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    return Mix_MusicDuration(((MusicSDLMixer *)context)->music);
+#else
+    (void)context;
+    return -1.0;
+#endif
+}
+
+static int MusicSDLMixer_SetSpeed(void *context, double rate, SDL_bool preserve_pitch)
+{
+    (void)context;
+    (void)preserve_pitch;
+
+    if (rate == 1.0)
+        return 0;
+
+    Mix_SetError("SDL_mixer music plays at its own rate");
+    return -1;
+}
+
+static int MusicSDLMixer_SetLoopPoints(void *context, double start, double end)
+{
+    (void)context;
+    (void)start;
+    (void)end;
+
+    Mix_SetError("SDL_mixer music loops only where its tags say");
+    return -1;
+}
+
+static double MusicSDLMixer_LoopStart(void *context)
+{
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    return Mix_GetMusicLoopStartTime(((MusicSDLMixer *)context)->music);
+#else
+    (void)context;
+    return -1.0;
+#endif
+}
+
+static double MusicSDLMixer_LoopEnd(void *context)
+{
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    return Mix_GetMusicLoopEndTime(((MusicSDLMixer *)context)->music);
+#else
+    (void)context;
+    return -1.0;
+#endif
+}
+
+static double MusicSDLMixer_LoopLength(void *context)
+{
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    return Mix_GetMusicLoopLengthTime(((MusicSDLMixer *)context)->music);
+#else
+    (void)context;
+    return -1.0;
+#endif
+}
+
+static const char *MusicSDLMixer_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
+{
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+
+    switch (tag_type)
+    {
+    case MIX_META_TITLE:
+        return Mix_GetMusicTitleTag(music->music);
+    case MIX_META_ARTIST:
+        return Mix_GetMusicArtistTag(music->music);
+    case MIX_META_ALBUM:
+        return Mix_GetMusicAlbumTag(music->music);
+    case MIX_META_COPYRIGHT:
+        return Mix_GetMusicCopyrightTag(music->music);
+    default:
+        return "";
+    }
+#else
+    (void)context;
+    (void)tag_type;
+    return "";
+#endif
+}
+
+static Mix_MusicType MusicSDLMixer_GetType(void *context)
+{
+    return Mix_GetMusicType(((MusicSDLMixer *)context)->music);
+}
+
+static void MusicSDLMixer_Pause(void *context)
+{
+    if (mixer_music == context)
+        Mix_PauseMusic();
+}
+
+static void MusicSDLMixer_Resume(void *context)
+{
+    if (mixer_music == context)
+        Mix_ResumeMusic();
+}
+
+static void MusicSDLMixer_Stop(void *context)
+{
+    if (mixer_music != context)
+        return;
+
+    mixer_music = NULL;
+    Mix_HaltMusic();
+}
+
+static void MusicSDLMixer_Delete(void *context)
+{
+    MusicSDLMixer *music = (MusicSDLMixer *)context;
+
+    MusicSDLMixer_Stop(context);
+
+    Mix_FreeMusic(music->music);
+    if (music->src)
+        SDL_RWclose(music->src);
+    SDL_free(music);
+}
+
+static void MusicSDLMixer_Close(void)
+{
+    if (mixer_music)
+        MusicSDLMixer_Stop(mixer_music);
+
+    if (mixer_opened)
+        Mix_CloseAudio();
+    mixer_opened = SDL_FALSE;
+}
+
+Mix_MusicInterface Mix_MusicInterface_SDL_MIXER =
+{
+    "SDL_MIXER",
+    MIX_MUSIC_SDL_MIXER,
+    MUS_NONE,
+    SDL_FALSE,
+    SDL_FALSE,
+
+    NULL,   /* Load */
+    MusicSDLMixer_Open,
+    MusicSDLMixer_CreateFromRW,
+    MusicSDLMixer_CreateFromFile,
+    MusicSDLMixer_SetVolume,
+    MusicSDLMixer_Play,
+    NULL,   /* Prefetch */
+    MusicSDLMixer_IsPlaying,
+    NULL,   /* GetAudio */
+    MusicSDLMixer_Seek,
+    MusicSDLMixer_Tell,
+    MusicSDLMixer_Duration,
+    MusicSDLMixer_SetSpeed,
+    MusicSDLMixer_SetLoopPoints,
+    MusicSDLMixer_LoopStart,
+    MusicSDLMixer_LoopEnd,
+    MusicSDLMixer_LoopLength,
+    MusicSDLMixer_GetMetaTag,
+    MusicSDLMixer_GetType,
+    MusicSDLMixer_Pause,
+    MusicSDLMixer_Resume,
+    MusicSDLMixer_Stop,
+    MusicSDLMixer_Delete,
+    MusicSDLMixer_Close,
+    NULL,   /* Unload */
+};
+
+#endif /* MUSIC_SDL_MIXER */
+
+/* vi: set ts=4 sw=4 expandtab: */
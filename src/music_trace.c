@@ -0,0 +1,345 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Records HTML5_Mix_*() calls into memory, in the format described in
+// music_trace.h, for tools/trace_replay.c.
+
+#include "../include/html5_mixer.h"
+#include "music_trace.h"
+
+#ifdef HTML5_MIXER_TRACE
+
+#include <stdarg.h>
+
+#define MUSIC_TRACE_SIGNATURE(name, signature, replay) signature,
+
+static const char *const music_trace_signatures[] = {
+	"",     // MUSIC_TRACE_HANDLE
+	MUSIC_TRACE_CALLS(MUSIC_TRACE_SIGNATURE)
+};
+
+static SDL_bool trace_recording = SDL_FALSE;
+static int trace_depth = 0;
+static double trace_time = 0.0;
+
+static Uint8 *trace_data = NULL;
+static size_t trace_size = 0;
+static size_t trace_capacity = 0;
+
+// Live handles; a handle's number is its index + 1. Freed ones are NULL.
+static const void **trace_handles = NULL;
+static int trace_num_handles = 0;
+static int trace_handles_capacity = 0;
+
+static void trace_write(const void *data, size_t size)
+{
+	if (trace_size + size > trace_capacity)
+	{
+		size_t capacity = trace_capacity ? trace_capacity * 2 : 64 * 1024;
+		Uint8 *grown;
+
+		while (capacity < trace_size + size)
+			capacity *= 2;
+		grown = (Uint8 *)SDL_realloc(trace_data, capacity);
+		if (grown == NULL) {
+			// Better a short trace than a crash
+			trace_recording = SDL_FALSE;
+			return;
+		}
+		trace_data = grown;
+		trace_capacity = capacity;
+	}
+
+	SDL_memcpy(trace_data + trace_size, data, size);
+	trace_size += size;
+}
+
+static void trace_varint(Uint64 value)
+{
+	Uint8 bytes[10];
+	size_t n = 0;
+
+	do {
+		bytes[n] = value & 0x7F;
+		value >>= 7;
+		if (value)
+			bytes[n] |= 0x80;
+		++n;
+	} while (value);
+
+	trace_write(bytes, n);
+}
+
+static void trace_int(int value)
+{
+	trace_varint(((Uint32)value << 1) ^ (Uint32)(value >> 31));
+}
+
+static void trace_string(const char *value)
+{
+	if (value == NULL) {
+		trace_varint(0);
+		return;
+	}
+
+	trace_varint(SDL_strlen(value) + 1);
+	trace_write(value, SDL_strlen(value));
+}
+
+static int trace_find_handle(const void *handle)
+{
+	int i;
+
+	if (handle == NULL)
+		return 0;
+
+	// Newest first: recent music is the likeliest to be used
+	for (i = trace_num_handles - 1; i >= 0; --i)
+		if (trace_handles[i] == handle)
+			return i + 1;
+
+	return -1;
+}
+
+static int trace_add_handle(const void *handle)
+{
+	if (trace_num_handles == trace_handles_capacity)
+	{
+		int capacity = trace_handles_capacity ? trace_handles_capacity * 2 : 64;
+		const void **handles = (const void **)SDL_realloc(trace_handles, capacity * sizeof *handles);
+
+		if (handles == NULL)
+			return 0;
+		trace_handles = handles;
+		trace_handles_capacity = capacity;
+	}
+
+	trace_handles[trace_num_handles++] = handle;
+	return trace_num_handles;
+}
+
+// Handles made before recording started get numbers too, though replay
+// can't know them
+static void trace_handle(const void *handle, SDL_bool freed)
+{
+	int index = trace_find_handle(handle);
+
+	if (index < 0)
+		index = trace_add_handle(handle);
+
+	trace_varint(index);
+
+	// A later allocation may reuse the address
+	if (freed && index > 0)
+		trace_handles[index - 1] = NULL;
+}
+
+static void trace_rw(SDL_RWops *src)
+{
+	Sint64 start, size;
+	Uint8 buffer[4096];
+	size_t n;
+
+	if (src == NULL) {
+		trace_varint(0);
+		return;
+	}
+
+	start = SDL_RWtell(src);
+	size = SDL_RWsize(src) - start;
+	if (start < 0 || size < 0)
+		size = 0;
+
+	trace_varint((Uint64)size);
+	while (size > 0 && (n = SDL_RWread(src, buffer, 1, (size_t)SDL_min((Sint64)sizeof buffer, size))) > 0) {
+		trace_write(buffer, n);
+		size -= n;
+	}
+
+	// Keep the length honest if the stream ended early
+	SDL_memset(buffer, 0, sizeof buffer);
+	while (size > 0) {
+		n = (size_t)SDL_min((Sint64)sizeof buffer, size);
+		trace_write(buffer, n);
+		size -= n;
+	}
+
+	SDL_RWseek(src, start, RW_SEEK_SET);
+}
+
+static void trace_record(MusicTraceCall call)
+{
+	double now = music_trace_now();
+	double delta = (now - trace_time) * 1000.0;
+
+	trace_time = now;
+	trace_varint(call);
+	trace_varint(delta > 0.0 ? (Uint64)delta : 0);
+}
+
+int music_trace_enter(MusicTraceCall call, ...)
+{
+	const char *signature;
+	va_list args;
+
+	if (trace_depth++ > 0 || !trace_recording)
+		return 0;
+
+	trace_record(call);
+
+	va_start(args, call);
+	for (signature = music_trace_signatures[call]; *signature; ++signature)
+	{
+		switch (*signature)
+		{
+		case 'i':
+			trace_int(va_arg(args, int));
+			break;
+		case 'l': {
+			Sint64 value = va_arg(args, Sint64);
+			trace_varint(((Uint64)value << 1) ^ (Uint64)(value >> 63));
+			break;
+		}
+		case 'u':
+			trace_varint(va_arg(args, size_t));
+			break;
+		case 'f': {
+			float value = (float)va_arg(args, double);
+			trace_write(&value, sizeof value);
+			break;
+		}
+		case 'd': {
+			double value = va_arg(args, double);
+			trace_write(&value, sizeof value);
+			break;
+		}
+		case 's':
+			trace_string(va_arg(args, const char *));
+			break;
+		case 'H':
+			trace_handle(va_arg(args, const void *), SDL_FALSE);
+			break;
+		case 'F':
+			trace_handle(va_arg(args, const void *), SDL_TRUE);
+			break;
+		case 'R':
+			trace_rw(va_arg(args, SDL_RWops *));
+			break;
+		case 'A': {
+			Mix_Music **stems = va_arg(args, Mix_Music **);
+			int i, count = va_arg(args, int);
+
+			if (stems == NULL || count < 0)
+				count = 0;
+			trace_varint(count);
+			for (i = 0; i < count; ++i)
+				trace_handle(stems[i], SDL_FALSE);
+			break;
+		}
+		case 'S': {
+			const HTML5_Mix_SpriteRegion *regions = va_arg(args, const HTML5_Mix_SpriteRegion *);
+			int i, count = va_arg(args, int);
+
+			if (regions == NULL || count < 0)
+				count = 0;
+			trace_varint(count);
+			for (i = 0; i < count; ++i) {
+				trace_string(regions[i].name);
+				trace_write(&regions[i].start, sizeof regions[i].start);
+				trace_write(&regions[i].end, sizeof regions[i].end);
+			}
+			break;
+		}
+		}
+	}
+	va_end(args);
+
+	return 0;
+}
+
+void music_trace_leave(int *scope)
+{
+	(void)scope;
+	--trace_depth;
+}
+
+void music_trace_created(const void *handle)
+{
+	if (!trace_recording || handle == NULL)
+		return;
+
+	trace_record(MUSIC_TRACE_HANDLE);
+	trace_varint(trace_add_handle(handle));
+}
+
+int music_trace_start(void)
+{
+	Uint8 version = MUSIC_TRACE_VERSION;
+
+	trace_size = 0;
+	trace_num_handles = 0;
+	trace_time = music_trace_now();
+
+	trace_write(MUSIC_TRACE_MAGIC, 4);
+	trace_write(&version, 1);
+	if (trace_size == 0) {
+		Mix_SetError("Out of memory");
+		return -1;
+	}
+
+	trace_recording = SDL_TRUE;
+	return 0;
+}
+
+int music_trace_stop(const char *file)
+{
+	SDL_RWops *dst;
+	size_t written;
+
+	trace_recording = SDL_FALSE;
+
+	if (file == NULL)
+		return 0;
+
+	dst = SDL_RWFromFile(file, "wb");
+	if (dst == NULL)
+		return -1;
+
+	written = SDL_RWwrite(dst, trace_data, 1, trace_size);
+	SDL_RWclose(dst);
+
+	if (written != trace_size) {
+		Mix_SetError("Couldn't write %s", file);
+		return -1;
+	}
+	return 0;
+}
+
+const void *music_trace_data(size_t *size)
+{
+	if (size)
+		*size = trace_size;
+	return trace_data;
+}
+
+#endif // HTML5_MIXER_TRACE
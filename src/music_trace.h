@@ -0,0 +1,194 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef HTML5_MUSIC_TRACE_H_
+#define HTML5_MUSIC_TRACE_H_
+
+#include "prerequisites.h"
+
+/* Recording of HTML5_Mix_*() calls, built with HTML5_MIXER_TRACE, and
+   replayed by tools/trace_replay.c.
+
+   A trace is MUSIC_TRACE_MAGIC, a version byte, then records. Each
+   record is a call id and the microseconds since the previous record,
+   then the call's arguments by its signature:
+     i  int, zigzag varint           u  size_t, varint
+     l  Sint64, zigzag varint
+     f  float, 4 bytes               d  double, 8 bytes
+     s  string: length + 1 and bytes, or 0 for NULL
+     H  music or stem group handle   F  handle, freed by the call
+     R  SDL_RWops: length and the bytes from its position
+     A  array of music handles: count and handles
+     S  sprite regions: count, then name, start and end of each
+   Varints are LEB128, numbers little endian. Handles are numbered from
+   1 in order of creation; 0 is NULL. A MUSIC_TRACE_HANDLE record names
+   what the call before it created.
+
+   Callbacks and output buffers aren't recorded; replay passes NULL and
+   scratch buffers.
+ */
+#define MUSIC_TRACE_MAGIC "H5MT"
+#define MUSIC_TRACE_VERSION 1
+
+/* Milliseconds on a monotonic clock, for recording and replay alike */
+#ifdef HTML5_MIXER_NATIVE
+#define music_trace_now() (SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency())
+#else
+#include <emscripten.h>
+#define music_trace_now() emscripten_get_now()
+#endif
+
+/* X(name, signature, replay): 'replay' is the call made by the replay
+   tool, using its argument accessors */
+#define MUSIC_TRACE_CALLS(X) \
+	X(Init, "i", HTML5_Mix_Init(I(0))) \
+	X(Quit, "", HTML5_Mix_Quit()) \
+	X(LoadMUS, "s", RET(HTML5_Mix_LoadMUS(S(0)))) \
+	X(LoadMUS_RW, "Ri", RET(HTML5_Mix_LoadMUS_RW(RW(0), I(1)))) \
+	X(LoadMUSType_RW, "Rii", RET(HTML5_Mix_LoadMUSType_RW(RW(0), (Mix_MusicType)I(1), I(2)))) \
+	X(LoadMUSBest, "s", RET(HTML5_Mix_LoadMUSBest(S(0)))) \
+	X(LoadMUSDecoded, "s", RET(HTML5_Mix_LoadMUSDecoded(S(0)))) \
+	X(LoadMUSDecoded_RW, "Ri", RET(HTML5_Mix_LoadMUSDecoded_RW(RW(0), I(1)))) \
+	X(SetDecodedMusicBudget, "u", HTML5_Mix_SetDecodedMusicBudget(U(0))) \
+	X(GetDecodedMusicBytes, "", HTML5_Mix_GetDecodedMusicBytes()) \
+	X(SetSuspendWhenHidden, "i", HTML5_Mix_SetSuspendWhenHidden(I(0))) \
+	X(FreeMusic, "F", HTML5_Mix_FreeMusic(M(0))) \
+	X(HookMusicFinished, "", HTML5_Mix_HookMusicFinished(NULL)) \
+	X(FadeInMusicPos, "Hiid", HTML5_Mix_FadeInMusicPos(M(0), I(1), I(2), D(3))) \
+	X(FadeInMusic, "Hii", HTML5_Mix_FadeInMusic(M(0), I(1), I(2))) \
+	X(PlayMusic, "Hi", HTML5_Mix_PlayMusic(M(0), I(1))) \
+	X(PlayMusicTicket, "Hi", HTML5_Mix_PlayMusicTicket(M(0), I(1))) \
+	X(GetPlayResult, "i", HTML5_Mix_GetPlayResult(I(0))) \
+	X(IsAudioUnlocked, "", HTML5_Mix_IsAudioUnlocked()) \
+	X(UnlockAudio, "", HTML5_Mix_UnlockAudio()) \
+	X(PlayMusicAwait, "Hi", HTML5_Mix_PlayMusicTicket(M(0), I(1))) \
+	X(PlayingMusic, "", HTML5_Mix_PlayingMusic()) \
+	X(VolumeMusic, "i", HTML5_Mix_VolumeMusic(I(0))) \
+	X(HaltMusic, "", HTML5_Mix_HaltMusic()) \
+	X(PauseMusic, "", HTML5_Mix_PauseMusic()) \
+	X(ResumeMusic, "", HTML5_Mix_ResumeMusic()) \
+	X(PausedMusic, "", HTML5_Mix_PausedMusic()) \
+	X(SetMusicPosition, "d", HTML5_Mix_SetMusicPosition(D(0))) \
+	X(GetMusicPosition, "H", HTML5_Mix_GetMusicPosition(M(0))) \
+	X(SetMusicSpeed, "Hdi", HTML5_Mix_SetMusicSpeed(M(0), D(1), I(2))) \
+	X(CreateStemGroup, "A", RET(HTML5_Mix_CreateStemGroup(A(0), N(0)))) \
+	X(FreeStemGroup, "F", HTML5_Mix_FreeStemGroup(G(0))) \
+	X(PlayStemGroup, "Hi", HTML5_Mix_PlayStemGroup(G(0), I(1))) \
+	X(HaltStemGroup, "H", HTML5_Mix_HaltStemGroup(G(0))) \
+	X(PauseStemGroup, "H", HTML5_Mix_PauseStemGroup(G(0))) \
+	X(ResumeStemGroup, "H", HTML5_Mix_ResumeStemGroup(G(0))) \
+	X(PlayingStemGroup, "H", HTML5_Mix_PlayingStemGroup(G(0))) \
+	X(VolumeStem, "Hiii", HTML5_Mix_VolumeStem(G(0), I(1), I(2), I(3))) \
+	X(SetSpriteRegions, "HS", HTML5_Mix_SetSpriteRegions(M(0), SR(1), N(1))) \
+	X(PlaySprite, "Hs", HTML5_Mix_PlaySprite(M(0), S(1))) \
+	X(HaltSprite, "i", HTML5_Mix_HaltSprite(I(0))) \
+	X(VolumeSprites, "i", HTML5_Mix_VolumeSprites(I(0))) \
+	X(QueueMusic, "Hi", HTML5_Mix_QueueMusic(M(0), I(1))) \
+	X(ClearQueue, "", HTML5_Mix_ClearQueue()) \
+	X(GetQueueLength, "", HTML5_Mix_GetQueueLength()) \
+	X(SetQueueMode, "i", HTML5_Mix_SetQueueMode(I(0))) \
+	X(SkipMusic, "", HTML5_Mix_SkipMusic()) \
+	X(SetMusicLoopPoints, "Hdd", HTML5_Mix_SetMusicLoopPoints(M(0), D(1), D(2))) \
+	X(GetMusicLoopStartTime, "H", HTML5_Mix_GetMusicLoopStartTime(M(0))) \
+	X(GetMusicLoopEndTime, "H", HTML5_Mix_GetMusicLoopEndTime(M(0))) \
+	X(GetMusicLoopLengthTime, "H", HTML5_Mix_GetMusicLoopLengthTime(M(0))) \
+	X(GetNumMusicDecoders, "", HTML5_Mix_GetNumMusicDecoders()) \
+	X(GetMusicDecoder, "i", HTML5_Mix_GetMusicDecoder(I(0))) \
+	X(HasMusicDecoder, "s", HTML5_Mix_HasMusicDecoder(S(0))) \
+	X(SetSoundFonts, "s", HTML5_Mix_SetSoundFonts(S(0))) \
+	X(GetSoundFonts, "", HTML5_Mix_GetSoundFonts()) \
+	X(RegisterEffect, "i", HTML5_Mix_RegisterEffect(I(0), NULL, NULL, NULL)) \
+	X(UnregisterEffect, "i", HTML5_Mix_UnregisterEffect(I(0), NULL)) \
+	X(UnregisterAllEffects, "i", HTML5_Mix_UnregisterAllEffects(I(0))) \
+	X(SetPostMix, "", HTML5_Mix_SetPostMix(NULL, NULL)) \
+	X(GetMusicEffectStats, "", HTML5_Mix_GetMusicEffectStats(&OUT.stats)) \
+	X(SetMusicFilter, "ifffi", HTML5_Mix_SetMusicFilter((HTML5_Mix_FilterType)I(0), F(1), F(2), F(3), I(4))) \
+	X(SetMusicPanning, "iii", HTML5_Mix_SetMusicPanning(I(0), I(1), I(2))) \
+	X(SetMusicDirection, "iii", HTML5_Mix_SetMusicDirection(I(0), I(1), I(2))) \
+	X(SetMusicCompressor, "fffffi", HTML5_Mix_SetMusicCompressor(F(0), F(1), F(2), F(3), F(4), I(5))) \
+	X(LoadMusicReverb, "s", HTML5_Mix_LoadMusicReverb(S(0))) \
+	X(SetMusicReverb, "fi", HTML5_Mix_SetMusicReverb(F(0), I(1))) \
+	X(SetPanning, "iii", HTML5_Mix_SetPanning(I(0), I(1), I(2))) \
+	X(SetPosition, "iii", HTML5_Mix_SetPosition(I(0), I(1), I(2))) \
+	X(SetDistance, "ii", HTML5_Mix_SetDistance(I(0), I(1))) \
+	X(SetMusicDucking, "fii", HTML5_Mix_SetMusicDucking(F(0), I(1), I(2))) \
+	X(DuckMusic, "i", HTML5_Mix_DuckMusic(I(0))) \
+	X(UnduckMusic, "i", HTML5_Mix_UnduckMusic(I(0))) \
+	X(DuckMusicFor, "i", HTML5_Mix_DuckMusicFor(I(0))) \
+	X(SetMusicAnalyser, "if", HTML5_Mix_SetMusicAnalyser(I(0), F(1))) \
+	X(GetMusicSpectrum, "i", HTML5_Mix_GetMusicSpectrum(OUT.floats, FLOATS(0))) \
+	X(GetMusicWaveform, "i", HTML5_Mix_GetMusicWaveform(OUT.floats, FLOATS(0))) \
+	X(MusicDuration, "H", HTML5_Mix_MusicDuration(M(0))) \
+	X(GetMusicType, "H", HTML5_Mix_GetMusicType(M(0))) \
+	X(GetMusicTitle, "H", HTML5_Mix_GetMusicTitle(M(0))) \
+	X(GetMusicTitleTag, "H", HTML5_Mix_GetMusicTitleTag(M(0))) \
+	X(GetMusicArtistTag, "H", HTML5_Mix_GetMusicArtistTag(M(0))) \
+	X(GetMusicAlbumTag, "H", HTML5_Mix_GetMusicAlbumTag(M(0))) \
+	X(GetMusicCopyrightTag, "H", HTML5_Mix_GetMusicCopyrightTag(M(0))) \
+	X(GetMusicInfo, "s", HTML5_Mix_GetMusicInfo(S(0), &OUT.info)) \
+	X(GetMusicInfo_RW, "R", HTML5_Mix_GetMusicInfo_RW(RW(0), &OUT.info)) \
+	X(HookMusicBuffered, "", HTML5_Mix_HookMusicBuffered(NULL)) \
+	X(GetMusicBuffered, "H", HTML5_Mix_GetMusicBuffered(M(0), &OUT.range[0], &OUT.range[1])) \
+	X(PrefetchMusic, "Hi", HTML5_Mix_PrefetchMusic(M(0), (HTML5_Mix_PrefetchPriority)I(1))) \
+	X(CancelPrefetch, "H", HTML5_Mix_CancelPrefetch(M(0))) \
+	X(SetMaxPrefetches, "i", HTML5_Mix_SetMaxPrefetches(I(0))) \
+	X(SetMusicPreload, "i", HTML5_Mix_SetMusicPreload((HTML5_Mix_Preload)I(0))) \
+	X(LoadMUSRange, "slls", RET(HTML5_Mix_LoadMUSRange(S(0), L(1), L(2), S(3))))
+
+#define MUSIC_TRACE_ENUM(name, signature, replay) MUSIC_TRACE_##name,
+
+typedef enum
+{
+	MUSIC_TRACE_HANDLE,
+	MUSIC_TRACE_CALLS(MUSIC_TRACE_ENUM)
+	MUSIC_TRACE_LAST
+} MusicTraceCall;
+
+#undef MUSIC_TRACE_ENUM
+
+#ifdef HTML5_MIXER_TRACE
+
+/* Record a call on entry to a public function; calls it makes itself
+   aren't recorded. Must be the first line of the function body. */
+#define MUSIC_TRACE(name, ...) \
+	int music_trace_scope __attribute__((cleanup(music_trace_leave))) = \
+		music_trace_enter(MUSIC_TRACE_##name, ##__VA_ARGS__)
+
+/* Number a music or stem group the traced call created */
+#define MUSIC_TRACE_CREATED(handle) music_trace_created(handle)
+
+extern int music_trace_enter(MusicTraceCall call, ...);
+extern void music_trace_leave(int *scope);
+extern void music_trace_created(const void *handle);
+
+extern int music_trace_start(void);
+extern int music_trace_stop(const char *file);
+extern const void *music_trace_data(size_t *size);
+
+#else
+
+#define MUSIC_TRACE(name, ...) ((void)0)
+#define MUSIC_TRACE_CREATED(handle) ((void)0)
+
+#endif
+
+#endif // HTML5_MUSIC_TRACE_H_
@@ -0,0 +1,103 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports playback control of music rendered by a worklet
+   processor. Such music is created by MusicHTML5_CreateWorkletMusic(), so
+   it is controlled like any other HTML5 music. */
+
+#include "music_worklet.h"
+#include "music_html5.h"
+
+#ifdef MUSIC_HTML5
+
+void MusicWorklet_SetVolume(void *context, int volume)
+{
+    Mix_MusicInterface_HTML5.SetVolume(context, volume);
+}
+
+int MusicWorklet_Play(void *context, int play_count)
+{
+    return Mix_MusicInterface_HTML5.Play(context, play_count);
+}
+
+void MusicWorklet_Prefetch(void *context)
+{
+    Mix_MusicInterface_HTML5.Prefetch(context);
+}
+
+SDL_bool MusicWorklet_IsPlaying(void *context)
+{
+    return Mix_MusicInterface_HTML5.IsPlaying(context);
+}
+
+int MusicWorklet_Seek(void *context, double position)
+{
+    return Mix_MusicInterface_HTML5.Seek(context, position);
+}
+
+double MusicWorklet_Tell(void *context)
+{
+    return Mix_MusicInterface_HTML5.Tell(context);
+}
+
+double MusicWorklet_Duration(void *context)
+{
+    return Mix_MusicInterface_HTML5.Duration(context);
+}
+
+int MusicWorklet_SetSpeed(void *context, double rate, SDL_bool preserve_pitch)
+{
+    return Mix_MusicInterface_HTML5.SetSpeed(context, rate, preserve_pitch);
+}
+
+const char *MusicWorklet_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
+{
+    return Mix_MusicInterface_HTML5.GetMetaTag(context, tag_type);
+}
+
+Mix_MusicType MusicWorklet_GetType(void *context)
+{
+    return Mix_MusicInterface_HTML5.GetType(context);
+}
+
+void MusicWorklet_Pause(void *context)
+{
+    Mix_MusicInterface_HTML5.Pause(context);
+}
+
+void MusicWorklet_Resume(void *context)
+{
+    Mix_MusicInterface_HTML5.Resume(context);
+}
+
+void MusicWorklet_Stop(void *context)
+{
+    Mix_MusicInterface_HTML5.Stop(context);
+}
+
+void MusicWorklet_Delete(void *context)
+{
+    Mix_MusicInterface_HTML5.Delete(context);
+}
+
+#endif /* MUSIC_HTML5 */
+
+/* vi: set ts=4 sw=4 expandtab: */
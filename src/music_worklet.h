@@ -0,0 +1,45 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2021 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file supports playback control of music rendered by a worklet processor */
+
+#ifndef MUSIC_WORKLET_H_
+#define MUSIC_WORKLET_H_
+
+#include "music.h"
+
+/* Interfaces built on MusicHTML5_CreateWorkletMusic() use these */
+extern void MusicWorklet_SetVolume(void *context, int volume);
+extern int MusicWorklet_Play(void *context, int play_count);
+extern void MusicWorklet_Prefetch(void *context);
+extern SDL_bool MusicWorklet_IsPlaying(void *context);
+extern int MusicWorklet_Seek(void *context, double position);
+extern double MusicWorklet_Tell(void *context);
+extern double MusicWorklet_Duration(void *context);
+extern int MusicWorklet_SetSpeed(void *context, double rate, SDL_bool preserve_pitch);
+extern const char *MusicWorklet_GetMetaTag(void *context, Mix_MusicMetaTag tag_type);
+extern Mix_MusicType MusicWorklet_GetType(void *context);
+extern void MusicWorklet_Pause(void *context);
+extern void MusicWorklet_Resume(void *context);
+extern void MusicWorklet_Stop(void *context);
+extern void MusicWorklet_Delete(void *context);
+
+#endif // MUSIC_WORKLET_H_
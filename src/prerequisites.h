@@ -23,6 +23,11 @@
 #ifndef PREREQUISITES_H_
 #define PREREQUISITES_H_
 
+// Native builds always have SDL
+#ifdef HTML5_MIXER_NATIVE
+#include <SDL.h>
+#endif
+
 // These checks don't work in *.c files.
 
 #ifdef SDL_VERSION
@@ -39,13 +44,26 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #ifndef HTML5_MIXER_HAVE_SDL
 #define SDL_Error(code) fprintf(stdout, "SDL Error: %d\n", code)
 #define SDL_SetError(...) {fprintf(stdout, __VA_ARGS__); fprintf(stdout, "\n");}
 #define SDL_calloc calloc
 #define SDL_malloc malloc
+#define SDL_realloc realloc
 #define SDL_free free
+#define SDL_memcmp memcmp
+#define SDL_memcpy memcpy
+#define SDL_memmove memmove
+#define SDL_memset memset
+#define SDL_strlen strlen
+#define SDL_strdup strdup
+#define SDL_strcasecmp strcasecmp
+#define SDL_snprintf snprintf
+#define SDL_min(x, y) (((x) < (y)) ? (x) : (y))
+#define SDL_arraysize(array) (sizeof(array)/sizeof(array[0]))
 #endif
 
 #ifndef HTML5_MIXER_HAVE_MIX
@@ -295,7 +313,11 @@ extern DECLSPEC void SDLCALL SDL_FreeRW(SDL_RWops * area);
  *
  *  \return the final offset in the data stream, or -1 on error.
  */
+#define SDL_RWsize(ctx)         (ctx)->size(ctx)
 #define SDL_RWseek(ctx, offset, whence) (ctx)->seek(ctx, offset, whence)
+#define SDL_RWtell(ctx)         (ctx)->seek(ctx, 0, RW_SEEK_CUR)
+#define SDL_RWread(ctx, ptr, size, n)   (ctx)->read(ctx, ptr, size, n)
+#define SDL_RWwrite(ctx, ptr, size, n)  (ctx)->write(ctx, ptr, size, n)
 
 #define SDL_RWclose(ctx)        (ctx)->close(ctx)
 
@@ -399,6 +421,16 @@ typedef struct SDL_AudioSpec
 
 #ifndef HTML5_MIXER_HAVE_MIX
 
+typedef enum
+{
+    MIX_INIT_FLAC   = 0x00000001,
+    MIX_INIT_MOD    = 0x00000002,
+    MIX_INIT_MP3    = 0x00000008,
+    MIX_INIT_OGG    = 0x00000010,
+    MIX_INIT_MID    = 0x00000020,
+    MIX_INIT_OPUS   = 0x00000040
+} MIX_InitFlags;
+
 /* The different fading types supported */
 typedef enum {
     MIX_NO_FADING,
@@ -418,15 +450,32 @@ typedef enum {
     MUS_MP3,
     MUS_MP3_MAD_UNUSED,
     MUS_FLAC,
-    MUS_MODPLUG_UNUSED
+    MUS_MODPLUG_UNUSED,
+    MUS_OPUS
 } Mix_MusicType;
 
+typedef enum {
+    MIX_META_TITLE,
+    MIX_META_ARTIST,
+    MIX_META_ALBUM,
+    MIX_META_COPYRIGHT,
+    MIX_META_LAST
+} Mix_MusicMetaTag;
+
 /* The internal format for a music chunk interpreted via mikmod */
 typedef struct _Mix_Music Mix_Music;
 
 #define SDL_MIX_MAXVOLUME (128)
 #define MIX_MAX_VOLUME SDL_MIX_MAXVOLUME
 
+/* Special Effects API by ryan c. gordon. (icculus@icculus.org) */
+
+#define MIX_CHANNEL_POST  (-2)
+
+typedef void (SDLCALL *Mix_EffectFunc_t)(int chan, void *stream, int len, void *udata);
+
+typedef void (SDLCALL *Mix_EffectDone_t)(int chan, void *udata);
+
 #endif // HTML5_MIXER_HAVE_MIX
 
 #endif // PREREQUISITES_H_
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# html5_mixer
+#
+# Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Serves a directory with HTTP Range support, standing in for the CDN
+# that HTML5_Mix_LoadMUSRange() fetches archive ranges from:
+#
+#   python3 tools/range_server.py --root build --port 8000
+#
+# --rate limits bytes per second, so progressive playback can be seen.
+# --no-ranges answers every request with the whole file, as servers that
+# ignore Range do.
+
+import argparse
+import os
+import re
+import time
+from functools import partial
+from http import HTTPStatus
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+CHUNK = 16 * 1024
+
+
+class RangeHandler(SimpleHTTPRequestHandler):
+    def __init__(self, *args, rate=0, ranges=True, **kwargs):
+        self.rate = rate
+        self.ranges = ranges
+        super().__init__(*args, **kwargs)
+
+    def end_headers(self):
+        # Pages served from elsewhere fetch from here too
+        self.send_header("Access-Control-Allow-Origin", "*")
+        self.send_header("Access-Control-Allow-Headers", "Range")
+        self.send_header("Access-Control-Expose-Headers", "Content-Range, Content-Length")
+        super().end_headers()
+
+    def do_OPTIONS(self):
+        self.send_response(HTTPStatus.NO_CONTENT)
+        self.end_headers()
+
+    def do_GET(self):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            return super().do_GET()
+
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+        status = HTTPStatus.OK
+
+        match = re.fullmatch(r"bytes=(\d*)-(\d*)", self.headers.get("Range", ""))
+        if self.ranges and match and (match.group(1) or match.group(2)):
+            if match.group(1):
+                start = int(match.group(1))
+                if match.group(2):
+                    end = min(int(match.group(2)), size - 1)
+            else:
+                # Suffix: the last N bytes
+                start = max(size - int(match.group(2)), 0)
+            if start >= size or start > end:
+                self.send_response(HTTPStatus.REQUESTED_RANGE_NOT_SATISFIABLE)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.end_headers()
+                return
+            status = HTTPStatus.PARTIAL_CONTENT
+
+        self.send_response(status)
+        self.send_header("Content-Type", self.guess_type(path))
+        self.send_header("Content-Length", str(end - start + 1))
+        if self.ranges:
+            self.send_header("Accept-Ranges", "bytes")
+        if status == HTTPStatus.PARTIAL_CONTENT:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, size))
+        self.end_headers()
+
+        with open(path, "rb") as f:
+            f.seek(start)
+            self.send_bytes(f, end - start + 1)
+
+    def send_bytes(self, f, left):
+        began = time.monotonic()
+        sent = 0
+        try:
+            while left > 0:
+                data = f.read(min(CHUNK, left))
+                if not data:
+                    break
+                self.wfile.write(data)
+                sent += len(data)
+                left -= len(data)
+                if self.rate > 0:
+                    ahead = sent / self.rate - (time.monotonic() - began)
+                    if ahead > 0:
+                        time.sleep(ahead)
+        except (BrokenPipeError, ConnectionResetError):
+            # The mixer aborts downloads it no longer needs
+            pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve files with HTTP Range support")
+    parser.add_argument("--root", default=".", help="directory to serve")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rate", type=int, default=0, help="bytes per second, 0 for no limit")
+    parser.add_argument("--no-ranges", action="store_true", help="ignore Range and send whole files")
+    args = parser.parse_args()
+
+    handler = partial(RangeHandler, directory=args.root, rate=args.rate, ranges=not args.no_ranges)
+    server = ThreadingHTTPServer(("", args.port), handler)
+    print("Serving %s on port %d" % (os.path.abspath(args.root), args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
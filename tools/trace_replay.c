@@ -0,0 +1,419 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Replays a trace recorded with HTML5_MIXER_TRACE against the library at
+// full speed, and reports the time spent in each call. Pauses between
+// calls are skipped, so this measures mixer overhead alone.
+//
+// In Node, with the browser stubbed out, from the repository root:
+//   emcc -O2 -sUSE_SDL=2 -sNODERAWFS -sENVIRONMENT=node -Iinclude
+//       src/*.c tools/trace_replay.c --pre-js tools/trace_replay_pre.js
+//       -o trace_replay.js
+//   node trace_replay.js session.h5mt
+//
+// In a browser, build without the stubs, -sNODERAWFS and -sENVIRONMENT,
+// --preload-file the trace and the music it loads, and pass the trace's
+// path in Module["arguments"].
+//
+// On desktop, against the native backend and a real audio device:
+//   cc -O2 -DHTML5_MIXER_NATIVE -Iinclude $(sdl2-config --cflags)
+//       src/*.c tools/trace_replay.c $(sdl2-config --libs) -o trace_replay
+//   ./trace_replay session.h5mt
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/html5_mixer.h"
+#include "../src/music_trace.h"
+
+#define REPLAY_MAX_ARGS 8
+#define REPLAY_FLOATS 16384
+
+typedef struct {
+	Sint64 i;
+	double d;
+	void *p;
+	int n;
+	SDL_bool owned;     // p is freed after the call
+} ReplayArg;
+
+typedef struct {
+	Uint32 calls;
+	double total_ms;
+	double peak_ms;
+} ReplayStats;
+
+#define REPLAY_SIGNATURE(name, signature, replay) signature,
+#define REPLAY_NAME(name, signature, replay) #name,
+
+static const char *const replay_signatures[] = {
+	"",     // MUSIC_TRACE_HANDLE
+	MUSIC_TRACE_CALLS(REPLAY_SIGNATURE)
+};
+
+static const char *const replay_names[] = {
+	"(handle)",
+	MUSIC_TRACE_CALLS(REPLAY_NAME)
+};
+
+static const Uint8 *replay_pos;
+static const Uint8 *replay_end;
+
+static ReplayArg replay_args[REPLAY_MAX_ARGS];
+static void *replay_result;
+
+static void **replay_handles = NULL;
+static Uint64 replay_num_handles = 0;
+
+static ReplayStats replay_stats[MUSIC_TRACE_LAST];
+
+// Scratch for what calls write out
+static struct {
+	float floats[REPLAY_FLOATS];
+	HTML5_Mix_EffectStats stats;
+	HTML5_Mix_MusicInfo info;
+	double range[2];
+} replay_out;
+
+// Argument accessors for the replay column of MUSIC_TRACE_CALLS
+#define I(arg) ((int)replay_args[arg].i)
+#define U(arg) ((size_t)replay_args[arg].i)
+#define L(arg) (replay_args[arg].i)
+#define F(arg) ((float)replay_args[arg].d)
+#define D(arg) (replay_args[arg].d)
+#define S(arg) ((const char *)replay_args[arg].p)
+#define M(arg) ((Mix_Music *)replay_args[arg].p)
+#define G(arg) ((HTML5_Mix_StemGroup *)replay_args[arg].p)
+#define RW(arg) ((SDL_RWops *)replay_args[arg].p)
+#define A(arg) ((Mix_Music **)replay_args[arg].p)
+#define SR(arg) ((const HTML5_Mix_SpriteRegion *)replay_args[arg].p)
+#define N(arg) (replay_args[arg].n)
+#define FLOATS(arg) SDL_min(I(arg), REPLAY_FLOATS)
+#define OUT replay_out
+#define RET(x) (replay_result = (void *)(x))
+
+static SDL_bool replay_truncated(size_t size)
+{
+	return (size_t)(replay_end - replay_pos) < size;
+}
+
+static Uint64 replay_varint(void)
+{
+	Uint64 value = 0;
+	int shift = 0;
+
+	while (replay_pos < replay_end && shift < 64) {
+		Uint8 byte = *replay_pos++;
+		value |= (Uint64)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+		shift += 7;
+	}
+	return value;
+}
+
+static void replay_bytes(void *data, size_t size)
+{
+	if (replay_truncated(size)) {
+		SDL_memset(data, 0, size);
+		replay_pos = replay_end;
+		return;
+	}
+	SDL_memcpy(data, replay_pos, size);
+	replay_pos += size;
+}
+
+static char *replay_string(void)
+{
+	Uint64 length = replay_varint();
+	char *value;
+
+	if (length == 0 || replay_truncated(length - 1))
+		return NULL;
+
+	value = (char *)SDL_malloc(length);
+	SDL_memcpy(value, replay_pos, length - 1);
+	value[length - 1] = '\0';
+	replay_pos += length - 1;
+	return value;
+}
+
+static void *replay_handle(void)
+{
+	Uint64 index = replay_varint();
+
+	// Handles made before the trace started are unknown
+	if (index == 0 || index > replay_num_handles)
+		return NULL;
+	return replay_handles[index - 1];
+}
+
+static void replay_set_handle(Uint64 index, void *handle)
+{
+	if (index == 0)
+		return;
+
+	if (index > replay_num_handles) {
+		replay_handles = (void **)SDL_realloc(replay_handles, index * sizeof *replay_handles);
+		SDL_memset(replay_handles + replay_num_handles, 0, (index - replay_num_handles) * sizeof *replay_handles);
+		replay_num_handles = index;
+	}
+	replay_handles[index - 1] = handle;
+}
+
+// Music loaded from memory keeps its bytes for the rest of the replay
+static SDL_RWops *replay_rw(void)
+{
+	Uint64 size = replay_varint();
+	void *data;
+
+	if (replay_truncated(size))
+		return NULL;
+
+	data = SDL_malloc(size ? size : 1);
+	SDL_memcpy(data, replay_pos, size);
+	replay_pos += size;
+	return SDL_RWFromConstMem(data, (int)size);
+}
+
+static void replay_read_args(const char *signature)
+{
+	int arg;
+
+	SDL_memset(replay_args, 0, sizeof replay_args);
+
+	for (arg = 0; *signature && arg < REPLAY_MAX_ARGS; ++signature, ++arg)
+	{
+		ReplayArg *a = &replay_args[arg];
+
+		switch (*signature)
+		{
+		case 'i':
+		case 'l': {
+			Uint64 value = replay_varint();
+			a->i = (Sint64)(value >> 1) ^ -(Sint64)(value & 1);
+			break;
+		}
+		case 'u':
+			a->i = (Sint64)replay_varint();
+			break;
+		case 'f': {
+			float value;
+			replay_bytes(&value, sizeof value);
+			a->d = value;
+			break;
+		}
+		case 'd':
+			replay_bytes(&a->d, sizeof a->d);
+			break;
+		case 's':
+			a->p = replay_string();
+			a->owned = SDL_TRUE;
+			break;
+		case 'H':
+		case 'F':
+			a->p = replay_handle();
+			break;
+		case 'R':
+			a->p = replay_rw();
+			break;
+		case 'A': {
+			Mix_Music **stems;
+			int i;
+
+			a->n = (int)replay_varint();
+			stems = (Mix_Music **)SDL_calloc(a->n ? a->n : 1, sizeof *stems);
+			for (i = 0; i < a->n; ++i)
+				stems[i] = (Mix_Music *)replay_handle();
+			a->p = stems;
+			a->owned = SDL_TRUE;
+			break;
+		}
+		case 'S': {
+			HTML5_Mix_SpriteRegion *regions;
+			int i;
+
+			a->n = (int)replay_varint();
+			regions = (HTML5_Mix_SpriteRegion *)SDL_calloc(a->n ? a->n : 1, sizeof *regions);
+			for (i = 0; i < a->n; ++i) {
+				regions[i].name = replay_string();
+				replay_bytes(&regions[i].start, sizeof regions[i].start);
+				replay_bytes(&regions[i].end, sizeof regions[i].end);
+			}
+			a->p = regions;
+			a->owned = SDL_TRUE;
+			break;
+		}
+		}
+	}
+}
+
+static void replay_free_args(const char *signature)
+{
+	int arg;
+
+	for (arg = 0; signature[arg] && arg < REPLAY_MAX_ARGS; ++arg)
+	{
+		ReplayArg *a = &replay_args[arg];
+		int i;
+
+		if (!a->owned)
+			continue;
+		if (signature[arg] == 'S')
+			for (i = 0; i < a->n; ++i)
+				SDL_free((void *)((HTML5_Mix_SpriteRegion *)a->p)[i].name);
+		SDL_free(a->p);
+	}
+}
+
+#define REPLAY_CALL(name, signature, replay) \
+	case MUSIC_TRACE_##name: (void)(replay); break;
+
+static void replay_call(MusicTraceCall call)
+{
+	switch (call)
+	{
+	MUSIC_TRACE_CALLS(REPLAY_CALL)
+	default:
+		break;
+	}
+}
+
+static int replay_compare(const void *a, const void *b)
+{
+	double x = replay_stats[*(const int *)a].total_ms;
+	double y = replay_stats[*(const int *)b].total_ms;
+	return (x < y) - (x > y);
+}
+
+static void replay_report(Uint32 calls, double session_ms, double replay_ms)
+{
+	int order[MUSIC_TRACE_LAST];
+	int i;
+
+	for (i = 0; i < MUSIC_TRACE_LAST; ++i)
+		order[i] = i;
+	qsort(order, MUSIC_TRACE_LAST, sizeof *order, replay_compare);
+
+	printf("Replayed %u calls from a %.1f s session in %.2f ms\n\n",
+		calls, session_ms / 1000.0, replay_ms);
+	printf("%-24s %8s %10s %9s %9s\n", "call", "count", "total ms", "mean us", "peak us");
+
+	for (i = 0; i < MUSIC_TRACE_LAST; ++i)
+	{
+		const ReplayStats *stats = &replay_stats[order[i]];
+
+		if (stats->calls == 0)
+			continue;
+		printf("%-24s %8u %10.3f %9.2f %9.2f\n", replay_names[order[i]], stats->calls,
+			stats->total_ms, stats->total_ms * 1000.0 / stats->calls, stats->peak_ms * 1000.0);
+	}
+}
+
+static Uint8 *replay_load(const char *file, size_t *size)
+{
+	FILE *fp = fopen(file, "rb");
+	Uint8 *data = NULL;
+	long length;
+
+	if (fp == NULL)
+		return NULL;
+
+	if (fseek(fp, 0, SEEK_END) == 0 && (length = ftell(fp)) > 0
+		&& fseek(fp, 0, SEEK_SET) == 0
+		&& (data = (Uint8 *)SDL_malloc(length)) != NULL
+		&& fread(data, 1, length, fp) == (size_t)length)
+		*size = (size_t)length;
+	else {
+		SDL_free(data);
+		data = NULL;
+	}
+
+	fclose(fp);
+	return data;
+}
+
+int main(int argc, char *argv[])
+{
+	Uint8 *trace;
+	size_t size = 0;
+	Uint32 calls = 0;
+	double session_ms = 0.0, replay_ms = 0.0;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s trace.h5mt\n", argv[0]);
+		return 1;
+	}
+
+	trace = replay_load(argv[1], &size);
+	if (trace == NULL || size < 5 || SDL_memcmp(trace, MUSIC_TRACE_MAGIC, 4) != 0) {
+		fprintf(stderr, "%s is not a trace\n", argv[1]);
+		return 1;
+	}
+	if (trace[4] != MUSIC_TRACE_VERSION) {
+		fprintf(stderr, "%s is version %d; this replays version %d\n", argv[1], trace[4], MUSIC_TRACE_VERSION);
+		return 1;
+	}
+
+	replay_pos = trace + 5;
+	replay_end = trace + size;
+
+	while (replay_pos < replay_end)
+	{
+		MusicTraceCall call = (MusicTraceCall)replay_varint();
+		const char *signature;
+		double start, elapsed;
+
+		session_ms += replay_varint() / 1000.0;
+
+		if (call == MUSIC_TRACE_HANDLE) {
+			replay_set_handle(replay_varint(), replay_result);
+			continue;
+		}
+		if (call >= MUSIC_TRACE_LAST) {
+			fprintf(stderr, "Unknown call %d; stopping\n", (int)call);
+			break;
+		}
+
+		signature = replay_signatures[call];
+		replay_read_args(signature);
+		replay_result = NULL;
+
+		start = music_trace_now();
+		replay_call(call);
+		elapsed = music_trace_now() - start;
+
+		replay_free_args(signature);
+
+		replay_stats[call].calls++;
+		replay_stats[call].total_ms += elapsed;
+		if (elapsed > replay_stats[call].peak_ms)
+			replay_stats[call].peak_ms = elapsed;
+		replay_ms += elapsed;
+		++calls;
+	}
+
+	replay_report(calls, session_ms, replay_ms);
+	SDL_free(trace);
+	return 0;
+}
@@ -0,0 +1,86 @@
+// html5_mixer
+//
+// Copyright (c) 2021 David Apollo (77db70f775fa0b590889c45371a70a1d23e99869d4565976a5207c11606fb6aa)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Stands in for the browser when tools/trace_replay.c runs in Node. Every
+// DOM and Web Audio object is an inert stub: properties read back what was
+// written, anything else is another stub, and calls return a stub or, for
+// the promise-returning methods, a resolved promise. Nothing plays, so a
+// replay in Node measures the mixer's own bookkeeping, not the browser's.
+
+(function() {
+    const promised = new Set([
+        "play", "resume", "suspend", "close", "decodeAudioData",
+        "arrayBuffer", "addModule"
+    ]);
+
+    function stub(name) {
+        const values = {};
+        const target = function() {};
+
+        return new Proxy(target, {
+            get: function(obj, key) {
+                if (key in values)
+                    return values[key];
+                if (key === Symbol.toPrimitive)
+                    return function(hint) { return hint === "string" ? "" : 0; };
+                // Never look like a promise
+                if (key === "then" || typeof key === "symbol")
+                    return undefined;
+                if (key === "canPlayType")
+                    return function() { return "probably"; };
+                if (promised.has(key))
+                    return function() { return Promise.resolve(stub(key)); };
+                values[key] = stub(key);
+                return values[key];
+            },
+            set: function(obj, key, value) {
+                values[key] = value;
+                return true;
+            },
+            has: function(obj, key) {
+                return true;
+            },
+            apply: function() {
+                return stub(name);
+            },
+            construct: function() {
+                return stub(name);
+            }
+        });
+    }
+
+    const names = [
+        "window", "document", "navigator", "Audio", "AudioContext", "webkitAudioContext",
+        "AudioWorkletNode"
+    ];
+    for (const name of names)
+        if (typeof globalThis[name] === "undefined")
+            globalThis[name] = stub(name);
+
+    // Music loaded by URL comes from a server the replay doesn't have
+    globalThis.fetch = function() { return Promise.resolve(stub("Response")); };
+
+    document.hidden = false;
+    document.visibilityState = "visible";
+    window.AudioContext = AudioContext;
+    window.webkitAudioContext = webkitAudioContext;
+})();